@@ -2370,6 +2370,9 @@ static const uint8_t rewind_fetch_tab[] = {
         if (maincpu_profiling) {
             profile_sample_start(reg_pc);
         }
+#ifdef USE_FUZZING
+        FUZZ_PC_HIT(reg_pc);
+#endif
 #endif
 
         SET_LAST_ADDR(reg_pc);
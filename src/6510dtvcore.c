@@ -1787,6 +1787,9 @@ static const uint8_t fetch_tab[] = {
         if (maincpu_profiling) {
             profile_sample_start(reg_pc);
         }
+#ifdef USE_FUZZING
+        FUZZ_PC_HIT(reg_pc);
+#endif
 #endif
 
         SET_LAST_ADDR(reg_pc);
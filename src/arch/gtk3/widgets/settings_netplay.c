@@ -9,6 +9,7 @@
  * $VICERES NetworkServerPort           -vsid
  * $VICERES NetworkServerBindAddress    -vsid
  * $VICERES NetworkControl              -vsid
+ * $VICERES NetworkSpectatorPort        -vsid
  */
 
 /*
@@ -78,7 +79,8 @@ static const char *net_modes[] = {
     "Idle",             /* NETWORK_IDLE */
     "Server",           /* NETWORK_SERVER */
     "Server connected", /* NETWORK_SERVER_CONNECTED */
-    "Client connected"  /* NETWORK_CLIENT */
+    "Client connected", /* NETWORK_CLIENT */
+    "Spectator"         /* NETWORK_SPECTATOR */
 };
 
 
@@ -93,6 +95,9 @@ static GtkWidget *client_address = NULL;
 /** \brief  Client and server port number */
 static GtkWidget *port_number = NULL;
 
+/** \brief  Spectator port number */
+static GtkWidget *spectator_port = NULL;
+
 /** \brief  Netplay status widget */
 static GtkWidget *netplay_status = NULL;
 
@@ -136,6 +141,8 @@ static void netplay_update_status(void)
     /* port cant be changed when network is active */
     gtk_widget_set_sensitive(port_number,
         (mode == NETWORK_IDLE) ? TRUE : FALSE);
+    gtk_widget_set_sensitive(spectator_port,
+        (mode == NETWORK_IDLE) ? TRUE : FALSE);
     /* server address can only be changed when server is selected, and we are idle */
     gtk_widget_set_sensitive(server_address,
         ((mode == NETWORK_IDLE) && server) ? TRUE : FALSE);
@@ -190,7 +197,7 @@ static void on_netplay_notify_active(GtkSwitch  *widget,
 
     debug_gtk3("active = %s, role = %s, mode = %s",
                active ? "TRUE" : "FALSE",
-               role == 0 ? "Server" : "Client",
+               role == 0 ? "Server" : (role == 1 ? "Client" : "Spectator"),
                mode >= 0 && mode < G_N_ELEMENTS(net_modes) ? net_modes[mode] : "(invalid)");
 
     /* disconnect when not idle */
@@ -206,12 +213,18 @@ static void on_netplay_notify_active(GtkSwitch  *widget,
                 log_error(LOG_DEFAULT, "Failed to start netplay server.");
                 failed = true;
            }
-        } else {
+        } else if (role == 1) {
             /* start the client */
             if (network_connect_client() < 0) {
                 log_error(LOG_DEFAULT, "Failed to start client.");
                 failed = true;
             }
+        } else {
+            /* watch the server */
+            if (network_connect_spectator() < 0) {
+                log_error(LOG_DEFAULT, "Failed to connect as spectator.");
+                failed = true;
+            }
         }
         if (failed) {
             g_signal_handler_block(widget, netplay_handler);
@@ -273,9 +286,17 @@ static GtkWidget *create_combo_box(void)
             NULL, "This emulator is the server");
     gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(combo),
             NULL, "This emulator is the client");
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(combo),
+            NULL, "This emulator is a spectator");
 
     if (netplay_mode < 0) {
-        netplay_mode = (mode == NETWORK_CLIENT ? 1 : 0);
+        if (mode == NETWORK_CLIENT) {
+            netplay_mode = 1;
+        } else if (mode == NETWORK_SPECTATOR) {
+            netplay_mode = 2;
+        } else {
+            netplay_mode = 0;
+        }
     }
     gtk_combo_box_set_active(GTK_COMBO_BOX(combo), netplay_mode);
 
@@ -454,6 +475,17 @@ GtkWidget *settings_netplay_widget_create(GtkWidget *parent)
     gtk_grid_attach(GTK_GRID(grid), port_number, 1, row, NUM_COLS - 1, 1);
     row++;
 
+    /* label */
+    label = label_helper("Spectator port (0: none)");
+    /* port */
+    spectator_port = vice_gtk3_resource_spin_int_new("NetworkSpectatorPort",
+                                                     0, 65535, 1);
+    gtk_widget_set_hexpand(spectator_port, FALSE);
+    gtk_widget_set_halign(spectator_port, GTK_ALIGN_START);
+    gtk_grid_attach(GTK_GRID(grid), label,          0, row, 1,            1);
+    gtk_grid_attach(GTK_GRID(grid), spectator_port, 1, row, NUM_COLS - 1, 1);
+    row++;
+
     /* Network status widgets */
 
     /* label */
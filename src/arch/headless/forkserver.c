@@ -0,0 +1,450 @@
+/** \file   forkserver.c
+ * \brief   Fork server for the headless UI
+ *
+ * With -forkserver the emulator initialises the machine as usual, but instead
+ * of running it waits for requests on a Unix domain socket. Every request
+ * forks a child that starts from the initialised machine, so a run costs
+ * little more than a fork().
+ *
+ * A request is a list of command line options, one per line, ended by an
+ * empty line:
+ *
+ * \code
+ *  -warp
+ *  -limitcycles
+ *  20000000
+ *  test.prg
+ *
+ * \endcode
+ *
+ * The options are applied in the child before the machine is reset, so an
+ * image given without an option is autostarted like on the command line
+ * (snapshots are loaded that way too). When the child exits the server
+ * replies on the same connection:
+ *
+ * \code
+ *  cycles <main cpu cycles run>
+ *  exit <exit code>            (or "signal <number>" if it was killed)
+ * \endcode
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef UNIX_COMPILE
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "archdep.h"
+#include "cmdline.h"
+#include "initcmdline.h"
+#include "lib.h"
+#include "log.h"
+#include "maincpu.h"
+#include "sid.h"
+#include "sound.h"
+#include "types.h"
+
+#include "forkserver.h"
+
+
+/** \brief  Maximum number of children running at the same time
+ */
+#define FORKSERVER_MAX_CHILDREN 64
+
+/** \brief  Maximum size of a request
+ */
+#define FORKSERVER_MAX_REQUEST  65536
+
+/** \brief  Path of the control socket, NULL if the fork server is not used
+ */
+static char *socket_path = NULL;
+
+
+static int set_fork_server(const char *value, void *extra_param)
+{
+    lib_free(socket_path);
+    socket_path = lib_strdup(value);
+    return 0;
+}
+
+static const cmdline_option_t cmdline_options[] =
+{
+    { "-forkserver", CALL_FUNCTION, CMDLINE_ATTRIB_NEED_ARGS,
+      set_fork_server, NULL, NULL, NULL,
+      "<Socket>", "Initialise the machine, then run it in a forked process for each request on the given Unix socket" },
+    CMDLINE_LIST_END
+};
+
+/** \brief  Register the command line options of the fork server
+ *
+ * \return  0 on success, -1 on failure
+ */
+int forkserver_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
+
+
+#ifdef UNIX_COMPILE
+
+typedef struct forkserver_child_s {
+    pid_t pid;  /**< process ID, 0 if the slot is free */
+    int fd;     /**< connection the request came from */
+} forkserver_child_t;
+
+static log_t forkserver_log = LOG_DEFAULT;
+static forkserver_child_t children[FORKSERVER_MAX_CHILDREN];
+static int num_children = 0;
+static int listen_fd = -1;
+
+/** \brief  Connection of the request a child runs, -1 in the server
+ */
+static int child_fd = -1;
+
+
+static void write_reply(int fd, const char *reply)
+{
+    size_t len = strlen(reply);
+
+    while (len > 0) {
+        ssize_t n = write(fd, reply, len);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        reply += n;
+        len -= (size_t)n;
+    }
+}
+
+/* runs when the child exits, however the emulation ended */
+static void child_atexit(void)
+{
+    char reply[64];
+
+    if (child_fd < 0) {
+        return;
+    }
+    snprintf(reply, sizeof reply, "cycles %"PRIu64"\n", (uint64_t)maincpu_clk);
+    write_reply(child_fd, reply);
+    close(child_fd);
+    child_fd = -1;
+}
+
+static void remove_socket(void)
+{
+    if (listen_fd >= 0 && socket_path != NULL) {
+        unlink(socket_path);
+    }
+}
+
+/* read a request, returns the options as a NULL terminated vector after
+   argv[0], or NULL on error */
+static char **read_request(int fd, int *argc)
+{
+    char *buf = lib_malloc(FORKSERVER_MAX_REQUEST + 1);
+    size_t len = 0;
+    char **argv;
+    char *p, *nl;
+    int n;
+
+    /* read until the empty line */
+    for (;;) {
+        ssize_t r;
+
+        if (len >= 2 && buf[len - 1] == '\n' && buf[len - 2] == '\n') {
+            break;
+        }
+        if (len == 1 && buf[0] == '\n') {
+            break;
+        }
+        if (len >= FORKSERVER_MAX_REQUEST) {
+            lib_free(buf);
+            return NULL;
+        }
+        r = read(fd, buf + len, FORKSERVER_MAX_REQUEST - len);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            if (len == 0) {
+                lib_free(buf);
+                return NULL;
+            }
+            /* a missing empty line at the end is fine */
+            break;
+        }
+        len += (size_t)r;
+    }
+    buf[len] = '\0';
+
+    /* split into lines, argv[0] is the program name */
+    n = 1;
+    for (p = buf; *p != '\0'; p++) {
+        if (*p == '\n') {
+            n++;
+        }
+    }
+    argv = lib_calloc((size_t)n + 2, sizeof(char *));
+    argv[0] = lib_strdup(archdep_program_name());
+    *argc = 1;
+    for (p = buf; *p != '\0'; p = nl + 1) {
+        nl = strchr(p, '\n');
+        if (nl == NULL) {
+            nl = p + strlen(p) - 1;
+        } else {
+            *nl = '\0';
+        }
+        if (*p != '\0') {
+            argv[(*argc)++] = lib_strdup(p);
+        }
+        if (nl[1] == '\0') {
+            break;
+        }
+    }
+    argv[*argc] = NULL;
+
+    lib_free(buf);
+    return argv;
+}
+
+static void free_request(char **argv)
+{
+    int i;
+
+    for (i = 0; argv[i] != NULL; i++) {
+        lib_free(argv[i]);
+    }
+    lib_free(argv);
+}
+
+/* report children that have exited to their clients */
+static void reap_children(int block)
+{
+    pid_t pid;
+    int status;
+
+    while ((pid = waitpid(-1, &status, block ? 0 : WNOHANG)) > 0) {
+        char reply[32];
+        int i;
+
+        block = 0;
+        for (i = 0; i < FORKSERVER_MAX_CHILDREN; i++) {
+            if (children[i].pid == pid) {
+                break;
+            }
+        }
+        if (i == FORKSERVER_MAX_CHILDREN) {
+            continue;
+        }
+        if (WIFSIGNALED(status)) {
+            snprintf(reply, sizeof reply, "signal %d\n", WTERMSIG(status));
+        } else {
+            snprintf(reply, sizeof reply, "exit %d\n", WEXITSTATUS(status));
+        }
+        write_reply(children[i].fd, reply);
+        close(children[i].fd);
+        children[i].pid = 0;
+        children[i].fd = -1;
+        num_children--;
+    }
+}
+
+/* set up a newly forked child, returns 0 if it can run */
+static int start_child(int fd, int argc, char **argv)
+{
+    int i;
+
+    signal(SIGPIPE, SIG_DFL);
+    close(listen_fd);
+    listen_fd = -1;
+    for (i = 0; i < FORKSERVER_MAX_CHILDREN; i++) {
+        if (children[i].pid != 0) {
+            close(children[i].fd);
+        }
+    }
+
+    child_fd = fd;
+    atexit(child_atexit);
+
+    /* per-run options, an image without an option is autostarted */
+    if (initcmdline_check_args(argc, argv) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* the reSIDfp tables are built when the first SID is created, do that once
+   here instead of in every child */
+static void prepare_sid(void)
+{
+    sound_t *psid = sid_sound_machine_open(0);
+
+    if (psid != NULL) {
+        sid_sound_machine_close(psid);
+    }
+}
+
+/** \brief  Serve requests until the server is killed
+ *
+ * Only returns in a child, which then runs the emulation, or if the fork
+ * server was not requested.
+ *
+ * \return  0 in a child or if the fork server is not used, -1 on error
+ */
+int forkserver_run(void)
+{
+    struct sockaddr_un addr;
+    int i;
+
+    if (socket_path == NULL) {
+        return 0;
+    }
+
+    forkserver_log = log_open("ForkServer");
+
+    if (strlen(socket_path) >= sizeof addr.sun_path) {
+        log_error(forkserver_log, "Socket path '%s' is too long.", socket_path);
+        return -1;
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        log_error(forkserver_log, "Cannot create socket: %s.", strerror(errno));
+        return -1;
+    }
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof addr) < 0
+        || listen(listen_fd, 16) < 0) {
+        log_error(forkserver_log, "Cannot listen on '%s': %s.",
+                  socket_path, strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+    atexit(remove_socket);
+
+    /* a client going away must not kill the server */
+    signal(SIGPIPE, SIG_IGN);
+
+    for (i = 0; i < FORKSERVER_MAX_CHILDREN; i++) {
+        children[i].pid = 0;
+        children[i].fd = -1;
+    }
+
+    prepare_sid();
+
+    log_message(forkserver_log, "Waiting for requests on '%s'.", socket_path);
+
+    for (;;) {
+        struct pollfd pfd;
+        int fd, argc;
+        char **argv;
+        pid_t pid;
+
+        reap_children(num_children >= FORKSERVER_MAX_CHILDREN);
+        if (num_children >= FORKSERVER_MAX_CHILDREN) {
+            continue;
+        }
+
+        pfd.fd = listen_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+
+        fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        argv = read_request(fd, &argc);
+        if (argv == NULL) {
+            close(fd);
+            continue;
+        }
+
+        /* don't let the child write out our buffered output again */
+        fflush(NULL);
+
+        pid = fork();
+        if (pid == 0) {
+            int result = start_child(fd, argc, argv);
+
+            free_request(argv);
+            if (result < 0) {
+                archdep_vice_exit(EXIT_FAILURE);
+            }
+            log_message(forkserver_log, "Running request in process %d.",
+                        (int)getpid());
+            return 0;
+        }
+        free_request(argv);
+
+        if (pid < 0) {
+            log_error(forkserver_log, "fork() failed: %s.", strerror(errno));
+            write_reply(fd, "error\n");
+            close(fd);
+            continue;
+        }
+        for (i = 0; i < FORKSERVER_MAX_CHILDREN; i++) {
+            if (children[i].pid == 0) {
+                children[i].pid = pid;
+                children[i].fd = fd;
+                num_children++;
+                break;
+            }
+        }
+    }
+}
+
+#else /* UNIX_COMPILE */
+
+int forkserver_run(void)
+{
+    if (socket_path != NULL) {
+        log_error(LOG_DEFAULT, "The fork server needs a Unix host.");
+        return -1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,485 @@
+/** \file   fuzz.c
+ * \brief   libFuzzer entry points for the headless emulators
+ *
+ * With --enable-fuzzing the headless emulators are linked against libFuzzer
+ * instead of having a main() of their own. The machine is initialised once
+ * in LLVMFuzzerInitialize() and each input is then handed to the target
+ * selected with the VICE_FUZZ_TARGET environment variable:
+ *
+ * \code
+ *  crt         cartridge image, attached and detached again
+ *  t64         T64 tape image, all files are read
+ *  tap         TAP tape image, all files are decoded and read
+ *  disk        disk image (D64, G64, P64, ...), all tracks are converted
+ *  psid        PSID/RSID file
+ *  snapshot    snapshot file
+ *  prg         program run on the emulated machine (default)
+ * \endcode
+ *
+ * The parsers only take file names, so the input is written to a temporary
+ * file first.
+ *
+ * The prg target boots the machine once and takes a snapshot. Each input
+ * restores that snapshot, copies the program to its load address (the first
+ * two bytes of the input), and runs it from there for VICE_FUZZ_CYCLES
+ * cycles (20000 by default). The CPU loop never returns, so it runs as a
+ * coroutine that is switched to for every input.
+ *
+ * With VICE_FUZZ_PC_COVERAGE=1 the instruction fetches of the emulated CPU
+ * are counted per address in a libFuzzer extra counters section (Linux
+ * only), so coverage of the guest code is used as feedback as well.
+ *
+ * Further emulator options can be given in VICE_FUZZ_ARGS, separated by
+ * spaces.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#ifdef USE_FUZZING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef UNIX_COMPILE
+#include <ucontext.h>
+#endif
+
+#include "alarm.h"
+#include "archdep.h"
+#include "cartridge.h"
+#include "diskimage.h"
+#include "gcr.h"
+#include "interrupt.h"
+#include "lib.h"
+#include "log.h"
+#include "machine.h"
+#include "main.h"
+#include "maincpu.h"
+#include "mem.h"
+#include "p64.h"
+#include "t64.h"
+#include "tap.h"
+#include "types.h"
+
+#include "fuzz.h"
+
+
+/** \brief  Cycles run to boot the machine before the prg target snapshot
+ */
+#define FUZZ_BOOT_CYCLES    3000000
+
+/** \brief  Default number of cycles an input of the prg target runs
+ */
+#define FUZZ_RUN_CYCLES     20000
+
+/** \brief  Stack size of the machine coroutine
+ */
+#define FUZZ_STACK_SIZE     (8 * 1024 * 1024)
+
+/** \brief  Maximum number of files read from a tape image
+ */
+#define FUZZ_MAX_TAPE_FILES 256
+
+/* libFuzzer picks up counters from this section on its own */
+#ifdef __linux__
+#define FUZZ_EXTRA_COUNTERS __attribute__((used, section("__libfuzzer_extra_counters")))
+#else
+#define FUZZ_EXTRA_COUNTERS
+#endif
+
+/** \brief  Instruction fetches of the main CPU per address
+ */
+uint8_t fuzz_pc_counters[FUZZ_PC_COUNTERS] FUZZ_EXTRA_COUNTERS;
+
+/** \brief  Count instruction fetches in fuzz_pc_counters
+ */
+int fuzz_pc_coverage = 0;
+
+
+typedef int (*fuzz_target_func_t)(const uint8_t *data, size_t size);
+
+static log_t fuzz_log = LOG_DEFAULT;
+
+/** \brief  Temporary file the parser targets read the input from
+ */
+static char *input_path = NULL;
+
+/** \brief  Temporary file the boot snapshot of the prg target is kept in
+ */
+static char *snapshot_path = NULL;
+
+static fuzz_target_func_t fuzz_target = NULL;
+
+
+static void remove_files(void)
+{
+    if (input_path != NULL) {
+        archdep_remove(input_path);
+    }
+    if (snapshot_path != NULL) {
+        archdep_remove(snapshot_path);
+    }
+}
+
+static int write_input(const uint8_t *data, size_t size)
+{
+    FILE *fd = fopen(input_path, MODE_WRITE);
+    int result = 0;
+
+    if (fd == NULL) {
+        return -1;
+    }
+    if (size > 0 && fwrite(data, 1, size, fd) != size) {
+        result = -1;
+    }
+    if (fclose(fd) != 0) {
+        result = -1;
+    }
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int fuzz_crt(const uint8_t *data, size_t size)
+{
+    if (write_input(data, size) < 0) {
+        return 0;
+    }
+    if (cartridge_attach_image(CARTRIDGE_CRT, input_path) == 0) {
+        cartridge_detach_image(-1);
+    }
+    return 0;
+}
+
+static int fuzz_t64(const uint8_t *data, size_t size)
+{
+    uint8_t buf[256];
+    unsigned int read_only = 1;
+    t64_t *t64;
+    int files;
+
+    if (write_input(data, size) < 0) {
+        return 0;
+    }
+    t64 = t64_open(input_path, &read_only);
+    if (t64 == NULL) {
+        return 0;
+    }
+    for (files = 0; files < FUZZ_MAX_TAPE_FILES; files++) {
+        if (t64_seek_to_next_file(t64, 0) < 0) {
+            break;
+        }
+        t64_get_current_file_record(t64);
+        while (t64_read(t64, buf, sizeof buf) > 0) {
+        }
+    }
+    t64_close(t64);
+    return 0;
+}
+
+static int fuzz_tap(const uint8_t *data, size_t size)
+{
+    uint8_t buf[256];
+    unsigned int read_only = 1;
+    tap_t *tap;
+    int files;
+
+    if (write_input(data, size) < 0) {
+        return 0;
+    }
+    tap = tap_open(input_path, &read_only);
+    if (tap == NULL) {
+        return 0;
+    }
+    for (files = 0; files < FUZZ_MAX_TAPE_FILES; files++) {
+        if (tap_seek_to_next_file(tap, 0) < 0) {
+            break;
+        }
+        tap_get_current_file_record(tap);
+        while (tap_read(tap, buf, sizeof buf) > 0) {
+        }
+    }
+    tap_close(tap);
+    return 0;
+}
+
+static int fuzz_disk(const uint8_t *data, size_t size)
+{
+    disk_image_t *image;
+    unsigned int i;
+
+    if (write_input(data, size) < 0) {
+        return 0;
+    }
+
+    image = disk_image_create();
+    image->gcr = NULL;
+    image->p64 = lib_calloc(1, sizeof(TP64Image));
+    P64ImageCreate((void *)image->p64);
+    image->read_only = 1;
+    image->device = DISK_IMAGE_DEVICE_FS;
+    disk_image_media_create(image);
+    disk_image_name_set(image, input_path);
+
+    if (disk_image_open(image) == 0) {
+        image->gcr = gcr_create_image();
+        if (disk_image_read_image(image) == 0) {
+            /* convert the tracks a drive would only convert when used */
+            for (i = 0; i < MAX_GCR_TRACKS; i++) {
+                if (image->gcr->pending[i]) {
+                    disk_image_load_half_track(image, i + 2);
+                }
+            }
+        }
+        disk_image_close(image);
+        gcr_destroy_image(image->gcr);
+    }
+
+    disk_image_media_destroy(image);
+    P64ImageDestroy((void *)image->p64);
+    lib_free(image->p64);
+    disk_image_destroy(image);
+    return 0;
+}
+
+static int fuzz_psid(const uint8_t *data, size_t size)
+{
+    if (write_input(data, size) == 0) {
+        machine_autodetect_psid(input_path);
+    }
+    return 0;
+}
+
+static int fuzz_snapshot(const uint8_t *data, size_t size)
+{
+    if (write_input(data, size) == 0) {
+        machine_read_snapshot(input_path, 0);
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef UNIX_COMPILE
+
+static ucontext_t fuzzer_context;
+static ucontext_t machine_context;
+static void *machine_stack = NULL;
+
+static alarm_t *run_alarm = NULL;
+static CLOCK run_cycles = FUZZ_RUN_CYCLES;
+static int snapshot_taken = 0;
+
+/* the input the machine runs next */
+static const uint8_t *run_data;
+static size_t run_size;
+
+
+static void load_program(void)
+{
+    uint16_t addr = (uint16_t)(run_data[0] | (run_data[1] << 8));
+    size_t i;
+
+    for (i = 2; i < run_size && i < 0x10002; i++) {
+        mem_inject((uint16_t)(addr + i - 2), run_data[i]);
+    }
+    maincpu_set_pc(addr);
+}
+
+/* runs with the CPU registers exported, so the machine can be left here */
+static void run_trap(uint16_t addr, void *data)
+{
+    if (!snapshot_taken) {
+        if (machine_write_snapshot(snapshot_path, 0, 0, 0) < 0) {
+            log_error(fuzz_log, "Cannot write the boot snapshot to '%s'.",
+                      snapshot_path);
+            archdep_vice_exit(EXIT_FAILURE);
+        }
+        snapshot_taken = 1;
+    }
+
+    /* back to LLVMFuzzerTestOneInput() until there is a new input */
+    swapcontext(&machine_context, &fuzzer_context);
+
+    if (machine_read_snapshot(snapshot_path, 0) < 0) {
+        log_error(fuzz_log, "Cannot restore the boot snapshot.");
+        archdep_vice_exit(EXIT_FAILURE);
+    }
+    load_program();
+    alarm_set(run_alarm, maincpu_clk + run_cycles);
+}
+
+static void run_alarm_handler(CLOCK offset, void *data)
+{
+    alarm_unset(run_alarm);
+    interrupt_maincpu_trigger_trap(run_trap, NULL);
+}
+
+static void machine_entry(void)
+{
+    /* doesn't return */
+    maincpu_mainloop();
+}
+
+static int fuzz_prg(const uint8_t *data, size_t size)
+{
+    if (size < 3) {
+        return 0;
+    }
+    run_data = data;
+    run_size = size;
+    swapcontext(&fuzzer_context, &machine_context);
+    return 0;
+}
+
+static int prg_init(void)
+{
+    const char *cycles = getenv("VICE_FUZZ_CYCLES");
+
+    if (cycles != NULL && strtoul(cycles, NULL, 0) > 0) {
+        run_cycles = (CLOCK)strtoul(cycles, NULL, 0);
+    }
+
+    run_alarm = alarm_new(maincpu_alarm_context, "Fuzz", run_alarm_handler, NULL);
+    alarm_set(run_alarm, maincpu_clk + FUZZ_BOOT_CYCLES);
+
+    machine_stack = lib_malloc(FUZZ_STACK_SIZE);
+    getcontext(&machine_context);
+    machine_context.uc_stack.ss_sp = machine_stack;
+    machine_context.uc_stack.ss_size = FUZZ_STACK_SIZE;
+    machine_context.uc_link = NULL;
+    makecontext(&machine_context, machine_entry, 0);
+
+    /* boot, returns when the boot snapshot has been taken */
+    log_message(fuzz_log, "Booting the machine.");
+    swapcontext(&fuzzer_context, &machine_context);
+    return 0;
+}
+
+#endif /* UNIX_COMPILE */
+
+/* ------------------------------------------------------------------------- */
+
+/* build the emulator command line from argv[0] and VICE_FUZZ_ARGS */
+static char **make_args(const char *program, int *argc)
+{
+    static const char * const defaults[] = {
+        "-default", "-silent", "-warp", "+sound"
+    };
+    const char *extra = getenv("VICE_FUZZ_ARGS");
+    char *copy = lib_strdup(extra != NULL ? extra : "");
+    char **argv;
+    char *p;
+    size_t n = 1 + sizeof defaults / sizeof defaults[0] + strlen(copy) + 1;
+    size_t i;
+
+    argv = lib_calloc(n, sizeof(char *));
+    *argc = 0;
+    argv[(*argc)++] = lib_strdup(program);
+    for (i = 0; i < sizeof defaults / sizeof defaults[0]; i++) {
+        argv[(*argc)++] = lib_strdup(defaults[i]);
+    }
+    for (p = strtok(copy, " "); p != NULL; p = strtok(NULL, " ")) {
+        argv[(*argc)++] = lib_strdup(p);
+    }
+    argv[*argc] = NULL;
+
+    lib_free(copy);
+    return argv;
+}
+
+/** \brief  Initialise the machine and the selected fuzz target
+ *
+ * Called once by libFuzzer before the first input.
+ *
+ * \param[in]   argc    pointer to the libFuzzer argument count
+ * \param[in]   argv    pointer to the libFuzzer argument vector
+ *
+ * \return  0
+ */
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    const char *target = getenv("VICE_FUZZ_TARGET");
+    const char *coverage = getenv("VICE_FUZZ_PC_COVERAGE");
+    char **vice_argv;
+    int vice_argc;
+
+    if (target == NULL) {
+        target = "prg";
+    }
+    if (coverage != NULL && strcmp(coverage, "1") == 0) {
+        fuzz_pc_coverage = 1;
+    }
+
+    vice_argv = make_args((*argv)[0], &vice_argc);
+    if (main_program(vice_argc, vice_argv) < 0) {
+        fprintf(stderr, "Cannot initialise the emulator.\n");
+        exit(EXIT_FAILURE);
+    }
+    fuzz_log = log_open("Fuzz");
+
+    input_path = archdep_tmpnam();
+    snapshot_path = archdep_tmpnam();
+    atexit(remove_files);
+
+    if (strcmp(target, "crt") == 0) {
+        fuzz_target = fuzz_crt;
+    } else if (strcmp(target, "t64") == 0) {
+        fuzz_target = fuzz_t64;
+    } else if (strcmp(target, "tap") == 0) {
+        fuzz_target = fuzz_tap;
+    } else if (strcmp(target, "disk") == 0) {
+        fuzz_target = fuzz_disk;
+    } else if (strcmp(target, "psid") == 0) {
+        fuzz_target = fuzz_psid;
+    } else if (strcmp(target, "snapshot") == 0) {
+        fuzz_target = fuzz_snapshot;
+#ifdef UNIX_COMPILE
+    } else if (strcmp(target, "prg") == 0) {
+        fuzz_target = fuzz_prg;
+        prg_init();
+#endif
+    } else {
+        log_error(fuzz_log, "Unknown fuzz target '%s'.", target);
+        exit(EXIT_FAILURE);
+    }
+
+    log_message(fuzz_log, "Fuzzing the %s target.", target);
+    return 0;
+}
+
+/** \brief  Run one input through the selected fuzz target
+ *
+ * \param[in]   data    input
+ * \param[in]   size    size of \a data
+ *
+ * \return  0
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    return fuzz_target(data, size);
+}
+
+#endif /* USE_FUZZING */
@@ -0,0 +1,52 @@
+/** \file   fuzz.h
+ * \brief   libFuzzer entry points for the headless emulators - header
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_FUZZ_H
+#define VICE_FUZZ_H
+
+#include <stddef.h>
+
+#include "types.h"
+
+/** \brief  Number of program counter coverage counters
+ */
+#define FUZZ_PC_COUNTERS    0x10000
+
+extern uint8_t fuzz_pc_counters[FUZZ_PC_COUNTERS];
+extern int fuzz_pc_coverage;
+
+/** \brief  Count an instruction fetch of the main CPU at \a pc
+ */
+#define FUZZ_PC_HIT(pc)                                              \
+    do {                                                             \
+        if (fuzz_pc_coverage) {                                      \
+            fuzz_pc_counters[(pc) & (FUZZ_PC_COUNTERS - 1)]++;       \
+        }                                                            \
+    } while (0)
+
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#endif
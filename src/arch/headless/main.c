@@ -42,6 +42,10 @@
 #endif
 
 
+#ifndef USE_FUZZING
+
+/* with --enable-fuzzing, main() is provided by libFuzzer, see fuzz.c */
+
 /** \brief  Program driver
  *
  * \param[in]   argc    argument count
@@ -60,6 +64,8 @@ int main(int argc, char **argv)
     return main_program(argc, argv);
 }
 
+#endif
+
 
 /** \brief  Exit handler
  */
@@ -0,0 +1,410 @@
+/** \file   sidrender.c
+ * \brief   Offline SID rendering for the headless VSID
+ *
+ * With -sidrender the tune given on the command line is played in warp mode
+ * and recorded by a sound recording device (-sidrenderformat, "wav" by
+ * default) to the given file, then VSID exits:
+ *
+ * \code
+ *  vsid -sidrender out.wav -tune 2 Commando.sid
+ * \endcode
+ *
+ * The length is taken from -sidrendertime, or else from the song length
+ * database of the HVSC (see -hvsc-root), or else it is three minutes.
+ *
+ * With -sidrenderdir every PSID file in a directory is rendered to a file
+ * next to it, by up to -sidrenderjobs processes at the same time (the number
+ * of CPUs by default). Each of them is forked from the initialised machine.
+ *
+ * The realtime factor is logged for every tune.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef UNIX_COMPILE
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "alarm.h"
+#include "archdep.h"
+#include "cmdline.h"
+#include "lib.h"
+#include "log.h"
+#include "machine.h"
+#include "maincpu.h"
+#include "resources.h"
+#include "sound.h"
+#include "types.h"
+#include "util.h"
+#include "vsync.h"
+
+#include "sidrender.h"
+
+
+/** \brief  Length of a tune in seconds if nothing else is known
+ */
+#define SIDRENDER_DEFAULT_LENGTH    180
+
+static log_t sidrender_log = LOG_DEFAULT;
+
+/** \brief  Output file for -sidrender, NULL if not rendering a single tune
+ */
+static char *output_file = NULL;
+
+/** \brief  Directory for -sidrenderdir, NULL if not rendering a directory
+ */
+static char *input_dir = NULL;
+
+/** \brief  Name of the sound recording device to use
+ */
+static char *output_format = NULL;
+
+/** \brief  Length in seconds, 0 to look it up
+ */
+static int render_time = 0;
+
+/** \brief  Number of processes for -sidrenderdir, 0 for the number of CPUs
+ */
+static int render_jobs = 0;
+
+/** \brief  Rendering runs in this process
+ */
+static bool rendering = false;
+
+static alarm_t *stop_alarm = NULL;
+static tick_t start_tick;
+static long tune_length;
+
+
+static int set_output_file(const char *value, void *extra_param)
+{
+    util_string_set(&output_file, value);
+    return 0;
+}
+
+static int set_input_dir(const char *value, void *extra_param)
+{
+    util_string_set(&input_dir, value);
+    return 0;
+}
+
+static int set_output_format(const char *value, void *extra_param)
+{
+    util_string_set(&output_format, value);
+    return 0;
+}
+
+static int set_render_time(const char *value, void *extra_param)
+{
+    render_time = atoi(value);
+    return render_time < 0 ? -1 : 0;
+}
+
+static int set_render_jobs(const char *value, void *extra_param)
+{
+    render_jobs = atoi(value);
+    return render_jobs < 0 ? -1 : 0;
+}
+
+static const cmdline_option_t cmdline_options[] =
+{
+    { "-sidrender", CALL_FUNCTION, CMDLINE_ATTRIB_NEED_ARGS,
+      set_output_file, NULL, NULL, NULL,
+      "<Name>", "Render the tune to the given file as fast as possible, then exit" },
+    { "-sidrenderdir", CALL_FUNCTION, CMDLINE_ATTRIB_NEED_ARGS,
+      set_input_dir, NULL, NULL, NULL,
+      "<Name>", "Render every PSID file in the given directory to a file next to it, then exit" },
+    { "-sidrenderformat", CALL_FUNCTION, CMDLINE_ATTRIB_NEED_ARGS,
+      set_output_format, NULL, NULL, NULL,
+      "<Name>", "Sound recording device to render with (wav, flac, ...)" },
+    { "-sidrendertime", CALL_FUNCTION, CMDLINE_ATTRIB_NEED_ARGS,
+      set_render_time, NULL, NULL, NULL,
+      "<seconds>", "Length to render, 0: use the song length database" },
+    { "-sidrenderjobs", CALL_FUNCTION, CMDLINE_ATTRIB_NEED_ARGS,
+      set_render_jobs, NULL, NULL, NULL,
+      "<number>", "Number of tunes to render at the same time with -sidrenderdir, 0: number of CPUs" },
+    CMDLINE_LIST_END
+};
+
+/** \brief  Register the command line options of the SID renderer
+ *
+ * The options are only available in VSID.
+ *
+ * \return  0 on success, -1 on failure
+ */
+int sidrender_cmdline_options_init(void)
+{
+    if (machine_class != VICE_MACHINE_VSID) {
+        return 0;
+    }
+    return cmdline_register_options(cmdline_options);
+}
+
+/** \brief  Check if this process renders a tune
+ *
+ * \return  true if rendering
+ */
+bool sidrender_active(void)
+{
+    return rendering;
+}
+
+
+static void stop_alarm_handler(CLOCK offset, void *data)
+{
+    double secs = (double)tick_now_delta(start_tick) / tick_per_second();
+
+    alarm_unset(stop_alarm);
+
+    /* write out what is left in the sample buffer */
+    sound_flush();
+
+    log_message(sidrender_log, "Rendered %ld s in %.2f s (%.1fx realtime).",
+                tune_length, secs, secs > 0.0 ? (double)tune_length / secs : 0.0);
+    archdep_vice_exit(EXIT_SUCCESS);
+}
+
+/** \brief  Start timing the tune
+ *
+ * Called when VSID starts playing a tune.
+ *
+ * \param[in]   psid_file   PSID file
+ * \param[in]   tune        tune number
+ * \param[in]   length      length from the song length database, -1 if unknown
+ */
+void sidrender_tune_started(const char *psid_file, int tune, long length)
+{
+    if (!rendering || stop_alarm != NULL) {
+        return;
+    }
+
+    if (render_time > 0) {
+        tune_length = render_time;
+    } else if (length > 0) {
+        tune_length = length;
+    } else {
+        log_warning(sidrender_log, "No song length known, rendering %d s.",
+                    SIDRENDER_DEFAULT_LENGTH);
+        tune_length = SIDRENDER_DEFAULT_LENGTH;
+    }
+
+    log_message(sidrender_log, "Rendering tune %d of '%s', %ld s.",
+                tune, psid_file != NULL ? psid_file : "", tune_length);
+
+    stop_alarm = alarm_new(maincpu_alarm_context, "SIDRender", stop_alarm_handler, NULL);
+    alarm_set(stop_alarm, maincpu_clk + (CLOCK)tune_length * (CLOCK)machine_get_cycles_per_second());
+    start_tick = tick_now();
+}
+
+/* record the machine running as fast as it can to the given file */
+static int start_rendering(const char *file)
+{
+    const char *format = output_format != NULL ? output_format : "wav";
+
+    if (resources_set_int("Sound", 1) < 0
+        || resources_set_string("SoundDeviceName", "dummy") < 0
+        || resources_set_string("SoundRecordDeviceArg", file) < 0
+        || resources_set_string("SoundRecordDeviceName", format) < 0
+        || resources_set_int("SoundEmulateOnWarp", 1) < 0) {
+        log_error(sidrender_log, "Cannot set up the sound recording.");
+        return -1;
+    }
+    sound_set_warp_mode_record(1);
+    vsync_set_warp_mode(1);
+    rendering = true;
+    return 0;
+}
+
+
+#ifdef UNIX_COMPILE
+
+/* file name of the output for a PSID file, with the extension replaced */
+static char *output_name(const char *psid_file)
+{
+    const char *format = output_format != NULL ? output_format : "wav";
+    const char *dot = strrchr(psid_file, '.');
+    int len = (int)(dot != NULL ? dot - psid_file : strlen(psid_file));
+
+    return lib_msprintf("%.*s.%s", len, psid_file, format);
+}
+
+/* set up a newly forked child for a tune, returns 0 if it can run */
+static int start_child(const char *psid_file)
+{
+    char *file = output_name(psid_file);
+    int result;
+
+    result = start_rendering(file);
+    lib_free(file);
+    if (result < 0) {
+        return -1;
+    }
+
+    if (machine_autodetect_psid(psid_file) < 0) {
+        log_error(sidrender_log, "'%s' is not a valid PSID file.", psid_file);
+        return -1;
+    }
+    machine_trigger_reset(MACHINE_RESET_MODE_POWER_CYCLE);
+    return 0;
+}
+
+/* render all PSID files of input_dir, only returns in a child */
+static int render_dir(void)
+{
+    archdep_dir_t *dir;
+    const char *name;
+    time_t start = time(NULL);
+    int running = 0;
+    int tunes = 0;
+    int failed = 0;
+    int status;
+    int jobs = render_jobs;
+
+    if (jobs == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        jobs = cpus > 0 ? (int)cpus : 1;
+    }
+
+    dir = archdep_opendir(input_dir, ARCHDEP_OPENDIR_NO_HIDDEN_FILES);
+    if (dir == NULL) {
+        log_error(sidrender_log, "Cannot open directory '%s'.", input_dir);
+        return -1;
+    }
+
+    log_message(sidrender_log, "Rendering the tunes in '%s' with %d processes.",
+                input_dir, jobs);
+
+    while ((name = archdep_readdir(dir)) != NULL) {
+        char *ext = util_get_extension(name);
+        char *path;
+        pid_t pid;
+
+        if (ext == NULL || util_strcasecmp(ext, "sid") != 0) {
+            lib_free(ext);
+            continue;
+        }
+        lib_free(ext);
+
+        /* wait for a free slot */
+        while (running >= jobs) {
+            if (wait(&status) > 0) {
+                running--;
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+                    failed++;
+                }
+            }
+        }
+
+        path = util_join_paths(input_dir, name, NULL);
+
+        /* don't let the child write out our buffered output again */
+        fflush(NULL);
+
+        pid = fork();
+        if (pid == 0) {
+            int result = start_child(path);
+
+            lib_free(path);
+            archdep_closedir(dir);
+            if (result < 0) {
+                archdep_vice_exit(EXIT_FAILURE);
+            }
+            return 0;
+        }
+        lib_free(path);
+
+        if (pid < 0) {
+            log_error(sidrender_log, "fork() failed: %s.", strerror(errno));
+            failed++;
+            continue;
+        }
+        running++;
+        tunes++;
+    }
+    archdep_closedir(dir);
+
+    while (running > 0) {
+        if (wait(&status) > 0) {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+                failed++;
+            }
+        } else if (errno != EINTR) {
+            break;
+        }
+    }
+
+    log_message(sidrender_log, "Rendered %d tunes in %.0f s, %d failed.",
+                tunes - failed, difftime(time(NULL), start), failed);
+    archdep_vice_exit(failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+    return -1;
+}
+
+#else /* UNIX_COMPILE */
+
+static int render_dir(void)
+{
+    log_error(sidrender_log, "-sidrenderdir needs a Unix host.");
+    return -1;
+}
+
+#endif
+
+/** \brief  Set up rendering if requested
+ *
+ * With -sidrenderdir this only returns in the processes that render a tune.
+ *
+ * \return  0 on success or if not rendering, -1 on error
+ */
+int sidrender_run(void)
+{
+    if (output_file == NULL && input_dir == NULL) {
+        return 0;
+    }
+
+    sidrender_log = log_open("SIDRender");
+
+    if (output_file != NULL && input_dir != NULL) {
+        log_error(sidrender_log, "Use either -sidrender or -sidrenderdir.");
+        return -1;
+    }
+    if (console_mode) {
+        log_error(sidrender_log, "Rendering doesn't work in console mode.");
+        return -1;
+    }
+
+    if (input_dir != NULL) {
+        return render_dir();
+    }
+    return start_rendering(output_file);
+}
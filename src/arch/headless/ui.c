@@ -67,6 +67,8 @@
 /* for the fullscreen_capability() stub */
 #include "fullscreen.h"
 
+#include "forkserver.h"
+#include "sidrender.h"
 #include "ui.h"
 
 
@@ -103,6 +105,12 @@ int ui_cmdline_options_init(void)
 {
     /* printf("%s\n", __func__); */
 
+    if (forkserver_cmdline_options_init() < 0) {
+        return -1;
+    }
+    if (sidrender_cmdline_options_init() < 0) {
+        return -1;
+    }
     return cmdline_register_options(cmdline_options_common);
 }
 
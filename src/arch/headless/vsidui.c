@@ -30,12 +30,18 @@
 
 #include <stdio.h>
 
+#include "lib.h"
 #include "ui.h"
 #include "vicii.h"
 #include "hvsc.h"
+#include "sidrender.h"
 #include "vsidui.h"
 
 
+/* PSID file being played, see c64/vsid.c */
+extern char *psid_autostart_image;
+
+
 void vsid_ui_close(void)
 {
     /* printf("%s\n", __func__); */
@@ -131,6 +137,23 @@ void vsid_ui_display_time(unsigned int dsec)
 void vsid_ui_display_tune_nr(int nr)
 {
     /* printf("%s\n", __func__); */
+
+    if (sidrender_active()) {
+        long *lengths = NULL;
+        long length = -1;
+        int num = -1;
+
+        if (psid_autostart_image != NULL) {
+            num = hvsc_sldb_get_lengths(psid_autostart_image, &lengths);
+        }
+        if (nr >= 1 && nr <= num) {
+            length = lengths[nr - 1];
+        }
+        if (lengths != NULL) {
+            lib_free(lengths);
+        }
+        sidrender_tune_started(psid_autostart_image, nr, length);
+    }
 }
 
 
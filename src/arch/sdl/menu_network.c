@@ -43,6 +43,7 @@
 UI_MENU_DEFINE_STRING(NetworkServerName)
 UI_MENU_DEFINE_STRING(NetworkServerBindAddress)
 UI_MENU_DEFINE_INT(NetworkServerPort)
+UI_MENU_DEFINE_INT(NetworkSpectatorPort)
 
 static UI_MENU_CALLBACK(custom_network_control_callback)
 {
@@ -133,6 +134,21 @@ static UI_MENU_CALLBACK(custom_connect_client_callback)
     return NULL;
 }
 
+static UI_MENU_CALLBACK(custom_connect_spectator_callback)
+{
+    if (activated) {
+        network_disconnect();
+        if (network_connect_spectator() < 0) {
+            ui_error("Couldn't connect as spectator.");
+        } else {
+            update_network_menu();
+            return sdl_menu_text_exit_ui;
+        }
+    }
+    update_network_menu();
+    return NULL;
+}
+
 static UI_MENU_CALLBACK(custom_start_server_callback)
 {
     if (activated) {
@@ -158,12 +174,14 @@ static UI_MENU_CALLBACK(custom_disconnect_callback)
 }
 
 #define OFFS_SERVER_PORT    1
-#define OFFS_SERVER_ADDR    3
-#define OFFS_START_SERVER   4
-#define OFFS_REMOTE_ADDR    6
-#define OFFS_START_CLIENT   7
-#define OFFS_DISCONNECT     9
-#define OFFS_CONTROL        11
+#define OFFS_SPECTATOR_PORT 2
+#define OFFS_SERVER_ADDR    4
+#define OFFS_START_SERVER   5
+#define OFFS_REMOTE_ADDR    7
+#define OFFS_START_CLIENT   8
+#define OFFS_START_SPECTATOR 9
+#define OFFS_DISCONNECT     11
+#define OFFS_CONTROL        13
 
 ui_menu_entry_t network_menu[] = {
     SDL_MENU_ITEM_TITLE("Netplay"),
@@ -173,42 +191,53 @@ ui_menu_entry_t network_menu[] = {
         .callback = int_NetworkServerPort_callback,
         .data     = (ui_callback_data_t)"Set network server port"
     },
+/* 2*/
+    {   .string   = "Spectator port",
+        .type     = MENU_ENTRY_RESOURCE_INT,
+        .callback = int_NetworkSpectatorPort_callback,
+        .data     = (ui_callback_data_t)"Set spectator port (0: no spectators)"
+    },
     SDL_MENU_ITEM_SEPARATOR,
 
-/* 3*/
+/* 4*/
     {   .string   = "Server address",
         .type     = MENU_ENTRY_RESOURCE_STRING,
         .callback = string_NetworkServerBindAddress_callback,
         .data     = (ui_callback_data_t)"Set network server bind address"
     },
-/* 4*/
+/* 5*/
     {   .string   = "Start server",
         .type     = MENU_ENTRY_OTHER,
         .callback = custom_start_server_callback
     },
     SDL_MENU_ITEM_SEPARATOR,
 
-/* 6*/
+/* 7*/
     {   .string   = "Remote Server",
         .type     = MENU_ENTRY_RESOURCE_STRING,
         .callback = string_NetworkServerName_callback,
         .data     = (ui_callback_data_t)"Set remote server address"
     },
-/* 7*/
+/* 8*/
     {   .string   = "Connect client",
         .type     = MENU_ENTRY_OTHER,
         .callback = custom_connect_client_callback
     },
+/* 9*/
+    {   .string   = "Connect as spectator",
+        .type     = MENU_ENTRY_OTHER,
+        .callback = custom_connect_spectator_callback
+    },
     SDL_MENU_ITEM_SEPARATOR,
 
-/* 9*/
+/*11*/
     {   .string   = "Disconnect",
         .type     = MENU_ENTRY_OTHER,
         .callback = custom_disconnect_callback
     },
     SDL_MENU_ITEM_SEPARATOR,
 
-/*11*/
+/*13*/
     {   .string   = "Control Settings",
         .type     = MENU_ENTRY_SUBMENU,
         .callback = submenu_callback,
@@ -222,9 +251,11 @@ static void update_network_menu(void)
     int mode = network_get_mode();
     network_menu[OFFS_START_SERVER].status = (mode == NETWORK_IDLE) ? MENU_STATUS_ACTIVE : MENU_STATUS_INACTIVE;
     network_menu[OFFS_START_CLIENT].status = (mode == NETWORK_IDLE) ? MENU_STATUS_ACTIVE : MENU_STATUS_INACTIVE;
+    network_menu[OFFS_START_SPECTATOR].status = (mode == NETWORK_IDLE) ? MENU_STATUS_ACTIVE : MENU_STATUS_INACTIVE;
     network_menu[OFFS_DISCONNECT].status = (mode != NETWORK_IDLE) ? MENU_STATUS_ACTIVE : MENU_STATUS_INACTIVE;
 
     network_menu[OFFS_SERVER_PORT].status = (mode == NETWORK_IDLE) ? MENU_STATUS_ACTIVE : MENU_STATUS_INACTIVE;
+    network_menu[OFFS_SPECTATOR_PORT].status = (mode == NETWORK_IDLE) ? MENU_STATUS_ACTIVE : MENU_STATUS_INACTIVE;
     network_menu[OFFS_SERVER_ADDR].status = (mode == NETWORK_IDLE) ? MENU_STATUS_ACTIVE : MENU_STATUS_INACTIVE;
     network_menu[OFFS_REMOTE_ADDR].status = (mode == NETWORK_IDLE) ? MENU_STATUS_ACTIVE : MENU_STATUS_INACTIVE;
     network_menu[OFFS_CONTROL].status = (mode == NETWORK_IDLE) ? MENU_STATUS_ACTIVE : MENU_STATUS_INACTIVE;
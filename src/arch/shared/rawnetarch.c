@@ -60,10 +60,14 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#ifdef UNIX_COMPILE
+#include <poll.h>
+#endif
 
 #ifdef HAVE_RAWNET
 
 #include "archdep_rawnet_capability.h"
+#include "rawnet.h"
 #include "rawnetarch.h"
 
 #ifdef WINDOWS_COMPILE
@@ -83,7 +87,7 @@ char *rawnet_arch_driver_name = NULL;
 
 /* Resources configuration ***************************************************/
 
-static int set_ethernet_driver(const char *name, void *param)
+static int set_ethernet_driver_unlocked(const char *name)
 {
     const rawnet_arch_driver_t *old_driver = rawnet_arch_driver;
     const char *ifname;
@@ -142,6 +146,18 @@ static int set_ethernet_driver(const char *name, void *param)
     return -1; /* Unsupported driver */
 }
 
+/* the receive thread must not use the driver while it is switched */
+static int set_ethernet_driver(const char *name, void *param)
+{
+    int result;
+
+    rawnet_lock();
+    result = set_ethernet_driver_unlocked(name);
+    rawnet_unlock();
+
+    return result;
+}
+
 static resource_string_t resources_string[] = {
     { "ETHERNET_DRIVER", NULL, RES_EVENT_NO, NULL,
       &rawnet_arch_driver_name, set_ethernet_driver, NULL },
@@ -359,6 +375,31 @@ int rawnet_arch_receive(uint8_t *pbuffer, int *plen, int *phashed, int *phash_in
     return rawnet_arch_driver->receive(pbuffer, plen, phashed, phash_index, prx_ok, pcorrect_mac, pbroadcast, pcrc_error);
 }
 
+/* Wait up to timeout_usec for a frame from the host, for the receive thread.
+   Returns 1 if one may be there, 0 on timeout and -1 if the driver can't be
+   waited for.  */
+int rawnet_arch_wait(int timeout_usec)
+{
+    struct pollfd pfd;
+    int fd = -1;
+
+    /* not while the driver is switched */
+    rawnet_lock();
+    if (rawnet_arch_driver != NULL && rawnet_arch_driver->selectable_fd != NULL) {
+        fd = rawnet_arch_driver->selectable_fd();
+    }
+    rawnet_unlock();
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return (poll(&pfd, 1, timeout_usec / 1000) > 0) ? 1 : 0;
+}
+
 int rawnet_arch_enumadapter_open(void)
 {
     if (rawnet_arch_driver != NULL) {
@@ -63,6 +63,7 @@ void rawnet_arch_line_ctl(int bEnableTransmitter, int bEnableReceiver);
 void rawnet_arch_transmit(int force, int onecoll, int inhibit_crc, int tx_pad_dis, int txlength, uint8_t *txframe);
 
 int rawnet_arch_receive(uint8_t *pbuffer, int *plen, int *phashed, int *phash_index, int *prx_ok, int *pcorrect_mac, int *pbroadcast, int *pcrc_error);
+int rawnet_arch_wait(int timeout_usec);
 
 int rawnet_arch_enumadapter_open(void);
 int rawnet_arch_enumadapter(char **ppname, char **ppdescription);
@@ -105,6 +106,9 @@ typedef struct rawnet_arch_driver_s {
 
     int (*receive)(uint8_t *pbuffer, int *plen, int *phashed, int *phash_index, int *prx_ok, int *pcorrect_mac, int *pbroadcast, int *pcrc_error);
 
+    /* file descriptor that becomes readable when a frame arrives, or -1 */
+    int (*selectable_fd)(void);
+
     int (*enumadapter_open)(void);
     int (*enumadapter)(char **ppname, char **ppdescription);
     int (*enumadapter_close)(void);
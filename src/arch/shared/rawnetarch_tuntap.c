@@ -307,6 +307,15 @@ static int rawnet_arch_tuntap_receive(uint8_t *pbuffer, int *plen, int  *phashed
     return 1;
 }
 
+/** \brief  Get the file descriptor to wait for frames with
+ *
+ * \return  file descriptor of the tap device, or -1 if it is not open
+ */
+static int rawnet_arch_tuntap_selectable_fd(void)
+{
+    return rawnet_arch_tuntap_tun_fd;
+}
+
 /** \brief  Find default device on which to capture
  *
  * \return  name of standard interface
@@ -333,6 +342,7 @@ rawnet_arch_driver_t rawnet_arch_driver_tuntap = {
     rawnet_arch_tuntap_transmit,
 
     rawnet_arch_tuntap_receive,
+    rawnet_arch_tuntap_selectable_fd,
 
     rawnet_arch_tuntap_enumadapter_open,
     rawnet_arch_tuntap_enumadapter,
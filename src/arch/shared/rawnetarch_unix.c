@@ -489,6 +489,19 @@ static int rawnet_arch_pcap_receive(uint8_t *pbuffer, int *plen, int  *phashed,
 }
 
 
+/** \brief  Get the file descriptor to wait for frames with
+ *
+ * \return  file descriptor, or -1 if the platform has none for the capture
+ */
+static int rawnet_arch_pcap_selectable_fd(void)
+{
+    if (rawnet_pcap_fp == NULL) {
+        return -1;
+    }
+    return pcap_get_selectable_fd(rawnet_pcap_fp);
+}
+
+
 /** \brief  Find default device on which to capture
  *
  * \return  name of standard interface
@@ -532,6 +545,7 @@ rawnet_arch_driver_t rawnet_arch_driver_pcap = {
     rawnet_arch_pcap_transmit,
 
     rawnet_arch_pcap_receive,
+    rawnet_arch_pcap_selectable_fd,
 
     rawnet_arch_pcap_enumadapter_open,
     rawnet_arch_pcap_enumadapter,
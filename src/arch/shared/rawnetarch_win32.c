@@ -550,6 +550,13 @@ int rawnet_arch_receive(uint8_t *pbuffer, int *plen, int *phashed, int *phash_in
     return 0;
 }
 
+/* The receive thread sleeps between polls here, the handle of the capture
+   is only available through the event functions of WinPcap/Npcap */
+int rawnet_arch_wait(int timeout_usec)
+{
+    return -1;
+}
+
 char *rawnet_arch_get_standard_interface(void)
 {
     char *dev, errbuf[PCAP_ERRBUF_SIZE];
@@ -163,6 +163,7 @@ static const sound_device_t aiff_device =
     NULL,
     0,
     2,
+    false,
     false
 };
 
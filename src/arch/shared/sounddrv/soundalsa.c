@@ -256,7 +256,8 @@ static const sound_device_t alsa_device =
     alsa_resume,
     1,
     2,
-    true
+    true,
+    false
 };
 
 int sound_init_alsa_device(void)
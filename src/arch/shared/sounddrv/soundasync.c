@@ -0,0 +1,261 @@
+/** \file   soundasync.c
+ * \brief   Run a sound recording device on its own thread
+ *
+ * Recording devices encode and write the samples in their write callback,
+ * which sound_flush() calls on the emulation thread. For the compressing
+ * devices (MP3, Ogg/Vorbis, FLAC) that costs a good part of the frame.
+ *
+ * soundasync_wrap() returns a device that only copies the samples into a
+ * block from a fixed pool and queues it. An encoder thread hands the queued
+ * blocks to the wrapped device. The recording must not lose samples, so
+ * when all blocks are queued the emulation waits for the encoder thread
+ * (this is counted as a stall and reported when the device is closed).
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef USE_VICE_THREAD
+#include <pthread.h>
+#endif
+
+#include "lib.h"
+#include "log.h"
+#include "sound.h"
+#include "types.h"
+
+
+#ifdef USE_VICE_THREAD
+
+/** \brief  Number of sample blocks in the pool
+ *
+ * sound_flush() writes about a fragment per call, so this holds a couple of
+ * seconds of audio.
+ */
+#define SOUNDASYNC_BLOCKS   256
+
+typedef struct soundasync_block_s {
+    int16_t *samples;   /**< sample buffer, grown to the largest write */
+    size_t size;        /**< allocated number of samples */
+    size_t used;        /**< number of samples in the block */
+} soundasync_block_t;
+
+static const sound_device_t *device = NULL;
+static sound_device_t async_device;
+
+static pthread_mutex_t async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t async_done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t async_thread;
+static bool async_running = false;
+static bool async_quit = false;
+
+static soundasync_block_t blocks[SOUNDASYNC_BLOCKS];
+static unsigned int block_head = 0;     /* next block to fill */
+static unsigned int block_tail = 0;     /* next block to encode */
+
+/* the first error of the wrapped device, reported by the next write */
+static int async_error = 0;
+
+/* statistics, logged when the device is closed */
+static unsigned long stat_blocks = 0;
+static unsigned long stat_samples = 0;
+static unsigned long stat_stalls = 0;
+static unsigned int stat_max_queued = 0;
+
+
+static void *async_thread_main(void *unused)
+{
+    pthread_mutex_lock(&async_lock);
+
+    for (;;) {
+        soundasync_block_t *block;
+        int err;
+
+        if (block_tail == block_head) {
+            if (async_quit) {
+                break;
+            }
+            pthread_cond_wait(&async_work_cond, &async_lock);
+            continue;
+        }
+
+        /* the emulation thread doesn't touch queued blocks */
+        block = &blocks[block_tail % SOUNDASYNC_BLOCKS];
+        pthread_mutex_unlock(&async_lock);
+
+        err = async_error ? 0 : device->write(block->samples, block->used);
+
+        pthread_mutex_lock(&async_lock);
+        if (err && !async_error) {
+            async_error = err;
+        }
+        block_tail++;
+        pthread_cond_signal(&async_done_cond);
+    }
+
+    pthread_mutex_unlock(&async_lock);
+    return NULL;
+}
+
+static int async_init(const char *param, int *speed, int *fragsize, int *fragnr, int *channels)
+{
+    int err;
+
+    if (device->init != NULL) {
+        err = device->init(param, speed, fragsize, fragnr, channels);
+        if (err) {
+            return err;
+        }
+    }
+
+    block_head = block_tail = 0;
+    async_error = 0;
+    async_quit = false;
+    stat_blocks = 0;
+    stat_samples = 0;
+    stat_stalls = 0;
+    stat_max_queued = 0;
+
+    if (pthread_create(&async_thread, NULL, async_thread_main, NULL) != 0) {
+        log_error(LOG_DEFAULT, "Cannot start the encoder thread for `%s', recording on the emulation thread.",
+                  device->name);
+        async_running = false;
+    } else {
+        async_running = true;
+    }
+    return 0;
+}
+
+static int async_write(int16_t *pbuf, size_t nr)
+{
+    soundasync_block_t *block;
+    unsigned int queued;
+
+    if (!async_running) {
+        return device->write(pbuf, nr);
+    }
+
+    pthread_mutex_lock(&async_lock);
+    if (async_error) {
+        pthread_mutex_unlock(&async_lock);
+        return async_error;
+    }
+    if (block_head - block_tail >= SOUNDASYNC_BLOCKS) {
+        stat_stalls++;
+        do {
+            pthread_cond_wait(&async_done_cond, &async_lock);
+        } while (block_head - block_tail >= SOUNDASYNC_BLOCKS);
+    }
+    pthread_mutex_unlock(&async_lock);
+
+    /* the block is free, fill it without holding the lock */
+    block = &blocks[block_head % SOUNDASYNC_BLOCKS];
+    if (block->size < nr) {
+        block->samples = lib_realloc(block->samples, nr * sizeof(int16_t));
+        block->size = nr;
+    }
+    memcpy(block->samples, pbuf, nr * sizeof(int16_t));
+    block->used = nr;
+
+    pthread_mutex_lock(&async_lock);
+    block_head++;
+    queued = block_head - block_tail;
+    if (queued > stat_max_queued) {
+        stat_max_queued = queued;
+    }
+    pthread_cond_signal(&async_work_cond);
+    pthread_mutex_unlock(&async_lock);
+
+    stat_blocks++;
+    stat_samples += (unsigned long)nr;
+    return 0;
+}
+
+static void async_close(void)
+{
+    int i;
+
+    if (async_running) {
+        /* let the encoder thread write what is queued */
+        pthread_mutex_lock(&async_lock);
+        async_quit = true;
+        pthread_cond_signal(&async_work_cond);
+        pthread_mutex_unlock(&async_lock);
+        pthread_join(async_thread, NULL);
+        async_running = false;
+
+        log_message(LOG_DEFAULT,
+                    "Sound recording `%s': %lu blocks, %lu samples, %u blocks queued at most, %lu stalls.",
+                    device->name, stat_blocks, stat_samples, stat_max_queued, stat_stalls);
+    }
+
+    if (device->close != NULL) {
+        device->close();
+    }
+
+    for (i = 0; i < SOUNDASYNC_BLOCKS; i++) {
+        lib_free(blocks[i].samples);
+        blocks[i].samples = NULL;
+        blocks[i].size = 0;
+    }
+}
+
+/** \brief  Run a sound recording device on its own thread
+ *
+ * Only one device can be wrapped at a time, wrapping a device again replaces
+ * the previous one, so it must be closed by then.
+ *
+ * \param[in]   dev recording device, must not be a realtime device
+ *
+ * \return  device that queues the writes for \a dev
+ */
+const sound_device_t *soundasync_wrap(const sound_device_t *dev)
+{
+    device = dev;
+
+    memset(&async_device, 0, sizeof async_device);
+    async_device.name = dev->name;
+    async_device.init = async_init;
+    async_device.write = async_write;
+    async_device.close = async_close;
+    async_device.need_attenuation = dev->need_attenuation;
+    async_device.max_channels = dev->max_channels;
+    async_device.is_timing_source = false;
+    async_device.is_synchronous = false;
+
+    return &async_device;
+}
+
+#else /* USE_VICE_THREAD */
+
+/* without threads the device is used as is */
+const sound_device_t *soundasync_wrap(const sound_device_t *dev)
+{
+    return dev;
+}
+
+#endif
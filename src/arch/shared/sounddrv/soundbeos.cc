@@ -170,6 +170,7 @@ static const sound_device_t beos_device =
     beos_resume,
     1,
     2,
+    false,
     false
 };
 
@@ -223,6 +223,7 @@ static const sound_device_t bsp_device =
     bsp_resume,
     1,
     2,
+    false,
     false
 };
 
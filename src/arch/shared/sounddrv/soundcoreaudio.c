@@ -777,7 +777,8 @@ static const sound_device_t coreaudio_device =
     coreaudio_resume,
     1,
     2,
-    true
+    true,
+    false
 };
 
 int sound_init_coreaudio_device(void)
@@ -48,6 +48,7 @@ static const sound_device_t dummy_device =
     NULL,
     0,
     2,
+    false,
     false
 };
 
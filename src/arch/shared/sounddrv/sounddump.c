@@ -99,6 +99,7 @@ static const sound_device_t dump_device =
     NULL,
     0,
     1,
+    false,
     false
 };
 
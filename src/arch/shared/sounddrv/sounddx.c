@@ -610,7 +610,8 @@ static const sound_device_t dx_device =
     dx_resume,
     0,
     2,           /* FIXME: should account for mono and stereo devices */
-    true
+    true,
+    false
 };
 
 int sound_init_dx_device(void)
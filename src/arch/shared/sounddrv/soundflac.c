@@ -181,6 +181,7 @@ static const sound_device_t flac_device =
     NULL,
     0,
     2,
+    false,
     false
 };
 
@@ -66,6 +66,7 @@ static const sound_device_t fs_device =
     NULL,
     0,
     1,
+    false,
     false
 };
 
@@ -169,6 +169,7 @@ static const sound_device_t iff_device =
     NULL,
     0,
     2,
+    false,
     false
 };
 
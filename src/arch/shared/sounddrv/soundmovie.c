@@ -118,7 +118,8 @@ static const sound_device_t soundmovie_device =
     NULL,
     0,
     2,
-    false
+    false,
+    true    /* the video encoders sync to the audio written so far */
 };
 
 int sound_init_movie_device(void)
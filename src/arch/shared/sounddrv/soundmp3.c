@@ -155,6 +155,7 @@ static const sound_device_t mp3_device =
     NULL,
     0,
     2,
+    false,
     false
 };
 
@@ -127,7 +127,8 @@ static const sound_device_t pulsedrv_device =
     NULL,
     1,
     2,
-    true
+    true,
+    false
 };
 
 int sound_init_pulse_device(void)
@@ -292,7 +292,8 @@ static const sound_device_t sdl_device =
     sdl_resume,
     1,
     2,
-    true
+    true,
+    false
 };
 
 int sound_init_sdl_device(void)
@@ -244,6 +244,7 @@ static const sound_device_t sun_device =
 #else
     2,
 #endif
+    false,
     false
 };
 
@@ -173,6 +173,7 @@ static const sound_device_t voc_device =
     NULL,
     0,
     2,
+    false,
     false
 };
 
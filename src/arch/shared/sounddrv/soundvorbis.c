@@ -167,6 +167,7 @@ static const sound_device_t vorbis_device =
     NULL,
     0,
     2,
+    false,
     false
 };
 
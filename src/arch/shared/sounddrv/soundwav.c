@@ -138,6 +138,7 @@ static const sound_device_t wav_device =
     NULL,
     0,
     2,
+    false,
     false
 };
 
@@ -542,7 +542,8 @@ static const sound_device_t wmm_device =
     wmm_resume,
     0,
     2,
-    true
+    true,
+    false
 };
 
 int sound_init_wmm_device(void)
@@ -787,6 +787,56 @@ void file_system_detach_disk_shutdown(void)
     }
 }
 
+/* Write the changes kept in the overlay of an image to the image file, see
+   imageoverlay.c. Returns 0 on success, -1 on error. */
+int file_system_overlay_commit(unsigned int unit, unsigned int drive)
+{
+    disk_image_t *image;
+
+    image = file_system_get_image(unit, drive);
+    if (image == NULL) {
+        log_error(attach_log, "No image attached to unit %u:%u.", unit, drive);
+        return -1;
+    }
+
+    /* tracks changed by the drive emulation go to the overlay first */
+    drive_gcr_data_writeback_all();
+    return disk_image_overlay_commit(image);
+}
+
+/* Throw away the changes to an image since the last commit. The drive and
+   vdrive let go of the image while doing so, and read it again afterwards.
+   Returns 0 on success, -1 on error. */
+int file_system_overlay_discard(unsigned int unit, unsigned int drive)
+{
+    vdrive_t *vdrive;
+    disk_image_t *image;
+    int err;
+
+    vdrive = file_system_get_vdrive(unit);
+    image = vdrive_get_image(vdrive, drive);
+    if (image == NULL) {
+        log_error(attach_log, "No image attached to unit %u:%u.", unit, drive);
+        return -1;
+    }
+
+    machine_drive_image_detach(image, unit, drive);
+    drive_image_detach(image, unit, drive);
+    vdrive_detach_image(image, unit, drive, vdrive);
+
+    disk_image_overlay_discard(image);
+
+    /* "wired OR" like in attach_disk_image() */
+    err = drive_image_attach(image, unit, drive);
+    err &= vdrive_attach_image(image, unit, drive, vdrive);
+    err &= machine_drive_image_attach(image, unit, drive);
+    if (err) {
+        log_error(attach_log, "Cannot attach the image to unit %u:%u again.", unit, drive);
+        return -1;
+    }
+    return 0;
+}
+
 void file_system_event_playback(unsigned int unit, unsigned int drive, const char *filename)
 {
     if (filename == NULL || filename[0] == 0) {
@@ -54,6 +54,8 @@ int file_system_attach_disk(unsigned int unit, unsigned int drive, const char *f
 void file_system_detach_disk(unsigned int unit, unsigned int drive);
 void file_system_detach_disk_all(void);
 void file_system_detach_disk_shutdown(void);
+int file_system_overlay_commit(unsigned int unit, unsigned int drive);
+int file_system_overlay_discard(unsigned int unit, unsigned int drive);
 struct vdrive_s *file_system_get_vdrive(unsigned int unit);
 struct disk_image_s *file_system_get_image(unsigned int unit, unsigned int drive);
 int file_system_bam_get_disk_id(unsigned int unit, unsigned int drive, uint8_t *id);
@@ -627,6 +627,7 @@ static int set_power_freq(int val, void *param)
 static int set_c128_hide_vdc(int val, void *param)
 {
     c128_hide_vdc = val ? 1 : 0;
+    c128video_update_refresh_threads();
     return 0;
 }
 
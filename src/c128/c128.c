@@ -1124,6 +1124,8 @@ int machine_specific_init(void)
         return -1;
     }
 
+    c128video_update_refresh_threads();
+
     cia1_init(machine_context.cia1);
     cia2_init(machine_context.cia2);
 
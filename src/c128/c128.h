@@ -75,4 +75,6 @@ void machine_autostart_reset_c64(void);
 void machine_tape_init_c64(void);
 void machine_tape_init_c128(void);
 
+void c128video_update_refresh_threads(void);
+
 #endif
@@ -29,6 +29,7 @@
 #include <stdio.h>
 
 #include "drive.h"
+#include "driverom.h"
 #include "iec-c64exp.h"
 #include "iec.h"
 #include "iec128dcr.h"
@@ -147,6 +148,9 @@ void machine_drive_rom_setup_image(unsigned int dnr)
 
 int machine_drive_rom_check_loaded(unsigned int type)
 {
+    /* test the ROMs of this type if that was skipped at startup */
+    driverom_probe_deferred(type);
+
     if (iec_drive_rom_check_loaded(type) == 0) {
         return 0;
     }
@@ -28,7 +28,12 @@
 
 #include <stdio.h>
 
+#include "videoarch.h"
+
+#include "c128.h"
+#include "machine.h"
 #include "machine-video.h"
+#include "resources.h"
 #include "vdc.h"
 #include "vicii.h"
 #include "video.h"
@@ -53,3 +58,35 @@ struct video_canvas_s *machine_video_canvas_get(unsigned int window)
 
     return NULL;
 }
+
+/** \brief  Render the VIC-II and VDC frames on their own threads if both
+ *          windows are shown
+ *
+ * Called when the canvases have been created and when the VDC window is
+ * hidden or shown. Only the GTK3 UI can refresh a canvas from another
+ * thread.
+ */
+void c128video_update_refresh_threads(void)
+{
+#ifdef USE_GTK3UI
+    struct video_canvas_s *vicii_canvas = vicii_get_canvas();
+    struct video_canvas_s *vdc_canvas = vdc_get_canvas();
+    int hide_vdc = 0;
+
+    if (vicii_canvas == NULL || vdc_canvas == NULL
+        || !vicii_canvas->created || !vdc_canvas->created) {
+        return;
+    }
+
+    resources_get_int("C128HideVDC", &hide_vdc);
+
+    if (!console_mode && !video_disabled_mode && !hide_vdc) {
+        if (video_canvas_refresh_thread_start(vicii_canvas) == 0
+            && video_canvas_refresh_thread_start(vdc_canvas) == 0) {
+            return;
+        }
+    }
+    video_canvas_refresh_thread_stop(vicii_canvas);
+    video_canvas_refresh_thread_stop(vdc_canvas);
+#endif
+}
@@ -605,7 +605,7 @@ static void ltk_imageopenall(void)
 
     /* purge out any old or stall file handles */
     for (i = 0; i < 56; i++) {
-        ltk_scsi.file[i] = NULL;
+        scsi_image_release(&ltk_scsi, i);
     }
 
     /* setup new ones */
@@ -1106,6 +1106,7 @@ static int mmc64_dump(void)
     mon_out("Clockport is %s.\n", mmc64_clockport_enabled ? "enabled" : "disabled");
     mon_out("Clockport mapped to $%04x.\n", (unsigned int)mmc64_hw_clockport);
     mon_out("Clockport device %s\n", clockport_device_id_to_name(clockport_device_id));
+    mmc_dump_card_stats();
 
     return 0;
 }
@@ -1465,6 +1466,9 @@ int mmc64_snapshot_write_module(snapshot_t *s)
 {
     snapshot_module_t *m;
 
+    /* write back cached sd card blocks, the image is not part of the snapshot */
+    mmc_flush_card_image();
+
     m = snapshot_module_create(s, snap_module_name, SNAP_MAJOR, SNAP_MINOR);
 
     if (m == NULL) {
@@ -1915,6 +1915,7 @@ static int mmcreplay_dump(void)
     /* mon_out("MMC Replay registers are %s.\n", mmcr_active ? "enabled" : "disabled"); */
     mon_out("Clockport is %s.\n", mmcr_clockport_enabled ? "enabled" : "disabled");
     mon_out("Clockport device: %s.\n", clockport_device_id_to_name(clockport_device_id));
+    mmc_dump_card_stats();
 
     return 0;
 }
@@ -3165,6 +3166,9 @@ int mmcreplay_snapshot_write_module(snapshot_t *s)
 {
     snapshot_module_t *m;
 
+    /* write back cached sd card blocks */
+    mmc_flush_card_image();
+
     m = snapshot_module_create(s, SNAP_MODULE_NAME,
                                CART_DUMP_VER_MAJOR, CART_DUMP_VER_MINOR);
     if (m == NULL) {
@@ -174,6 +174,8 @@ static sound_chip_t sfx_soundexpander_sound_chip = {
     sfx_soundexpander_sound_machine_calculate_samples, /* sound chip calculate samples function */
     sfx_soundexpander_sound_machine_store,             /* sound chip store function */
     sfx_soundexpander_sound_machine_read,              /* sound chip read function */
+    NULL,                                              /* NO sound chip shadow read function */
+    NULL,                                              /* NO sound chip shadow store function */
     sfx_soundexpander_sound_reset,                     /* sound chip reset function */
     sfx_soundexpander_sound_machine_cycle_based,       /* sound chip 'is_cycle_based()' function, sound chip is NOT cycle based */
     sfx_soundexpander_sound_machine_channels,          /* sound chip 'get_amount_of_channels()' function, sound chip has 1 channel */
@@ -823,6 +823,15 @@ int disk_image_write_p64_image(const disk_image_t *image)
     return 0;
 }
 
+int disk_image_overlay_commit(disk_image_t *image)
+{
+    return 0;
+}
+
+void disk_image_overlay_discard(disk_image_t *image)
+{
+}
+
 void disk_image_attach_log(const disk_image_t *image, signed int lognum, unsigned int unit, unsigned int drive)
 {
 }
@@ -940,6 +949,10 @@ void drive_shutdown(void)
 {
 }
 
+void drive_gcr_data_writeback_all(void)
+{
+}
+
 int drive_image_detach(disk_image_t *image, unsigned int unit, unsigned int drive)
 {
     return 0;
@@ -981,6 +994,23 @@ int drive_check_extend_policy(int drive_type)
     return 0;
 }
 
+drive_gcr_state_t *drive_gcr_state_new(void)
+{
+    return NULL;
+}
+
+void drive_gcr_state_free(drive_gcr_state_t *state)
+{
+}
+
+void drive_gcr_state_save(drive_gcr_state_t *state)
+{
+}
+
+void drive_gcr_state_restore(drive_gcr_state_t *state)
+{
+}
+
 int drive_check_idle_method(int drive_type)
 {
     return 0;
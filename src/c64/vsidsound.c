@@ -57,6 +57,8 @@ static sound_chip_t sid_sound_chip = {
     sid_sound_machine_calculate_samples, /* sound chip calculate samples function */
     sid_sound_machine_store,             /* sound chip store function */
     sid_sound_machine_read,              /* sound chip read function */
+    sid_sound_machine_shadow_read,       /* sound chip shadow read function */
+    sid_sound_machine_shadow_store,      /* sound chip shadow store function */
     sid_sound_machine_reset,             /* sound chip reset function */
     sid_sound_machine_cycle_based,       /* sound chip 'is_cycle_based()' function, RESID engine is cycle based, everything else is NOT */
     sid_sound_machine_channels,          /* sound chip 'get_amount_of_channels()' function, depends on how many extra SIDs are active */
@@ -37,6 +37,8 @@
 #include "archdep.h"
 #include "log.h"
 #include "ata.h"
+#include "blockcache.h"
+#include "imageoverlay.h"
 #include "snapshot.h"
 #include "types.h"
 #include "util.h"
@@ -79,6 +81,9 @@ struct ata_drive_s {
     int bufp;
     uint8_t *buffer;
     FILE *file;
+    blockcache_t *cache;
+    imageoverlay_t *overlay; /* changes kept in memory, or NULL */
+    int seekpos; /* sector of the next read or write */
     char *filename;
     char *myname;
     ata_drive_geometry_t geometry;
@@ -247,9 +252,7 @@ static int seek_sector(ata_drive_t *drv)
     drv->busy |= 2;
     alarm_set(drv->head_alarm, maincpu_clk + (CLOCK)(abs(drv->pos - lba) * drv->seek_time / drv->geometry.size));
     ata_change_power_mode(drv, 0xff);
-    if (archdep_fseeko(drv->file, (off_t)lba * drv->sector_size, SEEK_SET)) {
-        drv->error = drv->atapi ? 0x54 : ATA_IDNF;
-    }
+    drv->seekpos = lba;
     drv->pos = lba;
     return drv->error;
 }
@@ -282,16 +285,12 @@ static int read_sector(ata_drive_t *drv)
         return drv->error;
     }
 
-    clearerr(drv->file);
-    if (fread(drv->buffer, drv->sector_size, 1, drv->file) != 1) {
-        memset(drv->buffer, 0, drv->sector_size);
-    }
-
-    if (ferror(drv->file)) {
+    if (blockcache_read(drv->cache, drv->seekpos, drv->buffer) < 0) {
         ata_set_command_block(drv);
         drv->error = drv->atapi ? 0x54 : (ATA_UNC | ATA_ABRT);
         drv->cmd = 0x00;
     } else {
+        drv->seekpos++;
         drv->pos++;
         drv->bufp = 0;
     }
@@ -324,16 +323,18 @@ static int write_sector(ata_drive_t *drv)
         return drv->error;
     }
 
-    if (fwrite(drv->buffer, 1, drv->sector_size, drv->file) != (size_t)drv->sector_size) {
+    if (blockcache_write(drv->cache, drv->seekpos, drv->buffer) < 0) {
         ata_set_command_block(drv);
         drv->error = drv->atapi ? 0x54 : (ATA_UNC | ATA_ABRT);
         drv->cmd = 0x00;
     } else {
+        drv->seekpos++;
         drv->pos++;
     }
 
+    /* without write cache the sector goes to the image at once */
     if (!drv->wcache) {
-        if (fflush(drv->file)) {
+        if (blockcache_flush(drv->cache)) {
             ata_set_command_block(drv);
             drv->error = drv->atapi ? 0x54 : (ATA_UNC | ATA_ABRT);
             drv->cmd = 0x00;
@@ -537,6 +538,9 @@ ata_drive_t *ata_init(int drive)
     drv->myname = lib_msprintf("ATA%d", drive);
     drv->log = log_open(drv->myname);
     drv->file = NULL;
+    drv->cache = NULL;
+    drv->overlay = NULL;
+    drv->seekpos = 0;
     drv->filename = NULL;
     drv->buffer = lib_malloc(2048);
     drv->slave = drive & 1;
@@ -726,7 +730,7 @@ static void ata_execute_command(ata_drive_t *drv, uint8_t value)
             }
             debug((drv->log, "FLUSH CACHE"));
             if (drv->file) {
-                if (fflush(drv->file)) {
+                if (blockcache_flush(drv->cache)) {
                     drv->error = drv->atapi ? 0x54 : (ATA_UNC | ATA_ABRT);
                 }
             }
@@ -830,8 +834,8 @@ static void ata_execute_command(ata_drive_t *drv, uint8_t value)
                 case 0x82:
                     debug((drv->log, "SET DISABLE WRITE CACHE"));
                     drv->wcache = 0;
-                    if (drv->file) {
-                        fflush(drv->file);
+                    if (drv->file && blockcache_flush(drv->cache)) {
+                        drv->error = drv->atapi ? 0x54 : (ATA_UNC | ATA_ABRT);
                     }
                     return;
                 case 0x99:
@@ -1193,7 +1197,7 @@ void ata_register_store(ata_drive_t *drv, uint16_t addr, uint16_t value)
                                     drv->bufp = 0;
                                     return;
                                 }
-                                if (!drv->file || fflush(drv->file)) {
+                                if (!drv->file || blockcache_flush(drv->cache)) {
                                     drv->error = drv->atapi ? 0x54 : (ATA_UNC | ATA_ABRT);
                                     break;
                                 }
@@ -1257,10 +1261,8 @@ void ata_register_store(ata_drive_t *drv, uint16_t addr, uint16_t value)
 
 void ata_image_attach(ata_drive_t *drv, char *filename, ata_drive_type_t type, ata_drive_geometry_t geometry)
 {
-    if (drv->file != NULL) {
-        fclose(drv->file);
-        drv->file = NULL;
-    }
+    /* changes kept in an overlay are handled like on a detach */
+    ata_image_detach(drv);
 
     if (drv->filename != filename) {
         util_string_set(&drv->filename, filename);
@@ -1269,7 +1271,7 @@ void ata_image_attach(ata_drive_t *drv, char *filename, ata_drive_type_t type, a
 
     if (type != ATA_DRIVE_NONE) {
         if (drv->filename && drv->filename[0]) {
-            if (type != ATA_DRIVE_CD) {
+            if (type != ATA_DRIVE_CD && !imageoverlay_enabled()) {
                 drv->file = fopen(drv->filename, MODE_READ_WRITE);
             }
             if (!drv->file) {
@@ -1307,6 +1309,13 @@ void ata_image_attach(ata_drive_t *drv, char *filename, ata_drive_type_t type, a
     }
 
     if (drv->file) {
+        drv->cache = blockcache_new(drv->file, (unsigned int)drv->sector_size, BLOCKCACHE_DEFAULT_SIZE);
+        drv->seekpos = 0;
+        if (imageoverlay_enabled() && !drv->readonly) {
+            drv->overlay = imageoverlay_new(drv->file);
+            blockcache_set_overlay(drv->cache, drv->overlay);
+            log_message(drv->log, "Changes to `%s' are kept in memory.", drv->filename);
+        }
         if (drv->atapi) {
             log_message(drv->log, "Attached `%s' %u sectors total.",
                     drv->filename, (unsigned int)drv->geometry.size);
@@ -1327,6 +1336,19 @@ void ata_image_attach(ata_drive_t *drv, char *filename, ata_drive_type_t type, a
 void ata_image_detach(ata_drive_t *drv)
 {
     if (drv->file != NULL) {
+        if (drv->overlay && imageoverlay_commit_on_detach()
+            && ata_image_overlay_commit(drv) < 0) {
+            log_error(drv->log, "Changes to `%s' are lost.", drv->filename);
+        }
+        blockcache_destroy(drv->cache);
+        drv->cache = NULL;
+        if (drv->overlay) {
+            if (imageoverlay_dirty_pages(drv->overlay) > 0 && !imageoverlay_commit_on_detach()) {
+                log_message(drv->log, "Discarding changes to `%s'.", drv->filename);
+            }
+            imageoverlay_destroy(drv->overlay);
+            drv->overlay = NULL;
+        }
         fclose(drv->file);
         drv->file = NULL;
         log_message(drv->log, "Detached.");
@@ -1334,6 +1356,35 @@ void ata_image_detach(ata_drive_t *drv)
     return;
 }
 
+/* Write the changes kept in memory to the image file, returns 0 on
+   success */
+int ata_image_overlay_commit(ata_drive_t *drv)
+{
+    FILE *fd;
+    int result;
+
+    if (drv->overlay == NULL) {
+        return 0;
+    }
+    if (blockcache_flush(drv->cache) < 0) {
+        return -1;
+    }
+
+    fd = fopen(drv->filename, MODE_READ_WRITE);
+    if (fd == NULL) {
+        log_error(drv->log, "Cannot open `%s' for writing.", drv->filename);
+        return -1;
+    }
+    result = imageoverlay_commit(drv->overlay, fd);
+    if (fclose(fd) != 0) {
+        result = -1;
+    }
+    if (result == 0) {
+        log_message(drv->log, "Changes written to `%s'.", drv->filename);
+    }
+    return result;
+}
+
 int ata_image_change(ata_drive_t *drv, char *filename, ata_drive_type_t type, ata_drive_geometry_t geometry)
 {
     if (drv->type != type || drv->locked) {
@@ -1356,6 +1407,9 @@ int ata_register_dump(ata_drive_t *drv)
     mon_out("LBA high:     %02x\n", ata_register_peek(drv, 5));
     mon_out("Device:       %02x\n", ata_register_peek(drv, 6));
     mon_out("Status:       %02x\n", ata_register_peek(drv, 7));
+    if (drv->cache) {
+        blockcache_dump(drv->cache);
+    }
 
     return 0;
 }
@@ -1416,7 +1470,6 @@ int ata_snapshot_write_module(ata_drive_t *drv, snapshot_t *s)
     CLOCK spindle_clk = CLOCK_MAX;
     CLOCK head_clk = CLOCK_MAX;
     CLOCK standby_clk = CLOCK_MAX;
-    off_t pos = 0;
 
     m = snapshot_module_create(s, drv->myname,
                                CART_DUMP_VER_MAJOR, CART_DUMP_VER_MINOR);
@@ -1434,9 +1487,9 @@ int ata_snapshot_write_module(ata_drive_t *drv, snapshot_t *s)
         standby_clk = drv->standby_alarm->context->pending_alarms[drv->standby_alarm->pending_idx].clk;
     }
     if (drv->file) {
-        pos = archdep_ftello(drv->file);
-        if (pos < 0) {
-            pos = 0;
+        /* the image itself is not saved, so bring it up to date */
+        if (blockcache_flush(drv->cache) < 0) {
+            log_error(drv->log, "Cannot write pending changes to `%s'.", drv->filename);
         }
     }
 
@@ -1463,7 +1516,7 @@ int ata_snapshot_write_module(ata_drive_t *drv, snapshot_t *s)
     SMW_B(m, (uint8_t)drv->heads);
     SMW_B(m, (uint8_t)drv->sectors);
     SMW_DW(m, drv->pos);
-    SMW_DW(m, (uint32_t)(pos / drv->sector_size));
+    SMW_DW(m, (uint32_t)drv->seekpos);
     SMW_B(m, (uint8_t)drv->wcache);
     SMW_B(m, (uint8_t)drv->lookahead);
     SMW_B(m, (uint8_t)drv->busy);
@@ -1604,9 +1657,7 @@ int ata_snapshot_read_module(ata_drive_t *drv, snapshot_t *s)
         alarm_unset(drv->standby_alarm);
     }
 
-    if (drv->file) {
-        archdep_fseeko(drv->file, (off_t)pos * drv->sector_size, SEEK_SET);
-    }
+    drv->seekpos = pos;
     if (!drv->atapi) { /* atapi supports disc change events */
         drv->readonly = 1; /* make sure for ata that there's no filesystem corruption */
     }
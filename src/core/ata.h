@@ -47,6 +47,7 @@ int ata_register_dump(ata_drive_t *cdrive);
 void ata_image_attach(ata_drive_t *cdrive, char *filename, ata_drive_type_t type, ata_drive_geometry_t geometry);
 void ata_image_detach(ata_drive_t *cdrive);
 int ata_image_change(ata_drive_t *cdrive, char *filename, ata_drive_type_t type, ata_drive_geometry_t geometry);
+int ata_image_overlay_commit(ata_drive_t *cdrive);
 void ata_reset(ata_drive_t *cdrive);
 void ata_update_timing(ata_drive_t *drv, CLOCK cycles_1s);
 
@@ -0,0 +1,632 @@
+/*
+ * blockcache.c - Block cache for hard disk and memory card images
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The block devices (ATA, SCSI, SD card) access their image files through
+   this cache, so the emulated sector transfers become memory operations.
+
+   - blocks are kept in an LRU cache, found through a small hash table
+   - sequential reads are detected and read ahead in one host read, the
+     read-ahead window doubles with every sequential miss
+   - dirty blocks are written back in runs of consecutive blocks, either
+     when a dirty block gets evicted or when the cache is flushed
+   - in write-through mode every written block goes to the image at once
+   - with an overlay the image file is only read, changes go to memory */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "archdep.h"
+#include "blockcache.h"
+#include "imageoverlay.h"
+#include "lib.h"
+#include "log.h"
+#include "monitor.h"
+#include "types.h"
+
+/* #define BLOCKCACHE_DEBUG */
+
+#ifdef BLOCKCACHE_DEBUG
+#define DBG(_x_) log_debug _x_
+#else
+#define DBG(_x_)
+#endif
+
+/* minimum number of cached blocks */
+#define BLOCKCACHE_MIN_BLOCKS   8
+
+/* maximum number of blocks transferred in one host read or write */
+#define BLOCKCACHE_MAX_RUN      16
+
+typedef struct blockcache_entry_s {
+    off_t block;            /* block number inside the image */
+    unsigned int len;       /* number of valid bytes, less than a block at EOF */
+    unsigned int stamp;     /* last access, for LRU replacement */
+    int next;               /* next entry in the hash chain, -1 for none */
+    uint8_t valid;
+    uint8_t dirty;
+    uint8_t *data;
+} blockcache_entry_t;
+
+struct blockcache_s {
+    FILE *fd;
+    imageoverlay_t *overlay;        /* receives the changes instead of fd */
+    unsigned int block_size;
+    unsigned int num_entries;
+    unsigned int hash_mask;
+    unsigned int max_run;
+    blockcache_entry_t *entries;
+    blockcache_entry_t **order;     /* scratch list for write-back */
+    int *buckets;
+    uint8_t *data;
+    uint8_t *iobuf;                 /* buffer for read-ahead */
+    uint8_t *wbuf;                  /* buffer for write-back */
+    off_t size;                     /* image size in bytes */
+    off_t last_block;               /* last block accessed */
+    unsigned int readahead;         /* current read-ahead window */
+    unsigned int stamp;
+    unsigned int dirty;             /* number of dirty blocks */
+    int writethrough;
+    blockcache_stats_t stats;
+};
+
+/* ------------------------------------------------------------------------- */
+
+static unsigned int blockcache_hash(blockcache_t *bc, off_t block)
+{
+    return (unsigned int)(block ^ (block >> 16)) & bc->hash_mask;
+}
+
+static int blockcache_lookup(blockcache_t *bc, off_t block)
+{
+    int i = bc->buckets[blockcache_hash(bc, block)];
+
+    while (i >= 0) {
+        if (bc->entries[i].block == block) {
+            return i;
+        }
+        i = bc->entries[i].next;
+    }
+    return -1;
+}
+
+static void blockcache_unlink(blockcache_t *bc, int idx)
+{
+    int *p = &bc->buckets[blockcache_hash(bc, bc->entries[idx].block)];
+
+    while (*p >= 0) {
+        if (*p == idx) {
+            *p = bc->entries[idx].next;
+            break;
+        }
+        p = &bc->entries[*p].next;
+    }
+    bc->entries[idx].valid = 0;
+    bc->entries[idx].next = -1;
+}
+
+static void blockcache_link(blockcache_t *bc, int idx, off_t block)
+{
+    unsigned int h = blockcache_hash(bc, block);
+
+    bc->entries[idx].block = block;
+    bc->entries[idx].valid = 1;
+    bc->entries[idx].dirty = 0;
+    bc->entries[idx].next = bc->buckets[h];
+    bc->buckets[h] = idx;
+}
+
+static int blockcache_compare(const void *a, const void *b)
+{
+    off_t ba = (*(blockcache_entry_t * const *)a)->block;
+    off_t bb = (*(blockcache_entry_t * const *)b)->block;
+
+    return (ba > bb) - (ba < bb);
+}
+
+/* Read from the image, got is set to the number of bytes that were
+   inside the image. Returns -1 on a host read error. */
+static int blockcache_host_read(blockcache_t *bc, uint8_t *buf, size_t len, off_t offset, size_t *got)
+{
+    bc->stats.host_reads++;
+    if (bc->overlay) {
+        *got = imageoverlay_read(bc->overlay, buf, len, offset);
+        return 0;
+    }
+    *got = 0;
+    clearerr(bc->fd);
+    if (archdep_fseeko(bc->fd, offset, SEEK_SET) == 0) {
+        *got = fread(buf, 1, len, bc->fd);
+    }
+    return ferror(bc->fd) ? -1 : 0;
+}
+
+static int blockcache_host_write(blockcache_t *bc, const uint8_t *buf, size_t len, off_t offset)
+{
+    bc->stats.host_writes++;
+    if (bc->overlay) {
+        return imageoverlay_write(bc->overlay, buf, len, offset);
+    }
+    if (archdep_fseeko(bc->fd, offset, SEEK_SET) != 0
+        || fwrite(buf, 1, len, bc->fd) != len) {
+        return -1;
+    }
+    return 0;
+}
+
+static int blockcache_host_flush(blockcache_t *bc)
+{
+    if (bc->overlay) {
+        return 0;
+    }
+    return fflush(bc->fd) != 0 ? -1 : 0;
+}
+
+static off_t blockcache_host_size(blockcache_t *bc)
+{
+    off_t size;
+
+    if (bc->overlay) {
+        return imageoverlay_size(bc->overlay);
+    }
+    size = archdep_file_size(bc->fd);
+    return size < 0 ? 0 : size;
+}
+
+/* Write one run of consecutive blocks to the image. The blocks stay dirty
+   if the write fails, so a later flush can try again. */
+static int blockcache_write_run(blockcache_t *bc, blockcache_entry_t **run, unsigned int count)
+{
+    size_t total = 0;
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        memcpy(bc->wbuf + total, run[i]->data, run[i]->len);
+        total += run[i]->len;
+    }
+
+    if (blockcache_host_write(bc, bc->wbuf, total, run[0]->block * bc->block_size) < 0) {
+        log_error(LOG_DEFAULT, "blockcache: error writing %u block(s) at block %lu.",
+                  count, (unsigned long)run[0]->block);
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        run[i]->dirty = 0;
+        bc->dirty--;
+    }
+    return 0;
+}
+
+/* Write all dirty blocks back, consecutive blocks are combined */
+static int blockcache_writeback(blockcache_t *bc)
+{
+    unsigned int i, n = 0, start;
+    int result = 0;
+
+    if (bc->dirty == 0) {
+        return 0;
+    }
+
+    for (i = 0; i < bc->num_entries; i++) {
+        if (bc->entries[i].valid && bc->entries[i].dirty) {
+            bc->order[n++] = &bc->entries[i];
+        }
+    }
+    qsort(bc->order, n, sizeof(blockcache_entry_t *), blockcache_compare);
+
+    start = 0;
+    for (i = 1; i <= n; i++) {
+        /* a run ends at a gap, at a short block or when the buffer is full */
+        if (i == n
+            || bc->order[i]->block != bc->order[i - 1]->block + 1
+            || bc->order[i - 1]->len != bc->block_size
+            || i - start == bc->max_run) {
+            if (blockcache_write_run(bc, &bc->order[start], i - start) < 0) {
+                result = -1;
+            }
+            start = i;
+        }
+    }
+    return result;
+}
+
+/* Find a free entry, evicting the least recently used one if needed */
+static int blockcache_victim(blockcache_t *bc)
+{
+    unsigned int i;
+    int victim = -1;
+
+    for (i = 0; i < bc->num_entries; i++) {
+        if (!bc->entries[i].valid) {
+            return (int)i;
+        }
+        if (victim < 0 || bc->entries[i].stamp < bc->entries[victim].stamp) {
+            victim = (int)i;
+        }
+    }
+
+    if (bc->entries[victim].dirty) {
+        /* write back everything, dirty blocks usually come in bursts */
+        blockcache_writeback(bc);
+    }
+    if (bc->entries[victim].dirty) {
+        /* the write failed, keep the dirty blocks and use the least
+           recently used clean one instead */
+        int clean = -1;
+
+        for (i = 0; i < bc->num_entries; i++) {
+            if (!bc->entries[i].dirty
+                && (clean < 0 || bc->entries[i].stamp < bc->entries[clean].stamp)) {
+                clean = (int)i;
+            }
+        }
+        if (clean >= 0) {
+            victim = clean;
+        } else {
+            log_error(LOG_DEFAULT, "blockcache: cache full of unwritable blocks, block %lu is lost.",
+                      (unsigned long)bc->entries[victim].block);
+            bc->entries[victim].dirty = 0;
+            bc->dirty--;
+        }
+    }
+    blockcache_unlink(bc, victim);
+    return victim;
+}
+
+/* Get the entry for a block. If fill is zero the old contents are not
+   needed, because the block will be overwritten completely. */
+static blockcache_entry_t *blockcache_get(blockcache_t *bc, off_t block, int fill)
+{
+    blockcache_entry_t *e = NULL;
+    off_t offset;
+    size_t got = 0;
+    unsigned int count, i;
+    int idx;
+    int sequential;
+
+    bc->stamp++;
+    sequential = (block == bc->last_block + 1);
+    bc->last_block = block;
+
+    idx = blockcache_lookup(bc, block);
+    if (idx >= 0) {
+        bc->stats.hits++;
+        bc->entries[idx].stamp = bc->stamp;
+        return &bc->entries[idx];
+    }
+    bc->stats.misses++;
+
+    offset = block * bc->block_size;
+    count = 1;
+
+    if (fill && offset < bc->size) {
+        /* grow the read-ahead window while the access pattern is sequential */
+        if (sequential) {
+            bc->readahead = bc->readahead * 2;
+            if (bc->readahead > bc->max_run) {
+                bc->readahead = bc->max_run;
+            }
+        } else {
+            bc->readahead = 1;
+        }
+
+        /* never read past the end of the image or over cached blocks */
+        while (count < bc->readahead
+               && offset + (off_t)count * bc->block_size < bc->size
+               && blockcache_lookup(bc, block + count) < 0) {
+            count++;
+        }
+
+        if (blockcache_host_read(bc, bc->iobuf, (size_t)count * bc->block_size, offset, &got) < 0) {
+            log_error(LOG_DEFAULT, "blockcache: error reading block %lu.",
+                      (unsigned long)block);
+            return NULL;
+        }
+        bc->stats.readahead += count - 1;
+        DBG(("blockcache: read %u block(s) at %lu", count, (unsigned long)block));
+    }
+
+    /* fill in the blocks backwards, so the requested one is used last */
+    for (i = count; i-- > 0; ) {
+        size_t pos = (size_t)i * bc->block_size;
+        unsigned int len = 0;
+
+        if (got > pos) {
+            len = (got - pos) < bc->block_size ? (unsigned int)(got - pos) : bc->block_size;
+        }
+        idx = blockcache_victim(bc);
+        e = &bc->entries[idx];
+        blockcache_link(bc, idx, block + i);
+        e->stamp = bc->stamp;
+        e->len = len;
+        memcpy(e->data, bc->iobuf + pos, len);
+        memset(e->data + len, 0, bc->block_size - len);
+    }
+    return e;
+}
+
+/* Mark a block as changed, it goes to the image at once in write-through
+   mode */
+static int blockcache_modified(blockcache_t *bc, blockcache_entry_t *e)
+{
+    off_t end = e->block * bc->block_size + e->len;
+
+    if (end > bc->size) {
+        bc->size = end;
+    }
+    if (!e->dirty) {
+        e->dirty = 1;
+        bc->dirty++;
+    }
+    if (bc->writethrough) {
+        if (blockcache_write_run(bc, &e, 1) < 0 || blockcache_host_flush(bc) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Create a cache for an image file, cache_size is the amount of memory
+   used for blocks in bytes */
+blockcache_t *blockcache_new(FILE *fd, unsigned int block_size, unsigned int cache_size)
+{
+    blockcache_t *bc;
+    unsigned int i;
+
+    bc = lib_calloc(1, sizeof(blockcache_t));
+    bc->fd = fd;
+    bc->block_size = block_size;
+    bc->num_entries = cache_size / block_size;
+    if (bc->num_entries < BLOCKCACHE_MIN_BLOCKS) {
+        bc->num_entries = BLOCKCACHE_MIN_BLOCKS;
+    }
+    bc->max_run = bc->num_entries / 2;
+    if (bc->max_run > BLOCKCACHE_MAX_RUN) {
+        bc->max_run = BLOCKCACHE_MAX_RUN;
+    }
+    bc->hash_mask = 1;
+    while (bc->hash_mask < bc->num_entries) {
+        bc->hash_mask <<= 1;
+    }
+
+    bc->entries = lib_calloc(bc->num_entries, sizeof(blockcache_entry_t));
+    bc->order = lib_malloc(bc->num_entries * sizeof(blockcache_entry_t *));
+    bc->buckets = lib_malloc(bc->hash_mask * sizeof(int));
+    bc->data = lib_malloc((size_t)bc->num_entries * block_size);
+    bc->iobuf = lib_malloc((size_t)bc->max_run * block_size);
+    bc->wbuf = lib_malloc((size_t)bc->max_run * block_size);
+    bc->hash_mask--;
+
+    for (i = 0; i < bc->num_entries; i++) {
+        bc->entries[i].data = bc->data + (size_t)i * block_size;
+        bc->entries[i].next = -1;
+    }
+    for (i = 0; i <= bc->hash_mask; i++) {
+        bc->buckets[i] = -1;
+    }
+
+    bc->last_block = -2;
+    bc->readahead = 1;
+    bc->size = blockcache_host_size(bc);
+    return bc;
+}
+
+/* Write back all dirty blocks and free the cache, the file stays open */
+void blockcache_destroy(blockcache_t *bc)
+{
+    if (bc == NULL) {
+        return;
+    }
+    /* the file is not touched when nothing is pending, it may be closed
+       already */
+    if (bc->dirty && blockcache_flush(bc) < 0) {
+        log_error(LOG_DEFAULT, "blockcache: %u changed block(s) could not be written to the image.",
+                  bc->dirty);
+    }
+    lib_free(bc->entries);
+    lib_free(bc->order);
+    lib_free(bc->buckets);
+    lib_free(bc->data);
+    lib_free(bc->iobuf);
+    lib_free(bc->wbuf);
+    lib_free(bc);
+}
+
+FILE *blockcache_file(blockcache_t *bc)
+{
+    return bc->fd;
+}
+
+off_t blockcache_image_size(blockcache_t *bc)
+{
+    return bc->size;
+}
+
+/* Send all changes to an overlay from now on, the image file is only read
+   afterwards. NULL switches back to the file. */
+void blockcache_set_overlay(blockcache_t *bc, imageoverlay_t *ov)
+{
+    blockcache_flush(bc);
+    bc->overlay = ov;
+    bc->size = blockcache_host_size(bc);
+}
+
+/* In write-through mode writes go to the image at once */
+void blockcache_set_writethrough(blockcache_t *bc, int enable)
+{
+    bc->writethrough = enable;
+    if (enable) {
+        blockcache_flush(bc);
+    }
+}
+
+/* Read one block, blocks beyond the end of the image read as zeros.
+   Returns 0 on success, -1 on a host read error. */
+int blockcache_read(blockcache_t *bc, off_t block, uint8_t *buf)
+{
+    blockcache_entry_t *e;
+
+    bc->stats.reads++;
+    e = blockcache_get(bc, block, 1);
+    if (e == NULL) {
+        return -1;
+    }
+    memcpy(buf, e->data, bc->block_size);
+    return 0;
+}
+
+/* Write one block, returns 0 on success, -1 on a host write error */
+int blockcache_write(blockcache_t *bc, off_t block, const uint8_t *buf)
+{
+    blockcache_entry_t *e;
+
+    bc->stats.writes++;
+    e = blockcache_get(bc, block, 0);
+    if (e == NULL) {
+        return -1;
+    }
+    memcpy(e->data, buf, bc->block_size);
+    e->len = bc->block_size;
+    return blockcache_modified(bc, e);
+}
+
+/* Read len bytes at any offset, returns the number of bytes that are
+   inside the image */
+size_t blockcache_read_bytes(blockcache_t *bc, off_t offset, uint8_t *buf, size_t len)
+{
+    size_t done = 0, valid = 0;
+
+    bc->stats.reads++;
+    while (done < len) {
+        blockcache_entry_t *e;
+        unsigned int pos = (unsigned int)(offset % bc->block_size);
+        size_t count = bc->block_size - pos;
+
+        if (count > len - done) {
+            count = len - done;
+        }
+        e = blockcache_get(bc, offset / bc->block_size, 1);
+        if (e == NULL) {
+            break;
+        }
+        memcpy(buf + done, e->data + pos, count);
+        if (e->len > pos) {
+            valid = done + ((e->len - pos) < count ? (e->len - pos) : count);
+        }
+        done += count;
+        offset += count;
+    }
+    return valid;
+}
+
+/* Write len bytes at any offset, returns 0 on success, -1 on error */
+int blockcache_write_bytes(blockcache_t *bc, off_t offset, const uint8_t *buf, size_t len)
+{
+    size_t done = 0;
+    int result = 0;
+
+    bc->stats.writes++;
+    while (done < len) {
+        blockcache_entry_t *e;
+        unsigned int pos = (unsigned int)(offset % bc->block_size);
+        size_t count = bc->block_size - pos;
+
+        if (count > len - done) {
+            count = len - done;
+        }
+        /* a block that is overwritten completely does not need to be read */
+        e = blockcache_get(bc, offset / bc->block_size, count != bc->block_size);
+        if (e == NULL) {
+            return -1;
+        }
+        memcpy(e->data + pos, buf + done, count);
+        if (e->len < pos + count) {
+            e->len = (unsigned int)(pos + count);
+        }
+        if (blockcache_modified(bc, e) < 0) {
+            result = -1;
+        }
+        done += count;
+        offset += count;
+    }
+    return result;
+}
+
+/* Write all dirty blocks to the image, returns 0 on success. Blocks that
+   could not be written stay dirty and -1 is returned. */
+int blockcache_flush(blockcache_t *bc)
+{
+    int result = blockcache_writeback(bc);
+
+    if (blockcache_host_flush(bc) < 0) {
+        result = -1;
+    }
+    return result;
+}
+
+/* Write back and drop all cached blocks, for when the image was changed
+   behind the cache's back. If the dirty blocks can't be written, nothing is
+   dropped and -1 is returned. */
+int blockcache_invalidate(blockcache_t *bc)
+{
+    unsigned int i;
+
+    if (blockcache_flush(bc) < 0) {
+        return -1;
+    }
+    for (i = 0; i < bc->num_entries; i++) {
+        bc->entries[i].valid = 0;
+        bc->entries[i].next = -1;
+    }
+    for (i = 0; i <= bc->hash_mask; i++) {
+        bc->buckets[i] = -1;
+    }
+    bc->last_block = -2;
+    bc->readahead = 1;
+    bc->size = blockcache_host_size(bc);
+    return 0;
+}
+
+/* Print the cache statistics, for the monitor */
+void blockcache_dump(blockcache_t *bc)
+{
+    mon_out("Block cache:  %u blocks of %u bytes, %u dirty, %s\n",
+            bc->num_entries, bc->block_size, bc->dirty,
+            bc->writethrough ? "write-through" : "write-back");
+    if (bc->overlay) {
+        mon_out("Overlay:      %u pages not committed\n",
+                imageoverlay_dirty_pages(bc->overlay));
+    }
+    mon_out("Reads:        %lu\n", bc->stats.reads);
+    mon_out("Writes:       %lu\n", bc->stats.writes);
+    mon_out("Hits:         %lu\n", bc->stats.hits);
+    mon_out("Misses:       %lu\n", bc->stats.misses);
+    mon_out("Read-ahead:   %lu\n", bc->stats.readahead);
+    mon_out("Host reads:   %lu\n", bc->stats.host_reads);
+    mon_out("Host writes:  %lu\n", bc->stats.host_writes);
+}
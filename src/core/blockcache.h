@@ -0,0 +1,67 @@
+/*
+ * blockcache.h - Block cache for hard disk and memory card images
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_BLOCKCACHE_H
+#define VICE_BLOCKCACHE_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "types.h"
+
+/* default amount of memory used for cached blocks of one image */
+#define BLOCKCACHE_DEFAULT_SIZE (128 * 1024)
+
+typedef struct blockcache_stats_s {
+    unsigned long reads;        /* blocks read by the emulation */
+    unsigned long writes;       /* blocks written by the emulation */
+    unsigned long hits;         /* block found in the cache */
+    unsigned long misses;       /* block had to be read from the image */
+    unsigned long readahead;    /* blocks read in advance */
+    unsigned long host_reads;   /* read calls to the host file */
+    unsigned long host_writes;  /* write calls to the host file */
+} blockcache_stats_t;
+
+typedef struct blockcache_s blockcache_t;
+
+struct imageoverlay_s;
+
+blockcache_t *blockcache_new(FILE *fd, unsigned int block_size, unsigned int cache_size);
+void blockcache_destroy(blockcache_t *bc);
+
+FILE *blockcache_file(blockcache_t *bc);
+off_t blockcache_image_size(blockcache_t *bc);
+void blockcache_set_writethrough(blockcache_t *bc, int enable);
+void blockcache_set_overlay(blockcache_t *bc, struct imageoverlay_s *ov);
+
+int blockcache_read(blockcache_t *bc, off_t block, uint8_t *buf);
+int blockcache_write(blockcache_t *bc, off_t block, const uint8_t *buf);
+size_t blockcache_read_bytes(blockcache_t *bc, off_t offset, uint8_t *buf, size_t len);
+int blockcache_write_bytes(blockcache_t *bc, off_t offset, const uint8_t *buf, size_t len);
+
+int blockcache_flush(blockcache_t *bc);
+int blockcache_invalidate(blockcache_t *bc);
+
+void blockcache_dump(blockcache_t *bc);
+
+#endif
@@ -43,6 +43,7 @@
 #include "lib.h"
 #include "log.h"
 #include "monitor.h"
+#include "rawnet.h"
 #include "rawnetarch.h"
 #include "resources.h"
 #include "snapshot.h"
@@ -358,7 +359,9 @@ void cs8900_reset(void)
     assert(cs8900);
     assert(cs8900_packetpage);
 
+    rawnet_lock();
     rawnet_arch_pre_reset();
+    rawnet_unlock();
 
     /* initialize visible IO register and PacketPage registers */
     memset(cs8900, 0, CS8900_COUNT_IO_REGISTER);
@@ -420,7 +423,12 @@ void cs8900_reset(void)
     cs8900_set_transmitter(0);
     cs8900_set_receiver(0);
 
+    rawnet_lock();
     rawnet_arch_post_reset();
+    rawnet_unlock();
+
+    /* frames received before the reset are gone */
+    rawnet_rx_flush();
 
     log_message(cs8900_log, "CS8900a rev.D reset");
 }
@@ -469,6 +477,9 @@ int cs8900_activate(const char *net_interface)
 
     /* virtually reset the LAN chip */
     cs8900_reset();
+
+    /* read frames from the host in the background if possible */
+    rawnet_rx_start();
     return 0;
 }
 
@@ -480,6 +491,7 @@ int cs8900_deactivate(void)
 
     assert(cs8900 && cs8900_packetpage);
 
+    rawnet_rx_stop();
     rawnet_arch_deactivate();
 
     lib_free(cs8900);
@@ -655,7 +667,7 @@ static uint16_t cs8900_receive(void)
 
         ready = 1;  /* assume we will find a good frame */
 
-        newframe = rawnet_arch_receive(buffer, &len, &hashed, &hash_index, &rx_ok, &correct_mac, &broadcast, &crc_error);
+        newframe = rawnet_receive(buffer, &len, &hashed, &hash_index, &rx_ok, &correct_mac, &broadcast, &crc_error);
 
         assert((len & 1) == 0); /* length has to be even! */
 
@@ -784,12 +796,14 @@ static void cs8900_write_tx_buffer(uint8_t value, int odd_address)
             } else {
                 /* send frame */
                 uint16_t txcmd = GET_PP_16(CS8900_PP_ADDR_CC_TXCMD);
+                rawnet_lock();
                 rawnet_arch_transmit(
                     txcmd & 0x0100 ? 1 : 0,   /* FORCE: Delete waiting frames in transmit buffer */
                     txcmd & 0x0200 ? 1 : 0,   /* ONECOLL: Terminate after just one collision */
                     txcmd & 0x1000 ? 1 : 0,   /* INHIBITCRC: Do not append CRC to the transmission */
                     txcmd & 0x2000 ? 1 : 0,   /* TXPADDIS: Disable padding to 60/64 octets */
                     tx_length, &cs8900_packetpage[CS8900_PP_ADDR_TX_FRAMELOC]);
+                rawnet_unlock();
             }
 
             /* reset transmitter state */
@@ -906,6 +920,7 @@ static void cs8900_sideeffects_write_pp(uint16_t ppaddress, int odd_address)
             break;
         case CS8900_PP_ADDR_CC_RXCTL:
             if (cs8900_recv_control != content) {
+                rawnet_lock();
                 cs8900_recv_broadcast = content & 0x0800; /* broadcast */
                 cs8900_recv_mac = content & 0x0400; /* individual address (IA) */
                 cs8900_recv_multicast = content & 0x0200; /* multicast if address passes the hash filter */
@@ -913,11 +928,14 @@ static void cs8900_sideeffects_write_pp(uint16_t ppaddress, int odd_address)
                 cs8900_recv_promiscuous = content & 0x0080; /* promiscuous mode */
                 cs8900_recv_hashfilter = content & 0x0040; /* accept if IA passes the hash filter */
                 cs8900_recv_control = content;
+                rawnet_unlock();
 
                 log_message(cs8900_log, "setup receiver: broadcast=%s mac=%s multicast=%s correct=%s promiscuous=%s hashfilter=%s",
                             on_off_str(cs8900_recv_broadcast), on_off_str(cs8900_recv_mac), on_off_str(cs8900_recv_multicast), on_off_str(cs8900_recv_correct), on_off_str(cs8900_recv_promiscuous), on_off_str(cs8900_recv_hashfilter));
 
+                rawnet_lock();
                 rawnet_arch_recv_ctl(cs8900_recv_broadcast, cs8900_recv_mac, cs8900_recv_multicast, cs8900_recv_correct, cs8900_recv_promiscuous, cs8900_recv_hashfilter);
+                rawnet_unlock();
             }
             break;
         case CS8900_PP_ADDR_CC_LINECTL:
@@ -926,7 +944,9 @@ static void cs8900_sideeffects_write_pp(uint16_t ppaddress, int odd_address)
                 int enable_rx = (content & 0x0040) == 0x0040;
 
                 if ((enable_tx != tx_enabled) || (enable_rx != rx_enabled)) {
+                    rawnet_lock();
                     rawnet_arch_line_ctl(enable_tx, enable_rx);
+                    rawnet_unlock();
                     cs8900_set_transmitter(enable_tx);
                     cs8900_set_receiver(enable_rx);
 
@@ -1012,10 +1032,12 @@ static void cs8900_sideeffects_write_pp(uint16_t ppaddress, int odd_address)
                 unsigned int pos = 8 * (ppaddress - CS8900_PP_ADDR_LOG_ADDR_FILTER + odd_address);
                 uint32_t *p = (pos < 32) ? &cs8900_hash_mask[0] : &cs8900_hash_mask[1];
 
+                rawnet_lock();
                 *p &= ~(0xFF << pos); /* clear out relevant bits */
                 *p |= GET_PP_8(ppaddress + odd_address) << pos;
 
                 rawnet_arch_set_hashfilter(cs8900_hash_mask);
+                rawnet_unlock();
 
 #if 0
                 if (odd_address && (ppaddress == CS8900_PP_ADDR_LOG_ADDR_FILTER + 6)) {
@@ -1029,8 +1051,10 @@ static void cs8900_sideeffects_write_pp(uint16_t ppaddress, int odd_address)
         case CS8900_PP_ADDR_MAC_ADDR + 2:
         case CS8900_PP_ADDR_MAC_ADDR + 4:
             /* the MAC address has been changed */
+            rawnet_lock();
             cs8900_ia_mac[ppaddress - CS8900_PP_ADDR_MAC_ADDR + odd_address] = GET_PP_8(ppaddress + odd_address);
             rawnet_arch_set_mac(cs8900_ia_mac);
+            rawnet_unlock();
             if (odd_address && (ppaddress == CS8900_PP_ADDR_MAC_ADDR + 4)) {
                 log_message(cs8900_log, "set MAC address: %02x:%02x:%02x:%02x:%02x:%02x",
                             cs8900_ia_mac[0], cs8900_ia_mac[1], cs8900_ia_mac[2], cs8900_ia_mac[3], cs8900_ia_mac[4], cs8900_ia_mac[5]);
@@ -1608,11 +1632,18 @@ void cs8900_store(uint16_t io_address, uint8_t byte)
 
 int cs8900_dump(void)
 {
+    rawnet_rx_stats_t stats;
+
     /* FIXME: this is incomplete */
     mon_out("Link status: %s\n", (GET_PP_16(CS8900_PP_ADDR_SE_LINEST) & 0x80) ? "up" : "no link");
     mon_out("Package Page Ptr: $%04X (autoincrement %s)\n",
             (unsigned int)(cs8900_packetpage_ptr & PP_PTR_ADDR_MASK),
             (cs8900_packetpage_ptr & PP_PTR_AUTO_INCR_FLAG) != 0 ? "enabled" : "disabled");
+
+    rawnet_rx_get_stats(&stats);
+    mon_out("Receive thread: %s\n", rawnet_rx_active() ? "running" : "not running");
+    mon_out("Frames received: %lu, rejected: %lu, queued: %lu, dropped: %lu\n",
+            stats.received, stats.rejected, stats.queued, stats.dropped);
     return 0;
 }
 
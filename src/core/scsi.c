@@ -34,6 +34,7 @@
 #include <string.h>
 
 #include "archdep.h"
+#include "blockcache.h"
 #include "lib.h"
 #include "log.h"
 #include "types.h"
@@ -115,15 +116,33 @@ static int32_t scsi_imagecheck(struct scsi_context_s *context)
     return 0;
 }
 
+/* Forget about the file of a disk without closing it */
+void scsi_image_release(struct scsi_context_s *context, int disk)
+{
+    if (disk < 0 || disk > 55) {
+        return;
+    }
+
+    if (context->cache[disk]) {
+        blockcache_destroy(context->cache[disk]);
+        context->cache[disk] = NULL;
+    }
+    context->file[disk] = NULL;
+    context->changes[disk] = NULL;
+}
+
 int scsi_image_detach(struct scsi_context_s *context, int disk)
 {
+    FILE *fd;
+
     if (disk < 0 || disk > 55) {
         return 2;
     }
 
-    if (context->file[disk]) {
-        fclose(context->file[disk]);
-        context->file[disk] = NULL;
+    fd = context->file[disk];
+    if (fd) {
+        scsi_image_release(context, disk);
+        fclose(fd);
         return 0;
     }
 
@@ -143,51 +162,98 @@ void scsi_image_detach_all(struct scsi_context_s *context)
 
 int scsi_image_attach(struct scsi_context_s *context, int disk, char *filename)
 {
+    FILE *fd;
+
     if (disk < 0 || disk > 55) {
         return 2;
     }
 
     scsi_image_detach(context, disk);
-    context->file[disk] = fopen(filename, "rb+");
+    fd = fopen(filename, "rb+");
 
-    if (context->file[disk]) {
-        setbuf(context->file[disk], NULL);
-        return 0;
+    if (fd) {
+        setbuf(fd, NULL);
+        return scsi_image_attach_fd(context, disk, fd);
     } else {
         return 1;
     }
 }
 
-int32_t scsi_image_read(struct scsi_context_s *context)
+/* Attach an already opened file to a disk, the caller keeps ownership */
+int scsi_image_attach_fd(struct scsi_context_s *context, int disk, FILE *fd)
 {
-    int32_t i;
-    FILE *fhd;
+    if (disk < 0 || disk > 55) {
+        return 2;
+    }
 
-    if (scsi_imagecheck(context)) {
-        return -1;
+    scsi_image_release(context, disk);
+    context->file[disk] = fd;
+    context->cache[disk] = blockcache_new(fd, 512, BLOCKCACHE_DEFAULT_SIZE);
+    /* writes go to the image at once, CMD HD shares the file with the
+       disk image layer */
+    blockcache_set_writethrough(context->cache[disk], 1);
+
+    return 0;
+}
+
+/* Keep the changes to a disk in an overlay, the file is only read then */
+void scsi_image_set_overlay(struct scsi_context_s *context, int disk, struct imageoverlay_s *ov)
+{
+    if (disk < 0 || disk > 55 || context->cache[disk] == NULL) {
+        return;
     }
 
-    fhd = context->file[(context->target << 3) | context->lun];
+    blockcache_set_overlay(context->cache[disk], ov);
+}
 
-    if (archdep_fseeko(fhd, (off_t)context->address * 512, SEEK_SET) < 0) {
-        CRIT((LOG, "SCSI: error seeking disk %d at sector 0x%x",
-            context->target, context->address));
-        return -3;
+/* The file is also written by someone else, who counts the writes in
+   changes. The cached blocks are dropped when it changed. */
+void scsi_image_set_changes(struct scsi_context_s *context, int disk, const unsigned int *changes)
+{
+    if (disk < 0 || disk > 55) {
+        return;
     }
 
-    if (fread(context->data_buf, 512, 1, fhd) < 1) {
-        if (!feof(fhd)) {
-            CRIT((LOG, "SCSI: error reading disk %d at sector 0x%x",
-                context->target, context->address));
-            return -4;
-        }
+    context->changes[disk] = changes;
+    if (changes != NULL) {
+        context->changes_seen[disk] = *changes;
+    }
+}
 
-        /* if there is a read beyond the EOF, fill it with zeros and say it
-            is good */
-        for ( i = 0; i < 512; i++) {
-            context->data_buf[i] = 0;
+/* Get the block cache of the selected disk, the file may have been changed
+   directly by the user of the SCSI module */
+static blockcache_t *scsi_image_cache(struct scsi_context_s *context)
+{
+    int disk = (context->target << 3) | context->lun;
+
+    if (context->cache[disk] == NULL
+        || blockcache_file(context->cache[disk]) != context->file[disk]) {
+        scsi_image_attach_fd(context, disk, context->file[disk]);
+    }
+    if (context->changes[disk] != NULL
+        && *context->changes[disk] != context->changes_seen[disk]) {
+        if (blockcache_invalidate(context->cache[disk]) < 0) {
+            CRIT((LOG, "SCSI: cannot write back the cache of disk %d", context->target));
+        } else {
+            context->changes_seen[disk] = *context->changes[disk];
         }
     }
+    return context->cache[disk];
+}
+
+int32_t scsi_image_read(struct scsi_context_s *context)
+{
+    if (scsi_imagecheck(context)) {
+        return -1;
+    }
+
+    /* a read beyond the EOF is filled with zeros and is good */
+    if (blockcache_read(scsi_image_cache(context), (off_t)context->address,
+                        context->data_buf) < 0) {
+        CRIT((LOG, "SCSI: error reading disk %d at sector 0x%x",
+            context->target, context->address));
+        return -4;
+    }
 
     LOG2((LOG, "SCSI: read disk %d at sector 0x%x", context->target,
         context->address));
@@ -203,8 +269,6 @@ int32_t scsi_image_read(struct scsi_context_s *context)
 
 int32_t scsi_image_write(struct scsi_context_s *context)
 {
-    FILE *fhd;
-
     if (scsi_imagecheck(context)) {
         return -1;
     }
@@ -215,20 +279,12 @@ int32_t scsi_image_write(struct scsi_context_s *context)
         context->user_write(context);
     }
 
-    fhd = context->file[(context->target << 3) | context->lun];
-
-    if (archdep_fseeko(fhd, (off_t)context->address * 512, SEEK_SET) < 0) {
-        CRIT((LOG, "SCSI: error seeking disk %d at sector 0x%x",
-            context->target, context->address));
-        return -3;
-    }
-
-    if (fwrite(context->data_buf, 512, 1, fhd) < 1) {
+    if (blockcache_write(scsi_image_cache(context), (off_t)context->address,
+                         context->data_buf) < 0) {
         CRIT((LOG, "SCSI: error writing disk %d at sector 0x%x",
             context->target, context->address));
         return -4;
     }
-    fflush(fhd);
 
     LOG2((LOG, "SCSI: write disk %d at sector 0x%x", context->target,
         context->address));
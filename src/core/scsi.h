@@ -29,6 +29,8 @@
 
 #include "types.h"
 
+struct blockcache_s;
+struct imageoverlay_s;
 struct scsi_context_s;
 
 typedef struct scsi_context_s {
@@ -64,6 +66,9 @@ typedef struct scsi_context_s {
     uint32_t limit_imagesize; /* in 512 byte sectors */
     uint32_t log;
     FILE *file[56];
+    struct blockcache_s *cache[56];
+    const unsigned int *changes[56];    /* write counter of another user of the file */
+    unsigned int changes_seen[56];
     void *p;
     void (*user_format)(struct scsi_context_s *);
     void (*user_read)(struct scsi_context_s *);
@@ -211,6 +216,10 @@ MSG C/D I/O   Phase Name          Direction Of Transfer         Comment
 int scsi_image_detach(struct scsi_context_s *context, int disk);
 void scsi_image_detach_all(struct scsi_context_s *context);
 int scsi_image_attach(struct scsi_context_s *context, int disk, char *filename);
+int scsi_image_attach_fd(struct scsi_context_s *context, int disk, FILE *fd);
+void scsi_image_release(struct scsi_context_s *context, int disk);
+void scsi_image_set_overlay(struct scsi_context_s *context, int disk, struct imageoverlay_s *ov);
+void scsi_image_set_changes(struct scsi_context_s *context, int disk, const unsigned int *changes);
 int32_t scsi_image_read(struct scsi_context_s *context);
 int32_t scsi_image_write(struct scsi_context_s *context);
 uint8_t scsi_get_bus(struct scsi_context_s *context);
@@ -32,7 +32,9 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "blockcache.h"
 #include "log.h"
+#include "monitor.h"
 #include "snapshot.h"
 #include "spi-sdcard.h"
 #include "types.h"
@@ -96,12 +98,28 @@ static int mmc_card_rw = 0;
 /* Image file */
 static FILE *mmc_image_file = NULL;
 
+/* Block cache for the image, reads and writes go through it */
+static blockcache_t *mmc_image_cache = NULL;
+
+/* Set when the image could only be opened read-only */
+static int mmc_image_readonly = 0;
+
 /* Pointer inside image */
 static sd_addr_t mmc_image_pointer;
 
 /* write sequence counter */
 static unsigned int mmc_write_sequence;
 
+/* Largest block length (CMD16) a block write is accepted for. SD cards
+   allow at most 2048 bytes (WRITE_BL_LEN of 11), this also covers the
+   4096 bytes the read buffer can hold. */
+#define MMC_WRITE_BLOCK_MAX    0x1000
+
+/* Start address and buffer of the block being written. A block is only
+   written to the image once it has been received completely. */
+static sd_addr_t mmc_write_address;
+static uint8_t mmc_write_buffer[MMC_WRITE_BLOCK_MAX];
+
 static uint8_t mmc_card_inserted;
 static uint8_t mmc_card_state;
 static uint8_t mmc_card_reset_count;
@@ -638,26 +656,21 @@ static void mmc_execute_cmd(void)
 #ifdef DEBUG_MMC
                     log_debug(LOG_DEFAULT, "Address: %08x", mmc_current_address_pointer);
 #endif
-                    if (fseek(mmc_image_file, mmc_current_address_pointer, SEEK_SET) != 0) {
-                        mmc_card_state = MMC_CARD_DUMMY_READ;
-                    } else {
-                        uint8_t readbuf[0x1000];    /* FIXME */
+                    uint8_t readbuf[0x1000];    /* FIXME */
 #ifdef DEBUG_MMC
-                        log_debug(LOG_DEFAULT, "Buffering: %08x", mmc_current_address_pointer);
-#endif
-                        fseek(mmc_image_file, mmc_current_address_pointer, SEEK_SET);
-                        if (!feof(mmc_image_file)) {
-                            if (fread(readbuf, 1, mmc_block_size, mmc_image_file) > 0) {
-                                mmc_read_buffer_readptr = 0;
-                                mmc_read_buffer_writeptr = 0;
-                                mmc_read_buffer_set(readbuf, mmc_block_size);
+                    log_debug(LOG_DEFAULT, "Buffering: %08x", mmc_current_address_pointer);
+#endif
+                    if (mmc_block_size <= sizeof(readbuf)
+                        && blockcache_read_bytes(mmc_image_cache, (off_t)mmc_current_address_pointer,
+                                                 readbuf, mmc_block_size) > 0) {
+                        mmc_read_buffer_readptr = 0;
+                        mmc_read_buffer_writeptr = 0;
+                        mmc_read_buffer_set(readbuf, mmc_block_size);
 #ifdef DEBUG_MMC
-                                log_debug(LOG_DEFAULT, "Buffered: %02x %02x", readbuf[0], readbuf[1]);
+                        log_debug(LOG_DEFAULT, "Buffered: %02x %02x", readbuf[0], readbuf[1]);
 #endif
-                            } else {
-                                /* FIXME: handle error */
-                            }
-                        }
+                    } else {
+                        /* FIXME: handle error */
                     }
                 }
             } else {
@@ -681,6 +694,7 @@ static void mmc_execute_cmd(void)
 #endif
                 } else {
                     mmc_write_sequence = 0;
+                    mmc_write_address = mmc_current_address_pointer;
                     mmc_card_state = MMC_CARD_WRITE;
                 }
             } else {
@@ -801,14 +815,23 @@ static void mmc_write_to_mmc(uint8_t value)
             }
             break;
         case 1:
-            if (mmc_card_state == MMC_CARD_WRITE) {
-                if (fwrite(&value, 1, 1, mmc_image_file) != 1) {
-                    LOG(("could not write to mmc image file"));
-                    /* FIXME: handle error */
-                }
+            if (mmc_image_pointer < MMC_WRITE_BLOCK_MAX) {
+                mmc_write_buffer[mmc_image_pointer] = value;
             }
             mmc_image_pointer++;
             if (mmc_image_pointer == mmc_block_size) {
+                if (mmc_card_state == MMC_CARD_WRITE) {
+                    if (mmc_image_readonly) {
+                        LOG(("could not write to mmc image file"));
+                        /* FIXME: handle error */
+                    } else if (mmc_block_size > MMC_WRITE_BLOCK_MAX) {
+                        log_error(LOG_DEFAULT, "sd card: block length %u too large to write, block dropped.",
+                                  (unsigned int)mmc_block_size);
+                    } else {
+                        blockcache_write_bytes(mmc_image_cache, (off_t)mmc_write_address,
+                                               mmc_write_buffer, mmc_block_size);
+                    }
+                }
                 mmc_write_sequence++;
             }
             break;
@@ -853,8 +876,10 @@ int mmc_open_card_image(char *name, int rw)
         mmc_image_file = fopen(mmc_image_filename, "rb+");
     }
 
+    mmc_image_readonly = 0;
     if (mmc_image_file == NULL) {
         mmc_image_file = fopen(mmc_image_filename, "rb");
+        mmc_image_readonly = 1;
 
         if (mmc_image_file == NULL) {
             LOG(("could not open sd card image: %s", mmc_image_filename));
@@ -873,6 +898,8 @@ int mmc_open_card_image(char *name, int rw)
         LOG(("opened sd card image (rw): %s", mmc_image_filename));
     }
     mmc_card_rw = rw;
+
+    mmc_image_cache = blockcache_new(mmc_image_file, 512, BLOCKCACHE_DEFAULT_SIZE);
     return 0;
 }
 
@@ -880,12 +907,38 @@ void mmc_close_card_image(void)
 {
     /* unmount mmc cart image */
     if (mmc_image_file != NULL) {
+        blockcache_destroy(mmc_image_cache);
+        mmc_image_cache = NULL;
         fclose(mmc_image_file);
         mmc_image_file = NULL;
         spi_mmc_set_card_inserted(MMC_CARD_NOTINSERTED);
     }
 }
 
+/* Write all pending changes back to the card image, returns 0 on success */
+int mmc_flush_card_image(void)
+{
+    if (mmc_image_cache != NULL && blockcache_flush(mmc_image_cache) < 0) {
+        log_error(LOG_DEFAULT, "could not write changes back to sd card image file");
+        return -1;
+    }
+    return 0;
+}
+
+/* Print the sector I/O counters of the card image, for the monitor */
+void mmc_dump_card_stats(void)
+{
+    if (mmc_image_cache == NULL) {
+        mon_out("SD card: no image attached.\n");
+        return;
+    }
+
+    mon_out("SD card image is %s, %lu bytes.\n",
+            mmc_image_readonly ? "read-only" : "read/write",
+            (unsigned long)blockcache_image_size(mmc_image_cache));
+    blockcache_dump(mmc_image_cache);
+}
+
 /* ---------------------------------------------------------------------*/
 /*    snapshot support functions                                             */
 
@@ -898,6 +951,9 @@ int mmc_snapshot_write_module(snapshot_t *s)
 {
     snapshot_module_t *m;
 
+    /* make sure the image on disk matches the emulated card */
+    mmc_flush_card_image();
+
     m = snapshot_module_create(s, SNAP_MODULE_NAME,
                                CART_DUMP_VER_MAJOR, CART_DUMP_VER_MINOR);
     if (m == NULL) {
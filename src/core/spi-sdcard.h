@@ -47,6 +47,8 @@ uint8_t spi_mmc_data_read(void);
 void spi_mmc_data_write(uint8_t value);
 int  mmc_open_card_image(char *name, int rw);
 void mmc_close_card_image(void);
+int mmc_flush_card_image(void);
+void mmc_dump_card_stats(void);
 uint8_t mmc_set_card_type(uint8_t value);
 
 struct snapshot_s;
@@ -81,6 +81,8 @@ static sound_chip_t digimax_sound_chip = {
     digimax_sound_machine_calculate_samples, /* sound chip calculate samples function */
     digimax_sound_machine_store,             /* sound chip store function */
     digimax_sound_machine_read,              /* sound chip read function */
+    NULL,                                    /* NO sound chip shadow read function */
+    NULL,                                    /* NO sound chip shadow store function */
     digimax_sound_reset,                     /* sound chip reset function */
     digimax_sound_machine_cycle_based,       /* sound chip 'is_cycle_based()' function, chip is NOT cycle based */
     digimax_sound_machine_channels,          /* sound chip 'get_amount_of_channels()' function, sound chip has 4 channels */
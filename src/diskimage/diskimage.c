@@ -46,6 +46,7 @@
 #include "fsimage-gcr.h"
 #include "fsimage-p64.h"
 #include "fsimage.h"
+#include "imageoverlay.h"
 #include "lib.h"
 #include "log.h"
 #include "realimage.h"
@@ -734,11 +735,46 @@ int disk_image_read_image(const disk_image_t *image)
     }
 }
 
+/* Convert a track that fsimage_read_dxx_image() left pending. GCR and P64
+   images are read completely when attached.  */
+int disk_image_load_half_track(const disk_image_t *image, unsigned int half_track)
+{
+    switch (image->type) {
+        case DISK_IMAGE_TYPE_P64:
+        case DISK_IMAGE_TYPE_G64:
+        case DISK_IMAGE_TYPE_G71:
+            return 0;
+        default:
+            return fsimage_dxx_load_half_track(image, half_track);
+    }
+}
+
 int disk_image_write_p64_image(const disk_image_t *image)
 {
     return fsimage_write_p64_image(image);
 }
 
+/*-----------------------------------------------------------------------*/
+/* Copy-on-write overlay, see imageoverlay.c.  */
+
+/* Write the changes kept in memory to the image file */
+int disk_image_overlay_commit(disk_image_t *image)
+{
+    if (image == NULL || image->device != DISK_IMAGE_DEVICE_FS) {
+        return 0;
+    }
+    return fsimage_overlay_commit(image);
+}
+
+/* Throw away the changes since the last commit */
+void disk_image_overlay_discard(disk_image_t *image)
+{
+    if (image == NULL || image->device != DISK_IMAGE_DEVICE_FS) {
+        return;
+    }
+    fsimage_overlay_discard(image);
+}
+
 /*-----------------------------------------------------------------------*/
 /* Initialization.  */
 
@@ -754,7 +790,7 @@ void disk_image_init(void)
 
 int disk_image_resources_init(void)
 {
-    return 0;
+    return imageoverlay_resources_init();
 }
 
 void disk_image_resources_shutdown(void)
@@ -763,7 +799,7 @@ void disk_image_resources_shutdown(void)
 
 int disk_image_cmdline_options_init(void)
 {
-    return 0;
+    return imageoverlay_cmdline_options_init();
 }
 
 /*-----------------------------------------------------------------------*/
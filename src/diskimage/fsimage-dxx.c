@@ -48,9 +48,13 @@ int fsimage_dxx_write_half_track(disk_image_t *image, unsigned int half_track,
                                  const disk_track_t *raw)
 {
     unsigned int track, sector, max_sector = 0, error_info_created = 0;
+    unsigned int first, last;
     int sectors, res;
     long offset;
     uint8_t *buffer;
+    uint8_t *changed;
+    int *pos;
+    const uint8_t *dirty = NULL;
     fsimage_t *fsimage = image->media.fsimage;
     fdc_err_t rf;
 
@@ -63,6 +67,14 @@ int fsimage_dxx_write_half_track(disk_image_t *image, unsigned int half_track,
         return -1;
     }
 
+    /* If the drive keeps track of the changed parts of this track only the
+       sectors touched by them need to be decoded and written back */
+    if (image->gcr != NULL && half_track >= 2 && half_track - 2 < MAX_GCR_TRACKS
+        && raw == &image->gcr->tracks[half_track - 2] && track <= image->tracks
+        && gcr_track_dirty(image->gcr->dirty[half_track - 2])) {
+        dirty = image->gcr->dirty[half_track - 2];
+    }
+
     if (track > image->tracks) {
         if (fsimage->error_info.map) {
             int newlen = sectors + max_sector;
@@ -76,8 +88,15 @@ int fsimage_dxx_write_half_track(disk_image_t *image, unsigned int half_track,
     }
 
     buffer = lib_calloc(max_sector, 256);
+    changed = lib_malloc(max_sector);
+    pos = lib_malloc(max_sector * sizeof(int));
+    gcr_find_sector_headers(raw, pos, max_sector);
     for (sector = 0; sector < max_sector; sector++) {
-        rf = gcr_read_sector(raw, &buffer[sector * 256], (uint8_t)sector);
+        changed[sector] = (dirty == NULL) || gcr_sector_dirty(raw, pos[sector], dirty);
+        if (!changed[sector]) {
+            continue;
+        }
+        rf = gcr_read_sector_at(raw, &buffer[sector * 256], pos[sector]);
         if (rf != CBMDOS_FDC_ERR_OK) {
             log_error(fsimage_dxx_log,
                       "Could not find data sector of T:%u S:%u.",
@@ -101,19 +120,32 @@ int fsimage_dxx_write_half_track(disk_image_t *image, unsigned int half_track,
             }
         }
     }
-    offset = sectors * 256;
+    lib_free(pos);
+
+    /* write back the runs of changed sectors */
+    for (first = 0; first < max_sector; first = last) {
+        if (!changed[first]) {
+            last = first + 1;
+            continue;
+        }
+        for (last = first + 1; last < max_sector && changed[last]; last++) {
+        }
+        offset = (sectors + first) * 256;
 
 #ifdef HAVE_X64_IMAGE
-    if (image->type == DISK_IMAGE_TYPE_X64) {
-        offset += X64_HEADER_LENGTH;
-    }
+        if (image->type == DISK_IMAGE_TYPE_X64) {
+            offset += X64_HEADER_LENGTH;
+        }
 #endif
-    if (util_fpwrite(fsimage->fd, buffer, max_sector * 256, offset) < 0) {
-        log_error(fsimage_dxx_log, "Error writing T:%u to disk image.",
-                  track);
-        lib_free(buffer);
-        return -1;
+        if (fsimage_fpwrite(fsimage, &buffer[first * 256], (last - first) * 256, offset) < 0) {
+            log_error(fsimage_dxx_log, "Error writing T:%u to disk image.",
+                      track);
+            lib_free(changed);
+            lib_free(buffer);
+            return -1;
+        }
     }
+    lib_free(changed);
     lib_free(buffer);
     if (fsimage->error_info.map) {
         if (fsimage->error_info.dirty) {
@@ -126,10 +158,10 @@ int fsimage_dxx_write_half_track(disk_image_t *image, unsigned int half_track,
 #endif
             fsimage->error_info.dirty = 0;
             if (error_info_created) {
-                res = util_fpwrite(fsimage->fd, fsimage->error_info.map,
+                res = fsimage_fpwrite(fsimage, fsimage->error_info.map,
                                    fsimage->error_info.len, fsimage->error_info.len * 256);
             } else {
-                res = util_fpwrite(fsimage->fd, fsimage->error_info.map + sectors,
+                res = fsimage_fpwrite(fsimage, fsimage->error_info.map + sectors,
                                    max_sector, offset);
             }
             if (res < 0) {
@@ -142,17 +174,95 @@ int fsimage_dxx_write_half_track(disk_image_t *image, unsigned int half_track,
     }
 
     /* Make sure the stream is visible to other readers.  */
-    fflush(fsimage->fd);
+    fsimage_flush(fsimage);
+    return 0;
+}
+
+/* Convert a track of the image to GCR, using the sector header and the
+   rotational offset that fsimage_read_dxx_image() recorded for it */
+int fsimage_dxx_load_half_track(const disk_image_t *image, unsigned int half_track)
+{
+    uint8_t buffer[256];
+    int gap, headergap, synclen;
+    unsigned int track, sector, track_size, trackoffset;
+    gcr_header_t header;
+    fdc_err_t rf;
+    fsimage_t *fsimage = image->media.fsimage;
+    unsigned int max_sector;
+    unsigned int idx = half_track - 2;
+    uint8_t *ptr;
+    int sectors;
+    long offset;
+    uint8_t *tempgcr;
+
+    if (image->gcr == NULL || idx >= MAX_GCR_TRACKS || !image->gcr->pending[idx]) {
+        return 0;
+    }
+    image->gcr->pending[idx] = 0;
+
+    track = half_track / 2;
+    header = image->gcr->pending_header[idx];
+    trackoffset = image->gcr->pending_offset[idx];
+    track_size = (unsigned int)image->gcr->tracks[idx].size;
+
+    /* get temp buffer */
+    ptr = tempgcr = lib_malloc(track_size);
+
+    gap = disk_image_gap_size(image->type, track);
+    headergap = disk_image_header_gap_size(image->type, track);
+    synclen = disk_image_sync_size(image->type, track);
+
+    max_sector = disk_image_sector_per_track(image->type, track);
+
+    /* Clear track to avoid read errors.  */
+    memset(ptr, 0x55, track_size);
+
+    for (sector = 0; sector < max_sector; sector++) {
+        sectors = disk_image_check_sector(image, track, sector);
+        offset = sectors * 256;
+
+#ifdef HAVE_X64_IMAGE
+        if (image->type == DISK_IMAGE_TYPE_X64) {
+            offset += X64_HEADER_LENGTH;
+        }
+#endif
+        if (sectors >= 0) {
+            rf = CBMDOS_FDC_ERR_DRIVE;
+            if (fsimage_fpread(fsimage, buffer, 256, offset) >= 0) {
+                if (fsimage->error_info.map != NULL) {
+                    rf = fsimage->error_info.map[sectors];
+                }
+            }
+            header.sector = sector;
+            gcr_convert_sector_to_GCR(buffer, ptr, &header, headergap, synclen, rf);
+        }
+
+        ptr += SECTOR_GCR_SIZE_WITH_HEADER + headergap + gap + (synclen * 2);
+    }
+
+#if 0
+    /* copy gcr data to buffer (this creates perfectly aligned tracks) */
+    ptr = image->gcr->tracks[idx].data;
+    memcpy(ptr, tempgcr, track_size);
+#else
+    /* copy gcr data to final buffer with offset + wraparound */
+    ptr = image->gcr->tracks[idx].data;
+    memset(ptr, 0x55, track_size);
+    memcpy(ptr + trackoffset, tempgcr, track_size - trackoffset);
+    memcpy(ptr, tempgcr + (track_size - trackoffset), track_size - (track_size - trackoffset));
+#endif
+    lib_free(tempgcr);
     return 0;
 }
 
+/* Set up the GCR buffers for the image. The tracks are only converted when
+   the head moves onto them, see fsimage_dxx_load_half_track(). */
 int fsimage_read_dxx_image(const disk_image_t *image)
 {
     uint8_t buffer[256], *bam_id;
     int gap, headergap, synclen;
-    unsigned int track, sector, track_size;
+    unsigned int track, track_size;
     gcr_header_t header;
-    fdc_err_t rf;
     int image_has_two_single_sides = 0;
     int double_sided_drive = 0;
     fsimage_t *fsimage = image->media.fsimage;
@@ -160,9 +270,7 @@ int fsimage_read_dxx_image(const disk_image_t *image)
     uint8_t *ptr;
     int half_track;
     int sectors;
-    long offset;
     unsigned long trackoffset = 0;
-    uint8_t *tempgcr;
 
     if (image->type == DISK_IMAGE_TYPE_D80
         || image->type == DISK_IMAGE_TYPE_D82) {
@@ -175,12 +283,16 @@ int fsimage_read_dxx_image(const disk_image_t *image)
 
     bam_id[0] = bam_id[1] = 0xa0;
     if (sectors >= 0) {
-        util_fpread(fsimage->fd, buffer, 256, sectors << 8);
+        fsimage_fpread(fsimage, buffer, 256, sectors << 8);
     } else {
         return -1;
     }
     header.id1 = bam_id[0];
     header.id2 = bam_id[1];
+    header.sector = 0;
+
+    memset(image->gcr->pending, 0, sizeof(image->gcr->pending));
+    memset(image->gcr->dirty, 0, sizeof(image->gcr->dirty));
 
     /* check double sided images */
     image_has_two_single_sides = (image->type == DISK_IMAGE_TYPE_D71) && !(buffer[0x03] & 0x80);
@@ -230,11 +342,9 @@ int fsimage_read_dxx_image(const disk_image_t *image)
         }
         ptr = image->gcr->tracks[half_track].data;
         image->gcr->tracks[half_track].size = track_size;
+        memset(ptr, 0x55, track_size);
 
         if (track <= image->tracks) {
-            /* get temp buffer */
-            ptr = tempgcr = lib_malloc(track_size);
-
             /* special case for second side of the 1571. If each side was formatted
                separately in one-sided mode, we must start from track 1 again and use
                the ID from the BAM on the second side. */
@@ -243,7 +353,7 @@ int fsimage_read_dxx_image(const disk_image_t *image)
 
                 buffer[BAM_ID_1571] = buffer[BAM_ID_1571 + 1] = 0xa0;
                 if (sectors >= 0) {
-                    util_fpread(fsimage->fd, buffer, 256, sectors << 8);
+                    fsimage_fpread(fsimage, buffer, 256, sectors << 8);
                 }
                 header.id1 = buffer[BAM_ID_1571]; /* second side, update id and track */
                 header.id2 = buffer[BAM_ID_1571 + 1];
@@ -256,56 +366,20 @@ int fsimage_read_dxx_image(const disk_image_t *image)
 
             max_sector = disk_image_sector_per_track(image->type, track);
 
-            /* Clear track to avoid read errors.  */
-            memset(ptr, 0x55, track_size);
-
-            for (sector = 0; sector < max_sector; sector++) {
-                sectors = disk_image_check_sector(image, track, sector);
-                offset = sectors * 256;
-
-#ifdef HAVE_X64_IMAGE
-                if (image->type == DISK_IMAGE_TYPE_X64) {
-                    offset += X64_HEADER_LENGTH;
-                }
-#endif
-                if (sectors >= 0) {
-                    rf = CBMDOS_FDC_ERR_DRIVE;
-                    if (util_fpread(fsimage->fd, buffer, 256, offset) >= 0) {
-                        if (fsimage->error_info.map != NULL) {
-                            rf = fsimage->error_info.map[sectors];
-                        }
-                    }
-                    header.sector = sector;
-                    gcr_convert_sector_to_GCR(buffer, ptr, &header, headergap, synclen, rf);
-                }
-
-                ptr += SECTOR_GCR_SIZE_WITH_HEADER + headergap + gap + (synclen * 2);
-            }
-
-#if 0
-            /* copy gcr data to buffer (this creates perfectly aligned tracks) */
-            ptr = image->gcr->tracks[half_track].data;
-            memcpy(ptr, tempgcr, track_size);
-#else
-            /* copy gcr data to final buffer with offset + wraparound */
             /* On real disks, the track skew depends on many factors of which
                none is exactly defined: the mechanical properties of the drive,
                and last not least the code used for formatting the disk. Thus
                the offset we use here is somewhat arbitrary, the choosen values
                are tweaked to be somewhat close to what the skew1.prg program
                shows for the first few tracks. */
-            trackoffset += (ptr - tempgcr) - gap; /* bytes we have written */
+            trackoffset += max_sector * (SECTOR_GCR_SIZE_WITH_HEADER + headergap + gap + (synclen * 2)) - gap; /* bytes we have written */
             trackoffset += (track_size * 100) / 270; /* time it takes to step */
             trackoffset %= track_size;
             /*printf("track: %2u sectors: %2u size: %5u offset: %5lu\n", track, max_sector, track_size, trackoffset);*/
-            ptr = image->gcr->tracks[half_track].data;
-            memset(ptr, 0x55, track_size);
-            memcpy(ptr + trackoffset, tempgcr, track_size - trackoffset);
-            memcpy(ptr, tempgcr + (track_size - trackoffset), track_size - (track_size - trackoffset));
-#endif
-            lib_free(tempgcr);
-        } else {
-            memset(ptr, 0x55, track_size);
+
+            image->gcr->pending[half_track] = 1;
+            image->gcr->pending_header[half_track] = header;
+            image->gcr->pending_offset[half_track] = (unsigned int)trackoffset;
         }
 
         /* Clear odd track */
@@ -373,7 +447,7 @@ int fsimage_dxx_read_sector(const disk_image_t *image, uint8_t *buf, const disk_
 
     if (harderror == 0) {
         if (image->gcr == NULL) {
-            if (util_fpread(fsimage->fd, buf, 256, offset) < 0) {
+            if (fsimage_fpread(fsimage, buf, 256, offset) < 0) {
                 log_error(fsimage_dxx_log,
                         "Error reading T:%u S:%u from disk image.",
                         dadr->track, dadr->sector);
@@ -382,6 +456,8 @@ int fsimage_dxx_read_sector(const disk_image_t *image, uint8_t *buf, const disk_
                 rf = fsimage->error_info.map ? fsimage->error_info.map[sectors] : CBMDOS_FDC_ERR_OK;
             }
         } else {
+            /* the drive may not have converted this track yet */
+            fsimage_dxx_load_half_track(image, dadr->track * 2);
             rf = gcr_read_sector(&image->gcr->tracks[(dadr->track * 2) - 2], buf, (uint8_t)dadr->sector);
             /* HACK: if the image has an error map, and the "FDC" did not detect an
             error in the GCR stream, use the error from the error map instead.
@@ -450,12 +526,14 @@ int fsimage_dxx_write_sector(disk_image_t *image, const uint8_t *buf, const disk
         offset += X64_HEADER_LENGTH;
     }
 #endif
-    if (util_fpwrite(fsimage->fd, buf, 256, offset) < 0) {
+    if (fsimage_fpwrite(fsimage, buf, 256, offset) < 0) {
         log_error(fsimage_dxx_log, "Error writing T:%u S:%u to disk image.",
                   dadr->track, dadr->sector);
         return -1;
     }
     if (image->gcr != NULL) {
+        /* the sector can only be found in a converted track */
+        fsimage_dxx_load_half_track(image, dadr->track * 2);
         gcr_write_sector(&image->gcr->tracks[(dadr->track * 2) - 2], buf, (uint8_t)dadr->sector);
     }
 
@@ -469,7 +547,7 @@ int fsimage_dxx_write_sector(disk_image_t *image, const uint8_t *buf, const disk
         }
 #endif
         fsimage->error_info.map[sectors] = CBMDOS_FDC_ERR_OK;
-        if (util_fpwrite(fsimage->fd, &fsimage->error_info.map[sectors], 1, offset) < 0) {
+        if (fsimage_fpwrite(fsimage, &fsimage->error_info.map[sectors], 1, offset) < 0) {
             log_error(fsimage_dxx_log,
                     "Error writing T:%u S:%u error info to disk image.",
                     dadr->track, dadr->sector);
@@ -477,7 +555,7 @@ int fsimage_dxx_write_sector(disk_image_t *image, const uint8_t *buf, const disk
     }
 
     /* Make sure the stream is visible to other readers.  */
-    fflush(fsimage->fd);
+    fsimage_flush(fsimage);
     return 0;
 }
 
@@ -36,6 +36,7 @@ struct disk_addr_s;
 void fsimage_dxx_init(void);
 
 int fsimage_read_dxx_image(const disk_image_t *image);
+int fsimage_dxx_load_half_track(const disk_image_t *image, unsigned int half_track);
 
 int fsimage_dxx_write_half_track(disk_image_t *image, unsigned int half_track,
                                  const struct disk_track_s *raw);
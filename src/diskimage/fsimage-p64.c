@@ -59,13 +59,13 @@ int fsimage_read_p64_image(const disk_image_t *image)
 
     fsimage = image->media.fsimage;
 
-    lSize = archdep_file_size(fsimage->fd);
+    lSize = fsimage_size(image);
     if (lSize < 0) {
         log_error(fsimage_p64_log, "Failed to get size of P64 disk image.");
         return -1;
     }
     buffer = lib_malloc((size_t)lSize);
-    if (util_fpread(fsimage->fd, buffer, (size_t)lSize, 0) < 0) {
+    if (fsimage_fpread(fsimage, buffer, (size_t)lSize, 0) < 0) {
         lib_free(buffer);
         log_error(fsimage_p64_log, "Could not read P64 disk image.");
         return -1;
@@ -102,11 +102,11 @@ int fsimage_write_p64_image(const disk_image_t *image)
     P64MemoryStreamCreate(&P64MemoryStreamInstance);
     P64MemoryStreamClear(&P64MemoryStreamInstance);
     if (P64ImageWriteToStream(P64Image, &P64MemoryStreamInstance)) {
-        if (util_fpwrite(fsimage->fd, P64MemoryStreamInstance.Data, P64MemoryStreamInstance.Size, 0) < 0) {
+        if (fsimage_fpwrite(fsimage, P64MemoryStreamInstance.Data, P64MemoryStreamInstance.Size, 0) < 0) {
             rc = -1;
             log_error(fsimage_p64_log, "Could not write P64 disk image.");
         } else {
-            fflush(fsimage->fd);
+            fsimage_flush(fsimage);
             rc = 0;
         }
     } else {
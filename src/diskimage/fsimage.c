@@ -37,6 +37,7 @@
 #include "fsimage-p64.h"
 #include "fsimage-probe.h"
 #include "fsimage.h"
+#include "imageoverlay.h"
 #include "lib.h"
 #include "log.h"
 #include "types.h"
@@ -146,6 +147,9 @@ int fsimage_open(disk_image_t *image)
     /* proceed with normal opening */
     if (image->read_only) {
         fsimage->fd = zfile_fopen(fsimage->name, MODE_READ);
+    } else if (imageoverlay_enabled()) {
+        /* the file is only read, writes go to the overlay */
+        fsimage->fd = zfile_fopen(fsimage->name, MODE_READ);
     } else {
         fsimage->fd = zfile_fopen(fsimage->name, MODE_READ_WRITE);
 
@@ -162,6 +166,10 @@ int fsimage_open(disk_image_t *image)
     }
 
     if (fsimage_probe(image) == 0) {
+        if (!image->read_only && imageoverlay_enabled()) {
+            fsimage->overlay = imageoverlay_new(fsimage->fd);
+            log_message(fsimage_log, "Changes to `%s' are kept in memory.", fsimage->name);
+        }
         return 0;
     }
 
@@ -190,6 +198,17 @@ int fsimage_close(disk_image_t *image)
         lib_free(fsimage->error_info.map);
         fsimage->error_info.map = NULL;
     }
+    if (fsimage->overlay) {
+        if (imageoverlay_dirty_pages(fsimage->overlay) > 0) {
+            if (!imageoverlay_commit_on_detach()) {
+                log_message(fsimage_log, "Discarding changes to `%s'.", fsimage->name);
+            } else if (fsimage_overlay_commit(image) < 0) {
+                log_error(fsimage_log, "Changes to `%s' are lost.", fsimage->name);
+            }
+        }
+        imageoverlay_destroy(fsimage->overlay);
+        fsimage->overlay = NULL;
+    }
     zfile_fclose(fsimage->fd);
     fsimage->fd = NULL;
 
@@ -305,5 +324,95 @@ off_t fsimage_size(const disk_image_t *image)
     fsimage_t *fsimage;
 
     fsimage = image->media.fsimage;
+    if (fsimage->overlay) {
+        return imageoverlay_size(fsimage->overlay);
+    }
     return archdep_file_size(fsimage->fd);
 }
+
+/*-----------------------------------------------------------------------*/
+/* Image access, through the overlay if there is one.  */
+
+/* Read num bytes at offset, returns 0 on success and -1 on error like
+   util_fpread() */
+int fsimage_fpread(fsimage_t *fsimage, void *buf, size_t num, long offset)
+{
+    if (fsimage->overlay) {
+        return imageoverlay_read(fsimage->overlay, buf, num, (off_t)offset) == num ? 0 : -1;
+    }
+    return util_fpread(fsimage->fd, buf, num, offset);
+}
+
+/* Write num bytes at offset, returns 0 on success and -1 on error like
+   util_fpwrite() */
+int fsimage_fpwrite(fsimage_t *fsimage, const void *buf, size_t num, long offset)
+{
+    fsimage->changes++;
+    if (fsimage->overlay) {
+        return imageoverlay_write(fsimage->overlay, buf, num, (off_t)offset);
+    }
+    return util_fpwrite(fsimage->fd, buf, num, offset);
+}
+
+/* Make the changes visible to other readers of the image file */
+void fsimage_flush(fsimage_t *fsimage)
+{
+    if (fsimage->overlay == NULL) {
+        fflush(fsimage->fd);
+    }
+}
+
+/** \brief  Write the changes kept in memory to the image file
+ *
+ * \param[in]   image   disk image
+ *
+ * \return  0 on success, -1 on error
+ */
+int fsimage_overlay_commit(disk_image_t *image)
+{
+    fsimage_t *fsimage;
+    FILE *fd;
+    int result;
+
+    fsimage = image->media.fsimage;
+
+    if (fsimage == NULL || fsimage->overlay == NULL) {
+        return 0;
+    }
+    if (image->type == DISK_IMAGE_TYPE_P64) {
+        fsimage_write_p64_image(image);
+    }
+
+    fd = zfile_fopen(fsimage->name, MODE_READ_WRITE);
+    if (fd == NULL) {
+        log_error(fsimage_log, "Cannot open `%s' for writing.", fsimage->name);
+        return -1;
+    }
+    result = imageoverlay_commit(fsimage->overlay, fd);
+    if (zfile_fclose(fd) < 0) {
+        result = -1;
+    }
+    if (result == 0) {
+        log_message(fsimage_log, "Changes written to `%s'.", fsimage->name);
+    }
+    return result;
+}
+
+/** \brief  Throw away the changes since the last commit
+ *
+ * \param[in]   image   disk image
+ *
+ * The caller has to make sure that the drive reads the image again.
+ */
+void fsimage_overlay_discard(disk_image_t *image)
+{
+    fsimage_t *fsimage;
+
+    fsimage = image->media.fsimage;
+
+    if (fsimage == NULL || fsimage->overlay == NULL) {
+        return;
+    }
+    imageoverlay_discard(fsimage->overlay);
+    log_message(fsimage_log, "Changes to `%s' discarded.", fsimage->name);
+}
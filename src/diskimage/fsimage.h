@@ -33,10 +33,13 @@
 
 struct disk_image_s;
 struct disk_addr_s;
+struct imageoverlay_s;
 
 typedef struct fsimage_s {
     FILE *fd;
     char *name;
+    struct imageoverlay_s *overlay; /* changes kept in memory, or NULL */
+    unsigned int changes;           /* counts the writes, for other users of fd */
     struct {
         uint8_t *map;
         int dirty;
@@ -61,4 +64,10 @@ int fsimage_write_sector(struct disk_image_s *image, const uint8_t *buf,
                          const struct disk_addr_s *dadr);
 off_t fsimage_size(const disk_image_t *image);
 
+int fsimage_fpread(fsimage_t *fsimage, void *buf, size_t num, long offset);
+int fsimage_fpwrite(fsimage_t *fsimage, const void *buf, size_t num, long offset);
+void fsimage_flush(fsimage_t *fsimage);
+int fsimage_overlay_commit(struct disk_image_s *image);
+void fsimage_overlay_discard(struct disk_image_s *image);
+
 #endif
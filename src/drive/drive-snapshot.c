@@ -885,6 +885,9 @@ static int drive_snapshot_write_gcrimage_module(snapshot_t *s, unsigned int dnr)
 
     /* Write half track data */
     for (i = 0; i < num_half_tracks; i++) {
+        if (drive->image != NULL && drive->gcr->pending[i]) {
+            disk_image_load_half_track(drive->image, i + 2);
+        }
         data = drive->gcr->tracks[i].data;
         track_size = data ? drive->gcr->tracks[i].size : 0;
         if (0
@@ -979,6 +982,9 @@ static int drive_snapshot_read_gcrimage_module(snapshot_t *s, unsigned int dnr)
     }
     snapshot_module_close(m);
 
+    memset(drive->gcr->pending, 0, sizeof(drive->gcr->pending));
+    memset(drive->gcr->dirty, 0, sizeof(drive->gcr->dirty));
+
     drive->GCR_image_loaded = 1;
     drive->complicated_image_loaded = 1; /* TODO: verify if it's really like this */
     drive->image = NULL;
@@ -1599,6 +1599,8 @@ static sound_chip_t drive_sound = {
     drive_sound_machine_calculate_samples, /* sound chip calculate samples function */
     NULL,                                  /* NO sound chip store function */
     NULL,                                  /* NO sound chip read function */
+    NULL,                                  /* NO sound chip shadow read function */
+    NULL,                                  /* NO sound chip shadow store function */
     NULL,                                  /* NO sound chip reset function */
     drive_sound_machine_cycle_based,       /* sound chip 'is_cycle_based()' function, chip is NOT cycle based */
     drive_sound_machine_channels,          /* sound chip 'get_amount_of_channels()' function, sound chip has 1 channel */
@@ -241,6 +241,7 @@ int drive_init(void)
             drive->GCR_dirty_track = 0;
             drive->GCR_write_value = 0x55;
             drive->GCR_track_start_ptr = NULL;
+            drive->GCR_dirty_map = NULL;
             drive->GCR_current_track_size = 0;
             drive->attach_clk = (CLOCK)0;
             drive->detach_clk = (CLOCK)0;
@@ -718,7 +719,13 @@ void drive_set_half_track(int num, int side, drive_t *dptr)
     /* FIXME: why would the offset be different for D71 and G71? */
     tmp = (dptr->image && dptr->image->type == DISK_IMAGE_TYPE_G71) ? DRIVE_HALFTRACKS_1571 : 70;
 
+    /* tracks of sector based images are converted to GCR when first used */
+    if (dptr->image && dptr->gcr->pending[dptr->current_half_track - 2 + (dptr->side * tmp)]) {
+        disk_image_load_half_track(dptr->image, dptr->current_half_track + (dptr->side * tmp));
+    }
+
     dptr->GCR_track_start_ptr = dptr->gcr->tracks[dptr->current_half_track - 2 + (dptr->side * tmp)].data;
+    dptr->GCR_dirty_map = dptr->gcr->dirty[dptr->current_half_track - 2 + (dptr->side * tmp)];
 
     if (dptr->GCR_current_track_size != 0) {
         dptr->GCR_head_offset = (dptr->GCR_head_offset
@@ -746,7 +753,7 @@ void drive_move_head(int step, drive_t *drive)
     drive_set_half_track(drive->current_half_track + step, drive->side, drive);
 }
 
-void drive_gcr_data_writeback(drive_t *drive)
+static void drive_gcr_data_writeback_track(drive_t *drive)
 {
     unsigned int half_track, track, end_half_track;
     int tmp;
@@ -846,6 +853,16 @@ void drive_gcr_data_writeback(drive_t *drive)
     drive->GCR_dirty_track = 0;
 }
 
+void drive_gcr_data_writeback(drive_t *drive)
+{
+    drive_gcr_data_writeback_track(drive);
+
+    /* the changes of the current track are on the image now */
+    if (drive->GCR_dirty_map != NULL && !drive->GCR_dirty_track) {
+        memset(drive->GCR_dirty_map, 0, GCR_DIRTY_MAP_SIZE);
+    }
+}
+
 void drive_gcr_data_writeback_all(void)
 {
     drive_t *drive;
@@ -871,6 +888,142 @@ void drive_gcr_data_writeback_all(void)
 
 /* ------------------------------------------------------------------------- */
 
+/* Copies of the GCR data of all drives, for netplay rollback. The machine
+   snapshot does not include the disks, so a state that is restored would
+   keep what the drives wrote after it was saved. */
+
+typedef struct drive_gcr_copy_s {
+    disk_image_t *image;            /* image the copy belongs to, or NULL */
+    int dirty_track;
+    disk_track_t tracks[MAX_GCR_TRACKS];
+    uint8_t dirty[MAX_GCR_TRACKS][GCR_DIRTY_MAP_SIZE];
+} drive_gcr_copy_t;
+
+struct drive_gcr_state_s {
+    drive_gcr_copy_t drives[NUM_DISK_UNITS][NUM_DRIVES];
+};
+
+drive_gcr_state_t *drive_gcr_state_new(void)
+{
+    return lib_calloc(1, sizeof(drive_gcr_state_t));
+}
+
+void drive_gcr_state_free(drive_gcr_state_t *state)
+{
+    unsigned int i, j, t;
+
+    if (state == NULL) {
+        return;
+    }
+    for (i = 0; i < NUM_DISK_UNITS; i++) {
+        for (j = 0; j < NUM_DRIVES; j++) {
+            for (t = 0; t < MAX_GCR_TRACKS; t++) {
+                lib_free(state->drives[i][j].tracks[t].data);
+            }
+        }
+    }
+    lib_free(state);
+}
+
+/* the GCR data of a drive can only be copied for sector and GCR images */
+static int drive_gcr_state_supported(drive_t *drive)
+{
+    return drive != NULL && drive->GCR_image_loaded && drive->image != NULL
+           && drive->image->type != DISK_IMAGE_TYPE_P64;
+}
+
+/* Copy the GCR data of all drives. Tracks that were not converted yet are
+   converted first, the image file may change before the copy is restored. */
+void drive_gcr_state_save(drive_gcr_state_t *state)
+{
+    drive_t *drive;
+    drive_gcr_copy_t *copy;
+    unsigned int i, j, t;
+
+    for (i = 0; i < NUM_DISK_UNITS; i++) {
+        for (j = 0; j < NUM_DRIVES; j++) {
+            drive = diskunit_context[i]->drives[j];
+            copy = &state->drives[i][j];
+            copy->image = NULL;
+            if (!drive_gcr_state_supported(drive)) {
+                continue;
+            }
+            for (t = 0; t < MAX_GCR_TRACKS; t++) {
+                disk_track_t *raw = &drive->gcr->tracks[t];
+
+                if (drive->gcr->pending[t]) {
+                    disk_image_load_half_track(drive->image, t + 2);
+                }
+                if (copy->tracks[t].size != raw->size) {
+                    copy->tracks[t].data = lib_realloc(copy->tracks[t].data, raw->size ? raw->size : 1);
+                    copy->tracks[t].size = raw->size;
+                }
+                if (raw->size) {
+                    memcpy(copy->tracks[t].data, raw->data, raw->size);
+                }
+            }
+            memcpy(copy->dirty, drive->gcr->dirty, sizeof(copy->dirty));
+            copy->dirty_track = drive->GCR_dirty_track;
+            copy->image = drive->image;
+        }
+    }
+}
+
+/* Put back the GCR data of all drives. Tracks that changed since the copy
+   was made are written to the image again, changes to them may already
+   have been written back. */
+void drive_gcr_state_restore(drive_gcr_state_t *state)
+{
+    drive_t *drive;
+    drive_gcr_copy_t *copy;
+    disk_image_t *image;
+    unsigned int i, j, t;
+
+    for (i = 0; i < NUM_DISK_UNITS; i++) {
+        for (j = 0; j < NUM_DRIVES; j++) {
+            drive = diskunit_context[i]->drives[j];
+            copy = &state->drives[i][j];
+            if (copy->image == NULL || !drive_gcr_state_supported(drive)
+                || drive->image != copy->image) {
+                continue;
+            }
+            image = drive->image;
+            memcpy(drive->gcr->dirty, copy->dirty, sizeof(copy->dirty));
+            for (t = 0; t < MAX_GCR_TRACKS; t++) {
+                disk_track_t *raw = &drive->gcr->tracks[t];
+
+                if (raw->size == copy->tracks[t].size
+                    && (raw->size == 0
+                        || memcmp(raw->data, copy->tracks[t].data, raw->size) == 0)) {
+                    continue;
+                }
+                if (raw->size != copy->tracks[t].size) {
+                    raw->data = lib_realloc(raw->data, copy->tracks[t].size ? copy->tracks[t].size : 1);
+                    raw->size = copy->tracks[t].size;
+                }
+                if (raw->size) {
+                    memcpy(raw->data, copy->tracks[t].data, raw->size);
+                }
+                drive->gcr->pending[t] = 0;
+                /* an empty dirty map writes the whole track */
+                memset(drive->gcr->dirty[t], 0, GCR_DIRTY_MAP_SIZE);
+                if (!image->read_only && raw->size
+                    && t + 2 <= image->max_half_tracks
+                    && (image->type == DISK_IMAGE_TYPE_G64
+                        || image->type == DISK_IMAGE_TYPE_G71
+                        || (t + 2) / 2 <= image->tracks)) {
+                    disk_image_write_half_track(image, t + 2, raw);
+                }
+            }
+            drive->GCR_dirty_track = copy->dirty_track;
+            /* the track buffers may have moved */
+            drive_set_half_track(drive->current_half_track, drive->side, drive);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
 static void drive_led_update(diskunit_context_t *unit, drive_t *drive, int base)
 {
     int my_led_status = 0;
@@ -269,6 +269,9 @@ typedef struct drive_s {
     /* Pointer to the start of the GCR data of this track.  */
     uint8_t *GCR_track_start_ptr;
 
+    /* Changed parts of this track, one bit per GCR_DIRTY_CHUNK bytes.  */
+    uint8_t *GCR_dirty_map;
+
     /* Size of the GCR data for the current track.  */
     unsigned int GCR_current_track_size;
 
@@ -402,6 +405,12 @@ void drive_enable_update_ui(struct diskunit_context_s *drv);
 void drive_update_ui_status(void);
 void drive_gcr_data_writeback(struct drive_s *drive);
 void drive_gcr_data_writeback_all(void);
+
+typedef struct drive_gcr_state_s drive_gcr_state_t;
+drive_gcr_state_t *drive_gcr_state_new(void);
+void drive_gcr_state_free(drive_gcr_state_t *state);
+void drive_gcr_state_save(drive_gcr_state_t *state);
+void drive_gcr_state_restore(drive_gcr_state_t *state);
 void drive_set_active_led_color(unsigned int type, unsigned int dnr);
 int drive_set_disk_drive_type(unsigned int drive_type,
                               struct diskunit_context_s *drv);
@@ -275,6 +275,8 @@ int drive_image_detach(disk_image_t *image, unsigned int unit, unsigned int drv)
             drive->gcr->tracks[i].size = 0;
         }
     }
+    memset(drive->gcr->pending, 0, sizeof(drive->gcr->pending));
+    memset(drive->gcr->dirty, 0, sizeof(drive->gcr->dirty));
     drive->detach_clk = diskunit_clk[dnr];
     drive->GCR_image_loaded = 0;
     drive->P64_image_loaded = 0;
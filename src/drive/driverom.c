@@ -73,15 +73,107 @@ static log_t driverom_log;
 /* If nonzero, we are far enough in init that we can load ROMs.  */
 static int drive_rom_load_ok = 0;
 
+/* While the ROMs are tested at startup, the tests are only recorded here and
+   done the first time a drive type is actually checked, so starting up does
+   not look for the ROMs of all the drive types nobody uses.  */
+#define DRIVEROM_MAX_DEFERRED   24
+
+typedef struct driverom_deferred_s {
+    const char *resource_name;
+    unsigned int *loaded;
+    int min;
+    int max;
+    const char *name;
+    unsigned int type;
+    unsigned int *size;
+    int pending;
+} driverom_deferred_t;
+
+static driverom_deferred_t deferred[DRIVEROM_MAX_DEFERRED];
+static unsigned int num_deferred = 0;
+static int defer_test_load = 0;
+
+static int driverom_test_load_now(const char *resource_name, unsigned int *loaded,
+                                  int min, int max, const char *name,
+                                  unsigned int type, unsigned int *size);
+
+/* find the deferred test of a ROM resource */
+static driverom_deferred_t *driverom_find_deferred(const char *resource_name)
+{
+    unsigned int i;
+
+    for (i = 0; i < num_deferred; i++) {
+        if (strcmp(deferred[i].resource_name, resource_name) == 0) {
+            return &deferred[i];
+        }
+    }
+    return NULL;
+}
+
+/* record a ROM test, returns -1 if it must be done right away */
+static int driverom_defer_test_load(const char *resource_name, unsigned int *loaded,
+                                    int min, int max, const char *name,
+                                    unsigned int type, unsigned int *size)
+{
+    driverom_deferred_t *d = driverom_find_deferred(resource_name);
+
+    if (d == NULL) {
+        if (num_deferred >= DRIVEROM_MAX_DEFERRED) {
+            return -1;
+        }
+        d = &deferred[num_deferred++];
+    }
+    d->resource_name = resource_name;
+    d->loaded = loaded;
+    d->min = min;
+    d->max = max;
+    d->name = name;
+    d->type = type;
+    d->size = size;
+    d->pending = 1;
+
+    if (size != NULL) {
+        *size = 0;
+    }
+    if (loaded != NULL) {
+        *loaded = 0;
+    }
+    return 0;
+}
+
+/** \brief  Do the ROM tests skipped at startup for a drive type
+ *
+ * Called before the ROM of a drive type is checked. With DRIVE_TYPE_ANY the
+ * tests are done until a ROM is found.
+ *
+ * \param[in]   type    drive type
+ */
+void driverom_probe_deferred(unsigned int type)
+{
+    unsigned int i;
+
+    for (i = 0; i < num_deferred; i++) {
+        driverom_deferred_t *d = &deferred[i];
+
+        if (!d->pending || (type != DRIVE_TYPE_ANY && d->type != type)) {
+            continue;
+        }
+        d->pending = 0;
+        if (driverom_test_load_now(d->resource_name, d->loaded, d->min, d->max,
+                                   d->name, d->type, d->size) == 0
+            && type == DRIVE_TYPE_ANY && d->loaded != NULL && *d->loaded) {
+            break;
+        }
+    }
+}
+
 /* like driverom_load, but doesn't actually load anything, and only tests if the
    file exists and matches the given size(s) */
 int driverom_test_load(const char *resource_name, unsigned int *loaded,
                         int min, int max, const char *name,
                         unsigned int type, unsigned int *size)
 {
-    const char *rom_name = NULL;
-    int filesize;
-    unsigned int dnr;
+    driverom_deferred_t *d;
 
     DBG(("driverom_test_load res:%s loaded:%u min:%d max:%d name:%s type:%u size:%u",
        resource_name, *loaded, min, max, name, type, size ? *size : 0));
@@ -90,6 +182,30 @@ int driverom_test_load(const char *resource_name, unsigned int *loaded,
         return 0;
     }
 
+    if (defer_test_load
+        && driverom_defer_test_load(resource_name, loaded, min, max, name,
+                                    type, size) == 0) {
+        return 0;
+    }
+
+    /* the ROM was changed after startup, an earlier test is obsolete */
+    d = driverom_find_deferred(resource_name);
+    if (d != NULL) {
+        d->pending = 0;
+    }
+
+    return driverom_test_load_now(resource_name, loaded, min, max, name,
+                                  type, size);
+}
+
+static int driverom_test_load_now(const char *resource_name, unsigned int *loaded,
+                                  int min, int max, const char *name,
+                                  unsigned int type, unsigned int *size)
+{
+    const char *rom_name = NULL;
+    int filesize;
+    unsigned int dnr;
+
     resources_get_string(resource_name, &rom_name);
 
     DBG(("driverom_test_load rom_name: %s", rom_name));
@@ -152,6 +268,7 @@ int driverom_load(const char *resource_name, uint8_t *drive_rom, unsigned
     const char *rom_name = NULL;
     int filesize;
     unsigned int dnr;
+    driverom_deferred_t *d;
 
     DBG(("driverom_load res:%s loaded:%u min:%d max:%d name:%s type:%u size:%u",
        resource_name, *loaded, min, max, name, type, size ? *size : 0));
@@ -164,6 +281,12 @@ int driverom_load(const char *resource_name, uint8_t *drive_rom, unsigned
 
     DBG(("driverom_load rom_name: %s", rom_name));
 
+    /* the ROM is there if this succeeds, no need to test it later */
+    d = driverom_find_deferred(resource_name);
+    if (d != NULL) {
+        d->pending = 0;
+    }
+
     if (size != NULL) {
         *size = 0;
     }
@@ -221,7 +344,9 @@ int driverom_load_images(void)
 {
     drive_rom_load_ok = 1;
 
+    defer_test_load = 1;
     machine_drive_rom_load();
+    defer_test_load = 0;
 
     if (machine_drive_rom_check_loaded(DRIVE_TYPE_ANY) < 0) {
         log_error(driverom_log,
@@ -63,6 +63,7 @@ int driverom_test_load(const char *resource_name, unsigned int *loaded,
                        int min, int max, const char *name,
                        unsigned int type, unsigned int *size);
 int driverom_load_images(void);
+void driverom_probe_deferred(unsigned int type);
 int driverom_snapshot_write(struct snapshot_s *s, const struct drive_s *drive);
 int driverom_snapshot_read(struct snapshot_s *s, struct drive_s *drive);
 
@@ -1308,7 +1308,7 @@ void cmdhd_reset(cmdhd_context_t *hd)
             }
         } else {
             /* remove scsi ID 0 */
-            hd->scsi->file[0] = NULL;
+            scsi_image_release(hd->scsi, 0);
         }
     }
 
@@ -1366,7 +1366,11 @@ int cmdhd_attach_image(disk_image_t *image, unsigned int unit)
     }
 
     /* copy file FD to the scsi module */
-    hd->scsi->file[0] = image->media.fsimage->fd;
+    scsi_image_attach_fd(hd->scsi, 0, image->media.fsimage->fd);
+    /* changes go where the disk image layer keeps them */
+    scsi_image_set_overlay(hd->scsi, 0, image->media.fsimage->overlay);
+    /* the virtual drive writes the image through the disk image layer */
+    scsi_image_set_changes(hd->scsi, 0, &image->media.fsimage->changes);
 
     /* find the base lba */
     cmdhd_findbaselba(hd);
@@ -1402,10 +1406,10 @@ int cmdhd_attach_image(disk_image_t *image, unsigned int unit)
                    /* must be multiple of 512 */
                    if ((filelength % 512) == 0) {
                        /* set the FILE pointer */
-                       hd->scsi->file[(i << 3) | j] = test;
+                       scsi_image_attach_fd(hd->scsi, (int)((i << 3) | j), test);
                    } else {
                        /* otherwise make sure it is zero */
-                       hd->scsi->file[(i << 3) | j] = NULL;
+                       scsi_image_release(hd->scsi, (int)((i << 3) | j));
                        fclose(test);
                    }
                }
@@ -1416,7 +1420,7 @@ int cmdhd_attach_image(disk_image_t *image, unsigned int unit)
     } else {
         /* otherwise clear out SCSI resources just in case */
         for (i = 1; i < 56; i++) {
-            hd->scsi->file[i] = NULL;
+            scsi_image_release(hd->scsi, (int)i);
         }
     }
 
@@ -1474,16 +1478,12 @@ int cmdhd_detach_image(disk_image_t *image, unsigned int unit)
     hd->image = NULL;
     hd->imagesize = 0;
     hd->baselba = UINT32_MAX;
-    hd->scsi->file[0] = NULL;
+    scsi_image_release(hd->scsi, 0);
 
     /* close all additional SCSI ID files */
     for (i = 1; i < 56; i++) {
-        /* if it isn't NULL, it must be a file */
-        if (hd->scsi->file[i]) {
-            /* close it and set to NULL */
-            fclose(hd->scsi->file[i]);
-            hd->scsi->file[i] = NULL;
-        }
+        /* if it isn't NULL, it must be a file, close it and set to NULL */
+        scsi_image_detach(hd->scsi, i);
     }
 
     /* make sure the cmdbus isn't held down */
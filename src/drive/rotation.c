@@ -32,6 +32,7 @@
 
 #include "drive.h"
 #include "drivetypes.h"
+#include "gcr.h"
 #include "lib.h"
 #include "rotation.h"
 #include "types.h"
@@ -246,6 +247,7 @@ inline static void write_next_bit(drive_t *dptr, int value)
         return;
     }
     dptr->GCR_dirty_track = 1;
+    dptr->GCR_dirty_map[byte_offset / (GCR_DIRTY_CHUNK * 8)] |= 1 << ((byte_offset / GCR_DIRTY_CHUNK) & 7);
     if (value) {
         dptr->GCR_track_start_ptr[byte_offset] |= 1 << bit;
     } else {
@@ -920,6 +922,7 @@ static void rotation_1541_p64(drive_t *dptr, CLOCK ref_cycles)
                         (P64PulseStream->Pulses[P64PulseStream->CurrentIndex].Position == rptr->PulseHeadPosition)) {
                         if (P64PulseStream->Pulses[P64PulseStream->CurrentIndex].Strength != 0xffffffffUL) {
                             P64PulseStream->Pulses[P64PulseStream->CurrentIndex].Strength = 0xffffffffUL;
+                            P64PulseStream->Modified = 1;
                             dptr->P64_dirty = 1;
                         }
                     } else {
@@ -260,18 +260,107 @@ static int gcr_find_sector_header(const disk_track_t *raw, uint8_t sector)
     return -CBMDOS_FDC_ERR_HEADER;
 }
 
+/* Find the headers of sectors 0 to num - 1 in one pass over the track. The
+   bit position of each header is stored in pos, or a negative error code
+   for sectors that were not found. */
+void gcr_find_sector_headers(const disk_track_t *raw, int *pos, unsigned int num)
+{
+    uint8_t header[4];
+    unsigned int i, found = 0;
+    int p, p2;
+
+    p = 0;
+    p2 = -CBMDOS_FDC_ERR_SYNC;
+    for (i = 0; i < num; i++) {
+        pos[i] = -CBMDOS_FDC_ERR_SYNC;
+    }
+    while (found < num) {
+        p = gcr_find_sync(raw, p, raw->size * 8);
+        if (p < 0 || p2 == p) {
+            break;
+        }
+        if (p2 < 0) {
+            p2 = p;
+        }
+        gcr_decode_block(raw, p, header, 1);
+
+        /* the first header of a sector wins, like in gcr_find_sector_header */
+        if (header[0] == 0x08 && header[2] < num && pos[header[2]] < 0) {
+            pos[header[2]] = p;
+            found++;
+        }
+    }
+    if (p2 >= 0) {
+        for (i = 0; i < num; i++) {
+            if (pos[i] < 0) {
+                pos[i] = -CBMDOS_FDC_ERR_HEADER;
+            }
+        }
+    }
+}
+
+/* Check whether a sector found by gcr_find_sector_headers() overlaps the
+   changed parts of the track */
+int gcr_sector_dirty(const disk_track_t *raw, int pos, const uint8_t *dirty)
+{
+    int p, b, left;
+
+    if (pos < 0) {
+        return 1;
+    }
+    p = gcr_find_sync(raw, pos, 500 * 8);
+    if (p < 0) {
+        return 1;
+    }
+
+    /* from the header up to the end of the data block */
+    b = pos >> 3;
+    left = (((p + 65 * 5 * 8) >> 3) - b + raw->size) % raw->size + 1;
+    while (left > 0) {
+        int step = GCR_DIRTY_CHUNK - (b % GCR_DIRTY_CHUNK);
+
+        if (dirty[b / (GCR_DIRTY_CHUNK * 8)] & (1 << ((b / GCR_DIRTY_CHUNK) & 7))) {
+            return 1;
+        }
+        b += step;
+        left -= step;
+        if (b >= raw->size) {
+            b -= raw->size;
+        }
+    }
+    return 0;
+}
+
+/* Check whether anything of a track was changed */
+int gcr_track_dirty(const uint8_t *dirty)
+{
+    int i;
+
+    for (i = 0; i < GCR_DIRTY_MAP_SIZE; i++) {
+        if (dirty[i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 fdc_err_t gcr_read_sector(const disk_track_t *raw, uint8_t *data, uint8_t sector)
+{
+    return gcr_read_sector_at(raw, data, gcr_find_sector_header(raw, sector));
+}
+
+/* Read the data block of the sector whose header is at bit position pos */
+fdc_err_t gcr_read_sector_at(const disk_track_t *raw, uint8_t *data, int pos)
 {
     uint8_t buffer[260];
     uint8_t b;
     int i, p;
 
-    p = gcr_find_sector_header(raw, sector);
-    if (p < 0) {
-        return -p;
+    if (pos < 0) {
+        return -pos;
     }
 
-    p = gcr_find_sync(raw, p, 500 * 8);
+    p = gcr_find_sync(raw, pos, 500 * 8);
     if (p < 0) {
         return -p;
     }
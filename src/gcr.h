@@ -53,20 +53,40 @@ typedef struct disk_track_s {
     int size;
 } disk_track_t;
 
-typedef struct gcr_s {
-    /* Raw GCR image of the disk.  */
-    disk_track_t tracks[MAX_GCR_TRACKS];
-} gcr_t;
+/* Changes to a track are recorded with one bit per GCR_DIRTY_CHUNK bytes */
+#define GCR_DIRTY_CHUNK 64
+#define GCR_DIRTY_MAP_SIZE (NUM_MAX_MEM_BYTES_TRACK / GCR_DIRTY_CHUNK / 8)
 
 typedef struct gcr_header_s {
     uint8_t sector, track, id2, id1;
 } gcr_header_t;
 
+typedef struct gcr_s {
+    /* Raw GCR image of the disk.  */
+    disk_track_t tracks[MAX_GCR_TRACKS];
+
+    /* Flag: the track has not been converted from the disk image yet, this
+       happens when the head moves onto it.  */
+    uint8_t pending[MAX_GCR_TRACKS];
+
+    /* Sector header and rotational offset to use for a pending track.  */
+    gcr_header_t pending_header[MAX_GCR_TRACKS];
+    unsigned int pending_offset[MAX_GCR_TRACKS];
+
+    /* Parts of each track written by the drive since the last writeback.  */
+    uint8_t dirty[MAX_GCR_TRACKS][GCR_DIRTY_MAP_SIZE];
+} gcr_t;
+
 void gcr_convert_sector_to_GCR(const uint8_t *buffer, uint8_t *ptr, const gcr_header_t *header,
                                int gap, int sync, enum fdc_err_e error_code);
 enum fdc_err_e gcr_read_sector(const disk_track_t *raw, uint8_t *data, uint8_t sector);
 enum fdc_err_e gcr_write_sector(disk_track_t *raw, const uint8_t *data, uint8_t sector);
 
+void gcr_find_sector_headers(const disk_track_t *raw, int *pos, unsigned int num);
+enum fdc_err_e gcr_read_sector_at(const disk_track_t *raw, uint8_t *data, int pos);
+int gcr_sector_dirty(const disk_track_t *raw, int pos, const uint8_t *dirty);
+int gcr_track_dirty(const uint8_t *dirty);
+
 gcr_t *gcr_create_image(void);
 void gcr_destroy_image(gcr_t *gcr);
 
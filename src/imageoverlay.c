@@ -0,0 +1,464 @@
+/*
+ * imageoverlay.c - Copy-on-write overlay for disk and hard disk images.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The base image is opened read only and is never written to. Every page
+   of the image that gets written is copied into memory first, reads are
+   served from these copies or from the base file. Several emulator
+   instances can use the same image this way, and the operating system
+   can share its cached pages between them.
+
+   A commit writes the changed pages to a writable handle of the image,
+   the pages stay in memory afterwards because the read only handle may
+   still see the old contents (e.g. for compressed images). A discard
+   returns to the state of the last commit. */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "archdep.h"
+#include "cmdline.h"
+#include "imageoverlay.h"
+#include "lib.h"
+#include "log.h"
+#include "resources.h"
+#include "types.h"
+
+typedef struct imageoverlay_page_s {
+    off_t index;                        /* page number inside the image */
+    struct imageoverlay_page_s *next;   /* next page in the hash chain */
+    uint8_t *saved;                     /* contents at the last commit */
+    int dirty;
+    uint8_t data[IMAGEOVERLAY_PAGE_SIZE];
+} imageoverlay_page_t;
+
+struct imageoverlay_s {
+    FILE *base;
+    off_t base_size;                /* size of the base file */
+    off_t committed_size;           /* image size at the last commit */
+    off_t size;                     /* current image size */
+    imageoverlay_page_t **buckets;
+    unsigned int hash_mask;
+    unsigned int num_pages;
+    unsigned int dirty;             /* number of pages not yet committed */
+};
+
+#define IMAGEOVERLAY_MIN_BUCKETS 64
+
+/* ------------------------------------------------------------------------- */
+
+static int overlay_enabled = 0;
+static int overlay_commit_on_detach = 0;
+
+static int set_overlay_enabled(int val, void *param)
+{
+    overlay_enabled = val ? 1 : 0;
+    return 0;
+}
+
+static int set_overlay_commit_on_detach(int val, void *param)
+{
+    overlay_commit_on_detach = val ? 1 : 0;
+    return 0;
+}
+
+static const resource_int_t resources_int[] = {
+    { "ImageOverlay", 0, RES_EVENT_NO, NULL,
+      &overlay_enabled, set_overlay_enabled, NULL },
+    { "ImageOverlayCommit", 0, RES_EVENT_NO, NULL,
+      &overlay_commit_on_detach, set_overlay_commit_on_detach, NULL },
+    RESOURCE_INT_LIST_END
+};
+
+int imageoverlay_resources_init(void)
+{
+    return resources_register_int(resources_int);
+}
+
+static const cmdline_option_t cmdline_options[] =
+{
+    { "-imageoverlay", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "ImageOverlay", (resource_value_t)1,
+      NULL, "Keep changes to disk and hard disk images in memory, the image files are only read" },
+    { "+imageoverlay", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "ImageOverlay", (resource_value_t)0,
+      NULL, "Write changes to disk and hard disk images back to the image files" },
+    { "-imageoverlaycommit", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "ImageOverlayCommit", (resource_value_t)1,
+      NULL, "Write the changes kept in memory to the image file when an image is detached" },
+    { "+imageoverlaycommit", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "ImageOverlayCommit", (resource_value_t)0,
+      NULL, "Throw away the changes kept in memory when an image is detached" },
+    CMDLINE_LIST_END
+};
+
+int imageoverlay_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
+
+/* Images attached from now on get an overlay */
+int imageoverlay_enabled(void)
+{
+    return overlay_enabled;
+}
+
+/* The changes in an overlay are committed when its image is detached,
+   instead of being thrown away */
+int imageoverlay_commit_on_detach(void)
+{
+    return overlay_commit_on_detach;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static unsigned int imageoverlay_hash(imageoverlay_t *ov, off_t index)
+{
+    return (unsigned int)(index ^ (index >> 12)) & ov->hash_mask;
+}
+
+static imageoverlay_page_t *imageoverlay_lookup(imageoverlay_t *ov, off_t index)
+{
+    imageoverlay_page_t *page = ov->buckets[imageoverlay_hash(ov, index)];
+
+    while (page != NULL && page->index != index) {
+        page = page->next;
+    }
+    return page;
+}
+
+static void imageoverlay_rehash(imageoverlay_t *ov, unsigned int num_buckets)
+{
+    imageoverlay_page_t **old = ov->buckets;
+    unsigned int i, old_num = ov->hash_mask + 1;
+
+    ov->buckets = lib_calloc(num_buckets, sizeof(imageoverlay_page_t *));
+    ov->hash_mask = num_buckets - 1;
+
+    for (i = 0; i < old_num; i++) {
+        while (old[i] != NULL) {
+            imageoverlay_page_t *page = old[i];
+            unsigned int h = imageoverlay_hash(ov, page->index);
+
+            old[i] = page->next;
+            page->next = ov->buckets[h];
+            ov->buckets[h] = page;
+        }
+    }
+    lib_free(old);
+}
+
+/* Read from the base file, everything behind its end reads as zeros */
+static int imageoverlay_read_base(imageoverlay_t *ov, uint8_t *buf, size_t num, off_t offset)
+{
+    size_t got = 0;
+
+    if (offset < ov->base_size) {
+        size_t avail = (size_t)(ov->base_size - offset);
+
+        if (avail > num) {
+            avail = num;
+        }
+        if (archdep_fseeko(ov->base, offset, SEEK_SET) != 0) {
+            return -1;
+        }
+        got = fread(buf, 1, avail, ov->base);
+        if (got != avail) {
+            return -1;
+        }
+    }
+    memset(buf + got, 0, num - got);
+    return 0;
+}
+
+/* Copy a page of the base file into the overlay */
+static imageoverlay_page_t *imageoverlay_page_new(imageoverlay_t *ov, off_t index)
+{
+    imageoverlay_page_t *page;
+    unsigned int h;
+
+    page = lib_malloc(sizeof(imageoverlay_page_t));
+    if (imageoverlay_read_base(ov, page->data, IMAGEOVERLAY_PAGE_SIZE,
+                               index * IMAGEOVERLAY_PAGE_SIZE) < 0) {
+        log_error(LOG_DEFAULT, "imageoverlay: error reading page %lu of the image.",
+                  (unsigned long)index);
+        lib_free(page);
+        return NULL;
+    }
+    page->index = index;
+    page->saved = NULL;
+    page->dirty = 0;
+
+    if (ov->num_pages >= (ov->hash_mask + 1) * 2) {
+        imageoverlay_rehash(ov, (ov->hash_mask + 1) * 2);
+    }
+    h = imageoverlay_hash(ov, index);
+    page->next = ov->buckets[h];
+    ov->buckets[h] = page;
+    ov->num_pages++;
+    return page;
+}
+
+static int imageoverlay_compare(const void *a, const void *b)
+{
+    off_t ia = (*(imageoverlay_page_t * const *)a)->index;
+    off_t ib = (*(imageoverlay_page_t * const *)b)->index;
+
+    return (ia > ib) - (ia < ib);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Create an overlay on top of an image file, the file is only read from */
+imageoverlay_t *imageoverlay_new(FILE *base)
+{
+    imageoverlay_t *ov = lib_calloc(1, sizeof(imageoverlay_t));
+
+    ov->base = base;
+    ov->base_size = archdep_file_size(base);
+    if (ov->base_size < 0) {
+        ov->base_size = 0;
+    }
+    ov->committed_size = ov->base_size;
+    ov->size = ov->base_size;
+    ov->buckets = lib_calloc(IMAGEOVERLAY_MIN_BUCKETS, sizeof(imageoverlay_page_t *));
+    ov->hash_mask = IMAGEOVERLAY_MIN_BUCKETS - 1;
+    return ov;
+}
+
+/* Free the overlay, changes that were not committed are lost. The base
+   file stays open. */
+void imageoverlay_destroy(imageoverlay_t *ov)
+{
+    unsigned int i;
+
+    if (ov == NULL) {
+        return;
+    }
+    for (i = 0; i <= ov->hash_mask; i++) {
+        while (ov->buckets[i] != NULL) {
+            imageoverlay_page_t *page = ov->buckets[i];
+
+            ov->buckets[i] = page->next;
+            lib_free(page->saved);
+            lib_free(page);
+        }
+    }
+    lib_free(ov->buckets);
+    lib_free(ov);
+}
+
+off_t imageoverlay_size(imageoverlay_t *ov)
+{
+    return ov->size;
+}
+
+unsigned int imageoverlay_dirty_pages(imageoverlay_t *ov)
+{
+    return ov->dirty;
+}
+
+/* Read like fread() at a given offset, returns the number of bytes read.
+   This is less than num only at the end of the image or on an error. */
+size_t imageoverlay_read(imageoverlay_t *ov, void *buf, size_t num, off_t offset)
+{
+    uint8_t *dst = buf;
+    size_t done = 0;
+
+    if (offset >= ov->size) {
+        return 0;
+    }
+    if ((off_t)num > ov->size - offset) {
+        num = (size_t)(ov->size - offset);
+    }
+
+    while (done < num) {
+        off_t index = offset / IMAGEOVERLAY_PAGE_SIZE;
+        size_t pos = (size_t)(offset % IMAGEOVERLAY_PAGE_SIZE);
+        size_t count = IMAGEOVERLAY_PAGE_SIZE - pos;
+        imageoverlay_page_t *page;
+
+        if (count > num - done) {
+            count = num - done;
+        }
+        page = imageoverlay_lookup(ov, index);
+        if (page != NULL) {
+            memcpy(dst + done, page->data + pos, count);
+        } else {
+            /* read all following pages that have no copy at once */
+            while (done + count < num && imageoverlay_lookup(ov, ++index) == NULL) {
+                size_t more = num - done - count;
+
+                count += more < IMAGEOVERLAY_PAGE_SIZE ? more : IMAGEOVERLAY_PAGE_SIZE;
+            }
+            if (imageoverlay_read_base(ov, dst + done, count, offset) < 0) {
+                log_error(LOG_DEFAULT, "imageoverlay: error reading image at offset %lu.",
+                          (unsigned long)offset);
+                break;
+            }
+        }
+        done += count;
+        offset += count;
+    }
+    return done;
+}
+
+/* Write at a given offset, returns 0 on success, -1 on error */
+int imageoverlay_write(imageoverlay_t *ov, const void *buf, size_t num, off_t offset)
+{
+    const uint8_t *src = buf;
+    size_t done = 0;
+
+    while (done < num) {
+        off_t index = offset / IMAGEOVERLAY_PAGE_SIZE;
+        size_t pos = (size_t)(offset % IMAGEOVERLAY_PAGE_SIZE);
+        size_t count = IMAGEOVERLAY_PAGE_SIZE - pos;
+        imageoverlay_page_t *page;
+
+        if (count > num - done) {
+            count = num - done;
+        }
+        page = imageoverlay_lookup(ov, index);
+        if (page == NULL) {
+            page = imageoverlay_page_new(ov, index);
+            if (page == NULL) {
+                return -1;
+            }
+            page->dirty = 1;
+            ov->dirty++;
+        } else if (!page->dirty) {
+            /* the page was committed before, keep the committed contents
+               for a discard */
+            page->saved = lib_malloc(IMAGEOVERLAY_PAGE_SIZE);
+            memcpy(page->saved, page->data, IMAGEOVERLAY_PAGE_SIZE);
+            page->dirty = 1;
+            ov->dirty++;
+        }
+        memcpy(page->data + pos, src + done, count);
+        done += count;
+        offset += count;
+    }
+    if (offset > ov->size) {
+        ov->size = offset;
+    }
+    return 0;
+}
+
+/* Write all changes to fd, which must be a writable handle of the image.
+   Returns 0 on success, -1 on error. */
+int imageoverlay_commit(imageoverlay_t *ov, FILE *fd)
+{
+    imageoverlay_page_t **order;
+    off_t pos = -1;
+    unsigned int i, n = 0;
+    int result = 0;
+
+    if (ov->dirty == 0) {
+        return 0;
+    }
+
+    order = lib_malloc(ov->dirty * sizeof(imageoverlay_page_t *));
+    for (i = 0; i <= ov->hash_mask; i++) {
+        imageoverlay_page_t *page;
+
+        for (page = ov->buckets[i]; page != NULL; page = page->next) {
+            if (page->dirty) {
+                order[n++] = page;
+            }
+        }
+    }
+    qsort(order, n, sizeof(imageoverlay_page_t *), imageoverlay_compare);
+
+    for (i = 0; i < n; i++) {
+        off_t offset = order[i]->index * IMAGEOVERLAY_PAGE_SIZE;
+        size_t len = IMAGEOVERLAY_PAGE_SIZE;
+
+        if (offset + (off_t)len > ov->size) {
+            len = (size_t)(ov->size - offset);
+        }
+        /* consecutive pages need no seek */
+        if (offset != pos && archdep_fseeko(fd, offset, SEEK_SET) != 0) {
+            result = -1;
+            break;
+        }
+        if (fwrite(order[i]->data, 1, len, fd) != len) {
+            result = -1;
+            break;
+        }
+        pos = offset + (off_t)len;
+    }
+    lib_free(order);
+
+    if (fflush(fd) != 0) {
+        result = -1;
+    }
+    if (result < 0) {
+        log_error(LOG_DEFAULT, "imageoverlay: error writing changes to the image.");
+        return -1;
+    }
+
+    for (i = 0; i <= ov->hash_mask; i++) {
+        imageoverlay_page_t *page;
+
+        for (page = ov->buckets[i]; page != NULL; page = page->next) {
+            lib_free(page->saved);
+            page->saved = NULL;
+            page->dirty = 0;
+        }
+    }
+    ov->dirty = 0;
+    ov->committed_size = ov->size;
+    return 0;
+}
+
+/* Throw away all changes since the last commit */
+void imageoverlay_discard(imageoverlay_t *ov)
+{
+    unsigned int i;
+
+    for (i = 0; i <= ov->hash_mask; i++) {
+        imageoverlay_page_t **p = &ov->buckets[i];
+
+        while (*p != NULL) {
+            imageoverlay_page_t *page = *p;
+
+            if (!page->dirty) {
+                p = &page->next;
+            } else if (page->saved != NULL) {
+                memcpy(page->data, page->saved, IMAGEOVERLAY_PAGE_SIZE);
+                lib_free(page->saved);
+                page->saved = NULL;
+                page->dirty = 0;
+                p = &page->next;
+            } else {
+                *p = page->next;
+                lib_free(page);
+                ov->num_pages--;
+            }
+        }
+    }
+    ov->dirty = 0;
+    ov->size = ov->committed_size;
+}
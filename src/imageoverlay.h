@@ -0,0 +1,54 @@
+/*
+ * imageoverlay.h - Copy-on-write overlay for disk and hard disk images.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_IMAGEOVERLAY_H
+#define VICE_IMAGEOVERLAY_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "types.h"
+
+/* granularity of the copied parts of an image */
+#define IMAGEOVERLAY_PAGE_SIZE 4096
+
+typedef struct imageoverlay_s imageoverlay_t;
+
+int imageoverlay_resources_init(void);
+int imageoverlay_cmdline_options_init(void);
+int imageoverlay_enabled(void);
+int imageoverlay_commit_on_detach(void);
+
+imageoverlay_t *imageoverlay_new(FILE *base);
+void imageoverlay_destroy(imageoverlay_t *ov);
+
+off_t imageoverlay_size(imageoverlay_t *ov);
+unsigned int imageoverlay_dirty_pages(imageoverlay_t *ov);
+
+size_t imageoverlay_read(imageoverlay_t *ov, void *buf, size_t num, off_t offset);
+int imageoverlay_write(imageoverlay_t *ov, const void *buf, size_t num, off_t offset);
+
+int imageoverlay_commit(imageoverlay_t *ov, FILE *fd);
+void imageoverlay_discard(imageoverlay_t *ov);
+
+#endif
@@ -51,6 +51,7 @@
 #include "romset.h"
 #include "screenshot.h"
 #include "signals.h"
+#include "startuptrace.h"
 #include "sysfile.h"
 #include "uiapi.h"
 #include "vdrive.h"
@@ -295,12 +296,14 @@ int init_main(void)
 
     machine_bus_init();
     machine_maincpu_init();
+    startuptrace_phase("romset/palette");
 
     /* Machine-specific initialization.  */
     if (machine_init() < 0) {
         log_error(LOG_DEFAULT, "Machine initialization failed.");
         return -1;
     }
+    startuptrace_phase("machine init");
 
     /* FIXME: what's about uimon_init??? */
     /* the monitor console MUST be available, because of for example cpujam,
@@ -320,6 +323,7 @@ int init_main(void)
     ui_init_finalize();
 
     main_init_hack();
+    startuptrace_phase("finalize");
 
     init_done = 1;
 
@@ -318,6 +318,12 @@ static int cmdline_seed(const char *param, void *extra_param)
     return 0;
 }
 
+/* already handled in main.c, before the startup began */
+static int cmdline_startuptrace(const char *param, void *extra_param)
+{
+    return 0;
+}
+
 static int cmdline_version(const char *param, void *extra_param)
 {
 #ifdef USE_SVN_REVISION
@@ -425,6 +431,9 @@ static const cmdline_option_t common_cmdline_options[] =
     { "-seed", CALL_FUNCTION, CMDLINE_ATTRIB_NEED_ARGS,
       cmdline_seed, NULL, NULL, NULL,
       "<value>", "Set random seed (for debugging)" },
+    { "-startuptrace", CALL_FUNCTION, CMDLINE_ATTRIB_NONE,
+      cmdline_startuptrace, NULL, NULL, NULL,
+      NULL, "Log the time spent in each phase of the startup" },
     { "-core", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
       NULL, NULL, "DoCoreDump", (resource_value_t)1,
       NULL, "Allow production of core dumps" },
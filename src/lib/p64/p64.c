@@ -405,6 +405,10 @@ void P64PulseStreamCreate(PP64PulseStream Instance) {
     Instance->UsedLast = -1;
     Instance->FreeList = -1;
     Instance->CurrentIndex = -1;
+    Instance->Encoded = 0;
+    Instance->EncodedSize = 0;
+    Instance->EncodedPulses = 0;
+    Instance->Modified = 1;
 }
 
 void P64PulseStreamDestroy(PP64PulseStream Instance) {
@@ -412,6 +416,17 @@ void P64PulseStreamDestroy(PP64PulseStream Instance) {
     memset(Instance, 0, sizeof(TP64PulseStream));
 }
 
+/* Forget the encoded form of the track kept since it was read or written */
+void P64PulseStreamDropEncoded(PP64PulseStream Instance) {
+    if(Instance->Encoded) {
+        p64_free(Instance->Encoded);
+    }
+    Instance->Encoded = 0;
+    Instance->EncodedSize = 0;
+    Instance->EncodedPulses = 0;
+    Instance->Modified = 1;
+}
+
 void P64PulseStreamClear(PP64PulseStream Instance) {
     if(Instance->Pulses) {
         p64_free(Instance->Pulses);
@@ -423,6 +438,7 @@ void P64PulseStreamClear(PP64PulseStream Instance) {
     Instance->UsedLast = -1;
     Instance->FreeList = -1;
     Instance->CurrentIndex = -1;
+    P64PulseStreamDropEncoded(Instance);
 }
 
 p64_int32_t P64PulseStreamAllocatePulse(PP64PulseStream Instance) {
@@ -454,6 +470,7 @@ p64_int32_t P64PulseStreamAllocatePulse(PP64PulseStream Instance) {
 }
 
 void P64PulseStreamFreePulse(PP64PulseStream Instance, p64_int32_t Index) {
+    Instance->Modified = 1;
     if(Instance->CurrentIndex == Index) {
         Instance->CurrentIndex = Instance->Pulses[Index].Next;
     }
@@ -474,6 +491,7 @@ void P64PulseStreamFreePulse(PP64PulseStream Instance, p64_int32_t Index) {
 
 void P64PulseStreamAddPulse(PP64PulseStream Instance, p64_uint32_t Position, p64_uint32_t Strength) {
     p64_int32_t Current, Index;
+    Instance->Modified = 1;
     while(Position >= P64PulseSamplesPerRotation) {
         Position -= P64PulseSamplesPerRotation;
     }
@@ -863,9 +881,20 @@ p64_uint32_t P64PulseStreamReadFromStream(PP64PulseStream Instance, PP64MemorySt
 
                 P64RangeCoderProbabilitiesFree(RangeCoderProbabilities);
 
-                p64_free(Buffer);
+                if(Count != CountPulses) {
+                    p64_free(Buffer);
+                    return 0;
+                }
+
+                /* keep the encoded track, it is written back as is unless
+                   the pulses are changed */
+                P64PulseStreamDropEncoded(Instance);
+                Instance->Encoded = Buffer;
+                Instance->EncodedSize = Size;
+                Instance->EncodedPulses = CountPulses;
+                Instance->Modified = 0;
 
-                return Count == CountPulses;
+                return 1;
 
             }
 
@@ -888,6 +917,16 @@ p64_uint32_t P64PulseStreamWriteToStream(PP64PulseStream Instance, PP64MemoryStr
     p64_int32_t Index, Current;
     p64_uint32_t ProbabilityCount, LastPosition, PreviousDeltaPosition, DeltaPosition, LastStrength, CountPulses, Size;
 
+    /* unchanged since the last read or write, no need to encode it again */
+    if(!Instance->Modified && Instance->Encoded) {
+        if(P64MemoryStreamWriteDWord(Stream, &Instance->EncodedPulses)) {
+            if(P64MemoryStreamWriteDWord(Stream, &Instance->EncodedSize)) {
+                return P64MemoryStreamWrite(Stream, Instance->Encoded, Instance->EncodedSize) == Instance->EncodedSize;
+            }
+        }
+        return 0;
+    }
+
     ProbabilityCount = 0;
     for(Index = 0; Index < ProbabilityModelCount; Index++) {
         RangeCoderProbabilityOffsets[Index] = ProbabilityCount;
@@ -966,7 +1005,11 @@ p64_uint32_t P64PulseStreamWriteToStream(PP64PulseStream Instance, PP64MemoryStr
         if(P64MemoryStreamWriteDWord(Stream, &Size)) {
             if(RangeCoderInstance.Buffer) {
                 if(P64MemoryStreamWrite(Stream, RangeCoderInstance.Buffer, RangeCoderInstance.BufferPosition) == RangeCoderInstance.BufferPosition) {
-                    p64_free(RangeCoderInstance.Buffer);
+                    P64PulseStreamDropEncoded(Instance);
+                    Instance->Encoded = RangeCoderInstance.Buffer;
+                    Instance->EncodedSize = Size;
+                    Instance->EncodedPulses = CountPulses;
+                    Instance->Modified = 0;
                     return 1;
                 }
                 p64_free(RangeCoderInstance.Buffer);
@@ -107,6 +107,10 @@ typedef struct {
 	p64_int32_t UsedLast;
 	p64_int32_t FreeList;
 	p64_int32_t CurrentIndex;
+	p64_uint8_t* Encoded;
+	p64_uint32_t EncodedSize;
+	p64_uint32_t EncodedPulses;
+	p64_uint32_t Modified;
 } TP64PulseStream;
 
 typedef TP64PulseStream* PP64PulseStream;
@@ -152,6 +156,7 @@ p64_uint32_t P64MemoryStreamAppendFromCount(PP64MemoryStream Instance, PP64Memor
 void P64PulseStreamCreate(PP64PulseStream Instance);
 void P64PulseStreamDestroy(PP64PulseStream Instance);
 void P64PulseStreamClear(PP64PulseStream Instance);
+void P64PulseStreamDropEncoded(PP64PulseStream Instance);
 p64_int32_t P64PulseStreamAllocatePulse(PP64PulseStream Instance);
 void P64PulseStreamFreePulse(PP64PulseStream Instance, p64_int32_t Index);
 void P64PulseStreamAddPulse(PP64PulseStream Instance, p64_uint32_t Position, p64_uint32_t Strength);
@@ -341,6 +341,20 @@ static void screenshot_at_exit(void)
     }
 }
 
+/* Is a screenshot saved at exit?  */
+bool machine_exit_screenshot_requested(void)
+{
+    if ((ExitScreenshotName != NULL) && (ExitScreenshotName[0] != 0)) {
+        return true;
+    }
+    if (machine_class == VICE_MACHINE_C128) {
+        if ((ExitScreenshotName1 != NULL) && (ExitScreenshotName1[0] != 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void machine_shutdown(void)
 {
     int save_on_exit;
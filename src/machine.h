@@ -195,6 +195,9 @@ unsigned int machine_jam(const char *format, ...) VICE_ATTR_PRINTF;
 bool machine_is_jammed(void);
 char *machine_jam_reason(void);
 
+/* Is a screenshot saved at exit? */
+bool machine_exit_screenshot_requested(void);
+
 /* Update memory pointers if memory mapping has changed. */
 void machine_update_memory_ptrs(void);
 
@@ -60,6 +60,7 @@
 #include "mainlock.h"
 #include "resources.h"
 #include "screenshot.h"
+#include "startuptrace.h"
 #include "sysfile.h"
 #include "types.h"
 #include "uiapi.h"
@@ -70,6 +71,11 @@
 #include "video.h"
 #include "vsyncapi.h"
 
+#ifdef USE_HEADLESSUI
+#include "forkserver.h"
+#include "sidrender.h"
+#endif
+
 #ifdef USE_SVN_REVISION
 #include "svnversion.h"
 #endif
@@ -322,6 +328,15 @@ int main_program(int argc, char **argv)
         }
     }
 
+    /* the startup trace must be enabled before the clock starts, the option
+       itself is accepted (and ignored) by the main commandline handler */
+    for (i = 1; i < argc; i++) {
+        if ((!strcmp(argv[i], "-startuptrace")) ||
+            (!strcmp(argv[i], "--startuptrace"))) {
+            startuptrace_enable();
+        }
+    }
+
     DBG(("main:archdep_init(argc:%d)", argc));
     if (archdep_init(&argc, argv) != 0) {
         archdep_startup_log_error("archdep_init failed.\n");
@@ -330,6 +345,7 @@ int main_program(int argc, char **argv)
 
     DBG(("main:early init"));
     tick_init();
+    startuptrace_start();
     maincpu_early_init();
     machine_setup_context();
     drive_setup_context();
@@ -338,12 +354,17 @@ int main_program(int argc, char **argv)
 
     /* Initialize system file locator.  */
     sysfile_init(machine_name);
+    startuptrace_phase("early init");
 
     /* generic init, first resources, then cmdline options that use them */
-    if ((init_resources() < 0) ||
-        (init_cmdline_options() < 0)) {
+    if (init_resources() < 0) {
+        return -1;
+    }
+    startuptrace_phase("resources");
+    if (init_cmdline_options() < 0) {
         return -1;
     }
+    startuptrace_phase("cmdline options");
 
     /* KLUDGES: this should really get fixed properly, so it can go into the
        regular init function(s) */
@@ -359,12 +380,14 @@ int main_program(int argc, char **argv)
         return -1;
     }
     DBG(("main:early gfxoutput init done"));
+    startuptrace_phase("gfxoutput");
 
     /* Set factory defaults.  */
     if (resources_set_defaults() < 0) {
         archdep_startup_log_error("Cannot set defaults.\n");
         return -1;
     }
+    startuptrace_phase("resource defaults");
 
     /* Initialize the UI actions system, this needs to happen before the UI
      * init so the UI code can register handlers */
@@ -384,6 +407,7 @@ int main_program(int argc, char **argv)
     if (!console_mode) {
         ui_init_with_args(&argc, argv);
     }
+    startuptrace_phase("ui init");
 
     if ((!help_requested) && (loadconfig)) {
         /* Load the user's default configuration file.  */
@@ -397,6 +421,7 @@ int main_program(int argc, char **argv)
             }
         }
     }
+    startuptrace_phase("config file");
 
     /* FIXME: it should be possible to init the log system much earlier */
     DBG(("main:log init"));
@@ -416,11 +441,13 @@ int main_program(int argc, char **argv)
     }
 
     main_log = log_open("Main");
+    startuptrace_phase("log init");
 
     DBG(("main:initcmdline_check_args(argc:%d)", argc));
     if (initcmdline_check_args(argc, argv) < 0) {
         return -1;
     }
+    startuptrace_phase("command line");
 
     /* Initialize the user interface, 2nd part. */
     DBG(("main:uidata_init(argc:%d)", argc));
@@ -428,6 +455,7 @@ int main_program(int argc, char **argv)
         archdep_startup_log_error("Cannot initialize the UI.\n");
         return -1;
     }
+    startuptrace_phase("ui data");
 
     /* VICE boot sequence.  */
     vice_banner();
@@ -451,6 +479,7 @@ int main_program(int argc, char **argv)
     if (/*!console_mode && */video_init() < 0) {
         return -1;
     }
+    startuptrace_phase("video init");
 
     if (initcmdline_check_psid() < 0) {
         return -1;
@@ -459,6 +488,14 @@ int main_program(int argc, char **argv)
     if (init_main() < 0) {
         return -1;
     }
+    startuptrace_report();
+
+#ifdef USE_HEADLESSUI
+    /* with -sidrenderdir, this only returns in the processes that render */
+    if (sidrender_run() < 0) {
+        return -1;
+    }
+#endif
 
 #ifdef USE_VICE_THREAD
 
@@ -485,6 +522,18 @@ int main_program(int argc, char **argv)
 
 #else /* #ifdef USE_VICE_THREAD */
 
+#ifdef USE_FUZZING
+    /* libFuzzer runs the machine, see arch/headless/fuzz.c */
+    return 0;
+#endif
+
+#ifdef USE_HEADLESSUI
+    /* with -forkserver, this only returns in the processes that run */
+    if (forkserver_run() < 0) {
+        return -1;
+    }
+#endif
+
     main_loop_forever();
 
 #endif /* #ifdef USE_VICE_THREAD */
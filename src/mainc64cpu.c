@@ -56,6 +56,10 @@
 #include "traps.h"
 #include "types.h"
 
+#ifdef USE_FUZZING
+#include "fuzz.h"
+#endif
+
 #ifndef EXIT_FAILURE
 #define EXIT_FAILURE 1
 #endif
@@ -46,6 +46,7 @@
 #include "log.h"
 #include "machine.h"
 #include "mainlock.h"
+#include "video.h"
 #include "vsyncapi.h"
 
 /* This is lock coordinates access to VICE data structures */
@@ -173,6 +174,9 @@ void mainlock_yield_begin(void)
 
     pthread_mutex_lock(&internal_lock);
     if (ui_is_waiting) {
+        /* The UI may change what the refresh threads are rendering */
+        video_canvas_refresh_thread_wait(NULL);
+
         /* Wake up the UI thread */
         pthread_cond_signal(&ui_waiting_cond);
         /* Block until the UI has the main lock */
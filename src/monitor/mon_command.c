@@ -751,6 +751,20 @@ static const mon_cmds_t mon_cmd_array[] = {
       FILENAME_ARG
     },
 
+    { "overlay_commit", "",
+      "<device>",
+      "Write the changes kept in memory for the disk image in the device"
+      " (see ImageOverlay) to the image file.",
+      NO_FILENAME_ARG
+    },
+
+    { "overlay_discard", "",
+      "<device>",
+      "Throw away the changes kept in memory for the disk image in the"
+      " device since the last overlay_commit.",
+      NO_FILENAME_ARG
+    },
+
     { "save", "s",
       "\"<filename>\" <device> <address1> <address2>",
       "Save the memory from address1 to address2 to the specified file."
@@ -493,6 +493,30 @@ void mon_detach(int device)
     }
 }
 
+void mon_overlay_commit(int device)
+{
+    if (device < 8 || device > 11) {
+        mon_out("Unknown device %i.\n", device);
+        return;
+    }
+    /* TODO: drive 1? */
+    if (file_system_overlay_commit(device, 0) < 0) {
+        mon_out("Failed.\n");
+    }
+}
+
+void mon_overlay_discard(int device)
+{
+    if (device < 8 || device > 11) {
+        mon_out("Unknown device %i.\n", device);
+        return;
+    }
+    /* TODO: drive 1? */
+    if (file_system_overlay_discard(device, 0) < 0) {
+        mon_out("Failed.\n");
+    }
+}
+
 int mon_autostart(const char *image_name,
                    int file_index,
                    int run)
@@ -38,6 +38,8 @@ void mon_file_verify(const char *filename, int device, MON_ADDR start_addr, bool
 
 void mon_attach(const char *filename, int unit);
 void mon_detach(int unit);
+void mon_overlay_commit(int unit);
+void mon_overlay_discard(int unit);
 
 int mon_autostart(const char *image_name, int file_index, int run);
 
@@ -155,6 +155,7 @@ void set_yydebug(int val);
 %token CMD_COMMENT CMD_LIST CMD_STOPWATCH RESET
 %token CMD_EXPORT CMD_AUTOSTART CMD_AUTOLOAD CMD_MAINCPU_TRACE
 %token CMD_WARP
+%token CMD_OVERLAY_COMMIT CMD_OVERLAY_DISCARD
 %token CMD_PROFILE FLAT GRAPH FUNC DEPTH DISASS PROFILE_CONTEXT CLEAR
 %token<str> CMD_LABEL_ASGN
 %token<i> L_PAREN R_PAREN ARG_IMMEDIATE REG_A REG_X REG_Y COMMA INST_SEP
@@ -663,6 +664,10 @@ disk_rules: CMD_LOAD filename device_num opt_address end_cmd
             { mon_attach($2,$3); }
           | CMD_DETACH expression end_cmd
             { mon_detach($2); }
+          | CMD_OVERLAY_COMMIT expression end_cmd
+            { mon_overlay_commit($2); }
+          | CMD_OVERLAY_DISCARD expression end_cmd
+            { mon_overlay_discard($2); }
           | CMD_AUTOSTART filename end_cmd
             { mon_autostart($2,0,1); }
           | CMD_AUTOSTART filename opt_sep number end_cmd
@@ -43,6 +43,7 @@
 
 #include "archdep.h"
 #include "cmdline.h"
+#include "drive.h"
 #include "interrupt.h"
 #include "lib.h"
 #include "log.h"
@@ -85,12 +86,103 @@ static unsigned short server_port;
 static int res_server_port;
 static int frame_delta;
 static int network_control;
+static int network_rollback;
 
 static int frame_buffer_full;
 static int current_frame, frame_to_play;
 static event_list_state_t *frame_event_list = NULL;
 static char *snapshotfilename;
 
+/* Rollback mode: instead of delaying the local input until the input of the
+   peer for the same frame has arrived, the input of the peer is predicted
+   (no events means the keyboard and joysticks stay as they are) and the
+   emulation runs on. The machine state after each frame is kept, and when
+   input of the peer arrives for a frame that was already emulated, the
+   state before that frame is restored and the following frames are emulated
+   again in warp mode. The GCR data of the drives is kept along with the
+   state, the machine snapshot does not include the disks.  */
+
+/* number of frames kept; the local side can get ahead of the peer by
+   three frames less than this before it has to wait: a misprediction that
+   far back needs the state before it, the frames emulated again and the
+   slot of the next frame */
+#define ROLLBACK_FRAMES 8
+#define ROLLBACK_AHEAD  (ROLLBACK_FRAMES - 3)
+
+/* frame number, frame number of the sync test, 5 registers */
+#define ROLLBACK_HEADER_SIZE (2 * 4 + 5 * 4)
+
+typedef struct rollback_frame_s {
+    int frame;                      /* frame kept in this slot */
+    event_list_state_t local;       /* events recorded locally */
+    event_list_state_t *remote;     /* events of the peer, NULL if not there yet */
+    char *state;                    /* machine state after this frame */
+    drive_gcr_state_t *disks;       /* GCR data of the drives after this frame */
+    int saved;                      /* state has been written */
+    uint8_t regs[5 * 4];            /* CPU registers when the state was saved */
+} rollback_frame_t;
+
+static int rollback_active;
+static rollback_frame_t rollback_ring[ROLLBACK_FRAMES];
+static int rollback_frame;          /* frame being emulated */
+static int rollback_confirmed;      /* last frame the input of the peer arrived for */
+static int rollback_saved;          /* last frame the state was saved for */
+static int rollback_mispredicted;   /* first frame emulated with wrong input, or -1 */
+static int rollback_replay_next;    /* next frame emulated again, or -1 */
+static int rollback_replay_to;      /* last frame emulated again */
+static int rollback_warp;           /* warp mode before emulating frames again */
+static int rollback_spectated;      /* last frame sent to the spectators */
+
+/* Spectators: read-only observers that get the event lists of each frame
+   from the server and play them back on their own emulation. A spectator
+   that joins late gets the last keyframe (the settings and a snapshot) and
+   the frames since. Data for the spectators is queued and sent without
+   blocking, so a slow spectator can not stall the players; when its queue
+   is full it is dropped.  */
+
+#define NETWORK_SPECTATORS_MAX 16
+
+/* data queued for one spectator before it is dropped, on top of the
+   keyframe it may still be sending */
+#define SPECTATOR_QUEUE_MAX (4 * 1024 * 1024)
+
+/* largest snapshot sent in a keyframe. It includes the ROMs and the disk
+   images, with a 16MB REU and a few disks it gets well past the queue
+   size above */
+#define SPECTATOR_SNAPSHOT_MAX (64 * 1024 * 1024)
+
+/* frames between two keyframes */
+#define SPECTATOR_KEYFRAME_INTERVAL 500
+
+/* messages of the spectator stream: type, payload length, payload */
+#define SPECTATOR_MSG_SETTINGS  1   /* event list of the settings */
+#define SPECTATOR_MSG_SNAPSHOT  2   /* snapshot file */
+#define SPECTATOR_MSG_FRAME     3   /* length of server list, server list, client list */
+
+#define SPECTATOR_MSG_HEADER_SIZE (2 * 4)
+
+typedef struct spectator_s {
+    vice_network_socket_t *socket;  /* NULL if the slot is free */
+    int synced;                     /* got a keyframe */
+    uint8_t *queue;                 /* data not sent yet */
+    size_t queue_start;
+    size_t queue_end;
+    size_t queue_size;
+} spectator_t;
+
+static int spectator_port;
+static vice_network_socket_t *spectator_listen_socket;
+static spectator_t spectators[NETWORK_SPECTATORS_MAX];
+static int spectators_connected;
+static uint8_t *spectator_keyframe;     /* settings and snapshot messages */
+static size_t spectator_keyframe_len;
+static uint8_t *spectator_log;          /* frame messages since the keyframe */
+static size_t spectator_log_len;
+static size_t spectator_log_size;
+static int spectator_log_frames;
+static int spectator_keyframe_pending;  /* keyframe trap triggered */
+static int spectator_synced;            /* spectator side: keyframe loaded */
+
 static int set_server_name(const char *val, void *param)
 {
     util_string_set(&server_name, val);
@@ -116,6 +208,24 @@ static int set_server_port(int val, void *param)
     return 0;
 }
 
+static int set_network_rollback(int val, void *param)
+{
+    network_rollback = val ? 1 : 0;
+
+    return 0;
+}
+
+static int set_spectator_port(int val, void *param)
+{
+    if (val != 0 && (val < 1024 || val > 65535)) {
+        return -1;
+    }
+
+    spectator_port = val;
+
+    return 0;
+}
+
 static int set_network_control(int val, void *param)
 {
     network_control = val;
@@ -141,6 +251,10 @@ static const resource_int_t resources_int[] = {
       &res_server_port, set_server_port, NULL },
     { "NetworkControl", NETWORK_CONTROL_DEFAULT, RES_EVENT_SAME, NULL,
       &network_control, set_network_control, NULL },
+    { "NetworkRollback", 0, RES_EVENT_NO, NULL,
+      &network_rollback, set_network_rollback, NULL },
+    { "NetworkSpectatorPort", 0, RES_EVENT_NO, NULL,
+      &spectator_port, set_spectator_port, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -225,6 +339,15 @@ static const cmdline_option_t cmdline_options[] =
     { "-netplayctrl", CALL_FUNCTION, CMDLINE_ATTRIB_NEED_ARGS,
       network_control_cmd, NULL, NULL, NULL,
       "<key,joy1,joy2,dev,rsrc>", "Set the netplay control elements (keyboard, joystick1, joystick2, devices and resources), each item takes a value (0: None, 1: Server, 2: Client, 3: Both)" },
+    { "-netplayrollback", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "NetworkRollback", (resource_value_t)1,
+      NULL, "Predict the input of the remote side and roll back on mispredictions instead of delaying the local input (server only)" },
+    { "+netplayrollback", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "NetworkRollback", (resource_value_t)0,
+      NULL, "Delay the local input until the input of the remote side has arrived" },
+    { "-netplayspectatorport", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "NetworkSpectatorPort", NULL,
+      "<port>", "Set the netplay spectator port (0: no spectators, 1024..65535)" },
     CMDLINE_LIST_END
 };
 
@@ -405,6 +528,811 @@ static ssize_t network_send_buffer(vice_network_socket_t * s, const uint8_t *buf
     return 0;
 }
 
+/*---------- Spectators ----------------------------------------------*/
+
+static void network_buffer_append(uint8_t **buf, size_t *len, size_t *size,
+                                  const uint8_t *data, size_t data_len)
+{
+    if (data_len == 0) {
+        return;
+    }
+    if (*len + data_len > *size) {
+        *size = (*len + data_len) * 2;
+        *buf = lib_realloc(*buf, *size);
+    }
+    memcpy(*buf + *len, data, data_len);
+    *len += data_len;
+}
+
+static void network_spectator_append_header(uint8_t **buf, size_t *len, size_t *size,
+                                            int type, size_t payload_len)
+{
+    uint8_t header[SPECTATOR_MSG_HEADER_SIZE];
+
+    util_int_to_le_buf4(&header[0], type);
+    util_int_to_le_buf4(&header[4], (int)payload_len);
+    network_buffer_append(buf, len, size, header, sizeof(header));
+}
+
+static void network_spectator_drop(spectator_t *s)
+{
+    DBG(("network_spectator_drop %d", (int)(s - spectators)));
+    vice_network_socket_close(s->socket);
+    lib_free(s->queue);
+    memset(s, 0, sizeof(spectator_t));
+    spectators_connected--;
+
+    /* nobody left to keep the keyframe for */
+    if (spectators_connected == 0) {
+        lib_free(spectator_keyframe);
+        lib_free(spectator_log);
+        spectator_keyframe = NULL;
+        spectator_log = NULL;
+        spectator_keyframe_len = 0;
+        spectator_log_len = 0;
+        spectator_log_size = 0;
+        spectator_log_frames = 0;
+    }
+}
+
+static void network_spectator_free(void)
+{
+    int i;
+
+    for (i = 0; i < NETWORK_SPECTATORS_MAX; i++) {
+        if (spectators[i].socket != NULL) {
+            network_spectator_drop(&spectators[i]);
+        }
+    }
+}
+
+/* Queue data for a spectator; it is dropped if it got too far behind */
+static int network_spectator_queue(spectator_t *s, const uint8_t *data, size_t len)
+{
+    if (s->queue_end - s->queue_start + len > SPECTATOR_QUEUE_MAX + spectator_keyframe_len) {
+        log_message(LOG_DEFAULT, "netplay: spectator too slow, dropping it.");
+        network_spectator_drop(s);
+        return -1;
+    }
+    if (s->queue_end + len > s->queue_size && s->queue_start > 0) {
+        memmove(s->queue, s->queue + s->queue_start, s->queue_end - s->queue_start);
+        s->queue_end -= s->queue_start;
+        s->queue_start = 0;
+    }
+    network_buffer_append(&s->queue, &s->queue_end, &s->queue_size, data, len);
+    return 0;
+}
+
+/* Send what the sockets take without blocking */
+static void network_spectator_flush(void)
+{
+    int i;
+    ssize_t t;
+    spectator_t *s;
+
+    for (i = 0; i < NETWORK_SPECTATORS_MAX; i++) {
+        s = &spectators[i];
+        while (s->socket != NULL && s->queue_start < s->queue_end) {
+            t = vice_network_send(s->socket, s->queue + s->queue_start,
+                                  s->queue_end - s->queue_start, SEND_FLAGS);
+            if (t < 0 && !vice_network_would_block()) {
+                log_message(LOG_DEFAULT, "netplay: spectator disconnected.");
+                network_spectator_drop(s);
+                break;
+            }
+            if (t <= 0) {
+                break;
+            }
+            s->queue_start += (size_t)t;
+        }
+        if (s->queue_start == s->queue_end) {
+            s->queue_start = 0;
+            s->queue_end = 0;
+        }
+    }
+}
+
+/* Bring a spectator up to date: keyframe and the frames since */
+static void network_spectator_sync(spectator_t *s)
+{
+    if (network_spectator_queue(s, spectator_keyframe, spectator_keyframe_len) < 0) {
+        return;
+    }
+    if (spectator_log_len > 0
+        && network_spectator_queue(s, spectator_log, spectator_log_len) < 0) {
+        return;
+    }
+    s->synced = 1;
+}
+
+static void network_spectator_accept(void)
+{
+    vice_network_socket_t *sockfd;
+    int i;
+
+    if (spectator_listen_socket == NULL
+        || vice_network_select_poll_one(spectator_listen_socket) == 0) {
+        return;
+    }
+
+    sockfd = vice_network_accept(spectator_listen_socket);
+    if (sockfd == NULL) {
+        return;
+    }
+
+    for (i = 0; i < NETWORK_SPECTATORS_MAX; i++) {
+        if (spectators[i].socket == NULL) {
+            break;
+        }
+    }
+    if (i == NETWORK_SPECTATORS_MAX
+        || vice_network_socket_set_nonblocking(sockfd) < 0) {
+        log_message(LOG_DEFAULT, "netplay: refusing spectator.");
+        vice_network_socket_close(sockfd);
+        return;
+    }
+
+    log_message(LOG_DEFAULT, "netplay: spectator connected.");
+    spectators[i].socket = sockfd;
+    spectators_connected++;
+
+    /* without a keyframe it waits for the next one */
+    if (spectator_keyframe != NULL) {
+        network_spectator_sync(&spectators[i]);
+    }
+}
+
+/* Send the event lists played in one frame to the spectators. A frame
+   without lists keeps the spectators in step with the players.  */
+static void network_spectator_frame(event_list_state_t *server_list,
+                                    event_list_state_t *client_list)
+{
+    uint8_t *server_buf = NULL;
+    uint8_t *client_buf = NULL;
+    unsigned int server_len, client_len;
+    uint8_t *msg = NULL;
+    size_t msg_len = 0, msg_size = 0;
+    uint8_t server_len4[4];
+    int i;
+
+    if (spectators_connected == 0) {
+        return;
+    }
+
+    server_len = network_create_event_buffer(&server_buf, server_list);
+    client_len = network_create_event_buffer(&client_buf, client_list);
+
+    network_spectator_append_header(&msg, &msg_len, &msg_size, SPECTATOR_MSG_FRAME,
+                                    4 + server_len + client_len);
+    util_int_to_le_buf4(server_len4, (int)server_len);
+    network_buffer_append(&msg, &msg_len, &msg_size, server_len4, 4);
+    network_buffer_append(&msg, &msg_len, &msg_size, server_buf, server_len);
+    network_buffer_append(&msg, &msg_len, &msg_size, client_buf, client_len);
+    lib_free(server_buf);
+    lib_free(client_buf);
+
+    if (spectator_keyframe != NULL) {
+        network_buffer_append(&spectator_log, &spectator_log_len, &spectator_log_size,
+                              msg, msg_len);
+        spectator_log_frames++;
+    }
+
+    for (i = 0; i < NETWORK_SPECTATORS_MAX; i++) {
+        if (spectators[i].socket != NULL && spectators[i].synced) {
+            network_spectator_queue(&spectators[i], msg, msg_len);
+        }
+    }
+    lib_free(msg);
+}
+
+static void network_spectator_keyframe_trap(uint16_t addr, void *data)
+{
+    event_list_state_t settings_list;
+    uint8_t *settings_buf = NULL;
+    uint8_t *file_buf;
+    unsigned int settings_len;
+    size_t keyframe_size = 0;
+    char *filename;
+    FILE *f;
+    off_t file_len = -1;
+    int i;
+
+    spectator_keyframe_pending = 0;
+    if (spectators_connected == 0) {
+        return;
+    }
+
+    filename = archdep_tmpnam();
+    f = NULL;
+    if (machine_write_snapshot(filename, 1, 1, 0) == 0) {
+        f = fopen(filename, MODE_READ);
+    }
+    if (f != NULL) {
+        file_len = archdep_file_size(f);
+        if (file_len > SPECTATOR_SNAPSHOT_MAX) {
+            log_error(LOG_DEFAULT, "netplay: snapshot of %ld bytes is too large for the spectators.",
+                      (long)file_len);
+            file_len = -1;
+        }
+    }
+    file_buf = NULL;
+    if (file_len >= 0) {
+        file_buf = lib_malloc((size_t)file_len);
+        if (fread(file_buf, 1, (size_t)file_len, f) != (size_t)file_len) {
+            lib_free(file_buf);
+            file_buf = NULL;
+        }
+    }
+    if (f != NULL) {
+        fclose(f);
+    }
+    archdep_remove(filename);
+    lib_free(filename);
+    if (file_buf == NULL) {
+        log_error(LOG_DEFAULT, "netplay: cannot create a keyframe for the spectators.");
+        network_spectator_free();
+        return;
+    }
+
+    event_register_event_list(&settings_list);
+    resources_get_event_safe_list(&settings_list);
+    settings_len = network_create_event_buffer(&settings_buf, &settings_list);
+    event_clear_list(&settings_list);
+
+    lib_free(spectator_keyframe);
+    spectator_keyframe = NULL;
+    spectator_keyframe_len = 0;
+    network_spectator_append_header(&spectator_keyframe, &spectator_keyframe_len, &keyframe_size,
+                                    SPECTATOR_MSG_SETTINGS, settings_len);
+    network_buffer_append(&spectator_keyframe, &spectator_keyframe_len, &keyframe_size,
+                          settings_buf, settings_len);
+    network_spectator_append_header(&spectator_keyframe, &spectator_keyframe_len, &keyframe_size,
+                                    SPECTATOR_MSG_SNAPSHOT, (size_t)file_len);
+    network_buffer_append(&spectator_keyframe, &spectator_keyframe_len, &keyframe_size,
+                          file_buf, (size_t)file_len);
+    lib_free(settings_buf);
+    lib_free(file_buf);
+
+    spectator_log_len = 0;
+    spectator_log_frames = 0;
+
+    for (i = 0; i < NETWORK_SPECTATORS_MAX; i++) {
+        if (spectators[i].socket != NULL && !spectators[i].synced) {
+            network_spectator_sync(&spectators[i]);
+        }
+    }
+}
+
+/* A new keyframe is taken when a spectator waits for one, and from time to
+   time so the log for late joiners stays short.  */
+static int network_spectator_keyframe_wanted(void)
+{
+    if (spectators_connected == 0 || spectator_keyframe_pending) {
+        return 0;
+    }
+    return spectator_keyframe == NULL || spectator_log_frames >= SPECTATOR_KEYFRAME_INTERVAL;
+}
+
+/* Whether the players may wait for each other to get a keyframe */
+static int network_spectator_keyframe_due(void)
+{
+    return network_spectator_keyframe_wanted()
+           && (spectator_keyframe == NULL
+               || spectator_log_frames >= 2 * SPECTATOR_KEYFRAME_INTERVAL);
+}
+
+/* Called after the events of a frame were played */
+static void network_spectator_keyframe(void)
+{
+    if (network_spectator_keyframe_wanted()) {
+        spectator_keyframe_pending = 1;
+        interrupt_maincpu_trigger_trap(network_spectator_keyframe_trap, NULL);
+    }
+}
+
+static int network_spectator_start(void)
+{
+    vice_network_socket_address_t *spectator_addr;
+
+    if (spectator_port == 0) {
+        return 0;
+    }
+
+    spectator_addr = vice_network_address_generate(server_bind_address,
+                                                   (unsigned short)spectator_port);
+    if (spectator_addr == NULL) {
+        return -1;
+    }
+    spectator_listen_socket = vice_network_server(spectator_addr);
+    vice_network_address_close(spectator_addr);
+
+    return spectator_listen_socket != NULL ? 0 : -1;
+}
+
+/* spectator side */
+
+static uint8_t *network_spectator_receive(int *type, size_t *len)
+{
+    uint8_t header[SPECTATOR_MSG_HEADER_SIZE];
+    uint8_t *buf;
+    int payload_len;
+
+    if (network_recv_buffer(network_socket, header, sizeof(header)) < 0) {
+        return NULL;
+    }
+    *type = util_le_buf4_to_int(&header[0]);
+    payload_len = util_le_buf4_to_int(&header[4]);
+    /* the server never sends larger messages, so anything larger is not a
+       message of a VICE server */
+    if (payload_len < 0
+        || payload_len > ((*type == SPECTATOR_MSG_SNAPSHOT) ? SPECTATOR_SNAPSHOT_MAX
+                                                            : SPECTATOR_QUEUE_MAX)) {
+        log_error(LOG_DEFAULT, "netplay: invalid spectator message of %d bytes.", payload_len);
+        return NULL;
+    }
+    *len = (size_t)payload_len;
+
+    buf = lib_malloc(*len + 1);
+    if (network_recv_buffer(network_socket, buf, (ssize_t)*len) < 0) {
+        lib_free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+static void network_spectator_play(uint8_t *buf)
+{
+    event_list_state_t *list;
+
+    list = network_create_event_list(buf);
+    event_playback_event_list(list);
+    event_clear_list(list);
+    lib_free(list);
+}
+
+static void network_spectator_snapshot_trap(uint16_t addr, void *data)
+{
+    char *filename = (char *)data;
+
+    if (network_mode == NETWORK_SPECTATOR) {
+        if (machine_read_snapshot(filename, 0) != 0) {
+            ui_error("Cannot open snapshot file %s", filename);
+            network_disconnect();
+        } else {
+            ui_display_statustext("Spectating...", true);
+        }
+    }
+    archdep_remove(filename);
+    lib_free(filename);
+}
+
+static int network_spectator_load_snapshot(const uint8_t *buf, size_t len)
+{
+    char *filename = NULL;
+    FILE *f;
+
+    f = archdep_mkstemp_fd(&filename, MODE_WRITE);
+    if (f == NULL) {
+        ui_error("Cannot create snapshot file. Select different history directory!");
+        return -1;
+    }
+    if (fwrite(buf, 1, len, f) != len) {
+        log_debug(LOG_DEFAULT, "network_spectator_load_snapshot write failed.");
+    }
+    fclose(f);
+
+    interrupt_maincpu_trigger_trap(network_spectator_snapshot_trap, filename);
+    return 0;
+}
+
+/* Until the keyframe is there, the emulation runs on; after that one frame
+   of the players is played each frame.  */
+static void network_hook_spectator(void)
+{
+    uint8_t *buf;
+    size_t len;
+    int type;
+    unsigned int server_len;
+
+    do {
+        if (!spectator_synced && vice_network_select_poll_one(network_socket) == 0) {
+            return;
+        }
+        buf = network_spectator_receive(&type, &len);
+        if (buf == NULL) {
+            ui_display_statustext("Netplay server disconnected.", true);
+            network_disconnect();
+            return;
+        }
+
+        switch (type) {
+            case SPECTATOR_MSG_SETTINGS:
+                network_spectator_play(buf);
+                break;
+            case SPECTATOR_MSG_SNAPSHOT:
+                if (network_spectator_load_snapshot(buf, len) < 0) {
+                    lib_free(buf);
+                    network_disconnect();
+                    return;
+                }
+                spectator_synced = 1;
+                break;
+            case SPECTATOR_MSG_FRAME:
+                if (len < 4) {
+                    break;
+                }
+                server_len = util_le_buf_to_dword(&buf[0]);
+                if (server_len > 0) {
+                    network_spectator_play(&buf[4]);
+                }
+                if (len > 4 + server_len) {
+                    network_spectator_play(&buf[4 + server_len]);
+                }
+                break;
+            default:
+                log_error(LOG_DEFAULT, "netplay: unknown spectator message %d.", type);
+                break;
+        }
+        lib_free(buf);
+    } while (type == SPECTATOR_MSG_SETTINGS);
+}
+
+/*---------- Rollback ------------------------------------------------*/
+
+static rollback_frame_t *network_rollback_slot(int frame)
+{
+    return &rollback_ring[frame % ROLLBACK_FRAMES];
+}
+
+static void network_rollback_clear_slot(rollback_frame_t *slot)
+{
+    if (slot->local.base != NULL) {
+        event_clear_list(&slot->local);
+        slot->local.base = slot->local.current = NULL;
+    }
+    if (slot->remote != NULL) {
+        event_clear_list(slot->remote);
+        lib_free(slot->remote);
+        slot->remote = NULL;
+    }
+    slot->saved = 0;
+}
+
+/* Start recording the local events of a new frame */
+static void network_rollback_prepare_frame(int frame)
+{
+    rollback_frame_t *slot = network_rollback_slot(frame);
+
+    network_rollback_clear_slot(slot);
+    slot->frame = frame;
+    event_register_event_list(&slot->local);
+    rollback_frame = frame;
+}
+
+static void network_rollback_save_trap(uint16_t addr, void *data)
+{
+    int frame = vice_ptr_to_int(data);
+    rollback_frame_t *slot = network_rollback_slot(frame);
+
+    if (!rollback_active || slot->frame != frame) {
+        return;
+    }
+
+    util_dword_to_le_buf(&slot->regs[0 * 4], (uint32_t)(maincpu_get_pc()));
+    util_dword_to_le_buf(&slot->regs[1 * 4], (uint32_t)(maincpu_get_a()));
+    util_dword_to_le_buf(&slot->regs[2 * 4], (uint32_t)(maincpu_get_x()));
+    util_dword_to_le_buf(&slot->regs[3 * 4], (uint32_t)(maincpu_get_y()));
+    util_dword_to_le_buf(&slot->regs[4 * 4], (uint32_t)(maincpu_get_sp()));
+
+    if (machine_write_snapshot(slot->state, 0, 0, 0) < 0) {
+        log_error(LOG_DEFAULT, "netplay: cannot save the state of frame %d.", frame);
+        return;
+    }
+    drive_gcr_state_save(slot->disks);
+    slot->saved = 1;
+    rollback_saved = frame;
+}
+
+static void network_rollback_restore_trap(uint16_t addr, void *data)
+{
+    int frame = vice_ptr_to_int(data);
+    rollback_frame_t *slot = network_rollback_slot(frame);
+
+    if (!rollback_active) {
+        return;
+    }
+
+    DBG(("network_rollback_restore_trap frame: %d", frame));
+
+    if (slot->frame != frame || !slot->saved
+        || machine_read_snapshot(slot->state, 0) < 0) {
+        ui_error("Cannot restore the netplay state of frame %d - disconnecting.", frame);
+        network_disconnect();
+        return;
+    }
+    drive_gcr_state_restore(slot->disks);
+    rollback_saved = frame;
+}
+
+static void network_rollback_free(void)
+{
+    int i;
+
+    for (i = 0; i < ROLLBACK_FRAMES; i++) {
+        network_rollback_clear_slot(&rollback_ring[i]);
+        if (rollback_ring[i].state != NULL) {
+            archdep_remove(rollback_ring[i].state);
+            lib_free(rollback_ring[i].state);
+            rollback_ring[i].state = NULL;
+        }
+        drive_gcr_state_free(rollback_ring[i].disks);
+        rollback_ring[i].disks = NULL;
+    }
+    if (rollback_active && rollback_replay_next >= 0) {
+        vsync_set_warp_mode(rollback_warp);
+    }
+    rollback_active = 0;
+}
+
+/* Called from the connect traps, the state of frame 0 is the state both
+   sides start from */
+static int network_rollback_init(void)
+{
+    int i;
+
+    for (i = 0; i < ROLLBACK_FRAMES; i++) {
+        memset(&rollback_ring[i], 0, sizeof(rollback_frame_t));
+        rollback_ring[i].frame = -1;
+        rollback_ring[i].state = archdep_tmpnam();
+        rollback_ring[i].disks = drive_gcr_state_new();
+    }
+    rollback_active = 1;
+    rollback_confirmed = 0;
+    rollback_saved = -1;
+    rollback_mispredicted = -1;
+    rollback_replay_next = -1;
+    rollback_replay_to = -1;
+    rollback_spectated = 0;
+
+    network_rollback_prepare_frame(0);
+    network_rollback_save_trap(0, vice_int_to_ptr(0));
+    if (rollback_saved != 0) {
+        network_rollback_free();
+        return -1;
+    }
+    network_rollback_prepare_frame(1);
+
+    return 0;
+}
+
+/* A list of the peer that does not change anything confirms the prediction */
+static int network_rollback_list_empty(event_list_state_t *list)
+{
+    event_list_t *current;
+
+    for (current = list->base; current != NULL && current->type != EVENT_LIST_END; current = current->next) {
+        if (current->type != EVENT_SYNC_TEST) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void network_rollback_check_sync(int frame, const uint8_t *regs)
+{
+    rollback_frame_t *slot;
+
+    if (frame < 0 || rollback_mispredicted >= 0) {
+        return;
+    }
+    slot = network_rollback_slot(frame);
+    if (slot->frame != frame || !slot->saved || frame > rollback_confirmed) {
+        return;
+    }
+    if (memcmp(slot->regs, regs, sizeof(slot->regs)) != 0) {
+        ui_error("Network out of sync - disconnecting.");
+        network_disconnect();
+    }
+}
+
+/* Read one message of the peer. Returns -1 on error, 0 if the peer suspended
+   the emulation and 1 if the input of a frame arrived.  */
+static int network_rollback_receive(void)
+{
+    uint8_t recv_len4[4];
+    uint8_t *buf;
+    unsigned int recv_len;
+    int frame, sync_frame;
+    rollback_frame_t *slot;
+
+    if (network_recv_buffer(network_socket, recv_len4, 4) < 0) {
+        return -1;
+    }
+    recv_len = util_le_buf4_to_int(recv_len4);
+    if (recv_len == 0) {
+        ui_display_statustext("Remote host suspending...", false);
+        suspended = 1;
+        vsync_suspend_speed_eval();
+        return 0;
+    }
+    if (recv_len < ROLLBACK_HEADER_SIZE + 3 * 4) {
+        return -1;
+    }
+    if (suspended == 1) {
+        ui_display_statustext("", false);
+        suspended = 0;
+    }
+
+    buf = lib_malloc(recv_len);
+    if (network_recv_buffer(network_socket, buf, recv_len) < 0) {
+        lib_free(buf);
+        return -1;
+    }
+
+    frame = (int)util_le_buf_to_dword(&buf[0]);
+    sync_frame = (int)util_le_buf_to_dword(&buf[4]);
+    slot = network_rollback_slot(frame);
+    if (frame != rollback_confirmed + 1 || slot->frame != frame) {
+        log_error(LOG_DEFAULT, "netplay: unexpected input for frame %d.", frame);
+        lib_free(buf);
+        return -1;
+    }
+
+    slot->remote = network_create_event_list(&buf[ROLLBACK_HEADER_SIZE]);
+    rollback_confirmed = frame;
+
+    /* the frame was emulated without these events */
+    if (frame < rollback_frame && !network_rollback_list_empty(slot->remote)
+        && rollback_mispredicted < 0) {
+        rollback_mispredicted = frame;
+    }
+
+    network_rollback_check_sync(sync_frame, &buf[8]);
+    lib_free(buf);
+    return 1;
+}
+
+static int network_rollback_send(void)
+{
+    uint8_t *event_buf = NULL;
+    uint8_t *buf;
+    unsigned int event_len;
+    uint8_t send_len4[4];
+    rollback_frame_t *slot = network_rollback_slot(rollback_frame);
+    rollback_frame_t *sync_slot;
+    int sync_frame;
+    ssize_t ret;
+
+    event_len = network_create_event_buffer(&event_buf, &slot->local);
+
+    /* the last state that can not change anymore */
+    sync_frame = (rollback_confirmed < rollback_saved) ? rollback_confirmed : rollback_saved;
+    if (rollback_mispredicted >= 0 || rollback_replay_next >= 0) {
+        sync_frame = -1;
+    }
+
+    buf = lib_malloc(ROLLBACK_HEADER_SIZE + event_len);
+    util_dword_to_le_buf(&buf[0], (uint32_t)rollback_frame);
+    util_dword_to_le_buf(&buf[4], (uint32_t)sync_frame);
+    memset(&buf[8], 0, 5 * 4);
+    if (sync_frame >= 0) {
+        sync_slot = network_rollback_slot(sync_frame);
+        memcpy(&buf[8], sync_slot->regs, sizeof(sync_slot->regs));
+    }
+    memcpy(&buf[ROLLBACK_HEADER_SIZE], event_buf, event_len);
+    lib_free(event_buf);
+
+    util_int_to_le_buf4(send_len4, (int)(ROLLBACK_HEADER_SIZE + event_len));
+    ret = network_send_buffer(network_socket, send_len4, 4);
+    if (ret >= 0) {
+        ret = network_send_buffer(network_socket, buf, ROLLBACK_HEADER_SIZE + event_len);
+    }
+    lib_free(buf);
+    return ret < 0 ? -1 : 0;
+}
+
+/* replay the events of a frame; server first, then client */
+static void network_rollback_play_frame(int frame)
+{
+    rollback_frame_t *slot = network_rollback_slot(frame);
+
+    if (network_mode == NETWORK_SERVER_CONNECTED) {
+        event_playback_event_list(&slot->local);
+        if (slot->remote != NULL) {
+            event_playback_event_list(slot->remote);
+        }
+    } else {
+        if (slot->remote != NULL) {
+            event_playback_event_list(slot->remote);
+        }
+        event_playback_event_list(&slot->local);
+    }
+    interrupt_maincpu_trigger_trap(network_rollback_save_trap, vice_int_to_ptr(frame));
+}
+
+/* the spectators get the frames once the input of both sides is known */
+static void network_rollback_spectate(int frame)
+{
+    rollback_frame_t *slot;
+    int last = (rollback_confirmed < frame) ? rollback_confirmed : frame;
+
+    while (rollback_spectated < last) {
+        rollback_spectated++;
+        slot = network_rollback_slot(rollback_spectated);
+        network_spectator_frame(&slot->local, slot->remote);
+    }
+}
+
+static void network_hook_rollback(void)
+{
+    int frame = rollback_frame;
+    int ret;
+
+    /* emulating frames again after a misprediction */
+    if (rollback_replay_next >= 0) {
+        frame = rollback_replay_next;
+        network_rollback_play_frame(frame);
+        if (frame == rollback_replay_to) {
+            rollback_replay_next = -1;
+            vsync_set_warp_mode(rollback_warp);
+        } else {
+            rollback_replay_next++;
+        }
+        return;
+    }
+
+    network_event_record(EVENT_LIST_END, NULL, 0);
+    if (network_rollback_send() < 0) {
+        ui_display_statustext("Remote host disconnected.", true);
+        network_disconnect();
+        return;
+    }
+
+    /* take what has arrived; wait if we are too far ahead of the peer */
+    while (rollback_confirmed < frame) {
+        if (frame - rollback_confirmed <= ROLLBACK_AHEAD
+            && !network_spectator_keyframe_due()
+            && vice_network_select_poll_one(network_socket) == 0) {
+            break;
+        }
+        ret = network_rollback_receive();
+        if (ret < 0) {
+            ui_display_statustext("Remote host disconnected.", true);
+            network_disconnect();
+            return;
+        }
+        if (ret == 0 && frame - rollback_confirmed <= ROLLBACK_AHEAD) {
+            break;
+        }
+    }
+    if (!network_connected()) {
+        return;
+    }
+
+    if (network_mode == NETWORK_SERVER_CONNECTED) {
+        network_rollback_spectate(frame);
+    }
+
+    if (rollback_mispredicted >= 0) {
+        DBG(("network_hook_rollback: frames %d-%d again", rollback_mispredicted, frame));
+        rollback_replay_next = rollback_mispredicted;
+        rollback_replay_to = frame;
+        rollback_mispredicted = -1;
+        rollback_warp = vsync_get_warp_mode();
+        vsync_set_warp_mode(1);
+        interrupt_maincpu_trigger_trap(network_rollback_restore_trap,
+                                       vice_int_to_ptr(rollback_replay_next - 1));
+    } else {
+        network_rollback_play_frame(frame);
+        /* the state is final when the input of the peer is known */
+        if (network_mode == NETWORK_SERVER_CONNECTED && rollback_confirmed >= frame) {
+            network_spectator_keyframe();
+        }
+    }
+
+    network_rollback_prepare_frame(frame + 1);
+}
+
 #define NUM_OF_TESTPACKETS 50
 
 typedef struct {
@@ -416,6 +1344,7 @@ static int network_test_delay(void)
 {
     int i, j, ret = -1;
     uint8_t new_frame_delta = 5; /* default to use on error */
+    uint8_t new_rollback = 0;
     unsigned char *buf;
     testpacket pkt;
 
@@ -462,6 +1391,10 @@ static int network_test_delay(void)
         if (network_send_buffer(network_socket, &new_frame_delta, sizeof(new_frame_delta)) < 0) {
             goto exiterror;
         }
+        new_rollback = (uint8_t)network_rollback;
+        if (network_send_buffer(network_socket, &new_rollback, sizeof(new_rollback)) < 0) {
+            goto exiterror;
+        }
     } else {
         DBG(("network_test_delay (client)"));
         /* network_mode == NETWORK_CLIENT */
@@ -474,14 +1407,25 @@ static int network_test_delay(void)
         }
         network_recv_buffer(network_socket, &new_frame_delta,
                             sizeof(new_frame_delta));
+        network_recv_buffer(network_socket, &new_rollback,
+                            sizeof(new_rollback));
     }
     ret = 0;
 exiterror:
     network_free_frame_event_list();
+    network_rollback_free();
     frame_delta = new_frame_delta;
-    network_init_frame_event_list();
-    sprintf(st, "Using %d frames delay.", frame_delta);
-    log_debug(LOG_DEFAULT, "netplay connected with %d frames delta.", frame_delta);
+    if (ret == 0 && new_rollback) {
+        if (network_rollback_init() < 0) {
+            return -1;
+        }
+        sprintf(st, "Using rollback (up to %d frames).", ROLLBACK_AHEAD);
+        log_debug(LOG_DEFAULT, "netplay connected in rollback mode.");
+    } else {
+        network_init_frame_event_list();
+        sprintf(st, "Using %d frames delay.", frame_delta);
+        log_debug(LOG_DEFAULT, "netplay connected with %d frames delta.", frame_delta);
+    }
     ui_display_statustext(st, true);
     return ret;
 }
@@ -623,6 +1567,14 @@ static void network_client_connect_trap(uint16_t addr, void *data)
 
 /*-------------------------------------------------------------------------*/
 
+static event_list_state_t *network_record_list(void)
+{
+    if (rollback_active) {
+        return &network_rollback_slot(rollback_frame)->local;
+    }
+    return &(frame_event_list[current_frame]);
+}
+
 void network_event_record(unsigned int type, void *data, unsigned int size)
 {
     unsigned int control = 0;
@@ -630,6 +1582,11 @@ void network_event_record(unsigned int type, void *data, unsigned int size)
 
     DBGT(("network_event_record type: %u size: %u", type, size));
 
+    /* spectators only watch */
+    if (network_mode == NETWORK_SPECTATOR) {
+        return;
+    }
+
     switch (type) {
         case EVENT_KEYBOARD_MATRIX:
         case EVENT_KEYBOARD_RESTORE:
@@ -667,7 +1624,7 @@ void network_event_record(unsigned int type, void *data, unsigned int size)
         return;
     }
 
-    event_record_in_list(&(frame_event_list[current_frame]), type, data, size);
+    event_record_in_list(network_record_list(), type, data, size);
 }
 
 void network_attach_image(unsigned int unit, const char *filename)
@@ -679,6 +1636,10 @@ void network_attach_image(unsigned int unit, const char *filename)
 
     DBG(("network_attach_image unit: %u filename: %s", unit, filename));
 
+    if (network_mode == NETWORK_SPECTATOR) {
+        return;
+    }
+
     if (network_get_mode() == NETWORK_CLIENT) {
         control <<= NETWORK_CONTROL_CLIENTOFFSET;
     }
@@ -687,7 +1648,7 @@ void network_attach_image(unsigned int unit, const char *filename)
         return;
     }
 
-    event_record_attach_in_list(&(frame_event_list[current_frame]), unit, drive, filename, 1);
+    event_record_attach_in_list(network_record_list(), unit, drive, filename, 1);
 }
 
 int network_get_mode(void)
@@ -698,7 +1659,8 @@ int network_get_mode(void)
 int network_connected(void)
 {
     if ((network_mode == NETWORK_SERVER_CONNECTED) ||
-        (network_mode == NETWORK_CLIENT)) {
+        (network_mode == NETWORK_CLIENT) ||
+        (network_mode == NETWORK_SPECTATOR)) {
         return 1;
     }
     return 0;
@@ -729,6 +1691,10 @@ int network_start_server(void)
             break;
         }
 
+        if (network_spectator_start() < 0) {
+            ui_error("Cannot open the spectator port %d.", spectator_port);
+        }
+
         /* Setup strict event safe values for the resources that need it */
         if (resources_set_event_safe() < 0) {
             ui_error("Warning! Failed to set netplay-safe settings.");
@@ -824,14 +1790,66 @@ int network_connect_client(void)
     return 0;
 }
 
+int network_connect_spectator(void)
+{
+    vice_network_socket_address_t * server_addr;
+
+    DBG(("network_connect_spectator (network_mode is: %u)", network_mode));
+
+    if (network_mode != NETWORK_IDLE) {
+        return -1;
+    }
+
+    if (spectator_port == 0) {
+        ui_error("No netplay spectator port set.");
+        return -1;
+    }
+
+    server_addr = vice_network_address_generate(server_name, (unsigned short)spectator_port);
+    if (server_addr == NULL) {
+        ui_error("Cannot resolve %s", server_name);
+        return -1;
+    }
+    network_socket = vice_network_client(server_addr);
+
+    vice_network_address_close(server_addr);
+    server_addr = NULL;
+
+    if (!network_socket) {
+        ui_error("Cannot connect to %s (no spectator port open on %d).", server_name, spectator_port);
+        return -1;
+    }
+
+    /* Setup strict event safe values for the resources that need it */
+    if (resources_set_event_safe() < 0) {
+        ui_error("Warning! Failed to set netplay-safe settings.");
+    }
+
+    event_init_image_list();
+    spectator_synced = 0;
+    network_mode = NETWORK_SPECTATOR;
+
+    ui_display_statustext("Waiting for a keyframe from the server...", false);
+    vsync_suspend_speed_eval();
+
+    return 0;
+}
+
 void network_disconnect(void)
 {
     DBG(("network_disconnect (network_mode was:%u)", network_mode));
     vice_network_socket_close(network_socket);
+    network_rollback_free();
+    network_spectator_free();
     if (network_mode == NETWORK_SERVER_CONNECTED) {
         network_mode = NETWORK_SERVER;
+    } else if (network_mode == NETWORK_SPECTATOR) {
+        event_destroy_image_list();
+        network_mode = NETWORK_IDLE;
     } else {
         vice_network_socket_close(listen_socket);
+        vice_network_socket_close(spectator_listen_socket);
+        spectator_listen_socket = NULL;
         network_mode = NETWORK_IDLE;
     }
     ui_display_statustext("Netplay disconnected...", true);
@@ -841,7 +1859,8 @@ void network_suspend(void)
 {
     int dummy_buf_len = 0;
 
-    if (!network_connected() || suspended == 1) {
+    if (!network_connected() || suspended == 1
+        || network_mode == NETWORK_SPECTATOR) {
         return;
     }
 
@@ -965,8 +1984,17 @@ static void network_hook_connected_receive(void)
         event_playback_event_list(server_event_list);
         event_playback_event_list(client_event_list);
 
+        if (network_mode == NETWORK_SERVER_CONNECTED) {
+            network_spectator_frame(server_event_list, client_event_list);
+        }
+
         event_clear_list(remote_event_list);
         lib_free(remote_event_list);
+    } else if (network_mode == NETWORK_SERVER_CONNECTED) {
+        network_spectator_frame(NULL, NULL);
+    }
+    if (network_mode == NETWORK_SERVER_CONNECTED) {
+        network_spectator_keyframe();
     }
     network_prepare_next_frame();
 #ifdef NETWORK_TRAFFIC_DEBUG
@@ -980,6 +2008,11 @@ void network_hook(void)
         return;
     }
 
+    if (network_mode == NETWORK_SPECTATOR) {
+        network_hook_spectator();
+        return;
+    }
+
     if (network_mode == NETWORK_SERVER) {
         if (vice_network_select_poll_one(listen_socket) != 0) {
             network_socket = vice_network_accept(listen_socket);
@@ -991,12 +2024,17 @@ void network_hook(void)
         }
     }
 
-    if (network_connected()) {
+    if (network_connected() && rollback_active) {
+        network_hook_rollback();
+    } else if (network_connected()) {
         network_hook_connected_send();
         network_hook_connected_receive();
         DBGT(("network_hook timing: %5ld %5ld %5ld; total: %5ld",
                   t2 - t1, t3 - t2, t4 - t3, t4 - t1));
     }
+
+    network_spectator_accept();
+    network_spectator_flush();
 }
 
 void network_shutdown(void)
@@ -1006,6 +2044,7 @@ void network_shutdown(void)
     }
 
     network_free_frame_event_list();
+    network_rollback_free();
     lib_free(server_name);
     lib_free(server_bind_address);
 }
@@ -1044,6 +2083,12 @@ int network_connect_client(void)
     return 0;
 }
 
+int network_connect_spectator(void)
+{
+    DBG(("network_connect_spectator (disabled)"));
+    return 0;
+}
+
 void network_disconnect(void)
 {
     DBG(("network_disconnect (disabled)"));
@@ -31,7 +31,8 @@ typedef enum {
     NETWORK_IDLE,
     NETWORK_SERVER,
     NETWORK_SERVER_CONNECTED,
-    NETWORK_CLIENT
+    NETWORK_CLIENT,
+    NETWORK_SPECTATOR
 } network_mode_t;
 
 #define NETWORK_CONTROL_KEYB (1 << 0)
@@ -54,6 +55,7 @@ int network_resources_init(void);
 int network_cmdline_options_init(void);
 int network_start_server(void);
 int network_connect_client(void);
+int network_connect_spectator(void);
 void network_disconnect(void);
 void network_suspend(void);
 void network_hook(void);
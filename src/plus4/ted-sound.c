@@ -97,6 +97,8 @@ static sound_chip_t ted_sound_chip = {
     ted_sound_machine_calculate_samples, /* sound chip calculate samples function */
     ted_sound_machine_store,             /* sound chip store function */
     ted_sound_machine_read,              /* sound chip read function */
+    NULL,                                /* NO sound chip shadow read function */
+    NULL,                                /* NO sound chip shadow store function */
     ted_sound_reset,                     /* sound chip reset function */
     ted_sound_machine_cycle_based,       /* sound chip 'is_cycle_based()' function, chip is NOT cycle based */
     ted_sound_machine_channels,          /* sound chip 'get_amount_of_channels()' function, sound chip has 1 channel */
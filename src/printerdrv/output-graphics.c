@@ -30,9 +30,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef USE_VICE_THREAD
+#include <pthread.h>
+#endif
+
+#include "archdep.h"
 #include "lib.h"
 #include "log.h"
 #include "cmdline.h"
+#include "coproc.h"
 #include "gfxoutput.h"
 #include "output-select.h"
 #include "output-graphics.h"
@@ -51,10 +57,28 @@
 #define DBG(x)
 #endif
 
+/*
+ * Pages are collected in memory and handed over to a worker thread when
+ * they are complete, which encodes them with the selected graphics output
+ * driver. So the emulation doesn't wait for the compression on every form
+ * feed. At most OUTPUT_GFX_QUEUE_MAX pages wait for the worker, when the
+ * queue is full the emulation waits for a page to be done.
+ *
+ * Besides the graphics output drivers, pages can be written as PBM. If the
+ * printer output device starts with '|', all pages are then written to one
+ * stream through a pipe to the given command.
+ */
+
+/* name of the PBM output, which isn't a graphics output driver */
+#define OUTPUT_GFX_FORMAT_PBM   "PBM"
+
+/* maximum number of pages waiting to be encoded */
+#define OUTPUT_GFX_QUEUE_MAX    4
+
 struct output_gfx_s {
-    gfxoutputdrv_t *gfxoutputdrv;
+    gfxoutputdrv_t *gfxoutputdrv;   /* NULL for PBM */
     screenshot_t screenshot;
-    uint8_t *line;
+    uint8_t *page;
     char *filename;
     unsigned int isopen;
     unsigned int line_pos;
@@ -62,9 +86,36 @@ struct output_gfx_s {
 };
 typedef struct output_gfx_s output_gfx_t;
 
+/* a complete page, waiting to be encoded */
+struct output_gfx_page_s {
+    screenshot_t screenshot;        /* must be first, see output_graphics_line_data() */
+    gfxoutputdrv_t *gfxoutputdrv;   /* NULL for PBM */
+    unsigned int prnr;
+    uint8_t *pixels;
+    char *filename;
+    struct output_gfx_page_s *next;
+};
+typedef struct output_gfx_page_s output_gfx_page_t;
+
 static output_gfx_t output_gfx[NUM_OUTPUT_SELECT];
 
-static unsigned int current_prnr;
+/* PBM streams to a pipe, only used when encoding pages */
+static FILE *output_gfx_stream[NUM_OUTPUT_SELECT];
+
+static char *output_gfx_format = NULL;
+
+#ifdef USE_VICE_THREAD
+/* the queue is protected by queue_lock */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t queue_thread;
+static int queue_thread_running = 0;
+static int queue_thread_quit = 0;
+static output_gfx_page_t *queue_head = NULL;
+static output_gfx_page_t *queue_tail = NULL;
+static unsigned int queue_len = 0;
+static int queue_busy = 0;              /* worker is encoding a page */
+#endif
 
 /* ------------------------------------------------------------------------- */
 
@@ -96,7 +147,8 @@ static void output_graphics_line_data(screenshot_t *screenshot, uint8_t *data,
     uint8_t *line_base;
     unsigned int color;
 
-    line_base = output_gfx[current_prnr].line;
+    /* the screenshot is the first member of the page */
+    line_base = ((output_gfx_page_t *)screenshot)->pixels + line * screenshot->width;
 
     switch (mode) {
         case SCREENSHOT_MODE_PALETTE:
@@ -128,32 +180,261 @@ static void output_graphics_line_data(screenshot_t *screenshot, uint8_t *data,
 
 /* ------------------------------------------------------------------------- */
 
+static int set_output_gfx_format(const char *val, void *param)
+{
+    util_string_set(&output_gfx_format, val);
+    return 0;
+}
+
+static const resource_string_t resources_string[] = {
+    { "PrinterGraphicsFormat", "BMP", RES_EVENT_NO, NULL,
+      &output_gfx_format, set_output_gfx_format, NULL },
+    RESOURCE_STRING_LIST_END
+};
+
+static const cmdline_option_t cmdline_options[] =
+{
+    { "-prgfxformat", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "PrinterGraphicsFormat", NULL,
+      "<Name>", "Specify the file format of printer graphics output (BMP, PNG, ..., or PBM)" },
+    CMDLINE_LIST_END
+};
+
+/* ------------------------------------------------------------------------- */
+
+static void output_graphics_write_pbm(output_gfx_page_t *page)
+{
+    unsigned int width = page->screenshot.width;
+    unsigned int height = page->screenshot.height;
+    unsigned int x, y;
+    uint8_t *row;
+    FILE *fd;
+    char *name = NULL;
+
+    if (page->filename[0] == '|') {
+        fd = output_gfx_stream[page->prnr];
+        if (fd == NULL) {
+            int fd_rd, fd_wr;
+            vice_pid_t pid;
+
+            if (fork_coproc(&fd_wr, &fd_rd, page->filename + 1, &pid) < 0) {
+                log_error(LOG_DEFAULT, "Cannot fork process '%s'.", page->filename + 1);
+                return;
+            }
+            archdep_close(fd_rd);   /* We only want to write to the process */
+            fd = archdep_fdopen(fd_wr, MODE_WRITE);
+            if (fd == NULL) {
+                return;
+            }
+            output_gfx_stream[page->prnr] = fd;
+        }
+    } else {
+        name = util_concat(page->filename, ".pbm", NULL);
+        fd = fopen(name, MODE_WRITE);
+        if (fd == NULL) {
+            log_error(LOG_DEFAULT, "Cannot write printer output '%s'.", name);
+            lib_free(name);
+            return;
+        }
+    }
+
+    /* black is 1 in a PBM, the colours of the colour printers as well */
+    row = lib_malloc((width + 7) / 8);
+    fprintf(fd, "P4\n%u %u\n", width, height);
+    for (y = 0; y < height; y++) {
+        const uint8_t *src = page->pixels + y * width;
+
+        memset(row, 0, (width + 7) / 8);
+        for (x = 0; x < width; x++) {
+            if (src[x] != OUTPUT_PIXEL_WHITE) {
+                row[x >> 3] |= 0x80 >> (x & 7);
+            }
+        }
+        fwrite(row, 1, (width + 7) / 8, fd);
+    }
+    lib_free(row);
+
+    if (name != NULL) {
+        fclose(fd);
+        lib_free(name);
+    } else {
+        fflush(fd);
+    }
+}
+
+/* writes a page and frees it */
+static void output_graphics_encode_page(output_gfx_page_t *page)
+{
+    gfxoutputdrv_t *drv = page->gfxoutputdrv;
+    unsigned int i;
+
+    if (drv == NULL) {
+        output_graphics_write_pbm(page);
+    } else if (drv->open(&page->screenshot, page->filename) < 0) {
+        log_error(LOG_DEFAULT, "Cannot write printer output '%s'.", page->filename);
+    } else {
+        for (i = 0; i < page->screenshot.height; i++) {
+            (drv->write)(&page->screenshot);
+        }
+        drv->close(&page->screenshot);
+    }
+
+    palette_free(page->screenshot.palette);
+    lib_free(page->pixels);
+    lib_free(page->filename);
+    lib_free(page);
+}
+
+#ifdef USE_VICE_THREAD
+static void *output_graphics_thread_main(void *unused)
+{
+    output_gfx_page_t *page;
+
+    pthread_mutex_lock(&queue_lock);
+    while (1) {
+        if (queue_head == NULL) {
+            if (queue_thread_quit) {
+                break;
+            }
+            pthread_cond_wait(&queue_cond, &queue_lock);
+            continue;
+        }
+        page = queue_head;
+        queue_head = page->next;
+        if (queue_head == NULL) {
+            queue_tail = NULL;
+        }
+        queue_len--;
+        queue_busy = 1;
+        pthread_mutex_unlock(&queue_lock);
+
+        output_graphics_encode_page(page);
+
+        pthread_mutex_lock(&queue_lock);
+        queue_busy = 0;
+        pthread_cond_broadcast(&queue_cond);
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return NULL;
+}
+#endif
+
+static void output_graphics_queue_page(output_gfx_page_t *page)
+{
+#ifdef USE_VICE_THREAD
+    if (!queue_thread_running) {
+        queue_thread_quit = 0;
+        if (pthread_create(&queue_thread, NULL, output_graphics_thread_main, NULL) == 0) {
+            queue_thread_running = 1;
+        } else {
+            log_error(LOG_DEFAULT, "Cannot start printer output thread.");
+        }
+    }
+    if (queue_thread_running) {
+        page->next = NULL;
+        pthread_mutex_lock(&queue_lock);
+        while (queue_len >= OUTPUT_GFX_QUEUE_MAX) {
+            pthread_cond_wait(&queue_cond, &queue_lock);
+        }
+        if (queue_tail != NULL) {
+            queue_tail->next = page;
+        } else {
+            queue_head = page;
+        }
+        queue_tail = page;
+        queue_len++;
+        pthread_cond_broadcast(&queue_cond);
+        pthread_mutex_unlock(&queue_lock);
+        return;
+    }
+#endif
+    output_graphics_encode_page(page);
+}
+
+/* waits until all queued pages are written */
+static void output_graphics_drain(void)
+{
+#ifdef USE_VICE_THREAD
+    if (!queue_thread_running) {
+        return;
+    }
+    pthread_mutex_lock(&queue_lock);
+    while (queue_head != NULL || queue_busy) {
+        pthread_cond_wait(&queue_cond, &queue_lock);
+    }
+    pthread_mutex_unlock(&queue_lock);
+#endif
+}
+
+static void output_graphics_stop(void)
+{
+    unsigned int i;
+
+#ifdef USE_VICE_THREAD
+    if (queue_thread_running) {
+        pthread_mutex_lock(&queue_lock);
+        queue_thread_quit = 1;
+        pthread_cond_broadcast(&queue_cond);
+        pthread_mutex_unlock(&queue_lock);
+        pthread_join(queue_thread, NULL);
+        queue_thread_running = 0;
+    }
+#endif
+    for (i = 0; i < NUM_OUTPUT_SELECT; i++) {
+        if (output_gfx_stream[i] != NULL) {
+            fclose(output_gfx_stream[i]);
+            output_gfx_stream[i] = NULL;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const char *output_graphics_extension(output_gfx_t *o)
+{
+    return o->gfxoutputdrv != NULL ? o->gfxoutputdrv->default_extension : "pbm";
+}
+
+/* increase page count in filename */
+static int increase_outfile_name(char *filename)
+{
+    int i = (int)strlen(filename);
+
+    filename[i - 1]++;
+    if (filename[i - 1] > '9') {
+        filename[i - 1] = '0';
+        filename[i - 2]++;
+        if (filename[i - 2] > '9') {
+            filename[i - 2] = '0';
+            filename[i - 3]++;
+            if (filename[i - 3] > '9') {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
 /* when creating a filename for a new file, check if that file already exists,
    and if yes, skip that file and try the next one */
 static int advance_outfile_name(unsigned int prnr)
 {
     output_gfx_t *o = &(output_gfx[prnr]);
-    int i;
-    char *testname = util_concat(o->filename, ".", o->gfxoutputdrv->default_extension, NULL);
+    char *testname;
+
+    if (o->filename[0] == '|') {
+        /* a stream, no files */
+        return 0;
+    }
 
+    testname = util_concat(o->filename, ".", output_graphics_extension(o), NULL);
     while (util_file_exists(testname)) {
-        /* increase page count in filename */
-        i = (int)strlen(o->filename);
-        o->filename[i - 1]++;
-        if (o->filename[i - 1] > '9') {
-            o->filename[i - 1] = '0';
-            o->filename[i - 2]++;
-            if (o->filename[i - 2] > '9') {
-                o->filename[i - 2] = '0';
-                o->filename[i - 3]++;
-                if (o->filename[i - 3] > '9') {
-                    lib_free(testname);
-                    return -1;
-                }
-            }
+        if (increase_outfile_name(o->filename) < 0) {
+            lib_free(testname);
+            return -1;
         }
         lib_free(testname);
-        testname = util_concat(o->filename, ".", o->gfxoutputdrv->default_extension, NULL);
+        testname = util_concat(o->filename, ".", output_graphics_extension(o), NULL);
     }
     lib_free(testname);
     return 0;
@@ -164,10 +445,26 @@ static int output_graphics_open(unsigned int prnr,
 {
     const char *filename;
     int device = 0;
-    output_gfx[prnr].gfxoutputdrv = gfxoutput_get_driver("BMP");
+    size_t size;
 
-    if (output_gfx[prnr].gfxoutputdrv == NULL) {
-        return -1;
+    if (output_gfx_format != NULL && strcmp(output_gfx_format, OUTPUT_GFX_FORMAT_PBM) == 0) {
+        output_gfx[prnr].gfxoutputdrv = NULL;
+    } else {
+        output_gfx[prnr].gfxoutputdrv = gfxoutput_get_driver(output_gfx_format != NULL ? output_gfx_format : "BMP");
+        if (output_gfx[prnr].gfxoutputdrv != NULL
+            && (output_gfx[prnr].gfxoutputdrv->open == NULL
+                || output_gfx[prnr].gfxoutputdrv->write == NULL
+                || output_gfx[prnr].gfxoutputdrv->close == NULL)) {
+            log_error(LOG_DEFAULT, "Graphics output driver %s cannot be used for printer output.",
+                      output_gfx_format);
+            output_gfx[prnr].gfxoutputdrv = NULL;
+        }
+        if (output_gfx[prnr].gfxoutputdrv == NULL) {
+            output_gfx[prnr].gfxoutputdrv = gfxoutput_get_driver("BMP");
+        }
+        if (output_gfx[prnr].gfxoutputdrv == NULL) {
+            return -1;
+        }
     }
 
     if (output_gfx[prnr].isopen) {
@@ -196,8 +493,17 @@ static int output_graphics_open(unsigned int prnr,
         lib_free(output_gfx[prnr].filename);
     }
 
-    /* add 000 after the filename */
-    output_gfx[prnr].filename = util_concat(filename, "000", NULL);
+    if (filename[0] == '|') {
+        /* a command to pipe to, only used for PBM */
+        if (output_gfx[prnr].gfxoutputdrv == NULL) {
+            output_gfx[prnr].filename = lib_strdup(filename);
+        } else {
+            output_gfx[prnr].filename = util_concat("prngfx", "000", NULL);
+        }
+    } else {
+        /* add 000 after the filename */
+        output_gfx[prnr].filename = util_concat(filename, "000", NULL);
+    }
     if (advance_outfile_name(prnr) < 0) {
         return -1;
     }
@@ -209,11 +515,12 @@ static int output_graphics_open(unsigned int prnr,
     output_gfx[prnr].screenshot.y_offset = 0;
     output_gfx[prnr].screenshot.palette = output_parameter->palette;
 
-    if (output_gfx[prnr].line != NULL) {
-        lib_free(output_gfx[prnr].line);
+    if (output_gfx[prnr].page != NULL) {
+        lib_free(output_gfx[prnr].page);
     }
-    output_gfx[prnr].line = lib_malloc(output_parameter->maxcol);
-    memset(output_gfx[prnr].line, OUTPUT_PIXEL_WHITE, output_parameter->maxcol);
+    size = (size_t)output_parameter->maxcol * output_parameter->maxrow;
+    output_gfx[prnr].page = lib_malloc(size);
+    memset(output_gfx[prnr].page, OUTPUT_PIXEL_WHITE, size);
 
     output_gfx[prnr].line_pos = 0;
     output_gfx[prnr].line_no = 0;
@@ -229,29 +536,44 @@ static void output_graphics_close(unsigned int prnr)
     DBG(("output_graphics_close(%u) isopen:%u", prnr, output_gfx[prnr].isopen));
     /* The layer that calls us does that for each CLOSE on the bus, this is not
        very useful */
-#if 0
-    output_gfx_t *o = &(output_gfx[prnr]);
-
-    /* only do this if something has actually been printed on this page */
-    if (o->isopen) {
-        unsigned int i;
-
-        /* output current line */
-        current_prnr = prnr;
-        (o->gfxoutputdrv->write)(&o->screenshot);
-        o->line_no++;
+}
 
-        /* fill rest of page with blank lines */
-        memset(o->line, OUTPUT_PIXEL_WHITE, o->screenshot.width);
-        for (i = o->line_no; i < o->screenshot.height; i++) {
-            (o->gfxoutputdrv->write)(&o->screenshot);
-        }
+/* passes the page on for encoding and starts a new one */
+static void output_graphics_page_done(unsigned int prnr)
+{
+    output_gfx_t *o = &(output_gfx[prnr]);
+    output_gfx_page_t *page;
+    palette_t *palette = o->screenshot.palette;
+    size_t size = (size_t)o->screenshot.width * o->screenshot.height;
+    unsigned int i;
 
-        /* close output */
-        o->gfxoutputdrv->close(&o->screenshot);
-        o->isopen = 0;
+    page = lib_calloc(1, sizeof(output_gfx_page_t));
+    page->screenshot = o->screenshot;
+    page->screenshot.gfxoutputdrv_data = NULL;
+    /* the printer driver may free its palette before the page is written */
+    page->screenshot.palette = palette_create(palette->num_entries, NULL);
+    for (i = 0; i < palette->num_entries; i++) {
+        page->screenshot.palette->entries[i].red = palette->entries[i].red;
+        page->screenshot.palette->entries[i].green = palette->entries[i].green;
+        page->screenshot.palette->entries[i].blue = palette->entries[i].blue;
     }
-#endif
+    page->gfxoutputdrv = o->gfxoutputdrv;
+    page->prnr = prnr;
+    page->pixels = o->page;
+    page->filename = lib_strdup(o->filename);
+
+    o->page = lib_malloc(size);
+    memset(o->page, OUTPUT_PIXEL_WHITE, size);
+    o->isopen = 0;
+    o->line_pos = 0;
+    o->line_no = 0;
+
+    /* the file of this page may not exist yet when the next one starts */
+    if (o->filename[0] != '|') {
+        increase_outfile_name(o->filename);
+    }
+
+    output_graphics_queue_page(page);
 }
 
 static int output_graphics_putc(unsigned int prnr, uint8_t b)
@@ -264,29 +586,21 @@ static int output_graphics_putc(unsigned int prnr, uint8_t b)
             if (advance_outfile_name(prnr) < 0) {
                 return -1;
             }
-            /* open output file */
-            o->gfxoutputdrv->open(&o->screenshot, o->filename);
             o->isopen = 1;
-            o->line_pos = 0;
-            o->line_no = 0;
         }
 
-        /* write buffered line to output and clear buffer */
-        current_prnr = prnr;
-        (o->gfxoutputdrv->write)(&o->screenshot);
-        memset(o->line, OUTPUT_PIXEL_WHITE, o->screenshot.width);
+        /* advance to the next line of the page */
         o->line_pos = 0;
-
-        /* check for bottom of page.  If so, close output file */
         o->line_no++;
+
+        /* check for bottom of page.  If so, pass on the page */
         if (o->line_no == o->screenshot.height) {
-            o->gfxoutputdrv->close(&o->screenshot);
-            o->isopen = 0;
+            output_graphics_page_done(prnr);
         }
     } else {
-        /* store pixel in buffer */
+        /* store pixel in page */
         if (o->line_pos < o->screenshot.width) {
-            o->line[o->line_pos] = b;
+            o->page[o->line_no * o->screenshot.width + o->line_pos] = b;
         }
         if (o->line_pos < o->screenshot.width - 1) {
             o->line_pos++;
@@ -313,33 +627,12 @@ static int output_graphics_formfeed(unsigned int prnr)
 {
     output_gfx_t *o = &(output_gfx[prnr]);
     DBG(("output_graphics_formfeed(prnr:%u) device:%u", prnr, prnr + 4));
-#if 0
-    /*
-     * Will finish writing current file, and leaves open
-     * the option to start a new one.
-     */
-    output_graphics_close(prnr);
-#else
-    /* only do this if something has actually been printed on this page */
-    if (o->isopen) {
-        unsigned int i;
-
-        /* output current line */
-        current_prnr = prnr;
-        (o->gfxoutputdrv->write)(&o->screenshot);
-        o->line_no++;
-
-        /* fill rest of page with blank lines */
-        memset(o->line, OUTPUT_PIXEL_WHITE, o->screenshot.width);
-        for (i = o->line_no; i < o->screenshot.height; i++) {
-            (o->gfxoutputdrv->write)(&o->screenshot);
-        }
 
-        /* close output */
-        o->gfxoutputdrv->close(&o->screenshot);
-        o->isopen = 0;
+    /* only do this if something has actually been printed on this page;
+       the rest of the page is blank already */
+    if (o->isopen) {
+        output_graphics_page_done(prnr);
     }
-#endif
     return 0;
 }
 
@@ -353,11 +646,11 @@ void output_graphics_init(void)
         if (output_gfx[i].filename) {
             lib_free(output_gfx[i].filename);
         }
-        if (output_gfx[i].line) {
-            lib_free(output_gfx[i].line);
+        if (output_gfx[i].page) {
+            lib_free(output_gfx[i].page);
         }
         output_gfx[i].filename = NULL;
-        output_gfx[i].line = NULL;
+        output_gfx[i].page = NULL;
 
         output_gfx[i].line_pos = 0;
     }
@@ -367,18 +660,33 @@ void output_graphics_shutdown(void)
 {
     unsigned int i;
 
+    /* write what was printed on the pages that are still open */
+    for (i = 0; i < NUM_OUTPUT_SELECT; i++) {
+        if (output_gfx[i].isopen) {
+            output_graphics_page_done(i);
+        }
+    }
+    output_graphics_drain();
+    output_graphics_stop();
+
     for (i = 0; i < NUM_OUTPUT_SELECT; i++) {
         if (output_gfx[i].filename) {
             lib_free(output_gfx[i].filename);
         }
-        if (output_gfx[i].line) {
-            lib_free(output_gfx[i].line);
+        if (output_gfx[i].page) {
+            lib_free(output_gfx[i].page);
         }
         output_gfx[i].filename = NULL;
-        output_gfx[i].line = NULL;
+        output_gfx[i].page = NULL;
     }
 }
 
+void output_graphics_shutdown_resources(void)
+{
+    lib_free(output_gfx_format);
+    output_gfx_format = NULL;
+}
+
 int output_graphics_init_resources(void)
 {
     output_select_t output_select;
@@ -393,5 +701,10 @@ int output_graphics_init_resources(void)
 
     output_select_register(&output_select);
 
-    return 1;
+    return resources_register_string(resources_string);
+}
+
+int output_graphics_init_cmdline_options(void)
+{
+    return cmdline_register_options(cmdline_options);
 }
@@ -84,12 +84,14 @@ int printer_userport_resources_init(void)
 void printer_resources_shutdown(void)
 {
     output_text_shutdown_resources();
+    output_graphics_shutdown_resources();
 }
 
 int printer_cmdline_options_init(void)
 {
     DBG(("printer_cmdline_options_init"));
     if (output_text_init_cmdline_options() < 0
+        || output_graphics_init_cmdline_options() < 0
         || output_select_init_cmdline_options() < 0
         || driver_select_init_cmdline_options() < 0
         || machine_printer_cmdline_options_init() < 0) {
@@ -142,12 +144,14 @@ void printer_shutdown(void)
         driver_select_formfeed(n);
     }
     /*
-     * So really shutting them down should be done after that.
+     * So really shutting them down should be done after that. The graphics
+     * output goes first, its open pages still use the palettes of the
+     * drivers.
      */
+    output_graphics_shutdown();
     drv_mps803_shutdown();
     drv_nl10_shutdown();
     drv_1520_shutdown();
-    output_graphics_shutdown();
     output_select_shutdown();
 }
 
@@ -31,6 +31,7 @@
 
 #include "videoarch.h"
 
+#include "archdep.h"
 #include "lib.h"
 #include "machine.h"
 #include "raster-canvas.h"
@@ -97,9 +98,9 @@ inline static void refresh_canvas(raster_t *raster)
 
     if ((int)(raster->canvas->draw_buffer->canvas_height) >= yy
         && (int)(raster->canvas->draw_buffer->canvas_width) >= xx) {
-        video_canvas_refresh(raster->canvas, x, y, xx, yy,
-                             MIN(w, (int)(raster->canvas->draw_buffer->canvas_width - xx)),
-                             MIN(h, (int)(raster->canvas->draw_buffer->canvas_height - yy)));
+        video_canvas_refresh_frame(raster->canvas, x, y, xx, yy,
+                                   MIN(w, (int)(raster->canvas->draw_buffer->canvas_width - xx)),
+                                   MIN(h, (int)(raster->canvas->draw_buffer->canvas_height - yy)));
     }
 
     update_area->is_null = 1;
@@ -107,11 +108,28 @@ inline static void refresh_canvas(raster_t *raster)
 
 void raster_canvas_handle_end_of_frame(raster_t *raster)
 {
+    int skipped = raster->skip_frame;
+
     if (video_disabled_mode) {
+        raster->skip_frame = 0;
+        raster->skip_drawing = 0;
         return;
     }
 
-    if (vsync_should_skip_frame(raster->canvas)) {
+    /* Decide now whether the next frame is shown, so its lines don't have
+       to be drawn at all if it isn't.  Interlaced frames are always drawn,
+       as the two fields go to different buffers.  */
+    raster->skip_frame = vsync_should_skip_frame(raster->canvas);
+    raster->skip_drawing = raster->skip_frame
+                           && !raster->canvas->videoconfig->interlaced
+                           /* the emulation can end at any time, every frame
+                              must be complete for the screenshot at exit,
+                              like with VICIIVideoSkip */
+                           && !machine_exit_screenshot_requested()
+                           && !raster->draw_next_frame;
+    raster->draw_next_frame = 0;
+
+    if (skipped || archdep_is_exiting()) {
         return;
     }
 
@@ -120,7 +138,7 @@ void raster_canvas_handle_end_of_frame(raster_t *raster)
     }
 
     if (raster->dont_cache) {
-        video_canvas_refresh_all(raster->canvas);
+        video_canvas_refresh_all_frame(raster->canvas);
     } else {
         refresh_canvas(raster);
     }
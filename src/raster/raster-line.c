@@ -648,17 +648,70 @@ inline static void handle_visible_line(raster_t *raster)
     }
 }
 
-void raster_line_emulate(raster_t *raster)
+inline static void handle_invisible_line(raster_t *raster)
 {
-    raster_draw_buffer_ptr_update(raster);
+    update_sprite_collisions(raster);
+
+    if (raster->changes->have_on_this_line) {
+        raster_changes_apply_all(raster->changes->background);
+        raster_changes_apply_all(raster->changes->foreground);
+        raster_changes_apply_all(raster->changes->border);
+        raster_changes_apply_all(raster->changes->sprites);
+        raster->changes->have_on_this_line = 0;
+    }
+}
+
+/* Go to the next line, handle the end of the frame if `end_of_frame' is set */
+inline static void next_line(raster_t *raster, int end_of_frame)
+{
+    raster->current_line++;
+
+    if (raster->current_line == raster->geometry->screen_size.height) {
+        raster->current_line = 0;
+        /* not end of frame on NTSC VIC-II where lines 0+ are */
+        /* displayed in the lower border */
+        if (end_of_frame
+            && raster->geometry->screen_size.height > raster->geometry->last_displayed_line) {
+            raster_canvas_handle_end_of_frame(raster);
+        }
+    }
+
+    /* end of frame on NTSC VIC-II */
+    if (end_of_frame
+        && raster->geometry->screen_size.height <= raster->geometry->last_displayed_line
+        && raster->current_line == raster->geometry->last_displayed_line - raster->geometry->screen_size.height + 1) {
+        raster_canvas_handle_end_of_frame(raster);
+    }
+
+    raster_changes_apply_all(raster->changes->next_line);
+
+    /* Handle open borders.  */
+    raster->open_left_border = raster->open_right_border;
+    raster->open_right_border = 0;
+
+    if (raster->sprite_status != NULL) {
+        raster->sprite_status->dma_msk = raster->sprite_status->new_dma_msk;
+    }
 
-    /* Emulate the vertical blank flip-flops.  (Well, sort of.)  */
+    raster->blank_this_line = 0;
+}
+
+/* Emulate the vertical blank flip-flops.  (Well, sort of.)  */
+inline static void update_blank(raster_t *raster)
+{
     if (raster->current_line == raster->display_ystart && (!raster->blank || raster->blank_off)) {
         raster->blank_enabled = 0;
     }
     if (raster->current_line == raster->display_ystop) {
         raster->blank_enabled = 1;
     }
+}
+
+void raster_line_emulate(raster_t *raster)
+{
+    raster_draw_buffer_ptr_update(raster);
+
+    update_blank(raster);
 
     if ((raster->current_line >= raster->geometry->first_displayed_line
          && raster->current_line <= raster->geometry->last_displayed_line)
@@ -668,6 +721,17 @@ void raster_line_emulate(raster_t *raster)
         ) {
         /* handle lines with no border or with changes that may affect
            the border as visible lines */
+        if (raster->skip_drawing
+            && (raster->sprite_status == NULL
+                || !(raster->sprite_status->dma_msk || raster->sprite_status->new_dma_msk))) {
+            /* The frame is not shown, lines with sprites are still drawn
+               for the sprite-background collisions.  The cache is left as
+               it is, it still matches what is in the draw buffer.  */
+            handle_invisible_line(raster);
+            next_line(raster, 1);
+            return;
+        }
+
         if (raster->can_disable_border && (raster->border_disable || raster->changes->have_on_this_line)) {
             handle_visible_line(raster);
         } else {
@@ -696,43 +760,26 @@ void raster_line_emulate(raster_t *raster)
                *raster->draw_buffer_ptr, 4);
 #endif
     } else {
-        update_sprite_collisions(raster);
-
-        if (raster->changes->have_on_this_line) {
-            raster_changes_apply_all(raster->changes->background);
-            raster_changes_apply_all(raster->changes->foreground);
-            raster_changes_apply_all(raster->changes->border);
-            raster_changes_apply_all(raster->changes->sprites);
-            raster->changes->have_on_this_line = 0;
-        }
+        handle_invisible_line(raster);
     }
 
-    raster->current_line++;
-
-    if (raster->current_line == raster->geometry->screen_size.height) {
-        raster->current_line = 0;
-        /* not end of frame on NTSC VIC-II where lines 0+ are */
-        /* displayed in the lower border */
-        if (raster->geometry->screen_size.height > raster->geometry->last_displayed_line) {
-            raster_canvas_handle_end_of_frame(raster);
-        }
-    }
-
-    /* end of frame on NTSC VIC-II */
-    if (raster->geometry->screen_size.height <= raster->geometry->last_displayed_line
-        && raster->current_line == raster->geometry->last_displayed_line - raster->geometry->screen_size.height + 1) {
-        raster_canvas_handle_end_of_frame(raster);
-    }
+    next_line(raster, 1);
+}
 
-    raster_changes_apply_all(raster->changes->next_line);
+/* Advance to the next line without drawing anything, for chips that draw
+   the line themselves and skip the frame.  The line is redrawn completely
+   in the next frame that is drawn.  */
+void raster_line_skip(raster_t *raster)
+{
+    update_blank(raster);
 
-    /* Handle open borders.  */
-    raster->open_left_border = raster->open_right_border;
-    raster->open_right_border = 0;
+    handle_invisible_line(raster);
 
-    if (raster->sprite_status != NULL) {
-        raster->sprite_status->dma_msk = raster->sprite_status->new_dma_msk;
+    if (raster->cache != NULL) {
+        raster->cache[raster->current_line].is_dirty = 1;
     }
+    raster->dont_cache = 1;
 
-    raster->blank_this_line = 0;
+    next_line(raster, 0);
 }
+
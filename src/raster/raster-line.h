@@ -34,5 +34,6 @@ void raster_line_draw_borders(struct raster_s *raster);
 void raster_line_fill_xsmooth_region(struct raster_s *raster);
 void raster_line_draw_blank(struct raster_s *raster, unsigned int start, unsigned int end);
 void raster_line_emulate(struct raster_s *raster);
+void raster_line_skip(struct raster_s *raster);
 
 #endif
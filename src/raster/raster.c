@@ -148,6 +148,7 @@ static int raster_realize_frame_buffer(raster_t *raster)
 {
     unsigned int fb_width, fb_height, fb_pitch;
 
+    video_canvas_refresh_thread_wait(raster->canvas);
     raster_draw_buffer_free(raster->canvas);
 
     fb_width = raster_calc_frame_buffer_width(raster);
@@ -218,6 +219,8 @@ static int realize_canvas(raster_t *raster)
 
 static int perform_mode_change(raster_t *raster)
 {
+    video_canvas_refresh_thread_wait(raster->canvas);
+
     if (!video_disabled_mode
         && raster->canvas && raster->canvas->palette != NULL) {
         if (video_canvas_set_palette(raster->canvas, raster->canvas->palette) < 0) {
@@ -275,6 +278,9 @@ int raster_init(raster_t *raster,
     raster->dont_cache = 1;
     raster->dont_cache_all = 1;
     raster->num_cached_lines = 0;
+    raster->skip_frame = 0;
+    raster->skip_drawing = 0;
+    raster->draw_next_frame = 0;
 
     raster->fake_draw_buffer_line = NULL;
 
@@ -530,6 +536,11 @@ void raster_set_canvas_refresh(raster_t *raster, int enable)
 
 void raster_screenshot(raster_t *raster, screenshot_t *screenshot)
 {
+    /* nothing is drawn while skipping frames, draw the next one */
+    if (raster->skip_drawing) {
+        raster->draw_next_frame = 1;
+    }
+
     screenshot->palette = raster->canvas->palette;
     screenshot->max_width = raster->geometry->screen_size.width;
     screenshot->max_height = raster->geometry->screen_size.height;
@@ -573,6 +584,7 @@ void raster_async_refresh(raster_t *raster, struct canvas_refresh_s *ref)
 void raster_shutdown(raster_t *raster)
 {
     if (raster->canvas) {
+        video_canvas_refresh_thread_stop(raster->canvas);
         raster_draw_buffer_free(raster->canvas);
     }
 
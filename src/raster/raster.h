@@ -153,6 +153,20 @@ struct raster_s {
     /* Don't cache anything, for cycle based emulation */
     int dont_cache_all;
 
+    /* This is != 0 if the current frame is not shown, because it is skipped
+       (e.g. in warp mode).  */
+    int skip_frame;
+
+    /* This is != 0 if the lines of the current frame are not drawn either,
+       apart from the ones needed for sprite-background collisions.  A
+       screenshot taken meanwhile shows the last drawn frame, with the lines
+       that had sprite DMA from the skipped ones.  */
+    int skip_drawing;
+
+    /* Set by a screenshot taken while lines are not drawn, so the next
+       frame is drawn completely.  */
+    int draw_next_frame;
+
     /* Number of lines that have been recalculated.  When this value reaches
        the number of lines that are displayed in the output, then the cache
        is valid again.  */
@@ -32,7 +32,15 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
+#ifdef USE_VICE_THREAD
+#include <pthread.h>
+#endif
+
+#include "archdep.h"
+#include "lib.h"
+#include "log.h"
 #include "rawnet.h"
 #include "rawnetarch.h"
 
@@ -63,6 +71,291 @@ void rawnet_set_should_accept_func(int (*func)(unsigned char *, int, int *, int
     should_accept = func;
 }
 
+/* ------------------------------------------------------------------------- */
+/*    receiving frames                                                       */
+
+/* frames kept for the emulated chip, must be a power of 2 */
+#define RAWNET_RX_RING_SIZE 64
+
+/* big enough for any ethernet frame including the CRC */
+#define RAWNET_RX_FRAME_SIZE 1536
+
+/* how long the receive thread waits for the host to get a frame, so it
+   notices rawnet_rx_stop() */
+#define RAWNET_RX_WAIT_USEC 10000
+
+/* how long it sleeps instead, if the driver can't be waited for */
+#define RAWNET_RX_IDLE_USEC 250
+
+typedef struct rawnet_rx_frame_s {
+    int len;
+    int hashed;
+    int hash_index;
+    int rx_ok;
+    int correct_mac;
+    int broadcast;
+    int crc_error;
+    uint8_t data[RAWNET_RX_FRAME_SIZE];
+} rawnet_rx_frame_t;
+
+static rawnet_rx_stats_t rx_stats;
+
+#ifdef USE_VICE_THREAD
+
+/* The receive thread fills the slot at rx_tail and then advances rx_tail,
+   the emulation takes the slot at rx_head and then advances rx_head. Only
+   the indices and the statistics are protected by rx_ring_lock, the frames
+   themselves are owned by one side at a time.  */
+static rawnet_rx_frame_t *rx_ring = NULL;
+static rawnet_rx_frame_t *rx_scratch = NULL;   /* frame that does not fit */
+static unsigned int rx_head;
+static unsigned int rx_tail;
+static pthread_mutex_t rx_ring_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* serialises the calls to the driver and should_accept */
+static pthread_mutex_t rx_driver_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t rx_thread;
+static int rx_thread_running = 0;
+static int rx_thread_quit = 0;          /* protected by rx_ring_lock */
+
+void rawnet_lock(void)
+{
+    pthread_mutex_lock(&rx_driver_lock);
+}
+
+void rawnet_unlock(void)
+{
+    pthread_mutex_unlock(&rx_driver_lock);
+}
+
+/* read one frame from the host; returns 1 if the chip accepts it */
+static int rawnet_rx_read_frame(rawnet_rx_frame_t *frame, int *pnewframe)
+{
+    int multicast;
+    int accept = 1;
+
+    rawnet_lock();
+    frame->len = RAWNET_RX_FRAME_SIZE;
+    *pnewframe = rawnet_arch_receive(frame->data, &frame->len, &frame->hashed,
+                                     &frame->hash_index, &frame->rx_ok,
+                                     &frame->correct_mac, &frame->broadcast,
+                                     &frame->crc_error);
+    if (*pnewframe && !(frame->hashed || frame->correct_mac || frame->broadcast)) {
+        /* the driver does not know the type of frame: ask the chip */
+        if (frame->len < 6 || should_accept == NULL
+            || !should_accept(frame->data, frame->len, &frame->hashed,
+                              &frame->hash_index, &frame->correct_mac,
+                              &frame->broadcast, &multicast)) {
+            accept = 0;
+        }
+    }
+    rawnet_unlock();
+
+    return *pnewframe && accept;
+}
+
+static void *rawnet_rx_thread_main(void *unused)
+{
+    rawnet_rx_frame_t *frame;
+    int newframe;
+    int accept;
+    int full;
+    int quit;
+
+    while (1) {
+        pthread_mutex_lock(&rx_ring_lock);
+        quit = rx_thread_quit;
+        full = (rx_tail - rx_head) == RAWNET_RX_RING_SIZE;
+        pthread_mutex_unlock(&rx_ring_lock);
+
+        if (quit) {
+            break;
+        }
+
+        /* keep reading when the ring is full, so the drops are counted */
+        frame = full ? rx_scratch : &rx_ring[rx_tail & (RAWNET_RX_RING_SIZE - 1)];
+        accept = rawnet_rx_read_frame(frame, &newframe);
+
+        if (!newframe) {
+            /* block on the capture until the host has a frame */
+            if (rawnet_arch_wait(RAWNET_RX_WAIT_USEC) < 0) {
+                archdep_usleep(RAWNET_RX_IDLE_USEC);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&rx_ring_lock);
+        rx_stats.received++;
+        if (!accept) {
+            rx_stats.rejected++;
+        } else if (full) {
+            rx_stats.dropped++;
+        } else {
+            rx_stats.queued++;
+            rx_tail++;
+        }
+        pthread_mutex_unlock(&rx_ring_lock);
+    }
+    return NULL;
+}
+
+int rawnet_rx_start(void)
+{
+    if (rx_thread_running) {
+        return 0;
+    }
+
+    rx_ring = lib_malloc(RAWNET_RX_RING_SIZE * sizeof(rawnet_rx_frame_t));
+    rx_scratch = lib_malloc(sizeof(rawnet_rx_frame_t));
+    rx_head = 0;
+    rx_tail = 0;
+    memset(&rx_stats, 0, sizeof(rx_stats));
+    rx_thread_quit = 0;
+
+    if (pthread_create(&rx_thread, NULL, rawnet_rx_thread_main, NULL) != 0) {
+        log_error(LOG_DEFAULT, "rawnet: cannot start the receive thread, receiving synchronously.");
+        lib_free(rx_ring);
+        lib_free(rx_scratch);
+        rx_ring = NULL;
+        rx_scratch = NULL;
+        return -1;
+    }
+    rx_thread_running = 1;
+    return 0;
+}
+
+void rawnet_rx_stop(void)
+{
+    if (!rx_thread_running) {
+        return;
+    }
+
+    pthread_mutex_lock(&rx_ring_lock);
+    rx_thread_quit = 1;
+    pthread_mutex_unlock(&rx_ring_lock);
+    pthread_join(rx_thread, NULL);
+    rx_thread_running = 0;
+
+    lib_free(rx_ring);
+    lib_free(rx_scratch);
+    rx_ring = NULL;
+    rx_scratch = NULL;
+}
+
+void rawnet_rx_flush(void)
+{
+    pthread_mutex_lock(&rx_ring_lock);
+    rx_head = rx_tail;
+    pthread_mutex_unlock(&rx_ring_lock);
+}
+
+int rawnet_rx_active(void)
+{
+    return rx_thread_running;
+}
+
+void rawnet_rx_get_stats(rawnet_rx_stats_t *stats)
+{
+    pthread_mutex_lock(&rx_ring_lock);
+    *stats = rx_stats;
+    pthread_mutex_unlock(&rx_ring_lock);
+}
+
+int rawnet_receive(uint8_t *pbuffer, int *plen, int *phashed, int *phash_index, int *prx_ok, int *pcorrect_mac, int *pbroadcast, int *pcrc_error)
+{
+    rawnet_rx_frame_t *frame;
+    int empty;
+    int len;
+
+    if (!rx_thread_running) {
+        if (!rawnet_arch_receive(pbuffer, plen, phashed, phash_index, prx_ok, pcorrect_mac, pbroadcast, pcrc_error)) {
+            return 0;
+        }
+        rx_stats.received++;
+        return 1;
+    }
+
+    pthread_mutex_lock(&rx_ring_lock);
+    empty = (rx_head == rx_tail);
+    pthread_mutex_unlock(&rx_ring_lock);
+
+    if (empty) {
+        return 0;
+    }
+
+    frame = &rx_ring[rx_head & (RAWNET_RX_RING_SIZE - 1)];
+
+    /* like the drivers, report the full length even if it does not fit */
+    len = (frame->len < *plen) ? frame->len : *plen;
+    if (len > RAWNET_RX_FRAME_SIZE) {
+        len = RAWNET_RX_FRAME_SIZE;
+    }
+    memcpy(pbuffer, frame->data, (size_t)len);
+    *plen = frame->len;
+    *phashed = frame->hashed;
+    *phash_index = frame->hash_index;
+    *prx_ok = frame->rx_ok;
+    *pcorrect_mac = frame->correct_mac;
+    *pbroadcast = frame->broadcast;
+    *pcrc_error = frame->crc_error;
+
+    pthread_mutex_lock(&rx_ring_lock);
+    rx_head++;
+    pthread_mutex_unlock(&rx_ring_lock);
+
+    return 1;
+}
+
+#else /* #ifdef USE_VICE_THREAD */
+
+/* Without threads the frames are read when the emulated chip asks for them */
+
+void rawnet_lock(void)
+{
+}
+
+void rawnet_unlock(void)
+{
+}
+
+int rawnet_rx_start(void)
+{
+    memset(&rx_stats, 0, sizeof(rx_stats));
+    return -1;
+}
+
+void rawnet_rx_stop(void)
+{
+}
+
+void rawnet_rx_flush(void)
+{
+}
+
+int rawnet_rx_active(void)
+{
+    return 0;
+}
+
+void rawnet_rx_get_stats(rawnet_rx_stats_t *stats)
+{
+    *stats = rx_stats;
+}
+
+int rawnet_receive(uint8_t *pbuffer, int *plen, int *phashed, int *phash_index, int *prx_ok, int *pcorrect_mac, int *pbroadcast, int *pcrc_error)
+{
+    int newframe;
+
+    newframe = rawnet_arch_receive(pbuffer, plen, phashed, phash_index, prx_ok, pcorrect_mac, pbroadcast, pcrc_error);
+    if (newframe) {
+        rx_stats.received++;
+    }
+    return newframe;
+}
+
+#endif /* #ifdef USE_VICE_THREAD */
+
 /* ------------------------------------------------------------------------- */
 /*    functions for selecting and querying available NICs                    */
 
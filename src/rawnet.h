@@ -32,6 +32,8 @@
 #ifndef VICE_RAWNET_H
 #define VICE_RAWNET_H
 
+#include "types.h"
+
 int rawnet_resources_init(void);
 int rawnet_cmdline_options_init(void);
 void rawnet_resources_shutdown(void);
@@ -48,6 +50,38 @@ void rawnet_resources_shutdown(void);
 int rawnet_should_accept(unsigned char *buffer, int length, int *phashed, int *phash_index, int *pcorrect_mac, int *pbroadcast, int *pmulticast);
 void rawnet_set_should_accept_func(int (*func)(unsigned char *, int, int *, int *, int *, int *, int *));
 
+/*
+ Receiving frames.
+
+ When VICE is built with threads, rawnet_rx_start() starts a thread which
+ reads the frames from the host and passes them through the should_accept
+ function of the emulated chip. Accepted frames are kept in a ring buffer,
+ rawnet_receive() then only takes them from memory. Without the thread,
+ rawnet_receive() reads from the host directly. It has the same parameters
+ as rawnet_arch_receive().
+
+ The thread calls the driver and the should_accept function, so the emulated
+ chip has to call rawnet_lock() and rawnet_unlock() around its calls to the
+ driver and around changes of the state should_accept depends on.
+*/
+
+typedef struct rawnet_rx_stats_s {
+    unsigned long received;     /* frames read from the host */
+    unsigned long rejected;     /* frames the emulated chip does not accept */
+    unsigned long queued;       /* frames put into the ring buffer */
+    unsigned long dropped;      /* frames lost because the ring buffer was full */
+} rawnet_rx_stats_t;
+
+int rawnet_rx_start(void);
+void rawnet_rx_stop(void);
+void rawnet_rx_flush(void);
+int rawnet_rx_active(void);
+void rawnet_rx_get_stats(rawnet_rx_stats_t *stats);
+int rawnet_receive(uint8_t *pbuffer, int *plen, int *phashed, int *phash_index, int *prx_ok, int *pcorrect_mac, int *pbroadcast, int *pcrc_error);
+
+void rawnet_lock(void);
+void rawnet_unlock(void);
+
 /*
 
  These functions let the UI enumerate the available interfaces.
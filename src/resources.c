@@ -127,36 +127,66 @@ static char *machine_id = NULL;
 static void write_resource_item(FILE *f, int num);
 static char *string_resource_item(int num, const char *delim);
 
-/* use a hash table with 1024 entries */
-static const unsigned int logHashSize = 10;
+/* the hash table starts with 1024 entries and is doubled whenever there are
+   more resources than entries, so the chains stay short on every machine */
+#define LOG_HASH_SIZE_INIT  10
+
+static unsigned int logHashSize = LOG_HASH_SIZE_INIT;
 
 static int *hashTable = NULL;
 
 static resource_callback_desc_t *resource_modified_callback = NULL;
 
-/* calculate the hash key */
+/* calculate the hash key (32 bit FNV-1a) */
 static unsigned int resources_calc_hash_key(const char *name)
 {
-    unsigned int key, i, shift;
+    uint32_t key;
+    unsigned int i;
 
     DBG(("resources_calc_hash_key: '%s'", name ? name : "<empty/null>"));
 
-    key = 0; shift = 0;
+    key = 2166136261U;
     for (i = 0; name[i] != '\0'; i++) {
         /* resources are case-insensitive */
-        unsigned int sym = (unsigned int)tolower((int)name[i]);
+        key ^= (uint32_t)tolower((unsigned char)name[i]);
+        key *= 16777619U;
+    }
+    /* fold the upper bits in, the table only uses the lower ones */
+    key ^= key >> 16;
+    return (unsigned int)(key & ((1U << logHashSize) - 1));
+}
 
-        if (shift >= logHashSize) {
-            shift = 0;
-        }
+/* (re)build the hash chains of all registered resources */
+static void resources_build_hash_table(void)
+{
+    unsigned int i;
 
-        key ^= (sym << shift);
-        if (shift + 8 > logHashSize) {
-            key ^= (((unsigned int)sym) >> (logHashSize - shift));
-        }
-        shift++;
+    for (i = 0; i < (1U << logHashSize); i++) {
+        hashTable[i] = -1;
     }
-    return (key & ((1 << logHashSize) - 1));
+    for (i = 0; i < num_resources; i++) {
+        unsigned int hashkey = resources_calc_hash_key(resources[i].name);
+
+        resources[i].hash_next = hashTable[hashkey];
+        hashTable[hashkey] = (int)i;
+    }
+}
+
+/* add resource number `num' to the hash table, growing the table if needed */
+static void resources_hash_add(unsigned int num)
+{
+    unsigned int hashkey;
+
+    if (num >= (1U << logHashSize)) {
+        logHashSize++;
+        hashTable = lib_realloc(hashTable, (1U << logHashSize) * sizeof(int));
+        /* the new resource is not counted yet, so it is not hashed here */
+        resources_build_hash_table();
+    }
+
+    hashkey = resources_calc_hash_key(resources[num].name);
+    resources[num].hash_next = hashTable[hashkey];
+    hashTable[hashkey] = (int)num;
 }
 
 
@@ -263,8 +293,6 @@ int resources_register_int(const resource_int_t *r)
     sp = r;
     dp = resources + num_resources;
     while (sp->name != NULL) {
-        unsigned int hashkey;
-
         if (sp->value_ptr == NULL || sp->set_func == NULL) {
             archdep_startup_log_error(
                 "Inconsistent resource declaration '%s'.\n", sp->name);
@@ -294,9 +322,7 @@ int resources_register_int(const resource_int_t *r)
         dp->param = sp->param;
         dp->callback = NULL;
 
-        hashkey = resources_calc_hash_key(sp->name);
-        dp->hash_next = hashTable[hashkey];
-        hashTable[hashkey] = (int)(dp - resources);
+        resources_hash_add((unsigned int)(dp - resources));
 
         num_resources++;
         sp++;
@@ -316,8 +342,6 @@ int resources_register_string(const resource_string_t *r)
     sp = r;
     dp = resources + num_resources;
     while (sp->name != NULL) {
-        unsigned int hashkey;
-
         if (sp->factory_value == NULL
             || sp->value_ptr == NULL || sp->set_func == NULL) {
             archdep_startup_log_error(
@@ -348,9 +372,7 @@ int resources_register_string(const resource_string_t *r)
         dp->param = sp->param;
         dp->callback = NULL;
 
-        hashkey = resources_calc_hash_key(sp->name);
-        dp->hash_next = hashTable[hashkey];
-        hashTable[hashkey] = (int)(dp - resources);
+        resources_hash_add((unsigned int)(dp - resources));
 
         num_resources++;
         sp++;
@@ -496,6 +518,7 @@ int resources_init(const char *machine)
 
     /* hash table maps hash keys to index in resources array rather than
        pointers into the array because the array may be reallocated. */
+    logHashSize = LOG_HASH_SIZE_INIT;
     hashTable = lib_malloc((1 << logHashSize) * sizeof(int));
 
     for (i = 0; i < (unsigned int)(1 << logHashSize); i++) {
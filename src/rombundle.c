@@ -0,0 +1,561 @@
+/*
+ * rombundle.c - Indexed bundle of system files.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/*
+ * A ROM bundle holds the files found in the subdirectories (C64, DRIVES, ...)
+ * of the system file search path in one file, so the ROMs can be looked up
+ * by a hash instead of probing every directory of the path. Where possible
+ * the bundle is mapped read-only, so many emulator instances on the same host
+ * share its pages.
+ *
+ * File format, all values are 32 bit little endian:
+ *
+ *   0   "VICEROMB"
+ *   8   version (1)
+ *   12  number of files
+ *   16  number of hash slots (power of two)
+ *   20  reserved (0)
+ *   24  hash slots: file number + 1, or 0 for an empty slot
+ *       file table: hash, name offset, name length, data offset, data size
+ *       names ("subdir/name", NUL terminated)
+ *       data (each file aligned to 16 bytes)
+ *
+ * The hash is FNV-1a over the name, collisions are resolved by linear probing.
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "archdep.h"
+#include "lib.h"
+#include "log.h"
+#include "rombundle.h"
+#include "util.h"
+
+#define ROMBUNDLE_MAGIC         "VICEROMB"
+#define ROMBUNDLE_VERSION       1
+#define ROMBUNDLE_HEADER_SIZE   24
+#define ROMBUNDLE_ENTRY_SIZE    20
+#define ROMBUNDLE_ALIGN         16
+
+/* files larger than this are not system files and are left out */
+#define ROMBUNDLE_MAX_FILE_SIZE (4 * 1024 * 1024)
+
+static log_t rombundle_log = LOG_DEFAULT;
+
+static const uint8_t *bundle = NULL;
+static size_t bundle_size = 0;
+static int bundle_mapped = 0;
+static uint32_t bundle_count = 0;
+static uint32_t bundle_hash_size = 0;
+static const uint8_t *bundle_hash = NULL;
+static const uint8_t *bundle_entries = NULL;
+
+static uint32_t get_dword(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8)
+           | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* FNV-1a, can be continued over several parts of a name */
+static uint32_t rombundle_hash(uint32_t hash, const char *s, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (uint8_t)s[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+#define ROMBUNDLE_HASH_INIT 2166136261U
+
+/* ------------------------------------------------------------------------- */
+
+static void rombundle_unmap(void)
+{
+    if (bundle == NULL) {
+        return;
+    }
+#ifdef HAVE_SYS_MMAN_H
+    if (bundle_mapped) {
+        munmap((void *)bundle, bundle_size);
+    } else
+#endif
+    {
+        lib_free((void *)bundle);
+    }
+    bundle = NULL;
+    bundle_size = 0;
+    bundle_mapped = 0;
+}
+
+/* map (or read) the whole file */
+static int rombundle_map(const char *filename)
+{
+#ifdef HAVE_SYS_MMAN_H
+    int fd;
+    struct stat st;
+    void *p;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return -1;
+    }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p != MAP_FAILED) {
+        bundle = p;
+        bundle_size = (size_t)st.st_size;
+        bundle_mapped = 1;
+        return 0;
+    }
+    /* fall back to reading it */
+#endif
+    {
+        FILE *fp;
+        off_t size;
+        uint8_t *buf;
+
+        fp = fopen(filename, MODE_READ);
+        if (fp == NULL) {
+            return -1;
+        }
+        size = archdep_file_size(fp);
+        if (size <= 0) {
+            fclose(fp);
+            return -1;
+        }
+        buf = lib_malloc((size_t)size);
+        if (fread(buf, 1, (size_t)size, fp) != (size_t)size) {
+            lib_free(buf);
+            fclose(fp);
+            return -1;
+        }
+        fclose(fp);
+        bundle = buf;
+        bundle_size = (size_t)size;
+        bundle_mapped = 0;
+    }
+    return 0;
+}
+
+/* check that all tables and files lie within the bundle */
+static int rombundle_check(void)
+{
+    uint32_t i;
+    uint64_t tables;
+
+    if (bundle_size < ROMBUNDLE_HEADER_SIZE
+        || memcmp(bundle, ROMBUNDLE_MAGIC, 8) != 0
+        || get_dword(bundle + 8) != ROMBUNDLE_VERSION) {
+        return -1;
+    }
+    bundle_count = get_dword(bundle + 12);
+    bundle_hash_size = get_dword(bundle + 16);
+    if (bundle_hash_size == 0
+        || (bundle_hash_size & (bundle_hash_size - 1)) != 0
+        || bundle_hash_size <= bundle_count) {
+        return -1;
+    }
+    tables = ROMBUNDLE_HEADER_SIZE + (uint64_t)bundle_hash_size * 4
+             + (uint64_t)bundle_count * ROMBUNDLE_ENTRY_SIZE;
+    if (tables > bundle_size) {
+        return -1;
+    }
+    bundle_hash = bundle + ROMBUNDLE_HEADER_SIZE;
+    bundle_entries = bundle_hash + bundle_hash_size * 4;
+
+    for (i = 0; i < bundle_hash_size; i++) {
+        if (get_dword(bundle_hash + i * 4) > bundle_count) {
+            return -1;
+        }
+    }
+    for (i = 0; i < bundle_count; i++) {
+        const uint8_t *e = bundle_entries + i * ROMBUNDLE_ENTRY_SIZE;
+
+        if ((uint64_t)get_dword(e + 4) + get_dword(e + 8) > bundle_size
+            || (uint64_t)get_dword(e + 12) + get_dword(e + 16) > bundle_size) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/** \brief  Open a ROM bundle, replacing the current one
+ *
+ * \param[in]   filename    bundle file name
+ *
+ * \return  0 on success, -1 on error
+ */
+int rombundle_open(const char *filename)
+{
+    if (rombundle_log == LOG_DEFAULT) {
+        rombundle_log = log_open("ROMBundle");
+    }
+
+    rombundle_close();
+
+    if (rombundle_map(filename) < 0) {
+        log_error(rombundle_log, "Cannot open ROM bundle '%s'.", filename);
+        return -1;
+    }
+    if (rombundle_check() < 0) {
+        log_error(rombundle_log, "'%s' is not a valid ROM bundle.", filename);
+        rombundle_close();
+        return -1;
+    }
+    log_message(rombundle_log, "Using ROM bundle '%s' (%u files%s).",
+                filename, bundle_count, bundle_mapped ? ", mapped" : "");
+    return 0;
+}
+
+/** \brief  Close the current ROM bundle
+ */
+void rombundle_close(void)
+{
+    rombundle_unmap();
+    bundle_count = 0;
+    bundle_hash_size = 0;
+    bundle_hash = NULL;
+    bundle_entries = NULL;
+}
+
+/** \brief  Look up a system file in the ROM bundle
+ *
+ * \param[in]   name    file name
+ * \param[in]   subpath subdirectory of the system path, like in findpath()
+ * \param[out]  data    file contents, valid until the bundle is closed
+ * \param[out]  size    file size
+ *
+ * \return  0 if the file was found, -1 if not
+ */
+int rombundle_find(const char *name, const char *subpath,
+                   const uint8_t **data, size_t *size)
+{
+    size_t name_len, sub_len;
+    uint32_t hash, slot, probes;
+
+    if (bundle == NULL || subpath == NULL) {
+        return -1;
+    }
+
+    name_len = strlen(name);
+    sub_len = strlen(subpath);
+    hash = rombundle_hash(ROMBUNDLE_HASH_INIT, subpath, sub_len);
+    hash = rombundle_hash(hash, "/", 1);
+    hash = rombundle_hash(hash, name, name_len);
+
+    slot = hash & (bundle_hash_size - 1);
+    for (probes = 0; probes < bundle_hash_size;
+         probes++, slot = (slot + 1) & (bundle_hash_size - 1)) {
+        uint32_t index = get_dword(bundle_hash + slot * 4);
+        const uint8_t *e;
+        const char *entry_name;
+
+        if (index == 0) {
+            return -1;
+        }
+        e = bundle_entries + (index - 1) * ROMBUNDLE_ENTRY_SIZE;
+        if (get_dword(e) != hash
+            || get_dword(e + 8) != sub_len + 1 + name_len) {
+            continue;
+        }
+        entry_name = (const char *)bundle + get_dword(e + 4);
+        if (memcmp(entry_name, subpath, sub_len) == 0
+            && entry_name[sub_len] == '/'
+            && memcmp(entry_name + sub_len + 1, name, name_len) == 0) {
+            *data = bundle + get_dword(e + 12);
+            *size = get_dword(e + 16);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* ------------------------------------------------------------------------- */
+
+typedef struct rombundle_file_s {
+    char *name;     /* "subdir/name" */
+    char *path;     /* host path */
+    uint32_t hash;
+    uint32_t size;
+} rombundle_file_t;
+
+static off_t rombundle_file_size(const char *path)
+{
+    FILE *fp;
+    off_t size;
+
+    fp = fopen(path, MODE_READ);
+    if (fp == NULL) {
+        return -1;
+    }
+    size = archdep_file_size(fp);
+    fclose(fp);
+    return size;
+}
+
+static int rombundle_has_file(const rombundle_file_t *files, unsigned int num,
+                              const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < num; i++) {
+        if (strcmp(files[i].name, name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* add the files of one subdirectory, the first file of a name wins just like
+   in findpath() */
+static void rombundle_add_dir(rombundle_file_t **files, unsigned int *num,
+                              unsigned int *allocated, const char *dir,
+                              const char *subdir)
+{
+    archdep_dir_t *d;
+    char *path;
+    int i;
+
+    path = util_join_paths(dir, subdir, NULL);
+    d = archdep_opendir(path, ARCHDEP_OPENDIR_NO_HIDDEN_FILES);
+    if (d == NULL) {
+        lib_free(path);
+        return;
+    }
+
+    for (i = 0; i < archdep_readdir_num_files(d); i++) {
+        const char *file = archdep_readdir_get_file(d, i);
+        char *name = util_concat(subdir, "/", file, NULL);
+        char *file_path;
+        off_t size;
+
+        if (rombundle_has_file(*files, *num, name)) {
+            lib_free(name);
+            continue;
+        }
+        file_path = util_join_paths(path, file, NULL);
+        size = rombundle_file_size(file_path);
+        if (size <= 0 || size > ROMBUNDLE_MAX_FILE_SIZE) {
+            lib_free(file_path);
+            lib_free(name);
+            continue;
+        }
+        if (*num >= *allocated) {
+            *allocated = *allocated ? *allocated * 2 : 64;
+            *files = lib_realloc(*files, *allocated * sizeof(rombundle_file_t));
+        }
+        (*files)[*num].name = name;
+        (*files)[*num].path = file_path;
+        (*files)[*num].hash = rombundle_hash(ROMBUNDLE_HASH_INIT, name, strlen(name));
+        (*files)[*num].size = (uint32_t)size;
+        (*num)++;
+    }
+
+    archdep_closedir(d);
+    lib_free(path);
+}
+
+static int rombundle_write_dword(FILE *fp, uint32_t value)
+{
+    uint8_t buf[4];
+
+    util_dword_to_le_buf(buf, value);
+    return fwrite(buf, 1, 4, fp) == 4 ? 0 : -1;
+}
+
+/** \brief  Create a ROM bundle from the subdirectories of the search path
+ *
+ * \param[in]   filename    bundle file name
+ * \param[in]   syspath     system file search path
+ *
+ * \return  0 on success, -1 on error
+ */
+int rombundle_create(const char *filename, const char *syspath)
+{
+    rombundle_file_t *files = NULL;
+    unsigned int num = 0, allocated = 0;
+    uint32_t hash_size, *slots;
+    uint32_t names_offset, names_size, data_offset, offset;
+    char *path, *dir, *sep;
+    unsigned int i;
+    FILE *fp;
+    uint8_t *buf = NULL;
+    int err = -1;
+
+    if (rombundle_log == LOG_DEFAULT) {
+        rombundle_log = log_open("ROMBundle");
+    }
+
+    /* collect the files of all subdirectories of all path elements */
+    path = lib_strdup(syspath);
+    for (dir = path; dir != NULL; dir = sep) {
+        archdep_dir_t *d;
+        int n;
+
+        sep = strstr(dir, ARCHDEP_FINDPATH_SEPARATOR_STRING);
+        if (sep != NULL) {
+            *sep = '\0';
+            sep += strlen(ARCHDEP_FINDPATH_SEPARATOR_STRING);
+        }
+        d = archdep_opendir(dir, ARCHDEP_OPENDIR_NO_HIDDEN_FILES);
+        if (d == NULL) {
+            continue;
+        }
+        for (n = 0; n < archdep_readdir_num_dirs(d); n++) {
+            const char *subdir = archdep_readdir_get_dir(d, n);
+
+            if (strcmp(subdir, ".") != 0 && strcmp(subdir, "..") != 0) {
+                rombundle_add_dir(&files, &num, &allocated, dir, subdir);
+            }
+        }
+        archdep_closedir(d);
+    }
+    lib_free(path);
+
+    if (num == 0) {
+        log_error(rombundle_log, "No system files found in '%s'.", syspath);
+        return -1;
+    }
+
+    /* hash slots, at most half of them are used */
+    for (hash_size = 16; hash_size < num * 2; hash_size *= 2) {
+    }
+    slots = lib_calloc(hash_size, sizeof(uint32_t));
+    for (i = 0; i < num; i++) {
+        uint32_t slot = files[i].hash & (hash_size - 1);
+
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (hash_size - 1);
+        }
+        slots[slot] = i + 1;
+    }
+
+    names_offset = ROMBUNDLE_HEADER_SIZE + hash_size * 4 + num * ROMBUNDLE_ENTRY_SIZE;
+    names_size = 0;
+    for (i = 0; i < num; i++) {
+        names_size += (uint32_t)strlen(files[i].name) + 1;
+    }
+    data_offset = (names_offset + names_size + ROMBUNDLE_ALIGN - 1) & ~(uint32_t)(ROMBUNDLE_ALIGN - 1);
+
+    fp = fopen(filename, MODE_WRITE);
+    if (fp == NULL) {
+        log_error(rombundle_log, "Cannot create ROM bundle '%s'.", filename);
+        goto out;
+    }
+
+    if (fwrite(ROMBUNDLE_MAGIC, 1, 8, fp) != 8
+        || rombundle_write_dword(fp, ROMBUNDLE_VERSION) < 0
+        || rombundle_write_dword(fp, num) < 0
+        || rombundle_write_dword(fp, hash_size) < 0
+        || rombundle_write_dword(fp, 0) < 0) {
+        goto write_error;
+    }
+    for (i = 0; i < hash_size; i++) {
+        if (rombundle_write_dword(fp, slots[i]) < 0) {
+            goto write_error;
+        }
+    }
+    for (i = 0, offset = data_offset; i < num; i++) {
+        uint32_t name_len = (uint32_t)strlen(files[i].name);
+
+        if (rombundle_write_dword(fp, files[i].hash) < 0
+            || rombundle_write_dword(fp, names_offset) < 0
+            || rombundle_write_dword(fp, name_len) < 0
+            || rombundle_write_dword(fp, offset) < 0
+            || rombundle_write_dword(fp, files[i].size) < 0) {
+            goto write_error;
+        }
+        names_offset += name_len + 1;
+        offset = (offset + files[i].size + ROMBUNDLE_ALIGN - 1) & ~(uint32_t)(ROMBUNDLE_ALIGN - 1);
+    }
+    for (i = 0; i < num; i++) {
+        if (fwrite(files[i].name, 1, strlen(files[i].name) + 1, fp)
+            != strlen(files[i].name) + 1) {
+            goto write_error;
+        }
+    }
+
+    buf = lib_calloc(1, ROMBUNDLE_MAX_FILE_SIZE + ROMBUNDLE_ALIGN);
+    offset = names_offset;
+    for (i = 0; i < num; i++) {
+        uint32_t padded;
+
+        /* pad to the start of the file data */
+        padded = (offset + ROMBUNDLE_ALIGN - 1) & ~(uint32_t)(ROMBUNDLE_ALIGN - 1);
+        memset(buf, 0, ROMBUNDLE_ALIGN);
+        if (fwrite(buf, 1, padded - offset, fp) != padded - offset) {
+            goto write_error;
+        }
+        if (util_file_load(files[i].path, buf, files[i].size,
+                           UTIL_FILE_LOAD_RAW) < 0) {
+            log_error(rombundle_log, "Cannot read '%s'.", files[i].path);
+            fclose(fp);
+            goto out;
+        }
+        if (fwrite(buf, 1, files[i].size, fp) != files[i].size) {
+            goto write_error;
+        }
+        offset = padded + files[i].size;
+    }
+
+    if (fclose(fp) != 0) {
+        log_error(rombundle_log, "Cannot write ROM bundle '%s'.", filename);
+        goto out;
+    }
+    log_message(rombundle_log, "Created ROM bundle '%s' with %u files.",
+                filename, num);
+    err = 0;
+    goto out;
+
+write_error:
+    log_error(rombundle_log, "Cannot write ROM bundle '%s'.", filename);
+    fclose(fp);
+
+out:
+    lib_free(buf);
+    lib_free(slots);
+    for (i = 0; i < num; i++) {
+        lib_free(files[i].name);
+        lib_free(files[i].path);
+    }
+    lib_free(files);
+    return err;
+}
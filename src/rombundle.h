@@ -0,0 +1,37 @@
+/*
+ * rombundle.h - Indexed bundle of system files.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_ROMBUNDLE_H
+#define VICE_ROMBUNDLE_H
+
+#include <stddef.h>
+
+#include "types.h"
+
+int rombundle_open(const char *filename);
+void rombundle_close(void);
+int rombundle_find(const char *name, const char *subpath,
+                   const uint8_t **data, size_t *size);
+int rombundle_create(const char *filename, const char *syspath);
+
+#endif
@@ -33,6 +33,11 @@
  *
  * I/O is done to a socket.  If the socket isnt connected, no data
  * is read and written data is discarded.
+ *
+ * The socket is non-blocking and both directions are buffered: received
+ * data is read in blocks, and written data is collected and sent when the
+ * buffer is full or the flush latency (RsNetFlushLatency) has passed. So
+ * the emulated interface does not cause a system call for every byte.
  */
 
 #undef DEBUG
@@ -50,8 +55,11 @@
 #include <io.h>
 #endif
 
+#include "archdep.h"
+#include "cmdline.h"
 #include "lib.h"
 #include "log.h"
+#include "resources.h"
 #include "rs232.h"
 #include "rs232net.h"
 #include "vicesocket.h"
@@ -71,18 +79,50 @@
 
 /* ------------------------------------------------------------------------- */
 
-int rs232net_resources_init(void)
+/* size of the receive and the transmit buffer of a connection */
+#define RS232NET_BUFFER_SIZE 4096
+
+/* time to wait for the transmit buffer to drain on close, in microseconds */
+#define RS232NET_CLOSE_TIMEOUT 1000000
+
+/* time between reading or writing the socket, in microseconds */
+static int flush_latency = 1000;
+
+static int set_flush_latency(int val, void *param)
 {
+    if (val < 0 || val > 1000000) {
+        return -1;
+    }
+    flush_latency = val;
     return 0;
 }
 
+static const resource_int_t resources_int[] = {
+    { "RsNetFlushLatency", 1000, RES_EVENT_NO, NULL,
+      &flush_latency, set_flush_latency, NULL },
+    RESOURCE_INT_LIST_END
+};
+
+int rs232net_resources_init(void)
+{
+    return resources_register_int(resources_int);
+}
+
 void rs232net_resources_shutdown(void)
 {
 }
 
+static const cmdline_option_t cmdline_options[] =
+{
+    { "-rsnetflushlatency", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "RsNetFlushLatency", NULL,
+      "<usec>", "Set the time between reading or writing the socket of network RS232 devices, in microseconds (0: on every byte)" },
+    CMDLINE_LIST_END
+};
+
 int rs232net_cmdline_options_init(void)
 {
-    return 0;
+    return cmdline_register_options(cmdline_options);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -98,6 +138,14 @@ typedef struct rs232net {
     int dcd_in;   /*!< ip232 status of DCD line */
     int ri_in;    /*!< ip232 status of RI line */
     int dtr_out;  /*!< ip232 status of DTR line */
+    uint8_t rx_buf[RS232NET_BUFFER_SIZE]; /*!< received data */
+    unsigned int rx_pos;    /*!< next byte to read from rx_buf */
+    unsigned int rx_len;    /*!< number of bytes in rx_buf */
+    tick_t rx_tick;         /*!< time the socket was read last */
+    uint8_t tx_buf[RS232NET_BUFFER_SIZE]; /*!< data not sent yet */
+    unsigned int tx_len;    /*!< number of bytes in tx_buf */
+    tick_t tx_tick;         /*!< time the socket was written last */
+    unsigned long tx_dropped; /*!< bytes dropped since tx_buf was last full */
 } rs232net_t;
 
 /* C99 standard guarantees all members of an object of static storage are
@@ -165,8 +213,21 @@ int rs232net_open(int device)
             break;
         }
 
+        if (vice_network_socket_set_nonblocking(fds[i].fd) < 0) {
+            log_error(rs232net_log, "Cant make connection non-blocking.");
+            vice_network_socket_close(fds[i].fd);
+            fds[i].fd = 0;
+            break;
+        }
+
         fds[i].inuse = 1;
         fds[i].useip232 = rs232_useip232[device];
+        fds[i].rx_pos = 0;
+        fds[i].rx_len = 0;
+        fds[i].tx_len = 0;
+        fds[i].tx_dropped = 0;
+        fds[i].rx_tick = tick_now();
+        fds[i].tx_tick = fds[i].rx_tick;
 
         index = i;
 
@@ -181,13 +242,75 @@ int rs232net_open(int device)
 
 static void rs232net_closesocket(int index)
 {
-    vice_network_socket_close(fds[index].fd);
+    if (fds[index].fd) {
+        vice_network_socket_close(fds[index].fd);
+    }
     fds[index].fd = 0;
+    fds[index].rx_pos = 0;
+    fds[index].rx_len = 0;
+    fds[index].tx_len = 0;
+}
+
+/* sends as much of the transmit buffer as the socket takes */
+static int rs232net_flush(int fd)
+{
+    ssize_t n;
+
+    fds[fd].tx_tick = tick_now();
+
+    if (!fds[fd].fd || fds[fd].tx_len == 0) {
+        return 0;
+    }
+
+    n = vice_network_send(fds[fd].fd, fds[fd].tx_buf, fds[fd].tx_len, 0);
+    if (n < 0) {
+        if (vice_network_would_block()) {
+            return 0;
+        }
+        log_error(rs232net_log, "Error writing: %d.", vice_network_get_errorcode());
+        rs232net_closesocket(fd);
+        return -1;
+    }
+
+    fds[fd].tx_len -= (unsigned int)n;
+    if (fds[fd].tx_len > 0) {
+        memmove(fds[fd].tx_buf, fds[fd].tx_buf + n, fds[fd].tx_len);
+    }
+    return 0;
+}
+
+/* reads what has arrived into the empty receive buffer */
+static int rs232net_fill(int fd)
+{
+    ssize_t n;
+
+    fds[fd].rx_tick = tick_now();
+
+    n = vice_network_receive(fds[fd].fd, fds[fd].rx_buf, sizeof(fds[fd].rx_buf), 0);
+    if (n > 0) {
+        fds[fd].rx_pos = 0;
+        fds[fd].rx_len = (unsigned int)n;
+        return 0;
+    }
+    if (n < 0 && vice_network_would_block()) {
+        return 0;
+    }
+
+    if (n < 0) {
+        log_error(rs232net_log, "Error reading: %d.",
+                vice_network_get_errorcode());
+    } else {
+        log_error(rs232net_log, "EOF");
+    }
+    rs232net_closesocket(fd);
+    return -1;
 }
 
 /* closes the rs232 window again */
 void rs232net_close(int fd)
 {
+    tick_t start;
+
     do {
 
         DEBUG_LOG_MESSAGE((rs232net_log, "close(fd=%d).", fd));
@@ -206,6 +329,22 @@ void rs232net_close(int fd)
             _rs232net_putc(fd, IP232DTRLO);
         }
 
+        /* send what is still buffered, but don't hang on a peer that
+           stopped reading */
+        start = tick_now();
+        while (fds[fd].fd && fds[fd].tx_len > 0) {
+            if (rs232net_flush(fd) < 0) {
+                break;
+            }
+            if (fds[fd].tx_len > 0) {
+                if (tick_now_delta(start) >= RS232NET_CLOSE_TIMEOUT) {
+                    log_warning(rs232net_log, "Closing with %u bytes not sent.", fds[fd].tx_len);
+                    break;
+                }
+                archdep_usleep(1000);
+            }
+        }
+
         rs232net_closesocket(fd);
         fds[fd].inuse = 0;
 
@@ -215,8 +354,6 @@ void rs232net_close(int fd)
 /* sends a byte to the RS232 line */
 static int _rs232net_putc(int fd, uint8_t b)
 {
-    ssize_t n;
-
     if (fd < 0 || fd >= RS232_NUM_DEVICES) {
         log_error(rs232net_log, "Attempt to write to invalid fd %d.", fd);
         return -1;
@@ -234,11 +371,29 @@ static int _rs232net_putc(int fd, uint8_t b)
     /* for the beginning... */
     DEBUG_LOG_MESSAGE((rs232net_log, "Output 0x%02x '%c'.", b, isgraph((unsigned char)b) ? b : '.'));
 
-    n = vice_network_send(fds[fd].fd, &b, 1, 0);
-    if (n < 0) {
-        log_error(rs232net_log, "Error writing: %d.", vice_network_get_errorcode());
-        rs232net_closesocket(fd);
-        return -1;
+    if (fds[fd].tx_len == sizeof(fds[fd].tx_buf)) {
+        if (rs232net_flush(fd) < 0) {
+            return -1;
+        }
+    }
+
+    /* the other side does not keep up: drop the byte like a serial line
+       without flow control, rather than stall the emulation */
+    if (fds[fd].tx_len == sizeof(fds[fd].tx_buf)) {
+        if (fds[fd].tx_dropped++ == 0) {
+            log_warning(rs232net_log, "Peer does not read, dropping output.");
+        }
+        return 0;
+    }
+    if (fds[fd].tx_dropped > 0) {
+        log_warning(rs232net_log, "Dropped %lu bytes of output.", fds[fd].tx_dropped);
+        fds[fd].tx_dropped = 0;
+    }
+
+    fds[fd].tx_buf[fds[fd].tx_len++] = b;
+
+    if (tick_now_delta(fds[fd].tx_tick) >= (tick_t)flush_latency) {
+        return rs232net_flush(fd);
     }
 
     return 0;
@@ -247,7 +402,6 @@ static int _rs232net_putc(int fd, uint8_t b)
 /* gets a byte to the RS232 line, returns !=0 if byte received, byte in *b. */
 static int _rs232net_getc(int fd, uint8_t * b)
 {
-    int ret;
     ssize_t no_of_read_byte = -1;
 
     do {
@@ -270,24 +424,31 @@ static int _rs232net_getc(int fd, uint8_t * b)
             break;
         }
 
-        ret = vice_network_select_poll_one(fds[fd].fd);
-
-        if (ret > 0) {
-
-            no_of_read_byte = vice_network_receive(fds[fd].fd, b, 1, 0);
-            DEBUG_LOG_MESSAGE((rs232net_log, "Input 0x%02x '%c'.", *b, isgraph((unsigned char)*b) ? *b : '.'));
+        /* the emulation polls for input regularly, send pending output */
+        if (fds[fd].tx_len > 0
+            && tick_now_delta(fds[fd].tx_tick) >= (tick_t)flush_latency) {
+            if (rs232net_flush(fd) < 0) {
+                no_of_read_byte = -1;
+                break;
+            }
+        }
 
-            if ( no_of_read_byte != 1 ) {
-                if ( no_of_read_byte < 0 ) {
-                    log_error(rs232net_log, "Error reading: %d.",
-                            vice_network_get_errorcode());
-                } else {
-                    log_error(rs232net_log, "EOF");
-                }
-                rs232net_closesocket(fd);
+        if (fds[fd].rx_pos == fds[fd].rx_len) {
+            if (tick_now_delta(fds[fd].rx_tick) < (tick_t)flush_latency) {
+                break;
+            }
+            if (rs232net_fill(fd) < 0) {
                 no_of_read_byte = -1;
+                break;
+            }
+            if (fds[fd].rx_pos == fds[fd].rx_len) {
+                break;
             }
         }
+
+        *b = fds[fd].rx_buf[fds[fd].rx_pos++];
+        no_of_read_byte = 1;
+        DEBUG_LOG_MESSAGE((rs232net_log, "Input 0x%02x '%c'.", *b, isgraph((unsigned char)*b) ? *b : '.'));
     } while (0);
 
     return (int)no_of_read_byte;
@@ -0,0 +1,220 @@
+/*
+ * fastsid-check.c - Compare the block renderer of FastSID with the per
+ *                   sample code.
+ *
+ * Two FastSID instances get the same register writes, one renders with
+ * fastsid_calculate_block(), the other one sample at a time with
+ * fastsid_calculate_single_sample(). Their output must be the same, for
+ * both SID models and with and without the filter.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* the renderers are static, so the engine is built into the checker */
+#include "fastsid.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vicecheck.h"
+
+#ifndef BLOCKRENDER
+#error "fastsid-check needs the block renderer (--enable-fastsid-blockrender)"
+#endif
+
+#define CHECK_SPEED     44100
+#define CHECK_CLOCK     985248
+
+/* register writes and render calls per configuration */
+#define CHECK_CHUNKS    4000
+
+/* longest render call, a few blocks */
+#define CHECK_CHUNK_MAX (3 * BLOCKSIZE + 17)
+
+/* the resources the engine reads on init */
+static int check_model;
+static int check_filters;
+
+/* ------------------------------------------------------------------------- */
+
+/* what the engine needs from the rest of VICE */
+
+CLOCK maincpu_clk = 0;
+
+int resources_get_int(const char *name, int *value_return)
+{
+    if (strcmp(name, "SidModel") == 0) {
+        *value_return = check_model;
+        return 0;
+    }
+    if (strcmp(name, "SidFilters") == 0) {
+        *value_return = check_filters;
+        return 0;
+    }
+    return -1;
+}
+
+long sound_sample_position(void)
+{
+    return 0;
+}
+
+#ifdef LIB_DEBUG_PINPOINT
+void *lib_calloc_pinpoint(size_t nmemb, size_t size, const char *name, unsigned int line)
+{
+    return calloc(nmemb, size);
+}
+
+void lib_free_pinpoint(void *p, const char *name, unsigned int line)
+{
+    free(p);
+}
+
+char *lib_strdup_pinpoint(const char *str, const char *name, unsigned int line)
+{
+    char *s = malloc(strlen(str) + 1);
+
+    strcpy(s, str);
+    return s;
+}
+#else
+void *lib_calloc(size_t nmemb, size_t size)
+{
+    return calloc(nmemb, size);
+}
+
+void lib_free(void *p)
+{
+    free(p);
+}
+
+char *lib_strdup(const char *str)
+{
+    char *s = malloc(strlen(str) + 1);
+
+    strcpy(s, str);
+    return s;
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+/* a value for a SID register, biased towards what tunes do */
+static uint8_t check_value(uint16_t addr)
+{
+    static const uint8_t waveforms[] = {
+        0x10, 0x20, 0x40, 0x80, 0x30, 0x50, 0x60, 0x70
+    };
+    uint8_t byte;
+
+    switch (addr) {
+        case 4:
+        case 11:
+        case 18:
+            byte = waveforms[check_rand(sizeof(waveforms))];
+            byte |= (uint8_t)check_rand(2);             /* gate */
+            if (check_rand(4) == 0) {
+                byte |= 0x04;                           /* ring modulation */
+            }
+            if (check_rand(8) == 0) {
+                byte |= 0x02;                           /* hard sync */
+            }
+            if (check_rand(16) == 0) {
+                byte |= 0x08;                           /* test */
+            }
+            return byte;
+        case 0x18:
+            /* filter mode and a volume that can be heard */
+            return (uint8_t)(check_rand(256) | 0x08);
+        default:
+            return (uint8_t)check_rand(256);
+    }
+}
+
+static int check_config(int model, int filters)
+{
+    uint8_t regs[32];
+    sound_t *block, *single;
+    int16_t out_block[CHECK_CHUNK_MAX];
+    int16_t out_single[CHECK_CHUNK_MAX];
+    unsigned long samples = 0;
+    int chunk, i, nr, writes;
+
+    check_model = model;
+    check_filters = filters;
+    check_srand(0x5eed0000 | (uint32_t)(model << 1) | (uint32_t)filters);
+
+    memset(regs, 0, sizeof(regs));
+    block = fastsid_open(regs);
+    single = fastsid_open(regs);
+    if (!fastsid_init(block, CHECK_SPEED, CHECK_CLOCK, 1000)
+        || !fastsid_init(single, CHECK_SPEED, CHECK_CLOCK, 1000)) {
+        printf("model %d, filter %d: init failed\n", model, filters);
+        return -1;
+    }
+
+    for (chunk = 0; chunk < CHECK_CHUNKS; chunk++) {
+        for (writes = (int)check_rand(4); writes > 0; writes--) {
+            uint16_t addr = (uint16_t)check_rand(0x19);
+            uint8_t byte = check_value(addr);
+
+            fastsid_store(block, addr, byte);
+            fastsid_store(single, addr, byte);
+        }
+
+        nr = 1 + (int)check_rand(CHECK_CHUNK_MAX);
+        fastsid_calculate_block(block, out_block, nr, 1);
+        for (i = 0; i < nr; i++) {
+            out_single[i] = fastsid_calculate_single_sample(single, i);
+        }
+
+        for (i = 0; i < nr; i++) {
+            if (out_block[i] != out_single[i]) {
+                printf("model %d, filter %d: sample %lu differs: %d instead of %d\n",
+                       model, filters, samples + (unsigned long)i,
+                       out_block[i], out_single[i]);
+                fastsid_close(block);
+                fastsid_close(single);
+                return -1;
+            }
+        }
+        samples += (unsigned long)nr;
+    }
+
+    printf("model %d, filter %d: %lu samples match\n", model, filters, samples);
+    fastsid_close(block);
+    fastsid_close(single);
+    return 0;
+}
+
+int main(void)
+{
+    int model, filters;
+    int result = EXIT_SUCCESS;
+
+    for (model = 0; model < 2; model++) {
+        for (filters = 0; filters < 2; filters++) {
+            if (check_config(model, filters) < 0) {
+                result = EXIT_FAILURE;
+            }
+        }
+    }
+    return result;
+}
@@ -61,6 +61,21 @@
 /* use wavetables (sampled waveforms) */
 #define WAVETABLES
 
+/* render a block of samples one voice at a time instead of one sample of
+   all voices at a time, see fastsid_calculate_block() (needs WAVETABLES,
+   configure with --disable-fastsid-blockrender to leave it out) */
+#ifdef USE_FASTSID_BLOCKRENDER
+#define BLOCKRENDER
+#endif
+
+/* compare every block against the output of the per-sample code and log
+   differences */
+/* #define BLOCKRENDER_CHECK */
+
+#if defined(BLOCKRENDER) && (!defined(WAVETABLES) || defined(SOUND_SYSTEM_FLOAT))
+#undef BLOCKRENDER
+#endif
+
 /* ADSR state */
 #define ATTACK   0
 #define DECAY    1
@@ -866,6 +881,205 @@ static int16_t fastsid_calculate_single_sample(sound_t *psid, int i)
 }
 #endif
 
+#ifdef BLOCKRENDER
+/* Block rendering
+ *
+ * Each stage runs over a whole block of one voice, which gives the compiler
+ * simple loops to vectorize (the counters of a voice without noise, the
+ * wavetable lookups, applying the envelope and mixing). The output is the
+ * same as with fastsid_calculate_single_sample().
+ *
+ * Voices only depend on each other through hard sync and ring modulation.
+ * Ring modulation only needs the counters of the previous voice, hard sync
+ * resets a counter in the middle of a block, so that is left to the per
+ * sample code.
+ */
+
+/* number of samples per voice rendered in one go */
+#define BLOCKSIZE 256
+
+/* advance the counter of a voice, store the counter values in f and the
+   noise output in o if noise is selected */
+static void block_osc(voice_t *pv, uint32_t *f, uint32_t *o, int n)
+{
+    uint32_t pf = pv->f;
+    uint32_t fs = pv->fs;
+    uint32_t rv = pv->rv;
+    int i;
+
+    if (pv->noise) {
+        for (i = 0; i < n; i++) {
+            if ((pf += fs) < fs) {
+                rv = NSHIFT(rv, 16);
+            }
+            f[i] = pf;
+            o[i] = ((uint32_t)NVALUE(NSHIFT(rv, pf >> 28))) << 7;
+        }
+    } else {
+        /* the noise register still shifts on every counter overflow */
+        uint64_t overflows = ((uint64_t)pf + (uint64_t)fs * (uint64_t)n) >> 32;
+
+        for (i = 0; i < n; i++) {
+            f[i] = pf + fs * (uint32_t)(i + 1);
+        }
+        while (overflows--) {
+            rv = NSHIFT(rv, 16);
+        }
+        pf = f[n - 1];
+    }
+    pv->f = pf;
+    pv->rv = rv;
+}
+
+/* wavetable lookup, fprev are the counters of the previous voice */
+static void block_wave(voice_t *pv, const uint32_t *f, const uint32_t *fprev, uint32_t *o, int n)
+{
+    const uint16_t *wt = pv->wt;
+    const uint16_t *wtr = pv->wtr;
+    uint32_t wtpf = pv->wtpf;
+    uint32_t wtl = pv->wtl;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        o[i] = wt[(f[i] + wtpf) >> wtl] ^ wtr[fprev[i] >> 31];
+    }
+}
+
+/* step the envelope and apply it to the waveform in o */
+static void block_env(voice_t *pv, uint32_t *o, int n, int enabled)
+{
+    uint32_t env[BLOCKSIZE];
+    uint32_t adsr = pv->adsr;
+    uint32_t adsrz = pv->adsrz + 0x80000000;
+    uint32_t adsrs = (uint32_t)pv->adsrs;
+    uint32_t trigger = 0;
+    int i;
+
+    /* without a state change within the block the counter is linear */
+    for (i = 0; i < n; i++) {
+        env[i] = adsr + adsrs * (uint32_t)(i + 1);
+        trigger |= (env[i] + 0x80000000 < adsrz);
+    }
+
+    if (!trigger) {
+        pv->adsr = env[n - 1];
+        for (i = 0; i < n; i++) {
+            env[i] >>= 16;
+        }
+    } else {
+        for (i = 0; i < n; i++) {
+            if ((pv->adsr += pv->adsrs) + 0x80000000 < pv->adsrz + 0x80000000) {
+                trigger_adsr(pv);
+            }
+            env[i] = pv->adsr >> 16;
+        }
+    }
+
+    if (!enabled) {
+        memset(o, 0, n * sizeof(uint32_t));
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        o[i] *= env[i];
+    }
+}
+
+/* the filter of a voice is a chain of dependent floating point operations,
+   so all three voices are run side by side */
+static void block_filter(sound_t *psid, uint32_t o[3][BLOCKSIZE], int n)
+{
+    voice_t *v0 = &psid->v[0];
+    voice_t *v1 = &psid->v[1];
+    voice_t *v2 = &psid->v[2];
+    int i;
+
+    for (i = 0; i < n; i++) {
+        v0->filtIO = ampMod1x8[(o[0][i] >> 22)];
+        dofilter(v0);
+        o[0][i] = ((uint32_t)(v0->filtIO) + 0x80) << (7 + 15);
+        v1->filtIO = ampMod1x8[(o[1][i] >> 22)];
+        dofilter(v1);
+        o[1][i] = ((uint32_t)(v1->filtIO) + 0x80) << (7 + 15);
+        v2->filtIO = ampMod1x8[(o[2][i] >> 22)];
+        dofilter(v2);
+        o[2][i] = ((uint32_t)(v2->filtIO) + 0x80) << (7 + 15);
+    }
+}
+
+static void fastsid_calculate_block(sound_t *psid, int16_t *pbuf, int nr, int interleave)
+{
+    uint32_t f[3][BLOCKSIZE];
+    uint32_t o[3][BLOCKSIZE];
+    int32_t vol;
+    int i, k, n;
+
+    setup_sid(psid);
+    for (k = 0; k < 3; k++) {
+        setup_voice(&psid->v[k]);
+    }
+
+    if (psid->v[0].sync || psid->v[1].sync || psid->v[2].sync) {
+        for (i = 0; i < nr; i++) {
+            pbuf[i * interleave] = fastsid_calculate_single_sample(psid, i);
+        }
+        return;
+    }
+
+    vol = psid->vol;
+    for (; nr > 0; nr -= n, pbuf += n * interleave) {
+        n = nr < BLOCKSIZE ? nr : BLOCKSIZE;
+
+        for (k = 0; k < 3; k++) {
+            block_osc(&psid->v[k], f[k], o[k], n);
+        }
+        for (k = 0; k < 3; k++) {
+            if (!psid->v[k].noise) {
+                block_wave(&psid->v[k], f[k], f[(k + 2) % 3], o[k], n);
+            }
+        }
+        block_env(&psid->v[0], o[0], n, 1);
+        block_env(&psid->v[1], o[1], n, 1);
+        block_env(&psid->v[2], o[2], n, psid->has3);
+        if (psid->emulatefilter) {
+            block_filter(psid, o, n);
+        }
+
+        for (i = 0; i < n; i++) {
+            pbuf[i * interleave] = (int16_t)(((int32_t)((o[0][i] + o[1][i] + o[2][i]) >> 20) - 0x600) * vol);
+        }
+    }
+}
+
+#ifdef BLOCKRENDER_CHECK
+/* render the block again with the per sample code, starting from a copy of
+   the state before, and log the first difference */
+static void check_block(const sound_t *before, const int16_t *pbuf, int nr, int interleave)
+{
+    sound_t *psid = lib_malloc(sizeof(sound_t));
+    int i;
+
+    memcpy(psid, before, sizeof(sound_t));
+    for (i = 0; i < 3; i++) {
+        psid->v[i].vprev = &psid->v[(i + 2) % 3];
+        psid->v[i].vnext = &psid->v[(i + 1) % 3];
+        psid->v[i].d = psid->d + i * 7;
+        psid->v[i].s = psid;
+    }
+
+    for (i = 0; i < nr; i++) {
+        int16_t sample = fastsid_calculate_single_sample(psid, i);
+
+        if (sample != pbuf[i * interleave]) {
+            log_error(LOG_DEFAULT, "fastsid: block output differs at sample %d of %d: %d instead of %d.",
+                      i, nr, pbuf[i * interleave], sample);
+            break;
+        }
+    }
+    lib_free(psid);
+}
+#endif
+#endif
+
 #ifdef SOUND_SYSTEM_FLOAT
 /* FIXME */
 static int fastsid_calculate_samples(sound_t *psid, float *pbuf, int nr, CLOCK *delta_t)
@@ -887,9 +1101,29 @@ static int fastsid_calculate_samples(sound_t *psid, float *pbuf, int nr, CLOCK *
 #else
 static int fastsid_calculate_samples(sound_t *psid, int16_t *pbuf, int nr, int interleave, CLOCK *delta_t)
 {
-    int i;
     int16_t *tmp_buf;
 
+#ifdef BLOCKRENDER
+#ifdef BLOCKRENDER_CHECK
+    sound_t before;
+
+    memcpy(&before, psid, sizeof(sound_t));
+#endif
+    if (psid->factor == 1000) {
+        fastsid_calculate_block(psid, pbuf, nr, interleave);
+#ifdef BLOCKRENDER_CHECK
+        check_block(&before, pbuf, nr, interleave);
+#endif
+        return nr;
+    }
+    tmp_buf = getbuf(2 * nr * psid->factor / 1000);
+    fastsid_calculate_block(psid, tmp_buf, nr * psid->factor / 1000, interleave);
+#ifdef BLOCKRENDER_CHECK
+    check_block(&before, tmp_buf, nr * psid->factor / 1000, interleave);
+#endif
+#else
+    int i;
+
     if (psid->factor == 1000) {
         for (i = 0; i < nr; i++) {
             pbuf[i * interleave] = fastsid_calculate_single_sample(psid, i);
@@ -900,6 +1134,7 @@ static int fastsid_calculate_samples(sound_t *psid, int16_t *pbuf, int nr, int i
     for (i = 0; i < (nr * psid->factor / 1000); i++) {
         tmp_buf[i * interleave] = fastsid_calculate_single_sample(psid, i);
     }
+#endif
     memcpy(pbuf, tmp_buf, 2 * nr);
     return nr;
 }
@@ -1212,7 +1447,9 @@ sid_engine_t fastsid_hooks =
     fastsid_calculate_samples,
     fastsid_dump_state,
     fastsid_resid_state_read,
-    fastsid_resid_state_write
+    fastsid_resid_state_write,
+    NULL,
+    NULL
 };
 
 /* ---------------------------------------------------------------------*/
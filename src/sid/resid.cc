@@ -448,7 +448,9 @@ sid_engine_t resid_hooks =
     resid_calculate_samples,
     resid_dump_state,
     resid_state_read,
-    resid_state_write
+    resid_state_write,
+    NULL,
+    NULL
 };
 
 } // extern "C"
@@ -41,6 +41,7 @@ extern "C" {
 #include "sid/sid.h" /* sid_engine_t */
 #include "lib.h"
 #include "log.h"
+#include "maincpu.h"
 #include "residfp.h"
 #include "resources.h"
 #include "sid-snapshot.h"
@@ -67,6 +68,14 @@ struct sound_s
 
     /* resid sid implementation */
     reSIDfp::SID *sid;
+
+    /* second chip that gets the same writes and is only clocked silently,
+     * so the emulation thread can read OSC3/ENV3 without waiting for the
+     * sound synthesis thread to run the first one */
+    reSIDfp::SID *shadow;
+
+    /* clock the shadow chip has been run up to */
+    CLOCK shadow_clk;
 };
 
 typedef struct sound_s sound_t;
@@ -96,9 +105,11 @@ static sound_t *residfp_open(uint8_t *sidstate)
 
     psid = new sound_t;
     psid->sid = new reSIDfp::SID;
+    psid->shadow = new reSIDfp::SID;
 
     for (i = 0x00; i <= 0x18; i++) {
         psid->sid->write(i, sidstate[i]);
+        psid->shadow->write(i, sidstate[i]);
     }
 
     return psid;
@@ -177,6 +188,11 @@ static int residfp_init(sound_t *psid, int speed, int cycles_per_sec, int factor
     }
     psid->sid->enableFilter(filters_enabled ? true : false);
 
+    /* the shadow chip only needs the model, it never makes samples. Like the
+       first one, it starts running at the current clock, see sound_open() */
+    psid->shadow->setChipModel(psid->sid->getChipModel());
+    psid->shadow_clk = maincpu_clk;
+
     switch (sampling) {
         default:
         case 0: /* "fast" */
@@ -209,6 +225,7 @@ static int residfp_init(sound_t *psid, int speed, int cycles_per_sec, int factor
 static void residfp_close(sound_t *psid)
 {
     delete psid->sid;
+    delete psid->shadow;
     delete psid;
 
     if (buf) {
@@ -231,6 +248,35 @@ static void residfp_store(sound_t *psid, uint16_t addr, uint8_t byte)
 static void residfp_reset(sound_t *psid, CLOCK cpu_clk)
 {
     psid->sid->reset();
+    psid->shadow->reset();
+    psid->shadow_clk = cpu_clk;
+}
+
+/* run the shadow chip up to clk */
+static void residfp_shadow_clock(sound_t *psid, CLOCK clk)
+{
+    /* in steps, clockSilent() takes an unsigned int */
+    while (psid->shadow_clk < clk) {
+        CLOCK cycles = clk - psid->shadow_clk;
+
+        if (cycles > 1000000) {
+            cycles = 1000000;
+        }
+        psid->shadow->clockSilent((unsigned int)cycles);
+        psid->shadow_clk += cycles;
+    }
+}
+
+static int residfp_shadow_read(sound_t *psid, uint16_t addr, CLOCK clk)
+{
+    residfp_shadow_clock(psid, clk);
+    return psid->shadow->read(addr);
+}
+
+static void residfp_shadow_store(sound_t *psid, uint16_t addr, uint8_t byte, CLOCK clk)
+{
+    residfp_shadow_clock(psid, clk);
+    psid->shadow->write(addr, byte);
 }
 
 #ifdef SOUND_SYSTEM_FLOAT
@@ -441,7 +487,9 @@ sid_engine_t residfp_hooks =
     residfp_calculate_samples,
     residfp_dump_state,
     residfp_state_read,
-    residfp_state_write
+    residfp_state_write,
+    residfp_shadow_read,
+    residfp_shadow_store
 };
 
 } // extern "C"
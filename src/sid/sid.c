@@ -111,7 +111,9 @@ sid_engine_t fakesid_hooks =
     fakesid_calculate_samples,
     fakesid_dump_state,
     fakesid_resid_state_read,
-    fakesid_resid_state_write
+    fakesid_resid_state_write,
+    NULL,
+    NULL
 };
 
 struct sound_s {
@@ -701,6 +703,21 @@ void sid_sound_machine_store(sound_t *psid, uint16_t addr, uint8_t byte)
     sid_engine.store(psid, addr, byte);
 }
 
+int sid_sound_machine_shadow_read(sound_t *psid, uint16_t addr, CLOCK clk)
+{
+    if (sid_engine.shadow_read == NULL) {
+        return -1;
+    }
+    return sid_engine.shadow_read(psid, addr, clk);
+}
+
+void sid_sound_machine_shadow_store(sound_t *psid, uint16_t addr, uint8_t byte, CLOCK clk)
+{
+    if (sid_engine.shadow_store != NULL) {
+        sid_engine.shadow_store(psid, addr, byte, clk);
+    }
+}
+
 void sid_sound_machine_reset(sound_t *psid, CLOCK cpu_clk)
 {
     sid_engine.reset(psid, cpu_clk);
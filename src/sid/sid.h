@@ -245,6 +245,10 @@ struct sid_engine_s {
     char *(*dump_state)(struct sound_s *psid);
     void (*state_read)(struct sound_s *psid, struct sid_snapshot_state_s *sid_state);
     void (*state_write)(struct sound_s *psid, struct sid_snapshot_state_s *sid_state);
+    /* optional, answer reads from a copy of the chip clocked up to clk, see
+       sound_read() */
+    int (*shadow_read)(struct sound_s *psid, uint16_t addr, CLOCK clk);
+    void (*shadow_store)(struct sound_s *psid, uint16_t addr, uint8_t val, CLOCK clk);
 };
 typedef struct sid_engine_s sid_engine_t;
 
@@ -261,6 +265,8 @@ int sid_sound_machine_init(sound_t *psid, int speed, int cycles_per_sec);
 void sid_sound_machine_close(sound_t *psid);
 uint8_t sid_sound_machine_read(sound_t *psid, uint16_t addr);
 void sid_sound_machine_store(sound_t *psid, uint16_t addr, uint8_t byte);
+int sid_sound_machine_shadow_read(sound_t *psid, uint16_t addr, CLOCK clk);
+void sid_sound_machine_shadow_store(sound_t *psid, uint16_t addr, uint8_t byte, CLOCK clk);
 void sid_sound_machine_reset(sound_t *psid, CLOCK cpu_clk);
 char *sid_sound_machine_dump_state(sound_t *psid);
 int sid_sound_machine_cycle_based(void);
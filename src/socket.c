@@ -68,6 +68,10 @@
 # define INVALID_SOCKET -1
 #endif
 
+#ifndef WINDOWS_COMPILE
+#include <fcntl.h>
+#endif
+
 #include "archdep.h"
 #include "lib.h"
 #include "log.h"
@@ -1005,7 +1009,7 @@ ssize_t vice_network_send(vice_network_socket_t *sockfd,
 
     signals_pipe_set();
     ret = send(sockfd->sockfd, buffer, buffer_length, flags);
-    if (ret > buffer_length) {
+    if (ret > 0 && (size_t)ret > buffer_length) {
         log_error(LOG_DEFAULT, "vice_network_send: internal error (ret:%"PRI_SSIZE_T" buffer_length:%"PRI_SIZE_T" errno:%d - %s)",
                   ret, buffer_length, errno, strerror(errno));
         ret = -1; /* signal error */
@@ -1114,6 +1118,51 @@ int vice_network_select_multiple(vice_network_socket_t ** readsockfd)
     return select(max_sockfd + 1, &fdsockset, NULL, NULL, &time);
 }
 
+/*! \brief Switch a socket to non-blocking mode
+
+  After this, vice_network_send() and vice_network_receive() return
+  immediately. If nothing could be transferred, they return -1 and
+  vice_network_would_block() returns 1.
+
+  \param sockfd
+     The socket to switch
+
+  \return
+     0 on success, -1 on error.
+*/
+int vice_network_socket_set_nonblocking(vice_network_socket_t * sockfd)
+{
+#ifdef WINDOWS_COMPILE
+    u_long mode = 1;
+
+    return (ioctlsocket(sockfd->sockfd, FIONBIO, &mode) == 0) ? 0 : -1;
+#else
+    int flags = fcntl(sockfd->sockfd, F_GETFL, 0);
+
+    if (flags < 0) {
+        return -1;
+    }
+    return (fcntl(sockfd->sockfd, F_SETFL, flags | O_NONBLOCK) < 0) ? -1 : 0;
+#endif
+}
+
+/*! \brief Check whether the last socket operation failed only because
+           a non-blocking socket was not ready
+
+  \return
+     1 if the operation would have blocked, 0 otherwise.
+*/
+int vice_network_would_block(void)
+{
+#ifdef WINDOWS_COMPILE
+    return ARCHDEP_SOCKET_ERROR == WSAEWOULDBLOCK;
+#else
+    int error = ARCHDEP_SOCKET_ERROR;
+
+    return (error == EAGAIN) || (error == EWOULDBLOCK);
+#endif
+}
+
 /*! \brief Get the error of the last socket operation
 
   This function determines the error code for the last
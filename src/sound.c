@@ -40,6 +40,10 @@
 #include <strings.h>
 #endif
 
+#ifdef USE_VICE_THREAD
+#include <pthread.h>
+#endif
+
 #include "archdep.h"
 #include "cmdline.h"
 #include "debug.h"
@@ -230,10 +234,24 @@ typedef struct {
     /* is the device suspended? */
     int issuspended;
     int16_t lastsample[SOUND_OUTPUT_CHANNELS_MAX];
+
+    /* adaptive sync: smoothed device buffer fill level in samples */
+    double adaptive_fill;
+
+    /* adaptive sync: position of the next output sample, relative to the
+       first sample of the next flush (-1 is adaptive_prev) */
+    double adaptive_pos;
+
+    /* adaptive sync: last sample of the previous flush */
+    int16_t adaptive_prev[SOUND_OUTPUT_CHANNELS_MAX];
 } snddata_t;
 
 static snddata_t snddata;
 
+static void synth_sync(void);
+static void synth_start(void);
+static void synth_stop(void);
+
 static sound_t *sound_machine_open(int chipno)
 {
     sound_t *retval = NULL;
@@ -487,6 +505,23 @@ static uint8_t sound_machine_read(sound_t *psid, uint16_t addr)
     return 0;
 }
 
+#ifdef USE_VICE_THREAD
+static int sound_machine_shadow_read(sound_t *psid, uint16_t addr, CLOCK clk)
+{
+    if (sound_calls[addr >> 5]->shadow_read) {
+        return sound_calls[addr >> 5]->shadow_read(psid, (uint16_t)(addr & 0x1f), clk);
+    }
+    return -1;
+}
+
+static void sound_machine_shadow_store(sound_t *psid, uint16_t addr, uint8_t val, CLOCK clk)
+{
+    if (sound_calls[addr >> 5]->shadow_store) {
+        sound_calls[addr >> 5]->shadow_store(psid, (uint16_t)(addr & 0x1f), val, clk);
+    }
+}
+#endif
+
 static void sound_machine_reset(sound_t *psid, CLOCK cpu_clk)
 {
     int i;
@@ -545,6 +580,9 @@ static int amp;
 static int fragment_size;
 static int output_option;
 static int sound_emulation_enabled_on_warp;
+static int synth_thread_enabled;
+static int record_thread_enabled;
+static int adaptive_sync_enabled;
 
 /* divisors for fragment size calculation */
 static const int fragment_divisor[] = {
@@ -595,10 +633,52 @@ static int set_sound_emulation_enabled_on_warp(int value, void *param)
 {
     int val = value ? 1 : 0;
 
+    /* the synthesis thread reads it, see sound_set_warp_mode() */
+    synth_sync();
     sound_emulation_enabled_on_warp = val;
     return 0;
 }
 
+static int set_synth_thread_enabled(int value, void *param)
+{
+    int val = value ? 1 : 0;
+
+#ifndef USE_VICE_THREAD
+    if (val) {
+        log_warning(LOG_DEFAULT, "SoundSynthThread: this build has no thread support, running the sound chips on the emulation thread.");
+        val = 0;
+    }
+#endif
+
+    if (synth_thread_enabled != val) {
+        synth_thread_enabled = val;
+        sound_state_changed = TRUE;
+    }
+    return 0;
+}
+
+static int set_record_thread_enabled(int value, void *param)
+{
+    int val = value ? 1 : 0;
+
+    if (record_thread_enabled != val) {
+        record_thread_enabled = val;
+        sound_state_changed = TRUE;
+    }
+    return 0;
+}
+
+static int set_adaptive_sync_enabled(int value, void *param)
+{
+    int val = value ? 1 : 0;
+
+    if (adaptive_sync_enabled != val) {
+        adaptive_sync_enabled = val;
+        sound_state_changed = TRUE;
+    }
+    return 0;
+}
+
 static int set_playback_enabled(int value, void *param)
 {
     int val = value ? 1 : 0;
@@ -732,6 +812,12 @@ static const resource_int_t resources_int[] = {
       (void *)&output_option, set_output_option, NULL },
     { "SoundEmulateOnWarp", 1, RES_EVENT_NO, NULL,
       (void *)&sound_emulation_enabled_on_warp, set_sound_emulation_enabled_on_warp, NULL },
+    { "SoundSynthThread", 0, RES_EVENT_NO, NULL,
+      (void *)&synth_thread_enabled, set_synth_thread_enabled, NULL },
+    { "SoundRecordThread", 1, RES_EVENT_NO, NULL,
+      (void *)&record_thread_enabled, set_record_thread_enabled, NULL },
+    { "SoundAdaptiveSync", 0, RES_EVENT_NO, NULL,
+      (void *)&adaptive_sync_enabled, set_adaptive_sync_enabled, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -792,6 +878,24 @@ static const cmdline_option_t cmdline_options[] =
     { "-soundwarpmode", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
       NULL, NULL, "SoundEmulateOnWarp", NULL,
       "<mode>", "Specify how to handle sound emulation in warp mode: (0: do not emulate the sound chips, 1: keep emulating the sound chips)" },
+    { "-soundsynththread", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "SoundSynthThread", (resource_value_t)1,
+      NULL, "Run the sound chips on a separate thread" },
+    { "+soundsynththread", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "SoundSynthThread", (resource_value_t)0,
+      NULL, "Run the sound chips on the emulation thread" },
+    { "-soundrecthread", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "SoundRecordThread", (resource_value_t)1,
+      NULL, "Encode sound recordings on a separate thread" },
+    { "+soundrecthread", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "SoundRecordThread", (resource_value_t)0,
+      NULL, "Encode sound recordings on the emulation thread" },
+    { "-soundadaptivesync", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "SoundAdaptiveSync", (resource_value_t)1,
+      NULL, "Keep the sound device buffer filled by adjusting the sample rate slightly, instead of blocking on the device" },
+    { "+soundadaptivesync", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "SoundAdaptiveSync", (resource_value_t)0,
+      NULL, "Sync the emulation by blocking on the sound device" },
     CMDLINE_LIST_END
 };
 
@@ -916,6 +1020,9 @@ static double speed_percent;
 /* Flag: Is warp mode enabled?  */
 static int warp_mode_enabled;
 
+/* Flag: Does the recording get the samples of warp mode?  */
+static int warp_mode_record;
+
 /* device registration code */
 #define MAX_SOUND_DEVICES 24
 
@@ -1095,6 +1202,7 @@ static void sid_close(void)
 
 sound_t *sound_get_psid(unsigned int channel)
 {
+    synth_sync();
     return snddata.psid[channel];
 }
 
@@ -1259,16 +1367,30 @@ int sound_open(void)
         sound_is_timing_source = pdev->is_timing_source ? TRUE : FALSE;
         sid_state_changed = FALSE;
 
+        snddata.adaptive_fill = snddata.bufsize / 2;
+        snddata.adaptive_pos = 0.0;
+        for (c = 0; c < snddata.sound_output_channels; c++) {
+            snddata.adaptive_prev[c] = 0;
+        }
+
         /* Fill up the sound hardware buffer. */
         if (pdev->bufferspace) {
-            /* Fill to bufsize - fragsize. */
-            j = pdev->bufferspace() - snddata.fragsize;
+            /* Fill to bufsize - fragsize, with adaptive sync to the level
+               it is kept at. */
+            if (adaptive_sync_enabled) {
+                j = pdev->bufferspace() - snddata.bufsize / 2;
+            } else {
+                j = pdev->bufferspace() - snddata.fragsize;
+            }
             if (j > 0) {
                 /* Whole fragments. */
                 j -= j % snddata.fragsize;
 
                 fill_buffer(j, 0);
             }
+        } else if (adaptive_sync_enabled) {
+            log_warning(sound_log, "Device `%s' doesn't report its buffer fill level, not using adaptive sync.",
+                        pdev->name);
         }
     } else {
         err = lib_msprintf("device '%s' not found or not supported.", playname);
@@ -1300,6 +1422,9 @@ int sound_open(void)
 
         if (rdev->bufferspace != NULL) {
             ui_error("Warning! Recording device %s seems to be a realtime device!", recname);
+        } else if (record_thread_enabled && !rdev->is_synchronous) {
+            /* keep the encoding off the emulation thread */
+            rdev = soundasync_wrap(rdev);
         }
 
         if (rdev->init) {
@@ -1323,6 +1448,8 @@ int sound_open(void)
             }
         }
     }
+
+    synth_start();
     return 0;
 }
 
@@ -1340,6 +1467,8 @@ static void sounddev_close(const sound_device_t **dev)
 /* close sid */
 void sound_close(void)
 {
+    synth_stop();
+
     sounddev_close(&snddata.playdev);
     sounddev_close(&snddata.recdev);
     sid_close();
@@ -1367,34 +1496,23 @@ void sound_close(void)
     vsync_suspend_speed_eval();
 }
 
-/* run sid */
-static int sound_run_sound(void)
+/* run the sound chips up to clk, adding the samples to the buffer */
+static void sound_synthesize(CLOCK clk)
 {
     int nr = 0;
     int i;
     CLOCK delta_t = 0;
     int16_t *bufferptr;
 
-    if (!playback_enabled) {
-        return 1;
-    }
-
-    if (!snddata.playdev) {
-        i = sound_open();
-        if (i) {
-            return i;
-        }
-    }
-
     /* if "disable sound emulation on warp" is enabled, exit */
     if ((sound_emulation_enabled_on_warp == 0) && warp_mode_enabled) {
-        snddata.lastclk = maincpu_clk;
-        return 0;
+        snddata.lastclk = clk;
+        return;
     }
 
     /* Handling of cycle based sound engines. */
     if (cycle_based) {
-        delta_t = maincpu_clk - snddata.lastclk;
+        delta_t = clk - snddata.lastclk;
         bufferptr = snddata.buffer + snddata.bufptr * snddata.sound_output_channels;
         nr = sound_machine_calculate_samples(snddata.psid,
                                              bufferptr,
@@ -1405,7 +1523,7 @@ static int sound_run_sound(void)
         if (delta_t && !archdep_is_exiting()) {
 #if 0
             sound_error_log_only("Sound buffer overflow (cycle based)");
-            return -1;
+            return;
 #else
             if (overflow_warning_count < 25) {
                 log_warning(sound_log, "%s", "Sound buffer overflow (cycle based)");
@@ -1420,10 +1538,10 @@ static int sound_run_sound(void)
         }
      } else {
          /* Handling of sample based sound engines. */
-         nr = (int)((SOUNDCLK_CONSTANT(maincpu_clk) - snddata.fclk)
+         nr = (int)((SOUNDCLK_CONSTANT(clk) - snddata.fclk)
                     / snddata.clkstep);
          if (!nr) {
-             return 0;
+             return;
          }
          if (nr > snddata.bufsize - snddata.bufptr) {
              nr = snddata.bufsize - snddata.bufptr;
@@ -1449,8 +1567,219 @@ static int sound_run_sound(void)
      }
 
     snddata.bufptr += nr;
-    snddata.lastclk = maincpu_clk;
+    snddata.lastclk = clk;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Synthesis thread
+ *
+ * With SoundSynthThread enabled, sound_store() does not run the sound chips
+ * up to the write itself. It only queues the write with its clock, and the
+ * synthesis thread runs the chips up to that clock and applies it, while the
+ * emulation goes on. Everything else that needs the chips or the sample
+ * buffer (flushing, snapshots, ...) first waits for the thread to catch up
+ * with maincpu_clk, see synth_sync().
+ *
+ * Register reads would have to wait as well, and tunes poll OSC3/ENV3 a lot.
+ * Sound chips that can, keep a shadow copy on the emulation thread which
+ * gets the writes too, and answer reads from that, see sound_read().
+ *
+ * The thread reads warp_mode_enabled and sound_emulation_enabled_on_warp
+ * in sound_synthesize(). They are only changed while it is idle, after a
+ * synth_sync(), and it picks the new values up with synth_lock.
+ */
+
+#ifdef USE_VICE_THREAD
+
+/** \brief  Size of the register write queue, must be a power of two
+ */
+#define SYNTH_QUEUE_SIZE    16384
+
+/** \brief  A register write for the synthesis thread
+ */
+typedef struct synth_write_s {
+    CLOCK clk;          /**< clock of the write */
+    uint16_t addr;      /**< register, like passed to sound_store() */
+    uint8_t val;        /**< value written */
+    uint8_t chipno;     /**< sound chip instance */
+} synth_write_t;
+
+static pthread_mutex_t synth_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t synth_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t synth_done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t synth_thread;
+
+static synth_write_t synth_queue[SYNTH_QUEUE_SIZE];
+static unsigned int synth_head = 0;     /* next entry to fill */
+static unsigned int synth_tail = 0;     /* next entry to apply */
+
+static CLOCK synth_target_clk = 0;      /* run the chips up to here ... */
+static bool synth_target_pending = false;   /* ... when this is set */
+static bool synth_idle = false;         /* waiting for work */
+static bool synth_quit = false;
+static bool synth_running = false;
+
+static void *synth_thread_main(void *unused)
+{
+    pthread_mutex_lock(&synth_lock);
+
+    while (!synth_quit) {
+        unsigned int head = synth_head;
+        unsigned int tail = synth_tail;
+
+        if (tail != head) {
+            /* the emulation thread only adds entries after head, so the
+               ones up to it can be applied without holding the lock */
+            pthread_mutex_unlock(&synth_lock);
+            while (tail != head) {
+                synth_write_t *w = &synth_queue[tail & (SYNTH_QUEUE_SIZE - 1)];
+
+                sound_synthesize(w->clk);
+                sound_machine_store(snddata.psid[w->chipno], w->addr, w->val);
+                tail++;
+            }
+            pthread_mutex_lock(&synth_lock);
+            synth_tail = tail;
+            pthread_cond_broadcast(&synth_done_cond);
+        } else if (synth_target_pending) {
+            CLOCK clk = synth_target_clk;
+
+            pthread_mutex_unlock(&synth_lock);
+            sound_synthesize(clk);
+            pthread_mutex_lock(&synth_lock);
+            if (synth_target_clk == clk) {
+                synth_target_pending = false;
+            }
+        } else {
+            synth_idle = true;
+            pthread_cond_broadcast(&synth_done_cond);
+            pthread_cond_wait(&synth_work_cond, &synth_lock);
+            synth_idle = false;
+        }
+    }
 
+    pthread_mutex_unlock(&synth_lock);
+    return NULL;
+}
+
+/* queue a register write, waits if the queue is full */
+static void synth_queue_store(uint16_t addr, uint8_t val, int chipno)
+{
+    synth_write_t *w;
+
+    pthread_mutex_lock(&synth_lock);
+    while (synth_head - synth_tail >= SYNTH_QUEUE_SIZE) {
+        pthread_cond_signal(&synth_work_cond);
+        pthread_cond_wait(&synth_done_cond, &synth_lock);
+    }
+    w = &synth_queue[synth_head & (SYNTH_QUEUE_SIZE - 1)];
+    w->clk = maincpu_clk;
+    w->addr = addr;
+    w->val = val;
+    w->chipno = (uint8_t)chipno;
+    synth_head++;
+    if (synth_idle) {
+        pthread_cond_signal(&synth_work_cond);
+    }
+    pthread_mutex_unlock(&synth_lock);
+}
+
+/* wait until the synthesis thread has run the chips up to maincpu_clk, it
+   is idle afterwards until the next sound_store() */
+static void synth_sync(void)
+{
+    if (!synth_running) {
+        return;
+    }
+
+    pthread_mutex_lock(&synth_lock);
+    synth_target_clk = maincpu_clk;
+    synth_target_pending = true;
+    pthread_cond_signal(&synth_work_cond);
+    while (synth_tail != synth_head || synth_target_pending || !synth_idle) {
+        pthread_cond_wait(&synth_done_cond, &synth_lock);
+    }
+    pthread_mutex_unlock(&synth_lock);
+}
+
+static void synth_start(void)
+{
+    if (synth_running || !synth_thread_enabled) {
+        return;
+    }
+
+    synth_head = synth_tail = 0;
+    synth_target_pending = false;
+    synth_idle = false;
+    synth_quit = false;
+    if (pthread_create(&synth_thread, NULL, synth_thread_main, NULL) != 0) {
+        log_error(sound_log, "Cannot start the sound synthesis thread.");
+        return;
+    }
+    synth_running = true;
+    log_message(sound_log, "Running the sound chips on a separate thread.");
+}
+
+static void synth_stop(void)
+{
+    if (!synth_running) {
+        return;
+    }
+
+    synth_sync();
+
+    pthread_mutex_lock(&synth_lock);
+    synth_quit = true;
+    pthread_cond_signal(&synth_work_cond);
+    pthread_mutex_unlock(&synth_lock);
+    pthread_join(synth_thread, NULL);
+    synth_running = false;
+}
+
+#else /* USE_VICE_THREAD */
+
+static void synth_sync(void)
+{
+}
+
+static void synth_start(void)
+{
+}
+
+static void synth_stop(void)
+{
+}
+
+#endif /* USE_VICE_THREAD */
+
+/* ------------------------------------------------------------------------- */
+
+/* run sid */
+static int sound_run_sound(void)
+{
+    int i;
+
+    if (!playback_enabled) {
+        return 1;
+    }
+
+    if (!snddata.playdev) {
+        i = sound_open();
+        if (i) {
+            return i;
+        }
+    }
+
+#ifdef USE_VICE_THREAD
+    if (synth_running) {
+        synth_sync();
+        return 0;
+    }
+#endif
+
+    sound_synthesize(maincpu_clk);
     return 0;
 }
 
@@ -1459,6 +1788,8 @@ void sound_reset(void)
 {
     int c;
 
+    synth_sync();
+
     snddata.fclk = SOUNDCLK_CONSTANT(maincpu_clk);
     snddata.wclk = maincpu_clk;
     snddata.lastclk = maincpu_clk;
@@ -1470,6 +1801,96 @@ void sound_reset(void)
     }
 }
 
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Adaptive sync
+ *
+ * Instead of blocking on the sound device, the emulation is timed by the
+ * host clock like with a device that is no timing source. The device clock
+ * drifts away from that, so every flush is resampled by a ratio slightly
+ * off 1, which moves the fill level of the device buffer towards half its
+ * size. This keeps small buffers from running empty or full.
+ */
+
+/** \brief  Maximum deviation of the resampling ratio from 1
+ */
+#define SOUND_ADAPTIVE_MAX_DEVIATION    0.005
+
+/** \brief  Number of flushes the measured fill level is smoothed over
+ */
+#define SOUND_ADAPTIVE_SMOOTHING        8.0
+
+/* adaptive sync needs a device that reports its fill level */
+static int sound_adaptive_active(void)
+{
+    return adaptive_sync_enabled
+           && snddata.playdev != NULL
+           && snddata.playdev->bufferspace != NULL;
+}
+
+/* write nr samples of the buffer to the playback device, resampled to keep
+   its fill level near the target */
+static int sound_adaptive_write(int nr)
+{
+    int channels = snddata.sound_output_channels;
+    double target = snddata.bufsize / 2;
+    double ratio, step, pos;
+    int space, out, c;
+    int16_t *p;
+
+    space = snddata.playdev->bufferspace();
+    snddata.adaptive_fill += (snddata.bufsize - space - snddata.adaptive_fill)
+                             / SOUND_ADAPTIVE_SMOOTHING;
+
+    /* less than the target in the buffer: make more samples */
+    ratio = 1.0 + SOUND_ADAPTIVE_MAX_DEVIATION
+                  * (target - snddata.adaptive_fill) / target;
+    if (ratio > 1.0 + SOUND_ADAPTIVE_MAX_DEVIATION) {
+        ratio = 1.0 + SOUND_ADAPTIVE_MAX_DEVIATION;
+    } else if (ratio < 1.0 - SOUND_ADAPTIVE_MAX_DEVIATION) {
+        ratio = 1.0 - SOUND_ADAPTIVE_MAX_DEVIATION;
+    }
+    step = 1.0 / ratio;
+
+    p = realloc_buffer((int)((nr * ratio + 2) * channels * sizeof(int16_t)));
+    if (!p) {
+        return -1;
+    }
+
+    /* linear interpolation between frame i and i + 1, so only up to the
+       last frame but one. A position from there on is carried over, and
+       interpolated from adaptive_prev in the next flush (pos >= -1) */
+    out = 0;
+    for (pos = snddata.adaptive_pos; pos < nr - 1; pos += step) {
+        int i = (int)(pos + 1.0) - 1;
+        double frac = pos - i;
+
+        for (c = 0; c < channels; c++) {
+            int a = (i < 0) ? snddata.adaptive_prev[c] : snddata.buffer[i * channels + c];
+            int b = snddata.buffer[(i + 1) * channels + c];
+
+            p[out * channels + c] = (int16_t)(a + (b - a) * frac);
+        }
+        out++;
+    }
+    snddata.adaptive_pos = pos - nr;
+    for (c = 0; c < channels; c++) {
+        snddata.adaptive_prev[c] = snddata.buffer[(nr - 1) * channels + c];
+    }
+
+    /* never block, what doesn't fit is dropped (only happens if the
+       emulation stalled) */
+    if (out > space) {
+        out = space;
+    }
+    if (out > 0 && snddata.playdev->write(p, out * channels)) {
+        sound_error("write to sound device failed.");
+        return -1;
+    }
+    return 0;
+}
+
 /* flush all generated samples from buffer to sounddevice. */
 bool sound_flush(void)
 {
@@ -1558,19 +1979,56 @@ bool sound_flush(void)
     }
 #endif
 
-    /* Calculate the number of samples to flush - whole fragments. */
-    nr = snddata.bufptr - snddata.bufptr % snddata.fragsize;
+    if (sound_adaptive_active()) {
+        /* The samples get resampled anyway, flush all of them. */
+        nr = snddata.bufptr;
+    } else {
+        /* Calculate the number of samples to flush - whole fragments. */
+        nr = snddata.bufptr - snddata.bufptr % snddata.fragsize;
+    }
     if (!nr) {
         goto done;
     }
 
+    if (sound_adaptive_active() && !warp_mode_enabled) {
+        mainlock_yield_begin();
+
+        if (sound_adaptive_write(nr) < 0) {
+            mainlock_yield_end();
+            goto done;
+        }
+
+        if (snddata.recdev) {
+            if (snddata.recdev->write(snddata.buffer, nr * snddata.sound_output_channels)) {
+                sound_error("write to sound device failed.");
+
+                mainlock_yield_end();
+                goto done;
+            }
+        }
+
+        mainlock_yield_end();
+    } else if (warp_mode_enabled && warp_mode_record && snddata.recdev) {
+        /* Nothing is played in warp mode, but the recording gets all of it. */
+        mainlock_yield_begin();
+
+        if (snddata.recdev->write(snddata.buffer, nr * snddata.sound_output_channels)) {
+            sound_error("write to sound device failed.");
+
+            mainlock_yield_end();
+            goto done;
+        }
+
+        mainlock_yield_end();
+    }
+
     /*
      * At this point we have to block until we have written at least one fragment.
      *
      * The 'push against the audio device' sync method depends on this.
      */
 
-    while (!warp_mode_enabled) {
+    while (!warp_mode_enabled && !sound_adaptive_active()) {
 
         if (snddata.playdev->bufferspace) {
             space = snddata.playdev->bufferspace();
@@ -1633,10 +2091,11 @@ done:
 
     /*
      * If the sound device is not a timing source, then we need
-     * the host to sleep to sync time with the emulator.
+     * the host to sleep to sync time with the emulator. The same
+     * goes for adaptive sync.
      */
 
-    return !sound_is_timing_source;
+    return !sound_is_timing_source || sound_adaptive_active();
 }
 
 /* suspend sid (eg. before pause) */
@@ -1748,12 +2207,25 @@ int sound_dump(int chipno)
     if (chipno >= snddata.sound_chip_channels) {
         return -1;
     }
+    synth_sync();
     mon_out("%s\n", sound_machine_dump_state(snddata.psid[chipno]));
     return 0;
 }
 
 int sound_read(uint16_t addr, int chipno)
 {
+#ifdef USE_VICE_THREAD
+    if (synth_running && playback_enabled && chipno < snddata.sound_chip_channels) {
+        /* no need to wait for the synthesis thread if the shadow chip can
+           answer */
+        int value = sound_machine_shadow_read(snddata.psid[chipno], addr, maincpu_clk);
+
+        if (value >= 0) {
+            return value;
+        }
+    }
+#endif
+
     if (sound_run_sound()) {
         return -1;
     }
@@ -1769,16 +2241,28 @@ void sound_store(uint16_t addr, uint8_t val, int chipno)
 {
     int i;
 
-    if (sound_run_sound()) {
-        return;
-    }
+#ifdef USE_VICE_THREAD
+    if (synth_running) {
+        if (!playback_enabled || chipno >= snddata.sound_chip_channels) {
+            return;
+        }
+        /* the synthesis thread gets to it, the shadow chip right away */
+        sound_machine_shadow_store(snddata.psid[chipno], addr, val, maincpu_clk);
+        synth_queue_store(addr, val, chipno);
+    } else
+#endif
+    {
+        if (sound_run_sound()) {
+            return;
+        }
 
-    if (chipno >= snddata.sound_chip_channels) {
-        return;
-    }
+        if (chipno >= snddata.sound_chip_channels) {
+            return;
+        }
 
-    /* perform the actual write to the sound chip */
-    sound_machine_store(snddata.psid[chipno], addr, val);
+        /* perform the actual write to the sound chip */
+        sound_machine_store(snddata.psid[chipno], addr, val);
+    }
 
     /* now check if we have a "dump" method (which dumps the details of the
        write access to a file), and if so, call it */
@@ -1818,6 +2302,9 @@ void sound_set_relative_speed(int value)
 
 void sound_set_warp_mode(int value)
 {
+    /* let the synthesis thread finish the writes made before the switch,
+       it is idle until the next one */
+    synth_sync();
     warp_mode_enabled = value;
 
     if (value) {
@@ -1827,6 +2314,13 @@ void sound_set_warp_mode(int value)
     }
 }
 
+/* Let the recording device get the samples generated in warp mode.  Off by
+   default, a recording then leaves out what was skipped in warp mode.  */
+void sound_set_warp_mode_record(int value)
+{
+    warp_mode_record = value;
+}
+
 void sound_snapshot_prepare(void)
 {
     /* Update lastclk.  */
@@ -1835,6 +2329,7 @@ void sound_snapshot_prepare(void)
 
 void sound_snapshot_finish(void)
 {
+    synth_sync();
     snddata.lastclk = maincpu_clk;
 }
 
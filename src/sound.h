@@ -206,6 +206,8 @@ typedef struct sound_device_s {
     int max_channels;
     /* Can this device be relied on as the emulator timing source */
     bool is_timing_source;
+    /* must be written on the emulation thread, never through the record thread */
+    bool is_synchronous;
 } sound_device_t;
 
 typedef struct sound_register_devices_s {
@@ -256,6 +258,7 @@ int sound_open(void);
 void sound_close(void);
 void sound_set_relative_speed(int value);
 void sound_set_warp_mode(int value);
+void sound_set_warp_mode_record(int value);
 void sound_set_machine_parameter(long clock_rate, long ticks_per_frame);
 void sound_snapshot_prepare(void);
 void sound_snapshot_finish(void);
@@ -290,6 +293,9 @@ int sound_init_pulse_device(void);
 /* internal function for sound device registration */
 int sound_register_device(const sound_device_t *pdevice);
 
+/* runs a recording device on its own thread, see soundasync.c */
+const sound_device_t *soundasync_wrap(const sound_device_t *device);
+
 /* other internal functions used around sound -code */
 int sound_read(uint16_t addr, int chipno);
 void sound_store(uint16_t addr, uint8_t val, int chipno);
@@ -345,6 +351,13 @@ typedef struct sound_chip_s {
     /* sound chip read function */
     uint8_t (*read)(sound_t *psid, uint16_t addr);
 
+    /* sound chip shadow read function, answers a read at clk without the
+       chip having run up to it, returns -1 if it cannot */
+    int (*shadow_read)(sound_t *psid, uint16_t addr, CLOCK clk);
+
+    /* sound chip shadow store function, keeps the shadow read in step */
+    void (*shadow_store)(sound_t *psid, uint16_t addr, uint8_t val, CLOCK clk);
+
     /* sound chip reset function */
     void (*reset)(sound_t *psid, CLOCK cpu_clk);
 
@@ -0,0 +1,127 @@
+/*
+ * startuptrace.c - Timing of the startup phases.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/*
+ * With -startuptrace, the time spent in each phase of the startup and the
+ * number of system files looked up in it are logged once the emulator is
+ * ready to run. The phases are marked in main.c and init.c.
+ */
+
+#include "vice.h"
+
+#include "archdep.h"
+#include "log.h"
+#include "startuptrace.h"
+
+#define STARTUPTRACE_MAX_PHASES 32
+
+typedef struct startuptrace_phase_s {
+    const char *name;
+    tick_t time;                /* duration in ticks */
+    unsigned int sysfiles;      /* system file lookups */
+} startuptrace_phase_t;
+
+static int enabled = 0;
+static int started = 0;
+static tick_t phase_start;
+static unsigned int sysfile_count = 0;
+static unsigned int num_phases = 0;
+static startuptrace_phase_t phases[STARTUPTRACE_MAX_PHASES];
+
+/** \brief  Enable the startup trace, can be called before the log is set up
+ */
+void startuptrace_enable(void)
+{
+    enabled = 1;
+}
+
+/** \brief  Start timing the first phase
+ *
+ * Must be called after tick_init().
+ */
+void startuptrace_start(void)
+{
+    if (!enabled) {
+        return;
+    }
+    started = 1;
+    phase_start = tick_now();
+    sysfile_count = 0;
+}
+
+/** \brief  End the current phase and start the next one
+ *
+ * \param[in]   name    name of the phase that ends, must be a static string
+ */
+void startuptrace_phase(const char *name)
+{
+    tick_t now;
+
+    if (!started || num_phases >= STARTUPTRACE_MAX_PHASES) {
+        return;
+    }
+    now = tick_now();
+    phases[num_phases].name = name;
+    phases[num_phases].time = now - phase_start;
+    phases[num_phases].sysfiles = sysfile_count;
+    num_phases++;
+
+    /* don't count the time taken here */
+    phase_start = tick_now();
+    sysfile_count = 0;
+}
+
+/** \brief  Count a lookup of a system file in the current phase
+ */
+void startuptrace_count_sysfile(void)
+{
+    sysfile_count++;
+}
+
+/** \brief  Log the phases and stop tracing
+ */
+void startuptrace_report(void)
+{
+    unsigned int i;
+    tick_t total = 0;
+    unsigned int total_sysfiles = 0;
+
+    if (!started) {
+        return;
+    }
+
+    log_message(LOG_DEFAULT, "Startup trace:");
+    for (i = 0; i < num_phases; i++) {
+        log_message(LOG_DEFAULT, "  %-24s %9.3f ms  %3u system files",
+                    phases[i].name,
+                    (double)phases[i].time * 1000.0 / tick_per_second(),
+                    phases[i].sysfiles);
+        total += phases[i].time;
+        total_sysfiles += phases[i].sysfiles;
+    }
+    log_message(LOG_DEFAULT, "  %-24s %9.3f ms  %3u system files", "total",
+                (double)total * 1000.0 / tick_per_second(), total_sysfiles);
+
+    started = 0;
+    enabled = 0;
+}
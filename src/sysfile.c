@@ -36,6 +36,8 @@
 #include "lib.h"
 #include "log.h"
 #include "resources.h"
+#include "rombundle.h"
+#include "startuptrace.h"
 #include "sysfile.h"
 #include "util.h"
 
@@ -54,6 +56,7 @@ static log_t sysfile_log = LOG_DEFAULT;
 static char *default_path = NULL;
 static char *system_path = NULL;
 static char *expanded_system_path = NULL;
+static char *rom_bundle = NULL;
 
 static int set_system_path(const char *val, void *param)
 {
@@ -120,19 +123,45 @@ const char *get_system_path(void)
     return expanded_system_path;
 }
 
+static int set_rom_bundle(const char *val, void *param)
+{
+    if (val != NULL && *val != '\0') {
+        if (rombundle_open(val) < 0) {
+            return -1;
+        }
+    } else {
+        rombundle_close();
+    }
+    util_string_set(&rom_bundle, val);
+    return 0;
+}
+
 static const resource_string_t resources_string[] = {
     { "Directory", "$$", RES_EVENT_NO, NULL,
       &system_path, set_system_path, NULL },
+    { "ROMBundle", "", RES_EVENT_NO, NULL,
+      &rom_bundle, set_rom_bundle, NULL },
     RESOURCE_STRING_LIST_END
 };
 
 /* Command-line options.  */
 
+static int cmdline_rom_bundle_create(const char *param, void *extra_param)
+{
+    return rombundle_create(param, expanded_system_path);
+}
+
 static const cmdline_option_t cmdline_options[] =
 {
     { "-directory", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
       NULL, NULL, "Directory", NULL,
       "<Path>", "Define search path to locate system files" },
+    { "-rombundle", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "ROMBundle", NULL,
+      "<File>", "Load system files from the given ROM bundle" },
+    { "-rombundlecreate", CALL_FUNCTION, CMDLINE_ATTRIB_NEED_ARGS,
+      cmdline_rom_bundle_create, NULL, NULL, NULL,
+      "<File>", "Create a ROM bundle from the system file search path" },
     CMDLINE_LIST_END
 };
 
@@ -153,6 +182,7 @@ int sysfile_init(const char *emu_id)
 
 void sysfile_shutdown(void)
 {
+    rombundle_close();
     lib_free(default_path);
     lib_free(expanded_system_path);
 }
@@ -165,6 +195,7 @@ int sysfile_resources_init(void)
 void sysfile_resources_shutdown(void)
 {
     lib_free(system_path);
+    lib_free(rom_bundle);
 }
 
 int sysfile_cmdline_options_init(void)
@@ -188,6 +219,8 @@ FILE *sysfile_open(const char *name, const char *subpath, char **complete_path_r
         return NULL;
     }
 
+    startuptrace_count_sysfile();
+
     /*
      * name      - filename or command we are looking for in the resulting path
      * expanded_system_path  - list of search path(es), separated by target specific separator
@@ -226,11 +259,81 @@ FILE *sysfile_open(const char *name, const char *subpath, char **complete_path_r
     }
 }
 
+/* Look up a system file in the ROM bundle, names with a directory are
+   always taken from the file system.  */
+static int sysfile_in_bundle(const char *name, const char *subpath,
+                             const uint8_t **data, size_t *size)
+{
+    const uint8_t *d;
+    size_t s;
+
+    if (name == NULL || *name == '\0' || strchr(name, '/') != NULL
+        || strchr(name, ARCHDEP_DIR_SEP_CHR) != NULL) {
+        return 0;
+    }
+    if (rombundle_find(name, subpath, &d, &s) < 0) {
+        return 0;
+    }
+    startuptrace_count_sysfile();
+    if (data != NULL) {
+        *data = d;
+        *size = s;
+    }
+    return 1;
+}
+
+/* As `sysfile_load', but copy the file from the ROM bundle.  */
+static int sysfile_load_from_bundle(const char *name, const char *subpath,
+                                    const uint8_t *data, size_t rsize,
+                                    uint8_t *dest, int minsize, int maxsize)
+{
+    int load_at_end;
+
+    log_message(sysfile_log, "Loading `%s/%s' from the ROM bundle.", subpath, name);
+
+    if (minsize < 0) {
+        minsize = -minsize;
+        load_at_end = 0;
+    } else {
+        load_at_end = 1;
+    }
+
+    if (rsize < ((size_t)minsize)) {
+        log_error(sysfile_log, "ROM %s: short file.", name);
+        return -1;
+    }
+    if (rsize == ((size_t)maxsize + 2)) {
+        log_warning(sysfile_log,
+                    "ROM `%s': two bytes too large - removing assumed "
+                    "start address.", name);
+        memcpy(dest, data, 2);
+        data += 2;
+        rsize -= 2;
+    }
+    if (load_at_end && rsize < ((size_t)maxsize)) {
+        dest += maxsize - rsize;
+    } else if (rsize > ((size_t)maxsize)) {
+        log_warning(sysfile_log,
+                    "ROM `%s': long file (%"PRI_SIZE_T"), discarding end (%"PRI_SIZE_T" bytes).",
+                    name, rsize, rsize - maxsize);
+        rsize = maxsize;
+    }
+    memcpy(dest, data, rsize);
+    return (int)rsize;
+}
+
 /* As `sysfile_open', but do not open the file.  Just return 0 if the file is
    found and is readable, or -1 if an error occurs.  */
 int sysfile_locate(const char *name, const char *subpath, char **complete_path_return)
 {
-    FILE *f = sysfile_open(name, subpath, complete_path_return, MODE_READ);
+    FILE *f;
+
+    /* callers that want the path need a real file */
+    if (complete_path_return == NULL && sysfile_in_bundle(name, subpath, NULL, NULL)) {
+        return 0;
+    }
+
+    f = sysfile_open(name, subpath, complete_path_return, MODE_READ);
 
     if (f != NULL) {
         fclose(f);
@@ -254,6 +357,12 @@ int sysfile_load(const char *name, const char *subpath, uint8_t *dest, int minsi
     off_t tmpsize;
     char *complete_path = NULL;
     int load_at_end;
+    const uint8_t *data;
+
+    if (sysfile_in_bundle(name, subpath, &data, &rsize)) {
+        return sysfile_load_from_bundle(name, subpath, data, rsize,
+                                        dest, minsize, maxsize);
+    }
 
     fp = sysfile_open(name, subpath, &complete_path, MODE_READ);
 
@@ -93,6 +93,8 @@ static sound_chip_t funmp3_sound_chip = {
     funmp3_sound_machine_calculate_samples, /* sound chip calculate samples function */
     NULL,                                   /* NO sound chip store function */
     NULL,                                   /* NO sound chip read function */
+    NULL,                                   /* NO sound chip shadow read function */
+    NULL,                                   /* NO sound chip shadow store function */
     funmp3_sound_reset,                     /* sound chip reset function */
     funmp3_sound_machine_cycle_based,       /* sound chip 'is_cycle_based()' function, sound chip is NOT cycle based */
     funmp3_sound_machine_channels,          /* sound chip 'get_amount_of_channels()' function, sound chip has 1 channel */
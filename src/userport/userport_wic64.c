@@ -67,6 +67,7 @@
 #include "snapshot.h"
 #include "userport.h"
 #include "userport_wic64.h"
+#include "userport_wic64_http.h"
 #include "machine.h"
 #include "uiapi.h"
 #include "lib.h"
@@ -115,6 +116,7 @@ static int wic64_set_resetuser(int val, void *param);
 static int wic64_set_hexdumplines(int val, void *param);
 
 static int wic64_set_remote_timeout(int val, void *param);
+static int wic64_set_cache_time(int val, void *param);
 static int wic64_cmdl_reset(const char *val, void *param);
 static void wic64_log(const char *col, const char *fmt, ...);
 static void debug_log(const char *col, const int lv, const char *fmt, ...);
@@ -158,7 +160,6 @@ static userport_device_t userport_wic64_device = {
 
 static struct alarm_s *http_get_alarm = NULL;
 static struct alarm_s *http_post_alarm = NULL;
-static struct alarm_s *http_post_endalarm = NULL;
 static struct alarm_s *tcp_get_alarm = NULL;
 static struct alarm_s *tcp_send_alarm = NULL;
 static struct alarm_s *cmd_timeout_alarm = NULL;
@@ -190,16 +191,14 @@ static int wic64_logenabled = 0;
 static int wic64_loglevel = 0;
 static int wic64_resetuser = 0;
 static int wic64_hexdumplines = 0;
+static int wic64_cache_time = 0; /* seconds to keep replies to GET requests */
 
 static char wic64_protocol = WIC64_PROT_UNKNOWN; /* invalid, so we see in trace even the legacy */
 static int big_load = 0;
 static char wic64_last_status[40]; /* according spec 40 bytes, hold status string. incl. \0 */
 static char *post_data = NULL;
 static size_t post_data_rcvd;
-static size_t post_data_new;
-static size_t post_data_size;
 static char *post_url = NULL;
-static int post_error;
 static int cheatlen = 0;
 
 /* ---------------------------------------------------------------------*/
@@ -342,6 +341,8 @@ static const resource_int_t wic64_resources_int[] = {
       &wic64_hexdumplines, wic64_set_hexdumplines, NULL },
     { "WIC64RemoteTimeout", WIC64_DEFAULT_REMOTE_TIMEOUT, RES_EVENT_NO, NULL,
       &wic64_remote_timeout, wic64_set_remote_timeout, NULL },
+    { "WIC64CacheTime", 0, RES_EVENT_NO, NULL,
+      &wic64_cache_time, wic64_set_cache_time, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -421,6 +422,9 @@ static const cmdline_option_t cmdline_options[] =
     { "-wic64remotetimeout", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
       NULL, NULL, "WIC64RemoteTimeout", NULL,
       "<value>", "Set WIC64 remote timeout (1 - 255)" },
+    { "-wic64cachetime", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "WIC64CacheTime", NULL,
+      "<seconds>", "Keep replies to WIC64 HTTP GET requests for <seconds> (0: disable cache)" },
     CMDLINE_LIST_END
 };
 
@@ -527,10 +531,6 @@ static char *encoded_helper = NULL;
 #endif
 #include <curl/curl.h>
 
-#define MAX_PARALLEL 1 /* number of simultaneous transfers */
-#define NUM_URLS 10
-static int still_alive = 0;
-static CURLM *cm = NULL;               /* used for http(s) */
 static CURL *curl = NULL;              /* used for telnet */
 static uint8_t curl_buf[240];          /* this slows down by smaller chunks sent to C64, improves BBSs  */
 static uint8_t *curl_send_buf = NULL;
@@ -570,12 +570,20 @@ static int userport_wic64_enable(int value)
         debug_log(CONS_COL_NO, 2, "%s: curl_send_buf allocated 0x%xkB", __FUNCTION__,
                    COMMANDBUFFER_MAXLEN / 1014);
 
+        if (wic64_http_init() < 0) {
+            log_error(wic64_loghandle, "Failed to start the HTTP engine.");
+        }
+        wic64_http_set_cache_time(wic64_cache_time);
+
         wic64_set_status("enabled");
         log_message(wic64_loghandle, "WiC64 enabled");
 
         prep_wic64_str();
         userport_wic64_reset();
     } else {
+        /* stop transfers into the buffers freed below */
+        wic64_http_shutdown();
+
         if (httpbuffer) {
             lib_free(httpbuffer);
             httpbuffer = NULL;
@@ -618,10 +626,6 @@ static int userport_wic64_enable(int value)
             alarm_destroy(http_post_alarm);
             http_post_alarm = NULL;
         }
-        if (http_post_endalarm) {
-            alarm_destroy(http_post_endalarm);
-            http_post_endalarm = NULL;
-        }
         if (tcp_get_alarm) {
             alarm_destroy(tcp_get_alarm);
             tcp_get_alarm = NULL;
@@ -776,6 +780,16 @@ static int wic64_set_remote_timeout(int val, void *param)
     return 0;
 }
 
+static int wic64_set_cache_time(int val, void *param)
+{
+    if (val < 0 || val > 86400) {
+        return -1;
+    }
+    wic64_cache_time = val;
+    wic64_http_set_cache_time(val);
+    return 0;
+}
+
 static int wic64_cmdl_reset(const char *val, void *param)
 {
     if (param == (void *)2) {
@@ -938,53 +952,16 @@ static void prep_wic64_str(void)
     cmd2string[WIC64_CMD_DEPRECATED_LEGACY_HTTP_POST_24] = "WIC64_CMD_DEPRECATED_LEGACY_HTTP_POST_24";
 }
 
-static size_t write_cb(char *data, size_t n, size_t l, void *userp)
-{
-    size_t tmp = httpbufferptr + n * l;
-    debug_log(CONS_COL_NO, 3, "%s, %dx%d bytes/size", __FUNCTION__, n, l);
-
-    if (tmp >= HTTPREPLY_MAXLEN) {
-        wic64_log(CONS_COL_NO, "libcurl reply too long, dropping %"PRI_SIZE_T" bytes.\n",
-                  tmp - HTTPREPLY_MAXLEN);
-        return CURLE_WRITE_ERROR;
-    }
-    memcpy(&httpbuffer[httpbufferptr], data, n * l);
-    httpbufferptr += (n * l);
-    return n*l;
-}
-
-static void add_transfer(CURLM *cmulti, char *url)
+/* user agent to send with HTTP requests */
+static const char *http_agent(void)
 {
-    CURL *eh = curl_easy_init();
-    if (wic64_loglevel > 1) {
-        curl_easy_setopt(eh, CURLOPT_VERBOSE, 1L);
-    } else {
-        curl_easy_setopt(eh, CURLOPT_VERBOSE, 0L);
-    }
-    curl_easy_setopt(eh, CURLOPT_WRITEFUNCTION, write_cb);
-    curl_easy_setopt(eh, CURLOPT_URL, url);
-    curl_easy_setopt(eh, CURLOPT_PRIVATE, url);
-    curl_easy_setopt(eh, CURLOPT_FOLLOWLOCATION, 1L);
-    /* need to decied if we want to ship a certificate file
-    curl_easy_setopt(eh, CURLOPT_CAINFO, PREFIX "/share/vice/etc/ca-bundle.crt");
-    curl_easy_setopt(eh, CURLOPT_CAPATH, PREFIX "/share/vice/etc/ca-bundle.crt");
-    */
-    curl_easy_setopt(eh, CURLOPT_SSL_VERIFYPEER, 0L);
-
-    /* work around bug 1964 (https://sourceforge.net/p/vice-emu/bugs/1964/) - maybe not needed anymore !*/
-#ifdef CURLSSLOPT_NATIVE_CA
-    curl_easy_setopt(eh, CURLOPT_SSL_OPTIONS, CURLSSLOPT_NATIVE_CA);
-#endif
-
     /* set USERAGENT: otherwise the server won't return data, e.g. wicradio */
     if (wic64_protocol == WIC64_PROT_LEGACY) {
         http_user_agent = HTTP_AGENT_LEGACY;
     } else {
         http_user_agent = HTTP_AGENT_REVISED;
     }
-    curl_easy_setopt(eh, CURLOPT_USERAGENT, http_user_agent);
-    curl_multi_add_handle(cmulti, eh);
-    curl_multi_poll(cm, NULL, 0, 1, NULL);
+    return http_user_agent;
 }
 
 static void update_prefs(uint8_t *buffer, size_t len)
@@ -1035,73 +1012,48 @@ static void update_prefs(uint8_t *buffer, size_t len)
 
 static void http_get_alarm_handler(CLOCK offset, void *data)
 {
-    CURLMsg *msg = NULL;
-    CURLMcode r;
-    int msgs_left = -1;
-    long response = -1;
-    char *url = "<unknown>";
-
-    still_alive = 0;
-    r = curl_multi_perform(cm, &still_alive);
-    if (r != CURLM_OK) {
-        wic64_log(CONS_COL_NO, "%s: curl_multi_perform failed: %s", __FUNCTION__, curl_multi_strerror(r));
-        msg = curl_multi_info_read(cm, &msgs_left);
-        if (msg) {
-            debug_log(LOG_COL_LRED, 2, "%s: msg: %u, %s", __FUNCTION__,
-                       msg->data.result, curl_easy_strerror(msg->data.result));
-            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &url);
-            debug_log(LOG_COL_LRED, 2, "%s, R: %u - %s <%s>", __FUNCTION__,
-                       msg->data.result, curl_easy_strerror(msg->data.result), url);
-        }
-        send_reply_revised(NETWORK_ERROR, "Failed to read HTTP response", NULL, 0, "!0"); /* maybe wrong here */
-        goto out;
-    }
-    debug_log(CONS_COL_NO, 3, "%s, running handles: %d, r = %d", __FUNCTION__, still_alive, r);
+    wic64_http_result_t res;
+    const char *url;
+    long response;
+    int state;
 
     if (wic64_remote_timeout_triggered) {
         debug_log(LOG_COL_LRED, 2, "Remote timout expired");
+        wic64_http_cancel();
         send_reply_revised(NETWORK_ERROR, "Remote timeout", NULL, 0, "!0");
         wic64_remote_timeout_triggered = 0;
         remote_to = wic64_remote_timeout;
-        msg = curl_multi_info_read(cm, &msgs_left); /* ensure all handles are freed when leaving below */
         goto out;
     }
 
-    if (still_alive) {
-        curl_multi_poll(cm, NULL, 0, 1, NULL);
+    state = wic64_http_poll(&res);
+    if (state == WIC64_HTTP_PENDING) {
         /* http request not yet finished */
         alarm_unset(http_get_alarm);
         alarm_set(http_get_alarm, maincpu_clk + (312 * 65));
         return;
     }
+    if (state != WIC64_HTTP_DONE) {
+        send_reply_revised(NETWORK_ERROR, "Failed to read HTTP response", NULL, 0, "!0");
+        goto out;
+    }
 
     alarm_unset(cmd_remote_timeout_alarm);
     remote_to = wic64_remote_timeout;
 
-    msg = curl_multi_info_read(cm, &msgs_left);
-    if (msgs_left > 0) {
-        wic64_log(LOG_COL_LRED, "%s, msgs_left: %d (>0! not handled), msg = %p", __FUNCTION__, msgs_left, msg);
-    }
-    if (msg) {
-        CURLcode res;
-        res = curl_easy_getinfo(msg->easy_handle,
-                                CURLINFO_RESPONSE_CODE,
-                                &response);
-        if (res != CURLE_OK) {
-            wic64_log(LOG_COL_LRED, "%s: curl_easy_getinfo(...&response failed: %s", __FUNCTION__,
-                      curl_easy_strerror(res));
-            send_reply_revised(NETWORK_ERROR, "Failed to read HTTP response", NULL, 0, "!0");
-            goto out;
-        }
-        res = curl_easy_getinfo(msg->easy_handle, CURLINFO_EFFECTIVE_URL, &url);
-        if (res != CURLE_OK) {
-            /* ignore problem, URL is only for debugging */
-            debug_log(CONS_COL_NO, 2, "%s: curl_easy_getinfo(...&URL failed: %s", __FUNCTION__,
-                      curl_easy_strerror(res));
-            url = "<unknown>";
-        }
-    } else {
-        wic64_log(LOG_COL_LRED, "%s, msgs_left: %d, msg = %p!", __FUNCTION__, msgs_left, msg);
+    url = res.url;
+    response = res.response;
+    httpbufferptr = res.len;
+    if (res.error != 0) {
+        debug_log(LOG_COL_LRED, 2, "%s, R: %d - %s <%s>", __FUNCTION__,
+                  res.error, res.error_string, url);
+    }
+    if (res.overflow) {
+        wic64_log(CONS_COL_NO, "libcurl reply too long, dropping bytes beyond %u.\n",
+                  HTTPREPLY_MAXLEN);
+    }
+    if (res.cached) {
+        debug_log(CONS_COL_NO, 2, "%s: reply from cache, URL: '%s'", __FUNCTION__, url);
     }
 
     if (response == 201) {
@@ -1114,7 +1066,7 @@ static void http_get_alarm_handler(CLOCK offset, void *data)
         wic64_log(CONS_COL_NO, "%s: got %lu bytes, URL: '%s', http code = %ld", __FUNCTION__,
                   httpbufferptr, url, response);
         if (wic64_protocol == WIC64_PROT_LEGACY) {
-            char *t;
+            const char *t;
             /* check weird .prg -> cheat length */
             t = strrchr(url, '.');
             if ((t != NULL) && (strcmp(t, ".prg") == 0)){
@@ -1144,13 +1096,6 @@ static void http_get_alarm_handler(CLOCK offset, void *data)
     }
 
   out:
-    if (msg) {
-        /* cleanup easy handly, fixes FD leak */
-        curl_multi_remove_handle(cm, msg->easy_handle);
-        curl_easy_cleanup(msg->easy_handle);
-    }
-    curl_multi_cleanup(cm);
-    curl_global_cleanup();
     alarm_unset(http_get_alarm);
     memset(httpbuffer, 0, httpbufferptr);
     big_load = 0;
@@ -1159,19 +1104,14 @@ static void http_get_alarm_handler(CLOCK offset, void *data)
 static void do_http_get(char *url)
 {
     cmd_remote_timeout(1);
-    cm = curl_multi_init();
-    if (!cm) {
+
+    httpbufferptr = 0;
+    if (wic64_http_get(url, http_agent(), wic64_loglevel > 1,
+                       httpbuffer, HTTPREPLY_MAXLEN) < 0) {
         send_reply_revised(CONNECTION_ERROR, "Can't send HTTP request", NULL, 0, "!0");
         return;
     }
 
-    /* Limit the amount of simultaneous connections curl should allow: */
-    curl_multi_setopt(cm, CURLMOPT_MAXCONNECTS, (long)MAX_PARALLEL);
-
-    still_alive = 1;
-    httpbufferptr = 0;
-    add_transfer(cm, url);
-
     if (http_get_alarm == NULL) {
         http_get_alarm = alarm_new(maincpu_alarm_context, "HTTPGetAlarm",
                                    http_get_alarm_handler, NULL);
@@ -1625,92 +1565,54 @@ static void cmd_http_get(void)
     do_http_get(url);
 }
 
-static void http_post_endalarm_handler(CLOCK offset, void *data)
-{
-    debug_log(CONS_COL_NO, 2, "http post endalarm triggered...");
-    send_reply_revised(SUCCESS, "Success", (uint8_t *)post_data, post_data_rcvd, NULL);
-    alarm_unset(http_post_endalarm);
-    alarm_unset(http_post_alarm);
-    lib_free(post_data);
-    post_data = NULL;
-    post_error = post_data_rcvd = post_data_new = 0;
-    debug_log(CONS_COL_NO, 2, "http post done");
-}
-
 static void http_post_alarm_handler(CLOCK offset, void *data)
 {
-    debug_log(CONS_COL_NO, 2, "%s: post_data_rcvd = %d, expected = %d",
-               __FUNCTION__, post_data_rcvd, post_data_size);
+    wic64_http_result_t res;
+    int state;
+
+    state = wic64_http_poll(&res);
+    if (state == WIC64_HTTP_PENDING) {
+        alarm_set(http_post_alarm, maincpu_clk + (312 * 65));
+        return;
+    }
+    if (state != WIC64_HTTP_DONE) {
+        send_reply_revised(NETWORK_ERROR, "Failed to send POST data to server", NULL, 0, "!0");
+        goto out;
+    }
+
+    post_data_rcvd = res.len;
+    debug_log(CONS_COL_NO, 2, "%s: post_data_rcvd = %d, http code = %ld",
+               __FUNCTION__, post_data_rcvd, res.response);
+    debug_hexdump(CONS_COL_NO, 2, post_data, (int)post_data_rcvd);
 
-    if (post_error) {
+    if (res.overflow) {
         send_reply_revised(SERVER_ERROR, "Server error",
                            (uint8_t *)post_data,
                            post_data_rcvd, NULL);
         goto out;
     }
-    if (post_data_rcvd >= post_data_size) { /* post_data_size is size_t so unsigned */
-        send_reply_revised(SUCCESS, "Success", (uint8_t *)post_data, post_data_rcvd, NULL);
+    if (res.error != 0) {
+        wic64_log(CONS_COL_NO, "perform failed: %s", res.error_string);
+        send_reply_revised(NETWORK_ERROR, "Failed to send POST data to server", NULL, 0, "!0");
         goto out;
     }
-    if (post_data_size == -1) {
+    if (!res.size_known && post_data_rcvd > 0xffff) {
         /* reply header didn't tell us the size, so read up to 64kB */
-        if (post_data_rcvd > 0xffff) {
-            send_reply_revised(SUCCESS, "Success", (uint8_t *)post_data, 0xffff, NULL);
-            goto out;
-        }
-        /* if new data has arrived, re-arm end-timeout */
-        if (post_data_new != post_data_rcvd) {
-            alarm_unset(http_post_endalarm);
-            /* reset alarm to 33% of wic64 timeout - should be fine in general */
-            alarm_set(http_post_endalarm,
-                      maincpu_clk + wic64_timeout * machine_get_cycles_per_second() / 3);
-            post_data_new = post_data_rcvd;
-        }
+        send_reply_revised(SUCCESS, "Success", (uint8_t *)post_data, 0xffff, NULL);
+        goto out;
     }
-    alarm_set(http_post_alarm, maincpu_clk +  machine_get_cycles_per_second() / 2);
-    return;
+    send_reply_revised(SUCCESS, "Success", (uint8_t *)post_data, post_data_rcvd, NULL);
 
 out:
-    alarm_unset(http_post_endalarm);
     alarm_unset(http_post_alarm);
     lib_free(post_data);
     post_data = NULL;
-    post_error = post_data_new = post_data_rcvd = 0;
+    post_data_rcvd = 0;
     debug_log(CONS_COL_NO, 2, "http post done");
 }
 
-static size_t post_write_func(char *buffer, size_t size, size_t nitems, void *userdata)
-{
-    CURLcode res;
-    curl_off_t cl;
-    size_t ret;
-
-    ret = size * nitems;
-    res = curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &cl);
-    debug_log(CONS_COL_NO, 2, "http_post returned %d/0x%x bytes, expected len = %d...", ret, ret, cl);
-    if (res != CURLE_OK) {
-        debug_log(CONS_COL_NO, 2, "post callback failed to read length");
-        post_error = 1;
-        goto out;
-    }
-    if ((post_data_rcvd + ret) > HTTPREPLY_MAXLEN) {
-        post_error = 1;
-        ret = HTTPREPLY_MAXLEN - post_data_rcvd;
-    }
-    memcpy(post_data + post_data_rcvd, buffer, ret);
-    post_data_rcvd += ret;
-    debug_hexdump(CONS_COL_NO, 2, buffer, (int)ret);
-  out:
-    post_data_size = (size_t) cl; /* if -1 => largest size_t, so unknown */
-    return ret;
-}
-
 static void cmd_http_post(int cmd)
 {
-    CURLcode res;
-    static curl_mime *mime;
-    static curl_mimepart *part;
-
     if (cmd == WIC64_CMD_HTTP_POST_URL) {
         if (post_url == NULL) {
             post_url = lib_malloc(URL_MAXLEN);
@@ -1727,61 +1629,21 @@ static void cmd_http_post(int cmd)
             return;
         }
 
-        if (!curl) {
-            curl = curl_easy_init();
-        }
-
-        if (wic64_loglevel > 1) {
-            curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-        } else {
-            curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
-        }
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        /* need to decied if we want to ship a certificate file
-           curl_easy_setopt(curl, CURLOPT_CAINFO, PREFIX "/share/vice/etc/ca-bundle.crt");
-           curl_easy_setopt(curl, CURLOPT_CAPATH, PREFIX "/share/vice/etc/ca-bundle.crt");
-        */
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-        res = curl_easy_setopt(curl, CURLOPT_USERAGENT, http_user_agent);
-        if (res != CURLE_OK) {
-            wic64_log(CONS_COL_NO, "curl set user agent failed: %s", curl_easy_strerror(res));
-            send_reply_revised(NETWORK_ERROR, "Failed to open connection", NULL, 0, "!0");
-            return;
+        /* first time prepare for receiving post resonses */
+        if (post_data == NULL) {
+            post_data = lib_malloc(HTTPREPLY_MAXLEN);
         }
-        curl_easy_setopt(curl, CURLOPT_URL, post_url);
-        res = curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, post_write_func);
-        if (res != CURLE_OK) {
-            wic64_log(CONS_COL_NO, "perform failed: %s", curl_easy_strerror(res));
+        post_data_rcvd = 0;
+        if (wic64_http_post(post_url, http_agent(), wic64_loglevel > 1,
+                            commandbuffer, commandptr,
+                            (uint8_t *)post_data, HTTPREPLY_MAXLEN) < 0) {
             send_reply_revised(NETWORK_ERROR, "Failed to open connection", NULL, 0, "!0");
             return;
         }
-        post_data_rcvd = post_data_new = post_error = 0;
-        post_data_size = HTTPREPLY_MAXLEN;
-        /* first time prepare for receiving post resonses */
-        post_data = lib_malloc(HTTPREPLY_MAXLEN);
-        if (!post_data) {
-            send_reply_revised(INTERNAL_ERROR, "Out of memory", NULL, 0, NULL);
-            return;
-        }
-        mime = curl_mime_init(curl);
-        part = curl_mime_addpart(mime);
-        curl_mime_data(part, (const char *) commandbuffer, (size_t) commandptr);
-        /* Build an HTTP form with a single field named "data", */
-        curl_mime_name(part, "data");
-        curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
-        res = curl_easy_perform(curl);
-        if (res != CURLE_OK) {
-            wic64_log(CONS_COL_NO, "perform failed: %s", curl_easy_strerror(res));
-            send_reply_revised(NETWORK_ERROR, "Failed to send POST data to server", NULL, 0, "!0");
-        }
         if (http_post_alarm == NULL) {
             http_post_alarm = alarm_new(maincpu_alarm_context, "HTTPPostAlarm",
                                         http_post_alarm_handler, NULL);
         }
-        if (http_post_endalarm == NULL) {
-            http_post_endalarm = alarm_new(maincpu_alarm_context, "HTTPPostAlarm",
-                                           http_post_endalarm_handler, NULL);
-        }
         alarm_unset(http_post_alarm);
         alarm_set(http_post_alarm, maincpu_clk + (312 * 65));
     }
@@ -1998,7 +1860,6 @@ static void tcp_get_alarm_handler(CLOCK offset, void *data)
     if ((res == CURLE_OK) && (nread == 0)) {
         /* connection closed */
         curl_easy_cleanup(curl);
-        curl_global_cleanup();
         alarm_unset(tcp_get_alarm);
         curl = NULL;
         wic64_log(CONS_COL_NO, "%s: connection closed", __FUNCTION__);
@@ -2096,7 +1957,6 @@ static void cmd_tcp_close(void)
     if (curl) {
         /* connection closed */
         curl_easy_cleanup(curl);
-        curl_global_cleanup();
         curl = NULL;
     }
     if (tcp_send_alarm) {
@@ -2687,9 +2547,7 @@ static void userport_wic64_reset(void)
     if (http_post_alarm) {
         alarm_unset(http_post_alarm);
     }
-    if (http_post_endalarm) {
-        alarm_unset(http_post_endalarm);
-    }
+    wic64_http_cancel();
     if (tcp_get_alarm) {
         alarm_unset(tcp_get_alarm);
     }
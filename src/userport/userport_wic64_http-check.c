@@ -0,0 +1,435 @@
+/*
+ * userport_wic64_http-check.c - Check the HTTP engine of the WiC64 against
+ *                               a local stand-in server.
+ *
+ * The checker runs a minimal HTTP server on a loopback port and sends its
+ * requests through the engine: cached and uncached GET replies, a reply
+ * that marks itself not cacheable, an error reply, a reply larger than the
+ * buffer, a POST, a refused connection and cancelling a request the server
+ * is slow to answer.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* the engine keeps its state in statics, so it is built into the checker */
+#include "userport_wic64_http.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(HAVE_LIBCURL) && !defined(WINDOWS_COMPILE)
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+/* how long a request may take before the check gives up, in milliseconds */
+#define CHECK_TIMEOUT   10000
+
+/* how long the server takes to answer the slow page, in milliseconds */
+#define SERVER_SLOW     3000
+
+/* size of the reply that does not fit the buffer */
+#define SERVER_BIG_SIZE 4096
+
+/* ------------------------------------------------------------------------- */
+
+/* what the engine needs from the rest of VICE */
+
+#ifdef LIB_DEBUG_PINPOINT
+void *lib_malloc_pinpoint(size_t size, const char *name, unsigned int line)
+{
+    return malloc(size);
+}
+
+void lib_free_pinpoint(void *p, const char *name, unsigned int line)
+{
+    free(p);
+}
+
+char *lib_strdup_pinpoint(const char *str, const char *name, unsigned int line)
+{
+    char *s = malloc(strlen(str) + 1);
+
+    strcpy(s, str);
+    return s;
+}
+#else
+void *lib_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void lib_free(void *p)
+{
+    free(p);
+}
+
+char *lib_strdup(const char *str)
+{
+    char *s = malloc(strlen(str) + 1);
+
+    strcpy(s, str);
+    return s;
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+/* the stand-in server, one thread per connection, every reply closes the
+   connection */
+
+enum {
+    PAGE_HELLO = 0,     /* short reply that can be cached */
+    PAGE_NOCACHE,       /* reply with "Cache-Control: no-cache" */
+    PAGE_MISSING,       /* 404 */
+    PAGE_BIG,           /* reply larger than the buffer */
+    PAGE_POST,          /* echoes the request body */
+    PAGE_SLOW,          /* answers after SERVER_SLOW ms */
+    PAGES
+};
+
+static const char *server_paths[PAGES] = {
+    "/hello", "/nocache", "/missing", "/big", "/post", "/slow"
+};
+
+static char server_big[SERVER_BIG_SIZE];
+static int server_port;
+static int server_hits[PAGES];
+static pthread_mutex_t server_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void server_send(int fd, const char *status, const char *headers,
+                        const char *body, size_t len)
+{
+    char head[256];
+
+    snprintf(head, sizeof(head),
+             "HTTP/1.1 %s\r\nContent-Length: %lu\r\n%sConnection: close\r\n\r\n",
+             status, (unsigned long)len, headers);
+    if (write(fd, head, strlen(head)) < 0 || write(fd, body, len) < 0) {
+        /* the client went away */
+        return;
+    }
+}
+
+static void *server_connection(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    char req[4096];
+    size_t len = 0, body = 0, want = 0;
+    ssize_t n;
+    char *end, *cl;
+    int page, i;
+
+    /* read the header and, for a POST, the body */
+    while (len < sizeof(req) - 1) {
+        n = read(fd, req + len, sizeof(req) - 1 - len);
+        if (n <= 0) {
+            break;
+        }
+        len += (size_t)n;
+        req[len] = '\0';
+        end = strstr(req, "\r\n\r\n");
+        if (end == NULL) {
+            continue;
+        }
+        body = (size_t)(end + 4 - req);
+        cl = strstr(req, "Content-Length: ");
+        want = body + (cl != NULL && cl < end ? strtoul(cl + 16, NULL, 10) : 0);
+        if (len >= want) {
+            break;
+        }
+    }
+    req[len] = '\0';
+
+    page = PAGES;
+    for (i = 0; i < PAGES; i++) {
+        const char *p = strchr(req, ' ');
+        size_t l = strlen(server_paths[i]);
+
+        if (p != NULL && strncmp(p + 1, server_paths[i], l) == 0 && p[l + 1] == ' ') {
+            page = i;
+        }
+    }
+    if (page < PAGES) {
+        pthread_mutex_lock(&server_lock);
+        server_hits[page]++;
+        pthread_mutex_unlock(&server_lock);
+    }
+
+    switch (page) {
+        case PAGE_HELLO:
+            server_send(fd, "200 OK", "", "hello", 5);
+            break;
+        case PAGE_NOCACHE:
+            server_send(fd, "200 OK", "Cache-Control: no-cache\r\n", "fresh", 5);
+            break;
+        case PAGE_BIG:
+            server_send(fd, "200 OK", "", server_big, sizeof(server_big));
+            break;
+        case PAGE_POST:
+            server_send(fd, "200 OK", "", req + body, len - body);
+            break;
+        case PAGE_SLOW:
+            usleep(SERVER_SLOW * 1000);
+            server_send(fd, "200 OK", "", "late", 4);
+            break;
+        default:
+            server_send(fd, "404 Not Found", "", "missing", 7);
+            break;
+    }
+    close(fd);
+    return NULL;
+}
+
+static void *server_main(void *arg)
+{
+    int listen_fd = (int)(intptr_t)arg;
+    pthread_t thread;
+    int fd;
+
+    while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+        if (pthread_create(&thread, NULL, server_connection, (void *)(intptr_t)fd) != 0) {
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+/* opens a socket on a free loopback port; returns the socket or -1 */
+static int server_socket(int *port)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || getsockname(fd, (struct sockaddr *)&addr, &addr_len) < 0) {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static int server_start(void)
+{
+    pthread_t thread;
+    int fd = server_socket(&server_port);
+
+    memset(server_big, 'x', sizeof(server_big));
+    if (fd < 0 || listen(fd, 8) < 0
+        || pthread_create(&thread, NULL, server_main, (void *)(intptr_t)fd) != 0) {
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+static int server_get_hits(int page)
+{
+    int hits;
+
+    pthread_mutex_lock(&server_lock);
+    hits = server_hits[page];
+    pthread_mutex_unlock(&server_lock);
+    return hits;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static uint8_t reply[1024];
+static wic64_http_result_t result;
+static int failures = 0;
+
+static long check_msecs(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000L + tv.tv_usec / 1000L;
+}
+
+static void check(int ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+/* polls the engine like the WiC64 alarms do until the reply is in */
+static int check_wait(void)
+{
+    long start = check_msecs();
+    int state;
+
+    while ((state = wic64_http_poll(&result)) == WIC64_HTTP_PENDING) {
+        if (check_msecs() - start > CHECK_TIMEOUT) {
+            wic64_http_cancel();
+            return -1;
+        }
+        usleep(1000);
+    }
+    return state == WIC64_HTTP_DONE ? 0 : -1;
+}
+
+static int check_get(int page, size_t maxlen)
+{
+    char url[64];
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d%s", server_port, server_paths[page]);
+    if (wic64_http_get(url, "VICE check", 0, reply, maxlen) < 0) {
+        return -1;
+    }
+    return check_wait();
+}
+
+static int reply_is(const char *s)
+{
+    return result.len == strlen(s) && memcmp(reply, s, result.len) == 0;
+}
+
+static int reply_contains(const char *s)
+{
+    size_t l = strlen(s), i;
+
+    for (i = 0; i + l <= result.len; i++) {
+        if (memcmp(reply + i, s, l) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    static const char post_data[] = "wic64 post data";
+    char url[64];
+    int fd, port, ok;
+    long start;
+
+    /* the server writes to connections the client gave up on */
+    signal(SIGPIPE, SIG_IGN);
+
+    if (server_start() < 0) {
+        printf("cannot start the stand-in server, skipped\n");
+        return 77;
+    }
+    if (wic64_http_init() < 0) {
+        printf("FAILED: wic64_http_init()\n");
+        return EXIT_FAILURE;
+    }
+#ifdef USE_VICE_THREAD
+    printf("transfers on the engine thread\n");
+#else
+    printf("transfers advanced by polling\n");
+#endif
+
+    wic64_http_set_cache_time(60);
+
+    ok = check_get(PAGE_HELLO, sizeof(reply)) == 0;
+    check(ok && result.error == 0 && result.response == 200 && reply_is("hello")
+          && result.size_known && !result.cached && server_get_hits(PAGE_HELLO) == 1,
+          "GET");
+    ok = check_get(PAGE_HELLO, sizeof(reply)) == 0;
+    check(ok && result.response == 200 && reply_is("hello") && result.cached
+          && server_get_hits(PAGE_HELLO) == 1,
+          "repeated GET is answered from the cache");
+
+    check_get(PAGE_NOCACHE, sizeof(reply));
+    ok = check_get(PAGE_NOCACHE, sizeof(reply)) == 0;
+    check(ok && reply_is("fresh") && !result.cached && server_get_hits(PAGE_NOCACHE) == 2,
+          "no-cache reply is not cached");
+
+    check_get(PAGE_MISSING, sizeof(reply));
+    ok = check_get(PAGE_MISSING, sizeof(reply)) == 0;
+    check(ok && result.error == 0 && result.response == 404 && !result.cached
+          && server_get_hits(PAGE_MISSING) == 2,
+          "404 reply is not cached");
+
+    ok = check_get(PAGE_BIG, 100) == 0;
+    check(ok && result.error == 0 && result.overflow && result.len == 100,
+          "reply larger than the buffer is cut off");
+    ok = check_get(PAGE_BIG, 100) == 0;
+    check(ok && !result.cached && server_get_hits(PAGE_BIG) == 2,
+          "cut off reply is not cached");
+
+    wic64_http_set_cache_time(0);
+    ok = check_get(PAGE_HELLO, sizeof(reply)) == 0;
+    check(ok && reply_is("hello") && !result.cached && server_get_hits(PAGE_HELLO) == 2,
+          "turning the cache off drops the cached replies");
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d%s", server_port, server_paths[PAGE_POST]);
+    ok = wic64_http_post(url, "VICE check", 0, (const uint8_t *)post_data,
+                         sizeof(post_data) - 1, reply, sizeof(reply)) == 0
+         && check_wait() == 0;
+    check(ok && result.response == 200 && reply_contains("name=\"data\"")
+          && reply_contains(post_data),
+          "POST sends the data as form field \"data\"");
+
+    /* a port nobody listens on */
+    fd = server_socket(&port);
+    close(fd);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/", port);
+    ok = fd >= 0 && wic64_http_get(url, "VICE check", 0, reply, sizeof(reply)) == 0
+         && check_wait() == 0;
+    check(ok && result.error != 0, "refused connection gives an error");
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d%s", server_port, server_paths[PAGE_SLOW]);
+    wic64_http_get(url, "VICE check", 0, reply, sizeof(reply));
+    wic64_http_poll(&result);
+    usleep(200 * 1000);
+    start = check_msecs();
+    wic64_http_cancel();
+    check(check_msecs() - start < SERVER_SLOW / 2 && wic64_http_poll(&result) == WIC64_HTTP_IDLE,
+          "cancel does not wait for the server");
+    ok = check_get(PAGE_HELLO, sizeof(reply)) == 0;
+    check(ok && reply_is("hello"), "GET after a cancelled request");
+
+    wic64_http_shutdown();
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#else
+
+int main(void)
+{
+    printf("no libcurl or no POSIX sockets, skipped\n");
+    return 77;
+}
+
+#endif
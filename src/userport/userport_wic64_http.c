@@ -0,0 +1,692 @@
+/*
+ * userport_wic64_http.c - HTTP transfers of the WiC64 emulation.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/*
+ * The WiC64 runs one HTTP request at a time. The transfer is done by
+ * libcurl on a thread of its own (when VICE is built with threads), so a
+ * slow server or name lookup never stalls the emulation: the alarms of
+ * the WiC64 emulation only check with wic64_http_poll() whether the reply
+ * is complete. Without threads, wic64_http_poll() advances the transfer
+ * itself, without waiting.
+ *
+ * Replies to GET requests can be kept in a small cache for a configurable
+ * time, so launchers and menus that fetch the same URLs over and over do
+ * not go to the server every time.
+ */
+
+#include "vice.h"
+
+#ifdef HAVE_LIBCURL
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <curl/curl.h>
+
+#ifdef USE_VICE_THREAD
+#include <pthread.h>
+#endif
+
+#include "lib.h"
+#include "userport_wic64_http.h"
+
+/* states of the request */
+#define REQ_IDLE     0  /* no request, or the result was collected */
+#define REQ_QUEUED   1  /* waiting for the transfer to be started */
+#define REQ_RUNNING  2  /* transfer in progress */
+#define REQ_DONE     3  /* transfer finished, result not collected yet */
+
+/* how long the engine waits for socket activity, in milliseconds */
+#define HTTP_POLL_TIMEOUT 100
+
+/* limits of the reply cache */
+#define HTTP_CACHE_ENTRIES    16
+#define HTTP_CACHE_MAX_SIZE   (4 * 1024 * 1024)
+#define HTTP_CACHE_MAX_ENTRY  (HTTP_CACHE_MAX_SIZE / 4)
+
+typedef struct http_request_s {
+    int state;
+    int cancel;             /* abort the running transfer */
+
+    /* set up by the emulation before the request is queued */
+    int post;
+    int verbose;
+    char *url;
+    char *agent;
+    uint8_t *post_data;
+    size_t post_len;
+    uint8_t *buf;
+    size_t maxlen;
+
+    /* written by the transfer, valid once the state is REQ_DONE */
+    size_t len;
+    int overflow;
+    int no_cache;           /* server asked not to cache the reply */
+    int size_known;
+    int cached;
+    long response;
+    CURLcode error;
+    char *effective_url;
+
+    /* only used by the transfer */
+    CURL *eh;
+    curl_mime *mime;
+} http_request_t;
+
+typedef struct http_cache_entry_s {
+    char *url;
+    char *effective_url;
+    uint8_t *data;
+    size_t len;
+    time_t stored;
+    unsigned long used;     /* for replacing the least recently used entry */
+} http_cache_entry_t;
+
+static http_request_t request;
+static CURLM *cm = NULL;
+static int engine_initialized = 0;
+
+/* the cache is only used by the emulation, not by the transfer */
+static http_cache_entry_t cache[HTTP_CACHE_ENTRIES];
+static size_t cache_size = 0;
+static unsigned long cache_use_count = 0;
+static int cache_time = 0;
+
+#ifdef USE_VICE_THREAD
+
+/* the request state, cancel flag and result are protected by request_lock;
+   the buffer is only written by the transfer while the state is
+   REQ_RUNNING, and only read by the emulation after that */
+static pthread_mutex_t request_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t request_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t http_thread;
+static int http_thread_quit = 0;        /* protected by request_lock */
+
+#define REQUEST_LOCK()      pthread_mutex_lock(&request_lock)
+#define REQUEST_UNLOCK()    pthread_mutex_unlock(&request_lock)
+#define REQUEST_CHANGED()   pthread_cond_broadcast(&request_cond)
+
+#else
+
+#define REQUEST_LOCK()
+#define REQUEST_UNLOCK()
+#define REQUEST_CHANGED()
+
+#endif
+
+/* ---------------------------------------------------------------------*/
+
+static size_t write_cb(char *data, size_t n, size_t l, void *userp)
+{
+    size_t len = n * l;
+
+    if (request.len + len > request.maxlen) {
+        request.overflow = 1;
+        len = request.maxlen - request.len;
+    }
+    memcpy(request.buf + request.len, data, len);
+    request.len += len;
+
+    /* a short count makes libcurl abort the transfer */
+    return len;
+}
+
+static size_t header_cb(char *data, size_t n, size_t l, void *userp)
+{
+    size_t len = n * l;
+    char line[128];
+    size_t i;
+
+    if (len > 14 && len < sizeof(line)) {
+        for (i = 0; i < len; i++) {
+            line[i] = (char)tolower((unsigned char)data[i]);
+        }
+        line[len] = '\0';
+        if (strncmp(line, "cache-control:", 14) == 0
+            && (strstr(line, "no-store") != NULL
+                || strstr(line, "no-cache") != NULL)) {
+            request.no_cache = 1;
+        }
+    }
+    return len;
+}
+
+/* sets up the transfer of the queued request */
+static int http_transfer_start(void)
+{
+    CURL *eh = curl_easy_init();
+
+    if (eh == NULL) {
+        return -1;
+    }
+    curl_easy_setopt(eh, CURLOPT_VERBOSE, request.verbose ? 1L : 0L);
+    curl_easy_setopt(eh, CURLOPT_WRITEFUNCTION, write_cb);
+    curl_easy_setopt(eh, CURLOPT_HEADERFUNCTION, header_cb);
+    curl_easy_setopt(eh, CURLOPT_URL, request.url);
+    curl_easy_setopt(eh, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(eh, CURLOPT_NOSIGNAL, 1L);
+    /* need to decied if we want to ship a certificate file
+    curl_easy_setopt(eh, CURLOPT_CAINFO, PREFIX "/share/vice/etc/ca-bundle.crt");
+    curl_easy_setopt(eh, CURLOPT_CAPATH, PREFIX "/share/vice/etc/ca-bundle.crt");
+    */
+    curl_easy_setopt(eh, CURLOPT_SSL_VERIFYPEER, 0L);
+
+    /* work around bug 1964 (https://sourceforge.net/p/vice-emu/bugs/1964/) - maybe not needed anymore !*/
+#ifdef CURLSSLOPT_NATIVE_CA
+    curl_easy_setopt(eh, CURLOPT_SSL_OPTIONS, CURLSSLOPT_NATIVE_CA);
+#endif
+
+    /* set USERAGENT: otherwise the server won't return data, e.g. wicradio */
+    curl_easy_setopt(eh, CURLOPT_USERAGENT, request.agent);
+
+    if (request.post) {
+        curl_mimepart *part;
+
+        /* Build an HTTP form with a single field named "data" */
+        request.mime = curl_mime_init(eh);
+        part = curl_mime_addpart(request.mime);
+        curl_mime_data(part, (const char *)request.post_data, request.post_len);
+        curl_mime_name(part, "data");
+        curl_easy_setopt(eh, CURLOPT_MIMEPOST, request.mime);
+    }
+
+    if (curl_multi_add_handle(cm, eh) != CURLM_OK) {
+        if (request.mime != NULL) {
+            curl_mime_free(request.mime);
+            request.mime = NULL;
+        }
+        curl_easy_cleanup(eh);
+        return -1;
+    }
+    request.eh = eh;
+    return 0;
+}
+
+static void http_transfer_end(void)
+{
+    if (request.eh != NULL) {
+        curl_multi_remove_handle(cm, request.eh);
+        curl_easy_cleanup(request.eh);
+        request.eh = NULL;
+    }
+    if (request.mime != NULL) {
+        curl_mime_free(request.mime);
+        request.mime = NULL;
+    }
+}
+
+/* gets the result from the finished transfer */
+static void http_transfer_result(CURLcode result)
+{
+    curl_off_t cl = -1;
+    char *url = NULL;
+
+    request.error = result;
+    if (request.overflow) {
+        /* the transfer was aborted by write_cb() */
+        request.error = CURLE_OK;
+    }
+    curl_easy_getinfo(request.eh, CURLINFO_RESPONSE_CODE, &request.response);
+    if (curl_easy_getinfo(request.eh, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &cl) != CURLE_OK) {
+        cl = -1;
+    }
+    request.size_known = (cl >= 0);
+    if (curl_easy_getinfo(request.eh, CURLINFO_EFFECTIVE_URL, &url) == CURLE_OK && url != NULL) {
+        request.effective_url = lib_strdup(url);
+    }
+}
+
+/* advances the transfer of the request; called with request_lock held,
+   which is released while libcurl does its work */
+static void http_step(int timeout)
+{
+    CURLMsg *msg;
+    CURLcode result = CURLE_OK;
+    int running = 0;
+    int left;
+    int done = 0;
+
+    if (request.state == REQ_QUEUED) {
+        if (http_transfer_start() < 0) {
+            request.error = CURLE_FAILED_INIT;
+            request.state = REQ_DONE;
+            REQUEST_CHANGED();
+            return;
+        }
+        request.state = REQ_RUNNING;
+    }
+    if (request.state != REQ_RUNNING) {
+        return;
+    }
+    if (request.cancel) {
+        http_transfer_end();
+        request.cancel = 0;
+        request.state = REQ_IDLE;
+        REQUEST_CHANGED();
+        return;
+    }
+
+    REQUEST_UNLOCK();
+    if (curl_multi_perform(cm, &running) != CURLM_OK) {
+        result = CURLE_FAILED_INIT;
+        done = 1;
+    }
+    while ((msg = curl_multi_info_read(cm, &left)) != NULL) {
+        if (msg->msg == CURLMSG_DONE) {
+            result = msg->data.result;
+            done = 1;
+        }
+    }
+    if (!done && timeout > 0) {
+        curl_multi_poll(cm, NULL, 0, timeout, NULL);
+    }
+    REQUEST_LOCK();
+
+    if (done) {
+        http_transfer_result(result);
+        http_transfer_end();
+        request.state = REQ_DONE;
+        REQUEST_CHANGED();
+    }
+}
+
+#ifdef USE_VICE_THREAD
+/* makes libcurl return from waiting for the sockets */
+static void http_wakeup(void)
+{
+#if LIBCURL_VERSION_NUM >= 0x074400
+    curl_multi_wakeup(cm);
+#endif
+}
+
+static void *http_thread_main(void *unused)
+{
+    REQUEST_LOCK();
+    while (!http_thread_quit) {
+        if (request.state == REQ_QUEUED || request.state == REQ_RUNNING) {
+            http_step(HTTP_POLL_TIMEOUT);
+        } else {
+            pthread_cond_wait(&request_cond, &request_lock);
+        }
+    }
+    REQUEST_UNLOCK();
+    return NULL;
+}
+#endif
+
+/* ---------------------------------------------------------------------*/
+
+static void cache_remove(int i)
+{
+    cache_size -= cache[i].len;
+    lib_free(cache[i].url);
+    lib_free(cache[i].effective_url);
+    lib_free(cache[i].data);
+    memset(&cache[i], 0, sizeof(cache[i]));
+}
+
+static int cache_find(const char *url)
+{
+    time_t now = time(NULL);
+    int i;
+
+    for (i = 0; i < HTTP_CACHE_ENTRIES; i++) {
+        if (cache[i].url == NULL) {
+            continue;
+        }
+        if (now - cache[i].stored >= cache_time || now < cache[i].stored) {
+            cache_remove(i);
+            continue;
+        }
+        if (strcmp(cache[i].url, url) == 0) {
+            cache[i].used = ++cache_use_count;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* returns a free entry, dropping the least recently used ones as needed */
+static int cache_make_room(size_t len)
+{
+    int i, lru;
+
+    while (1) {
+        lru = -1;
+        for (i = 0; i < HTTP_CACHE_ENTRIES; i++) {
+            if (cache[i].url == NULL) {
+                if (cache_size + len <= HTTP_CACHE_MAX_SIZE) {
+                    return i;
+                }
+                continue;
+            }
+            if (lru < 0 || cache[i].used < cache[lru].used) {
+                lru = i;
+            }
+        }
+        if (lru < 0) {
+            return -1;
+        }
+        cache_remove(lru);
+    }
+}
+
+static void cache_store(void)
+{
+    int i;
+
+    if (cache_time <= 0 || request.post || request.no_cache
+        || request.overflow || request.error != CURLE_OK
+        || request.response != 200 || request.len > HTTP_CACHE_MAX_ENTRY) {
+        return;
+    }
+
+    i = cache_find(request.url);
+    if (i >= 0) {
+        cache_remove(i);
+    }
+    i = cache_make_room(request.len);
+    if (i < 0) {
+        return;
+    }
+    cache[i].url = lib_strdup(request.url);
+    cache[i].effective_url = lib_strdup(request.effective_url != NULL ? request.effective_url : request.url);
+    cache[i].data = lib_malloc(request.len > 0 ? request.len : 1);
+    memcpy(cache[i].data, request.buf, request.len);
+    cache[i].len = request.len;
+    cache[i].stored = time(NULL);
+    cache[i].used = ++cache_use_count;
+    cache_size += request.len;
+}
+
+/** \brief  Set how long replies to GET requests are kept
+ *
+ * \param[in]   seconds time to keep a reply, 0 disables the cache
+ */
+void wic64_http_set_cache_time(int seconds)
+{
+    cache_time = seconds;
+    if (seconds <= 0) {
+        wic64_http_cache_clear();
+    }
+}
+
+/** \brief  Drop all cached replies
+ */
+void wic64_http_cache_clear(void)
+{
+    int i;
+
+    for (i = 0; i < HTTP_CACHE_ENTRIES; i++) {
+        if (cache[i].url != NULL) {
+            cache_remove(i);
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------*/
+
+/* frees what the last request allocated; the request must not be running */
+static void request_free(void)
+{
+    lib_free(request.url);
+    lib_free(request.agent);
+    lib_free(request.post_data);
+    lib_free(request.effective_url);
+    request.url = NULL;
+    request.agent = NULL;
+    request.post_data = NULL;
+    request.effective_url = NULL;
+}
+
+static int request_queue(int post, const char *url, const char *agent, int verbose,
+                         const uint8_t *data, size_t len,
+                         uint8_t *buf, size_t maxlen)
+{
+    int i;
+
+    if (!engine_initialized) {
+        return -1;
+    }
+    wic64_http_cancel();
+
+    REQUEST_LOCK();
+    request_free();
+    request.post = post;
+    request.verbose = verbose;
+    request.url = lib_strdup(url);
+    request.agent = lib_strdup(agent);
+    if (post) {
+        request.post_data = lib_malloc(len > 0 ? len : 1);
+        memcpy(request.post_data, data, len);
+        request.post_len = len;
+    }
+    request.buf = buf;
+    request.maxlen = maxlen;
+    request.len = 0;
+    request.overflow = 0;
+    request.no_cache = 0;
+    request.size_known = 0;
+    request.cached = 0;
+    request.response = 0;
+    request.error = CURLE_OK;
+    request.cancel = 0;
+
+    i = (!post && cache_time > 0) ? cache_find(url) : -1;
+    if (i >= 0 && cache[i].len <= maxlen) {
+        memcpy(buf, cache[i].data, cache[i].len);
+        request.len = cache[i].len;
+        request.size_known = 1;
+        request.cached = 1;
+        request.response = 200;
+        request.effective_url = lib_strdup(cache[i].effective_url);
+        request.state = REQ_DONE;
+    } else {
+        request.state = REQ_QUEUED;
+    }
+    REQUEST_CHANGED();
+    REQUEST_UNLOCK();
+    return 0;
+}
+
+/** \brief  Start a GET request
+ *
+ * A request that is still running is cancelled. The reply is written to
+ * \a buf, which must stay valid until the request is done or cancelled.
+ *
+ * \param[in]   url     URL to get
+ * \param[in]   agent   user agent to send
+ * \param[in]   verbose let libcurl log the transfer
+ * \param[out]  buf     buffer for the reply
+ * \param[in]   maxlen  size of \a buf
+ *
+ * \return  0 on success, -1 on error
+ */
+int wic64_http_get(const char *url, const char *agent, int verbose,
+                   uint8_t *buf, size_t maxlen)
+{
+    return request_queue(0, url, agent, verbose, NULL, 0, buf, maxlen);
+}
+
+/** \brief  Start a POST request
+ *
+ * Like wic64_http_get(), \a data is sent as the form field "data".
+ *
+ * \param[in]   url     URL to post to
+ * \param[in]   agent   user agent to send
+ * \param[in]   verbose let libcurl log the transfer
+ * \param[in]   data    data to post, copied
+ * \param[in]   len     length of \a data
+ * \param[out]  buf     buffer for the reply
+ * \param[in]   maxlen  size of \a buf
+ *
+ * \return  0 on success, -1 on error
+ */
+int wic64_http_post(const char *url, const char *agent, int verbose,
+                    const uint8_t *data, size_t len,
+                    uint8_t *buf, size_t maxlen)
+{
+    return request_queue(1, url, agent, verbose, data, len, buf, maxlen);
+}
+
+/** \brief  Check whether the request has finished
+ *
+ * Once WIC64_HTTP_DONE was returned, the request is complete and the
+ * strings in \a result stay valid until the next request is started.
+ *
+ * \param[out]  result  result of the request
+ *
+ * \return  WIC64_HTTP_DONE, WIC64_HTTP_PENDING or WIC64_HTTP_IDLE
+ */
+int wic64_http_poll(wic64_http_result_t *result)
+{
+    int ret;
+
+    if (!engine_initialized) {
+        return WIC64_HTTP_IDLE;
+    }
+
+    REQUEST_LOCK();
+#ifndef USE_VICE_THREAD
+    http_step(0);
+#endif
+    switch (request.state) {
+        case REQ_QUEUED:
+        case REQ_RUNNING:
+            ret = WIC64_HTTP_PENDING;
+            break;
+        case REQ_DONE:
+            result->error = request.error;
+            result->error_string = curl_easy_strerror(request.error);
+            result->response = request.response;
+            result->url = request.effective_url != NULL ? request.effective_url : request.url;
+            result->len = request.len;
+            result->overflow = request.overflow;
+            result->size_known = request.size_known;
+            result->cached = request.cached;
+            if (!request.cached) {
+                cache_store();
+            }
+            request.state = REQ_IDLE;
+            ret = WIC64_HTTP_DONE;
+            break;
+        default:
+            ret = WIC64_HTTP_IDLE;
+            break;
+    }
+    REQUEST_UNLOCK();
+    return ret;
+}
+
+/** \brief  Abort the request
+ *
+ * Returns once the transfer has stopped writing to the reply buffer.
+ */
+void wic64_http_cancel(void)
+{
+    if (!engine_initialized) {
+        return;
+    }
+
+    REQUEST_LOCK();
+#ifdef USE_VICE_THREAD
+    if (request.state == REQ_RUNNING) {
+        request.cancel = 1;
+        http_wakeup();
+        while (request.state == REQ_RUNNING) {
+            pthread_cond_wait(&request_cond, &request_lock);
+        }
+    }
+#else
+    if (request.state == REQ_RUNNING) {
+        http_transfer_end();
+    }
+#endif
+    request.cancel = 0;
+    request.state = REQ_IDLE;
+    REQUEST_UNLOCK();
+}
+
+/* ---------------------------------------------------------------------*/
+
+/** \brief  Start the HTTP engine
+ *
+ * \return  0 on success, -1 on error
+ */
+int wic64_http_init(void)
+{
+    if (engine_initialized) {
+        return 0;
+    }
+    if (curl_global_init(CURL_GLOBAL_ALL) != CURLE_OK) {
+        return -1;
+    }
+    cm = curl_multi_init();
+    if (cm == NULL) {
+        curl_global_cleanup();
+        return -1;
+    }
+    /* the WiC64 does one request at a time */
+    curl_multi_setopt(cm, CURLMOPT_MAXCONNECTS, 1L);
+    memset(&request, 0, sizeof(request));
+
+#ifdef USE_VICE_THREAD
+    http_thread_quit = 0;
+    if (pthread_create(&http_thread, NULL, http_thread_main, NULL) != 0) {
+        curl_multi_cleanup(cm);
+        cm = NULL;
+        curl_global_cleanup();
+        return -1;
+    }
+#endif
+    engine_initialized = 1;
+    return 0;
+}
+
+/** \brief  Stop the HTTP engine, aborting a running request
+ */
+void wic64_http_shutdown(void)
+{
+    if (!engine_initialized) {
+        return;
+    }
+    wic64_http_cancel();
+
+#ifdef USE_VICE_THREAD
+    REQUEST_LOCK();
+    http_thread_quit = 1;
+    REQUEST_CHANGED();
+    REQUEST_UNLOCK();
+    pthread_join(http_thread, NULL);
+#endif
+
+    request_free();
+    wic64_http_cache_clear();
+    curl_multi_cleanup(cm);
+    cm = NULL;
+    curl_global_cleanup();
+    engine_initialized = 0;
+}
+
+#endif /* HAVE_LIBCURL */
@@ -0,0 +1,61 @@
+/*
+ * userport_wic64_http.h - HTTP transfers of the WiC64 emulation.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_USERPORT_WIC64_HTTP_H
+#define VICE_USERPORT_WIC64_HTTP_H
+
+#include <stddef.h>
+
+#include "types.h"
+
+/* state of a request, as returned by wic64_http_poll() */
+#define WIC64_HTTP_IDLE     -1  /* no request was started */
+#define WIC64_HTTP_PENDING   0  /* transfer is still running */
+#define WIC64_HTTP_DONE      1  /* transfer has finished, result is valid */
+
+typedef struct wic64_http_result_s {
+    int error;          /* 0 or the libcurl error of the transfer */
+    const char *error_string; /* description of the error */
+    long response;      /* HTTP response code */
+    const char *url;    /* effective URL, after redirects */
+    size_t len;         /* number of bytes written to the buffer */
+    int overflow;       /* reply was larger than the buffer */
+    int size_known;     /* server sent the content length */
+    int cached;         /* reply came from the cache */
+} wic64_http_result_t;
+
+int wic64_http_init(void);
+void wic64_http_shutdown(void);
+
+int wic64_http_get(const char *url, const char *agent, int verbose,
+                   uint8_t *buf, size_t maxlen);
+int wic64_http_post(const char *url, const char *agent, int verbose,
+                    const uint8_t *data, size_t len,
+                    uint8_t *buf, size_t maxlen);
+int wic64_http_poll(wic64_http_result_t *result);
+void wic64_http_cancel(void);
+
+void wic64_http_set_cache_time(int seconds);
+void wic64_http_cache_clear(void);
+
+#endif
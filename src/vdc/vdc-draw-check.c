@@ -0,0 +1,343 @@
+/*
+ * vdc-draw-check.c - Check the VDC renderer against the output of the
+ *                    renderer that drew one character at a time.
+ *
+ * draw_chars() expands a whole row, with SSE2 eight characters at a time,
+ * and draws the inter character gaps before the characters. Two checks:
+ *
+ * - rows: draw_chars() must give the same pixels as expanding one character
+ *   at a time through the lookup tables, each followed by its gap.
+ *
+ * - lines: draw_std_text(), draw_std_text_cached(), draw_std_bitmap() and
+ *   draw_std_bitmap_cached() draw whole raster lines from random VDC memory
+ *   and registers. The lines of each group are hashed and compared with the
+ *   hashes the renderer gave before draw_chars() was added.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* the expansion functions are static, so the renderer is built into the
+   checker */
+#include "vdc-draw.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vicecheck.h"
+
+/* random rows drawn */
+#define CHECK_ROWS      200000
+
+/* random raster lines drawn per group and line renderer */
+#define CHECK_LINES     10000
+
+/* room for a raster line of 100 32 pixel characters plus the border, and
+   for the scroll offset to the left of draw_buffer_ptr */
+#define CHECK_LINE_SIZE     4096
+#define CHECK_LINE_OFFSET   512
+
+/* room for the widest row: 32 pixel double width characters, plus the
+   16 pixels a character or gap can reach past its cell */
+#define CHECK_BUF_SIZE  (VDC_SCREEN_MAX_TEXTCOLS * 32 + 64)
+
+/* ------------------------------------------------------------------------- */
+
+/* what the renderer needs from the rest of VICE */
+
+vdc_t vdc;
+
+uint8_t vdc_ram_read(uint16_t addr)
+{
+    return vdc.ram[addr];
+}
+
+void raster_modes_set(raster_modes_t *modes, unsigned int num_mode,
+                      raster_modes_fill_cache_function_t fill_cache,
+                      raster_modes_draw_line_cached_function_t draw_line_cached,
+                      raster_modes_draw_line_function_t draw_line,
+                      raster_modes_draw_background_function_t draw_background,
+                      raster_modes_draw_foreground_function_t draw_foreground)
+{
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* one character at a time through the lookup tables, each followed by its
+   gap */
+static void draw_reference(uint8_t *p, unsigned int count, const uint8_t *data,
+                           const uint8_t *gap, const uint8_t *fg, const uint8_t *bg)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++, p += vdc.charwidth) {
+        if (vdc.regs[25] & 0x10) {
+            draw_row_double(p, vdc.charwidth, 1, data + i, fg + i, bg + i);
+            if (gap != NULL) {
+                draw_row_double(p + 16, vdc.charwidth, 1, gap + i, fg + i, bg + i);
+            }
+        } else {
+            draw_row(p, vdc.charwidth, 1, data + i, fg + i, bg + i);
+            if (gap != NULL) {
+                draw_row(p + 8, vdc.charwidth, 1, gap + i, fg + i, bg + i);
+            }
+        }
+    }
+}
+
+static int check_rows(void)
+{
+    static uint8_t row[CHECK_BUF_SIZE], reference[CHECK_BUF_SIZE];
+    uint8_t data[VDC_SCREEN_MAX_TEXTCOLS];
+    uint8_t gap[VDC_SCREEN_MAX_TEXTCOLS];
+    uint8_t fg[VDC_SCREEN_MAX_TEXTCOLS];
+    uint8_t bg[VDC_SCREEN_MAX_TEXTCOLS];
+    unsigned int n, i, count;
+    int use_gap;
+
+    check_srand(0x5eed);
+
+    for (n = 0; n < CHECK_ROWS; n++) {
+        /* character width from regs[22], doubled in double pixel mode */
+        vdc.regs[25] = (uint8_t)(check_rand(2) ? 0x10 : 0);
+        vdc.regs[22] = (uint8_t)((check_rand(2) ? 7 : check_rand(16)) << 4);
+        vdc.charwidth = ((vdc.regs[22] >> 4) + 1) * ((vdc.regs[25] & 0x10) ? 2 : 1);
+
+        count = 1 + check_rand(VDC_SCREEN_MAX_TEXTCOLS);
+        use_gap = check_rand(2);
+        for (i = 0; i < count; i++) {
+            data[i] = (uint8_t)check_rand(256);
+            gap[i] = (uint8_t)check_rand(256);
+            fg[i] = (uint8_t)check_rand(16);
+            bg[i] = (uint8_t)check_rand(16);
+        }
+
+        memset(row, 0xee, sizeof(row));
+        memset(reference, 0xee, sizeof(reference));
+        draw_chars(row, count, data, use_gap ? gap : NULL, fg, bg);
+        draw_reference(reference, count, data, use_gap ? gap : NULL, fg, bg);
+
+        if (memcmp(row, reference, sizeof(row)) != 0) {
+            for (i = 0; row[i] == reference[i]; i++) {
+            }
+            printf("row %u (%u characters of %u pixels%s%s): pixel %u is %u instead of %u\n",
+                   n, count, vdc.charwidth,
+                   (vdc.regs[25] & 0x10) ? ", double pixel" : "",
+                   use_gap ? ", gaps" : "",
+                   i, row[i], reference[i]);
+            return -1;
+        }
+    }
+
+    printf("%u rows match\n", n);
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* the line renderers, drawing from the cache with a random part of the line
+   for the cached ones */
+
+static raster_cache_t check_cache;
+
+static void check_std_text(void)
+{
+    draw_std_text();
+}
+
+static void check_std_text_cached(void)
+{
+    unsigned int xs, xe;
+
+    get_std_text(&check_cache, &xs, &xe, 1);
+    xs = check_rand(vdc.screen_text_cols);
+    xe = xs + check_rand(vdc.screen_text_cols - xs);
+    draw_std_text_cached(&check_cache, xs, xe);
+}
+
+static void check_std_bitmap(void)
+{
+    draw_std_bitmap();
+}
+
+static void check_std_bitmap_cached(void)
+{
+    unsigned int xs, xe;
+
+    get_std_bitmap(&check_cache, &xs, &xe, 1);
+    xs = check_rand(vdc.screen_text_cols);
+    xe = xs + check_rand(vdc.screen_text_cols - xs);
+    draw_std_bitmap_cached(&check_cache, xs, xe);
+}
+
+static const struct {
+    const char *name;
+    void (*draw)(void);
+} check_renderers[] = {
+    { "draw_std_text", check_std_text },
+    { "draw_std_text_cached", check_std_text_cached },
+    { "draw_std_bitmap", check_std_bitmap },
+    { "draw_std_bitmap_cached", check_std_bitmap_cached }
+};
+
+#define CHECK_RENDERERS (sizeof(check_renderers) / sizeof(check_renderers[0]))
+
+/* the groups force the register bits that pick the colours and the gap
+   pixels, everything else is random */
+enum {
+    CHECK_GROUP_COLOR_REG = 0,  /* colours from regs[26], no attributes */
+    CHECK_GROUP_ATTR,           /* text foreground and bitmap colour nibbles
+                                   from the attributes */
+    CHECK_GROUP_REVERSE,        /* whole screen reverse */
+    CHECK_GROUP_SEMIGFX,        /* semigraphics with a gap between the
+                                   characters */
+    CHECK_GROUPS
+};
+
+static const char *check_group_names[CHECK_GROUPS] = {
+    "colours from register 26",
+    "attribute colours",
+    "reverse screen",
+    "semigraphics gap"
+};
+
+/* hashes of the lines drawn by the renderer before draw_chars(). A change
+   that is meant to alter the output has to update them, the check prints
+   the new ones. */
+static const uint32_t check_hashes[CHECK_GROUPS][CHECK_RENDERERS] = {
+    { 0x1fe56209, 0xd4ff6b4e, 0xdb024640, 0x0f548375 },
+    { 0x37e94a8b, 0xabc5a087, 0x6398bb59, 0x5457a5a9 },
+    { 0x8912777c, 0x7591ccd6, 0x3ef97e93, 0xacb0b9a9 },
+    { 0x4d52fb7a, 0x0ba9d495, 0x1cfcab90, 0x04be10aa }
+};
+
+static void check_setup_line(int group)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(vdc.attrbuf); i++) {
+        vdc.attrbuf[i] = (uint8_t)check_rand(256);
+        vdc.scrnbuf[i] = (uint8_t)check_rand(256);
+    }
+    for (i = 0; i < sizeof(vdc.regs); i++) {
+        vdc.regs[i] = (uint8_t)check_rand(256);
+    }
+
+    /* mostly 8 pixel wide characters, sometimes with a gap */
+    if (check_rand(2)) {
+        vdc.regs[22] = (uint8_t)((vdc.regs[22] & 0x0f) | 0x70);
+    }
+    if (check_rand(2)) {
+        vdc.regs[22] = (uint8_t)((vdc.regs[22] & 0xf0) | 0x07);
+    }
+
+    switch (group) {
+        case CHECK_GROUP_COLOR_REG:
+            vdc.regs[24] &= (uint8_t)~0x40;
+            vdc.regs[25] &= (uint8_t)~0x60;
+            break;
+        case CHECK_GROUP_ATTR:
+            vdc.regs[24] &= (uint8_t)~0x40;
+            vdc.regs[25] = (uint8_t)((vdc.regs[25] & ~0x20) | 0x40);
+            break;
+        case CHECK_GROUP_REVERSE:
+            vdc.regs[24] |= 0x40;
+            break;
+        case CHECK_GROUP_SEMIGFX:
+            vdc.regs[22] = (uint8_t)((vdc.regs[22] & 0x0f) | ((8 + check_rand(8)) << 4));
+            vdc.regs[25] |= 0x20;
+            break;
+    }
+
+    vdc.charwidth = ((vdc.regs[22] >> 4) + 1) * ((vdc.regs[25] & 0x10) ? 2 : 1);
+    vdc.xsmooth = check_rand((vdc.regs[22] >> 4) + 1);
+    vdc.border_width = check_rand(64);
+    vdc.screen_text_cols = check_rand(2) ? 80 : 1 + check_rand(VDC_SCREEN_MAX_TEXTCOLS);
+    vdc.mem_counter_inc = vdc.screen_text_cols;
+    vdc.bytes_per_char = check_rand(2) ? 16 : 32;
+    vdc.vdc_address_mask = 0xffff;
+    /* the alternate character set must stay inside the 64k too */
+    vdc.chargen_adr = check_rand(4) << 14;
+    vdc.screen_adr = check_rand(0x8000);
+    vdc.attribute_adr = check_rand(0x8000);
+    vdc.mem_counter = check_rand(0x4000);
+    vdc.bitmap_counter = check_rand(0x4000);
+    vdc.crsrpos = (int)(vdc.screen_adr + vdc.mem_counter + check_rand(VDC_SCREEN_MAX_TEXTCOLS));
+    vdc.frame_counter = (int)check_rand(256);
+    vdc.attribute_blink = (int)check_rand(2);
+    vdc.attrbufdraw = check_rand(0x100);
+    vdc.raster.ycounter = check_rand(32);
+}
+
+static int check_lines(void)
+{
+    static uint8_t line[CHECK_LINE_SIZE];
+    unsigned int group, r, n, i;
+    uint32_t hash;
+    int result = 0;
+
+    for (group = 0; group < CHECK_GROUPS; group++) {
+        for (r = 0; r < CHECK_RENDERERS; r++) {
+            check_srand(0x5eed0000 | (group << 4) | r);
+            for (i = 0; i < sizeof(vdc.ram); i++) {
+                vdc.ram[i] = (uint8_t)check_rand(256);
+            }
+            memset(&check_cache, 0, sizeof(check_cache));
+
+            hash = 0;
+            for (n = 0; n < CHECK_LINES; n++) {
+                check_setup_line((int)group);
+                memset(line, 0xee, sizeof(line));
+                vdc.raster.draw_buffer_ptr = line + CHECK_LINE_OFFSET;
+                check_renderers[r].draw();
+                hash = check_hash(hash, line, sizeof(line));
+            }
+
+            if (hash != check_hashes[group][r]) {
+                printf("%s, %s: %u lines hash to 0x%08x instead of 0x%08x\n",
+                       check_renderers[r].name, check_group_names[group],
+                       n, hash, check_hashes[group][r]);
+                result = -1;
+            }
+        }
+    }
+
+    if (result == 0) {
+        printf("%u lines match\n", (unsigned int)(CHECK_GROUPS * CHECK_RENDERERS * CHECK_LINES));
+    }
+    return result;
+}
+
+int main(void)
+{
+    int result = EXIT_SUCCESS;
+
+    init_drawing_tables();
+
+#ifdef __SSE2__
+    printf("SSE2 row expansion\n");
+#endif
+    if (check_rows() < 0) {
+        result = EXIT_FAILURE;
+    }
+    if (check_lines() < 0) {
+        result = EXIT_FAILURE;
+    }
+    return result;
+}
@@ -31,6 +31,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "raster-cache-const.h"
 #include "raster-cache-fill.h"
 #include "raster-cache.h"
@@ -174,6 +178,159 @@ static void init_drawing_tables(void)
 }
 
 
+/*-----------------------------------------------------------------------*/
+
+/* Pixel expansion.  The draw functions first work out the pixel data byte
+   and the colours of every character of the line, then expand the whole
+   row at once: each data byte becomes 8 pixels (16 in double pixel mode),
+   a set bit in the foreground colour, a clear one in the background
+   colour, with one character every `charwidth' pixels.  The characters are
+   drawn from left to right, so if `charwidth' is smaller than the
+   expanded character, the next one overwrites the rest.  */
+
+/* expand `count' characters into 8 pixels each */
+static void draw_row(uint8_t *p, unsigned int charwidth, unsigned int count,
+                     const uint8_t *data, const uint8_t *fg, const uint8_t *bg)
+{
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    /* bit 7 goes to the leftmost pixel */
+    const __m128i bits = _mm_set1_epi64x(0x0102040810204080LL);
+
+    /* 8 characters at a time, each vector holds the pixels of two */
+    for (; i + 8 <= count; i += 8) {
+        __m128i d = _mm_loadl_epi64((const __m128i *)(data + i));
+        __m128i f = _mm_loadl_epi64((const __m128i *)(fg + i));
+        __m128i b = _mm_loadl_epi64((const __m128i *)(bg + i));
+        __m128i dv[4], fv[4], bv[4];
+        int j;
+
+        d = _mm_unpacklo_epi8(d, d);
+        f = _mm_unpacklo_epi8(f, f);
+        b = _mm_unpacklo_epi8(b, b);
+        dv[0] = _mm_unpacklo_epi16(d, d);
+        dv[2] = _mm_unpackhi_epi16(d, d);
+        fv[0] = _mm_unpacklo_epi16(f, f);
+        fv[2] = _mm_unpackhi_epi16(f, f);
+        bv[0] = _mm_unpacklo_epi16(b, b);
+        bv[2] = _mm_unpackhi_epi16(b, b);
+        for (j = 0; j < 4; j += 2) {
+            dv[j + 1] = _mm_unpackhi_epi32(dv[j], dv[j]);
+            dv[j] = _mm_unpacklo_epi32(dv[j], dv[j]);
+            fv[j + 1] = _mm_unpackhi_epi32(fv[j], fv[j]);
+            fv[j] = _mm_unpacklo_epi32(fv[j], fv[j]);
+            bv[j + 1] = _mm_unpackhi_epi32(bv[j], bv[j]);
+            bv[j] = _mm_unpacklo_epi32(bv[j], bv[j]);
+        }
+
+        for (j = 0; j < 4; j++) {
+            __m128i m = _mm_cmpeq_epi8(_mm_and_si128(dv[j], bits), bits);
+            __m128i px = _mm_or_si128(_mm_and_si128(m, fv[j]), _mm_andnot_si128(m, bv[j]));
+
+            if (charwidth == 8) {
+                _mm_storeu_si128((__m128i *)p, px);
+            } else {
+                _mm_storel_epi64((__m128i *)p, px);
+                _mm_storel_epi64((__m128i *)(p + charwidth), _mm_srli_si128(px, 8));
+            }
+            p += 2 * charwidth;
+        }
+    }
+#endif
+
+    for (; i < count; i++, p += charwidth) {
+        uint32_t *ptr = hr_table + (fg[i] << 8) + (bg[i] << 4);
+
+        *((uint32_t *)p) = *(ptr + (data[i] >> 4));
+        *((uint32_t *)p + 1) = *(ptr + (data[i] & 0x0f));
+    }
+}
+
+/* expand `count' characters into 16 pixels each, for double pixel mode */
+static void draw_row_double(uint8_t *p, unsigned int charwidth, unsigned int count,
+                            const uint8_t *data, const uint8_t *fg, const uint8_t *bg)
+{
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    const __m128i bits = _mm_set_epi64x(0x0101020204040808LL, 0x1010202040408080LL);
+
+    /* 8 characters at a time, each vector holds the pixels of one */
+    for (; i + 8 <= count; i += 8) {
+        __m128i d = _mm_loadl_epi64((const __m128i *)(data + i));
+        __m128i f = _mm_loadl_epi64((const __m128i *)(fg + i));
+        __m128i b = _mm_loadl_epi64((const __m128i *)(bg + i));
+        __m128i dv[8], fv[8], bv[8];
+        int j;
+
+        d = _mm_unpacklo_epi8(d, d);
+        f = _mm_unpacklo_epi8(f, f);
+        b = _mm_unpacklo_epi8(b, b);
+        dv[0] = _mm_unpacklo_epi16(d, d);
+        dv[4] = _mm_unpackhi_epi16(d, d);
+        fv[0] = _mm_unpacklo_epi16(f, f);
+        fv[4] = _mm_unpackhi_epi16(f, f);
+        bv[0] = _mm_unpacklo_epi16(b, b);
+        bv[4] = _mm_unpackhi_epi16(b, b);
+        for (j = 0; j < 8; j += 4) {
+            dv[j + 2] = _mm_unpackhi_epi32(dv[j], dv[j]);
+            dv[j] = _mm_unpacklo_epi32(dv[j], dv[j]);
+            fv[j + 2] = _mm_unpackhi_epi32(fv[j], fv[j]);
+            fv[j] = _mm_unpacklo_epi32(fv[j], fv[j]);
+            bv[j + 2] = _mm_unpackhi_epi32(bv[j], bv[j]);
+            bv[j] = _mm_unpacklo_epi32(bv[j], bv[j]);
+        }
+        for (j = 0; j < 8; j += 2) {
+            dv[j + 1] = _mm_unpackhi_epi64(dv[j], dv[j]);
+            dv[j] = _mm_unpacklo_epi64(dv[j], dv[j]);
+            fv[j + 1] = _mm_unpackhi_epi64(fv[j], fv[j]);
+            fv[j] = _mm_unpacklo_epi64(fv[j], fv[j]);
+            bv[j + 1] = _mm_unpackhi_epi64(bv[j], bv[j]);
+            bv[j] = _mm_unpacklo_epi64(bv[j], bv[j]);
+        }
+
+        for (j = 0; j < 8; j++, p += charwidth) {
+            __m128i m = _mm_cmpeq_epi8(_mm_and_si128(dv[j], bits), bits);
+
+            _mm_storeu_si128((__m128i *)p,
+                             _mm_or_si128(_mm_and_si128(m, fv[j]), _mm_andnot_si128(m, bv[j])));
+        }
+    }
+#endif
+
+    for (; i < count; i++, p += charwidth) {
+        uint32_t *pdwl = pdl_table + (fg[i] << 8) + (bg[i] << 4);
+        uint32_t *pdwh = pdh_table + (fg[i] << 8) + (bg[i] << 4);
+
+        *((uint32_t *)p) = *(pdwh + (data[i] >> 4));
+        *((uint32_t *)p + 1) = *(pdwl + (data[i] >> 4));
+        *((uint32_t *)p + 2) = *(pdwh + (data[i] & 0x0f));
+        *((uint32_t *)p + 3) = *(pdwl + (data[i] & 0x0f));
+    }
+}
+
+/* Expand a row of characters in the current pixel size, with the data of
+   the inter character gaps in `gap' if it isn't NULL.  The gaps are drawn
+   first, the characters then overwrite them where they overlap, just like
+   drawing the gap right after each character.  */
+static void draw_chars(uint8_t *p, unsigned int count, const uint8_t *data,
+                       const uint8_t *gap, const uint8_t *fg, const uint8_t *bg)
+{
+    if (vdc.regs[25] & 0x10) { /* double pixel mode */
+        if (gap != NULL) {
+            draw_row_double(p + 16, vdc.charwidth, count, gap, fg, bg);
+        }
+        draw_row_double(p, vdc.charwidth, count, data, fg, bg);
+    } else {
+        if (gap != NULL) {
+            draw_row(p + 8, vdc.charwidth, count, gap, fg, bg);
+        }
+        draw_row(p, vdc.charwidth, count, data, fg, bg);
+    }
+}
+
+
 /* Calculate the displayed character width, and bit-masks for the character byte (d) & inter-character gap byte (d2) */
 /* Various special cases here to cover weird observed behaviour */
 static void calculate_draw_masks(void)
@@ -565,10 +722,12 @@ static void draw_std_text_cached(raster_cache_t *cache, unsigned int xs,
                                  unsigned int xe)
 /* aka raster_modes_draw_line_cached() in raster */
 {
-    uint8_t *p, *q;
-    uint32_t *table_ptr, *pdl_ptr, *pdh_ptr;
+    uint8_t *p;
+    uint8_t gap[VDC_SCREEN_MAX_TEXTCOLS + 1];
+    uint8_t fg[VDC_SCREEN_MAX_TEXTCOLS + 1];
+    uint8_t bg[VDC_SCREEN_MAX_TEXTCOLS + 1];
 
-    unsigned int i;
+    unsigned int i, count = xe - xs + 1;
     int icsi = -1;  /* Inter Character Spacing Index - used as a combo flag/index as to whether there is any intercharacter gap to render */
 
     if (vdc.regs[25] & 0x10) { /* double pixel a.k.a 40column mode */
@@ -586,63 +745,36 @@ static void draw_std_text_cached(raster_cache_t *cache, unsigned int xs,
         + vdc.xsmooth * ((vdc.regs[25] & 0x10) ? 2 : 1)
         - (vdc.regs[22] >> 4) * ((vdc.regs[25] & 0x10) ? 2 : 1)
         + xs * vdc.charwidth;
-    table_ptr = hr_table + ((vdc.regs[26] & 0x0f) << 4);
-    pdl_ptr = pdl_table + ((vdc.regs[26] & 0x0f) << 4);
-    pdh_ptr = pdh_table + ((vdc.regs[26] & 0x0f) << 4);
 
-    if (vdc.regs[25] & 0x10) { /* double pixel mode */
-        for (i = xs; i <= (unsigned int)xe; i++, p += vdc.charwidth) {
-            uint32_t *pdwl = pdl_ptr + ((cache->color_data_1[i] & 0x0f) << 8);
-            uint32_t *pdwh = pdh_ptr + ((cache->color_data_1[i] & 0x0f) << 8);
-            int d = cache->foreground_data[i];
-            *((uint32_t *)p) = *(pdwh + (d >> 4));
-            *((uint32_t *)p + 1) = *(pdwl + (d >> 4));
-            *((uint32_t *)p + 2) = *(pdwh + (d & 0x0f));
-            *((uint32_t *)p + 3) = *(pdwl + (d & 0x0f));
-            if (icsi >= 0) {    /* if there's inter character spacing, then render it */
-                q = p + 16;
-                if ((vdc.regs[25] & 0x20) && (d & semigfxtest[vdc.regs[22] & 0x0F])) { /* If semi-graphics mode and the rightmost active bit is set */
-                    d = mask[icsi];   /* .. figure out how big it is based on the width of the gap */
-                } else { /* otherwise just draw the background */
-                    d = 0;
-                }
-                if (cache->color_data_1[i] & VDC_REVERSE_ATTR) { /* reverse if the reverse attribute is set for this char */
-                    d ^= 0xff;
-                }
-                if (vdc.regs[24] & VDC_REVERSE_ATTR) {  /* whole screen reverse */
-                    d ^= 0xff;
-                }
-                *((uint32_t *)q) = *(pdwh + (d >> 4));
-                *((uint32_t *)q + 1) = *(pdwl + (d >> 4));
-                *((uint32_t *)q + 2) = *(pdwh + (d & 0x0f));
-                *((uint32_t *)q + 3) = *(pdwl + (d & 0x0f));
+    /* foreground colour from the cache, background colour from regs[26] */
+    for (i = 0; i < count; i++) {
+        fg[i] = cache->color_data_1[xs + i] & 0x0f;
+    }
+    memset(bg, vdc.regs[26] & 0x0f, count);
+
+    if (icsi >= 0) {    /* if there's inter character spacing, then render it */
+        for (i = 0; i < count; i++) {
+            int d = cache->foreground_data[xs + i];
+
+            if ((vdc.regs[25] & 0x20) && (d & semigfxtest[vdc.regs[22] & 0x0F])) { /* If semi-graphics mode and the rightmost active bit is set */
+                d = mask[icsi];   /* .. figure out how big it is based on the width of the gap */
+            } else { /* otherwise just draw the background */
+                d = 0;
             }
-        }
-    } else { /* normal text size */
-        for (i = xs; i <= (unsigned int)xe; i++, p += vdc.charwidth) {
-            uint32_t *ptr = table_ptr + ((cache->color_data_1[i] & 0x0f) << 8);
-            int d = cache->foreground_data[i];
-            *((uint32_t *)p) = *(ptr + (d >> 4));
-            *((uint32_t *)p + 1) = *(ptr + (d & 0x0f));
-            if (icsi >= 0) {    /* if there's inter character spacing, then render it */
-                q = p + 8;
-                if ((vdc.regs[25] & 0x20) && (d & semigfxtest[vdc.regs[22] & 0x0F])) { /* If semi-graphics mode and the rightmost active bit is set */
-                    d = mask[icsi];   /* .. figure out how big it is based on the width of the gap */
-                } else { /* otherwise just draw the background */
-                    d = 0;
-                }
-                if (cache->color_data_1[i] & VDC_REVERSE_ATTR) { /* reverse if the reverse attribute is set for this char */
-                    d ^= 0xff;
-                }
-                if (vdc.regs[24] & VDC_REVERSE_ATTR) {  /* whole screen reverse */
-                    d ^= 0xff;
-                }
-                *((uint32_t *)q) = *(ptr + (d >> 4));
-                *((uint32_t *)q + 1) = *(ptr + (d & 0x0f));
+            if (cache->color_data_1[xs + i] & VDC_REVERSE_ATTR) { /* reverse if the reverse attribute is set for this char */
+                d ^= 0xff;
+            }
+            if (vdc.regs[24] & VDC_REVERSE_ATTR) {  /* whole screen reverse */
+                d ^= 0xff;
             }
+            gap[i] = (uint8_t)d;
         }
     }
 
+    draw_chars(p, count, cache->foreground_data + xs, icsi >= 0 ? gap : NULL, fg, bg);
+    p += count * vdc.charwidth;
+    i = xe + 1;
+
     /* fill the last few pixels of the display with bg colour if smooth scroll != 0 - if needed */
     if (i == vdc.screen_text_cols) {
         for (i = vdc.xsmooth; i < (unsigned)(vdc.regs[22] >> 4); i++, p++) {
@@ -657,9 +789,13 @@ static void draw_std_text(void)
    (vdc.raster.draw_buffer_ptr), which is one byte per pixel, based on the VDC
    screen, attr(ibute) and char(set) ram (which are one byte per 8 pixels */
 {
-    uint8_t *p, *q;
-    uint32_t *table_ptr, *pdl_ptr, *pdh_ptr, char_index;
+    uint8_t *p;
+    uint32_t char_index;
     uint8_t *attr_ptr, *screen_ptr;
+    uint8_t data[VDC_SCREEN_MAX_TEXTCOLS];
+    uint8_t gap[VDC_SCREEN_MAX_TEXTCOLS];
+    uint8_t fg[VDC_SCREEN_MAX_TEXTCOLS];
+    uint8_t bg[VDC_SCREEN_MAX_TEXTCOLS];
 
     unsigned int i, d, d2;
     unsigned int cpos = 0xFFFF;
@@ -691,12 +827,10 @@ static void draw_std_text(void)
 
     calculate_draw_masks();
 
-    /* Now actually render everything */
+    /* Now work out the pixels of every character */
     if (vdc.regs[25] & 0x40) {  /* Attribute mode - background colour from regs[26] but foreground from attribute ram */
-        table_ptr = hr_table + ((vdc.regs[26] & 0x0F) << 4);    /* regs[26] & 0xF is the background colour */
-        pdl_ptr = pdl_table + ((vdc.regs[26] & 0x0F) << 4);
-        pdh_ptr = pdh_table + ((vdc.regs[26] & 0x0F) << 4);
-        for (i = 0; i < vdc.screen_text_cols; i++, p += vdc.charwidth) {
+        memset(bg, vdc.regs[26] & 0x0F, vdc.screen_text_cols);    /* regs[26] & 0xF is the background colour */
+        for (i = 0; i < vdc.screen_text_cols; i++) {
             if (vdc.raster.ycounter > (signed)vdc.regs[23]) {
                 /* Return nothing if > Vertical Character Size */
                 d = 0x00;
@@ -755,37 +889,14 @@ static void draw_std_text(void)
 
             d2 &= d2mask;   /* Mask off any extra "on" pixels from the inter-character gap */
 
-            /* actually render the byte into 8 bytes of colour pixels using the lookup tables */
-            if (vdc.regs[25] & 0x10) { /* double pixel mode */
-                uint32_t *pdwl = pdl_ptr + ((*(attr_ptr + i) & 0x0F) << 8);
-                uint32_t *pdwh = pdh_ptr + ((*(attr_ptr + i) & 0x0F) << 8);
-                *((uint32_t *)p) = *(pdwh + (d >> 4));
-                *((uint32_t *)p + 1) = *(pdwl + (d >> 4));
-                *((uint32_t *)p + 2) = *(pdwh + (d & 0x0F));
-                *((uint32_t *)p + 3) = *(pdwl + (d & 0x0F));
-                if (icsi >= 0) {    /* if there's inter character spacing, then render it */
-                    q = p + 16;
-                    *((uint32_t *)q) = *(pdwh + (d2 >> 4));
-                    *((uint32_t *)q + 1) = *(pdwl + (d2 >> 4));
-                    *((uint32_t *)q + 2) = *(pdwh + (d2 & 0x0F));
-                    *((uint32_t *)q + 3) = *(pdwl + (d2 & 0x0F));
-                }
-            } else { /* normal text size */
-                uint32_t *ptr = table_ptr + ((*(attr_ptr + i) & 0x0F) << 8);
-                *((uint32_t *)p) = *(ptr + (d >> 4));
-                *((uint32_t *)p + 1) = *(ptr + (d & 0x0F));
-                if (icsi >= 0) {    /* if there's inter character spacing, then render it */
-                    q = p + 8;
-                    *((uint32_t *)q) = *(ptr + (d2 >> 4));
-                    *((uint32_t *)q + 1) = *(ptr + (d2 & 0x0F));
-                }
-            }
+            data[i] = (uint8_t)d;
+            gap[i] = (uint8_t)d2;
+            fg[i] = *(attr_ptr + i) & 0x0F;
         }
     } else {    /* Monochrome mode - foreground & background colours both from register 26 */
-        uint32_t *ptr = hr_table + (vdc.regs[26] << 4);
-        uint32_t *pdwl = pdl_table + (vdc.regs[26] << 4);  /* Pointers into the lookup tables */
-        uint32_t *pdwh = pdh_table + (vdc.regs[26] << 4);
-        for (i = 0; i < vdc.screen_text_cols; i++, p += vdc.charwidth) {
+        memset(fg, vdc.regs[26] >> 4, vdc.screen_text_cols);
+        memset(bg, vdc.regs[26] & 0x0F, vdc.screen_text_cols);
+        for (i = 0; i < vdc.screen_text_cols; i++) {
             if (vdc.raster.ycounter > (signed)vdc.regs[23]) {
                 /* Return nothing if > Vertical Character Size */
                 d = 0x00;
@@ -824,30 +935,15 @@ static void draw_std_text(void)
 
             d2 &= d2mask;   /* Mask off any extra "on" pixels from the inter-character gap */
 
-            /* actually render the byte into 8 bytes of colour pixels using the lookup tables */
-            if (vdc.regs[25] & 0x10) { /* double pixel mode */
-                *((uint32_t *)p) = *(pdwh + (d >> 4));
-                *((uint32_t *)p + 1) = *(pdwl + (d >> 4));
-                *((uint32_t *)p + 2) = *(pdwh + (d & 0x0F));
-                *((uint32_t *)p + 3) = *(pdwl + (d & 0x0F));
-                if (icsi >= 0) {    /* if there's inter character spacing, then render it */
-                    q = p + 16;
-                    *((uint32_t *)q) = *(pdwh + (d2 >> 4));
-                    *((uint32_t *)q + 1) = *(pdwl + (d2 >> 4));
-                    *((uint32_t *)q + 2) = *(pdwh + (d2 & 0x0F));
-                    *((uint32_t *)q + 3) = *(pdwl + (d2 & 0x0F));
-                }
-            } else { /* normal text size */
-                *((uint32_t *)p) = *(ptr + (d >> 4));
-                *((uint32_t *)p + 1) = *(ptr + (d & 0x0F));
-                if (icsi >= 0) {    /* if there's inter character spacing, then render it */
-                    q = p + 8;
-                    *((uint32_t *)q) = *(ptr + (d2 >> 4));
-                    *((uint32_t *)q + 1) = *(ptr + (d2 & 0x0F));
-                }
-            }
+            data[i] = (uint8_t)d;
+            gap[i] = (uint8_t)d2;
         }
     }
+
+    /* actually render the bytes into colour pixels */
+    draw_chars(p, vdc.screen_text_cols, data, icsi >= 0 ? gap : NULL, fg, bg);
+    p += vdc.screen_text_cols * vdc.charwidth;
+
     /* fill the last few pixels of the display with bg colour if smooth scroll != 0 */
     for (i = vdc.xsmooth; i < (unsigned)(vdc.regs[22] >> 4); i++, p++) {
         *p = (vdc.regs[26] & 0x0F);
@@ -894,10 +990,10 @@ static void draw_std_bitmap_cached(raster_cache_t *cache, unsigned int xs,
 /* raster_modes_draw_line_cached() in raster */
 {
     uint8_t *p;
-    uint32_t *table_ptr, *pdl_ptr, *pdh_ptr;
-    uint32_t *ptr, *pdwl, *pdwh;
+    uint8_t fgbuf[VDC_SCREEN_MAX_TEXTCOLS + 1];
+    uint8_t bgbuf[VDC_SCREEN_MAX_TEXTCOLS + 1];
 
-    unsigned int i, d, j, fg, bg;
+    unsigned int i, d, j, fg, bg, count = xe - xs + 1;
     p = vdc.raster.draw_buffer_ptr
         + vdc.border_width
         + ((vdc.regs[25] & 0x10) ? 2 : 0)
@@ -905,59 +1001,23 @@ static void draw_std_bitmap_cached(raster_cache_t *cache, unsigned int xs,
         - (vdc.regs[22] >> 4) * ((vdc.regs[25] & 0x10) ? 2 : 1)
         + xs * vdc.charwidth;
 
-    /* TODO: See if we even need to split these renderers between attr/mono, because the attr data is filled either way. draw_std_text_cached mode() doesn't differentiate */
+    for (i = 0; i < count; i++) {
+        fgbuf[i] = cache->color_data_1[xs + i] & 0x0f;
+    }
     if (vdc.regs[25] & 0x40) {
-        /* attribute mode */
-        if (vdc.regs[25] & 0x10) { /* double pixel mode */
-            for (i = xs; i <= (unsigned int)xe; i++, p += vdc.charwidth) {
-                d = cache->foreground_data[i];
-                pdwl = pdl_table + ((cache->color_data_1[i] & 0x0f) << 8) + (cache->color_data_1[i] & 0xf0);
-                pdwh = pdh_table + ((cache->color_data_1[i] & 0x0f) << 8) + (cache->color_data_1[i] & 0xf0);
-                *((uint32_t *)p) = *(pdwh + (d >> 4));
-                *((uint32_t *)p + 1) = *(pdwl + (d >> 4));
-                *((uint32_t *)p + 2) = *(pdwh + (d & 0x0f));
-                *((uint32_t *)p + 3) = *(pdwl + (d & 0x0f));
-            }
-        } else { /* normal text size */
-            for (i = xs; i <= (unsigned int)xe; i++, p += vdc.charwidth) {
-                d = cache->foreground_data[i];
-
-                table_ptr = hr_table + (cache->color_data_1[i] & 0xf0);
-                ptr = table_ptr + ((cache->color_data_1[i] & 0x0f) << 8);
-
-                *((uint32_t *)p) = *(ptr + (d >> 4));
-                *((uint32_t *)p + 1) = *(ptr + (d & 0x0f));
-            }
+        /* attribute mode - background colour from the upper nibble */
+        for (i = 0; i < count; i++) {
+            bgbuf[i] = cache->color_data_1[xs + i] >> 4;
         }
     } else {
         /* monochrome mode - attributes from register 26 */
-        if (vdc.regs[25] & 0x10) { /* double pixel mode */
-            pdl_ptr = pdl_table + ((vdc.regs[26] & 0x0f) << 4);
-            pdh_ptr = pdh_table + ((vdc.regs[26] & 0x0f) << 4);
-
-            for (i = xs; i <= (unsigned int)xe; i++, p += vdc.charwidth) {
-                d = cache->foreground_data[i];
-                pdwl = pdl_ptr + ((cache->color_data_1[i] & 0x0f) << 8);
-                pdwh = pdh_ptr + ((cache->color_data_1[i] & 0x0f) << 8);
-                *((uint32_t *)p) = *(pdwh + (d >> 4));
-                *((uint32_t *)p + 1) = *(pdwl + (d >> 4));
-                *((uint32_t *)p + 2) = *(pdwh + (d & 0x0f));
-                *((uint32_t *)p + 3) = *(pdwl + (d & 0x0f));
-            }
-        } else { /* normal text size */
-            table_ptr = hr_table + ((vdc.regs[26] & 0x0f) << 4);
-
-            for (i = xs; i <= (unsigned int)xe; i++, p += vdc.charwidth) {
-                d = cache->foreground_data[i];
-
-                ptr = table_ptr + ((cache->color_data_1[i] & 0x0f) << 8);
-
-                *((uint32_t *)p) = *(ptr + (d >> 4));
-                *((uint32_t *)p + 1) = *(ptr + (d & 0x0f));
-            }
-        }
+        memset(bgbuf, vdc.regs[26] & 0x0f, count);
     }
 
+    draw_chars(p, count, cache->foreground_data + xs, NULL, fgbuf, bgbuf);
+    p += count * vdc.charwidth;
+    i = xe + 1;
+
     /* fill the last few pixels of the display with bg colour if xsmooth scroll != maximum  */
     d = cache->foreground_data[i];
     if (vdc.regs[24] & VDC_REVERSE_ATTR) {
@@ -988,8 +1048,12 @@ static void draw_std_bitmap(void)
 /* raster_modes_draw_line() in raster - draw bitmap mode when cache is not used
    See draw_std_text(), this is for bitmap mode. */
 {
-    uint8_t *p, *q;
+    uint8_t *p;
     uint8_t *attr_ptr;
+    uint8_t data[VDC_SCREEN_MAX_TEXTCOLS];
+    uint8_t gap[VDC_SCREEN_MAX_TEXTCOLS];
+    uint8_t fgbuf[VDC_SCREEN_MAX_TEXTCOLS];
+    uint8_t bgbuf[VDC_SCREEN_MAX_TEXTCOLS];
 
     unsigned int i, d, d2, j, fg, bg, bitmap_index;
     int icsi = -1;  /* Inter Character Spacing Index - used as a combo flag/index as to whether there is any intercharacter gap to render */
@@ -1016,19 +1080,15 @@ static void draw_std_bitmap(void)
 
     calculate_draw_masks();
 
-    for (i = 0; i < vdc.mem_counter_inc; i++, p += vdc.charwidth) {
-        uint32_t *ptr, *pdwl, *pdwh;
-
+    for (i = 0; i < vdc.mem_counter_inc; i++) {
         if (vdc.regs[25] & 0x40) {
             /* attribute mode */
-            ptr = hr_table + (*(attr_ptr + i) & 0xf0) + ((*(attr_ptr + i) & 0x0f) << 8);
-            pdwl = pdl_table + (*(attr_ptr + i) & 0xf0) + ((*(attr_ptr + i) & 0x0f) << 8);
-            pdwh = pdh_table + (*(attr_ptr + i) & 0xf0) + ((*(attr_ptr + i) & 0x0f) << 8);
+            fgbuf[i] = *(attr_ptr + i) & 0x0f;
+            bgbuf[i] = *(attr_ptr + i) >> 4;
         } else {
             /* monochrome mode - attributes from register 26 */
-            ptr = hr_table + (vdc.regs[26] << 4);
-            pdwl = pdl_table + (vdc.regs[26] << 4);  /* Pointers into the lookup tables */
-            pdwh = pdh_table + (vdc.regs[26] << 4);
+            fgbuf[i] = vdc.regs[26] >> 4;
+            bgbuf[i] = vdc.regs[26] & 0x0f;
         }
 
         if (vdc.raster.ycounter > (signed)vdc.regs[23]) {
@@ -1053,30 +1113,14 @@ static void draw_std_bitmap(void)
 
         d2 &= d2mask;   /* Mask off any extra "on" pixels from the inter-character gap */
 
-        /* actually render the byte into 8 bytes of colour pixels using the lookup tables */
-        if (vdc.regs[25] & 0x10) { /* double pixel mode */
-            *((uint32_t *)p) = *(pdwh + (d >> 4));
-            *((uint32_t *)p + 1) = *(pdwl + (d >> 4));
-            *((uint32_t *)p + 2) = *(pdwh + (d & 0x0f));
-            *((uint32_t *)p + 3) = *(pdwl + (d & 0x0f));
-            if (icsi >= 0) {    /* if there's inter character spacing, then render it */
-                q = p + 16;
-                *((uint32_t *)q) = *(pdwh + (d2 >> 4));
-                *((uint32_t *)q + 1) = *(pdwl + (d2 >> 4));
-                *((uint32_t *)q + 2) = *(pdwh + (d2 & 0x0F));
-                *((uint32_t *)q + 3) = *(pdwl + (d2 & 0x0F));
-            }
-        } else { /* normal pixel size */
-            *((uint32_t *)p) = *(ptr + (d >> 4));
-            *((uint32_t *)p + 1) = *(ptr + (d & 0x0f));
-            if (icsi >= 0) {    /* if there's inter character spacing, then render it */
-                q = p + 8;
-                *((uint32_t *)q) = *(ptr + (d2 >> 4));
-                *((uint32_t *)q + 1) = *(ptr + (d2 & 0x0F));
-            }
-        }
+        data[i] = (uint8_t)d;
+        gap[i] = (uint8_t)d2;
     }
 
+    /* actually render the bytes into colour pixels */
+    draw_chars(p, vdc.mem_counter_inc, data, icsi >= 0 ? gap : NULL, fgbuf, bgbuf);
+    p += vdc.mem_counter_inc * vdc.charwidth;
+
     /* fill the last few pixels of the display with bg colour if xsmooth scroll != maximum  */
     d = vdc_ram_read(bitmap_index + i); /* grab the data byte from the bitmap */
     if (vdc.regs[24] & VDC_REVERSE_ATTR) { /* reverse screen bit */
@@ -83,6 +83,8 @@ static sound_chip_t vic_sound_chip = {
     vic_sound_machine_calculate_samples, /* sound chip calculate samples function */
     vic_sound_machine_store,             /* sound chip store function */
     NULL,                                /* NO sound chip read function */
+    NULL,                                /* NO sound chip shadow read function */
+    NULL,                                /* NO sound chip shadow store function */
     vic_sound_reset,                     /* sound chip reset function */
     vic_sound_machine_cycle_based,       /* sound chip 'is_cycle_based()' function, chip is NOT cycle based */
     vic_sound_machine_channels,          /* sound chip 'get_amount_of_channels()' function, sound chip has 1 channel */
@@ -0,0 +1,61 @@
+/*
+ * vicecheck.h - Common code for the checkers run by "make check".
+ *
+ * See "Checkers" in doc/coding-guidelines.txt for how the checkers are laid
+ * out.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_CHECK_H
+#define VICE_CHECK_H
+
+#include "types.h"
+
+/* Checkers draw their input from this fixed sequence instead of rand(), so
+   a failure can be reproduced on any host and any C library. */
+static uint32_t check_seed;
+
+/* start the sequence at `seed' */
+static inline void check_srand(uint32_t seed)
+{
+    check_seed = seed;
+}
+
+/* next number of the sequence, 0 to range - 1 */
+static inline unsigned int check_rand(unsigned int range)
+{
+    check_seed = check_seed * 1103515245 + 12345;
+    return (check_seed >> 8) % range;
+}
+
+/* add `len' bytes to the hash `hash', to compare output with a recorded
+   value */
+static inline uint32_t check_hash(uint32_t hash, const uint8_t *data, unsigned int len)
+{
+    unsigned int i;
+
+    for (i = 0; i < len; i++) {
+        hash = hash * 31 + data[i];
+    }
+    return hash;
+}
+
+#endif
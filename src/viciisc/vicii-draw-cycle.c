@@ -141,7 +141,7 @@ static const uint8_t colors[] = {
     COL_NONE, COL_NONE, COL_NONE, COL_NONE          /* ECM=1 BMM=1 MCM=1 */
 };
 
-static DRAW_INLINE void draw_graphics(int i)
+static DRAW_INLINE void draw_graphics(int i, int skip)
 {
     uint8_t px;
     uint8_t cc;
@@ -192,8 +192,13 @@ static DRAW_INLINE void draw_graphics(int i)
     gbuf_mc_flop ^= 1;
 
     /* Determine pixel color and priority */
-    vmode = vmode11_pipe | vmode16_pipe;
     pixel_pri = (px & 0x2);
+    if (skip) {
+        /* only the priority is needed for the collisions */
+        pri_buffer[i] = pixel_pri;
+        return;
+    }
+    vmode = vmode11_pipe | vmode16_pipe;
     cc = colors[vmode | px];
 
     /* lookup colors and render pixel */
@@ -224,7 +229,7 @@ static DRAW_INLINE void draw_graphics(int i)
     pri_buffer[i] = pixel_pri;
 }
 
-static DRAW_INLINE void draw_graphics8(unsigned int cycle_flags)
+static DRAW_INLINE void draw_graphics8(unsigned int cycle_flags, int skip)
 {
     int vis_en;
 
@@ -232,34 +237,34 @@ static DRAW_INLINE void draw_graphics8(unsigned int cycle_flags)
 
     /* render pixels */
     /* pixel 0 */
-    draw_graphics(0);
+    draw_graphics(0, skip);
     /* pixel 1 */
-    draw_graphics(1);
+    draw_graphics(1, skip);
     /* pixel 2 */
-    draw_graphics(2);
+    draw_graphics(2, skip);
     /* pixel 3 */
-    draw_graphics(3);
+    draw_graphics(3, skip);
     /* pixel 4 */
     vmode16_pipe = ( vicii.regs[0x16] & 0x10 ) >> 2;
     if (vicii.color_latency) {
         /* handle rising edge of internal signal */
         vmode11_pipe |= ( vicii.regs[0x11] & 0x60 ) >> 2;
     }
-    draw_graphics(4);
+    draw_graphics(4, skip);
     /* pixel 5 */
-    draw_graphics(5);
+    draw_graphics(5, skip);
     /* pixel 6 */
     if (vicii.color_latency) {
         /* handle falling edge of internal signal */
         vmode11_pipe &= ( vicii.regs[0x11] & 0x60 ) >> 2;
     }
-    draw_graphics(6);
+    draw_graphics(6, skip);
     /* pixel 7 */
     if (vmode16_pipe && !vmode16_pipe2) {
         gbuf_mc_flop = 0;
     }
     vmode16_pipe2 = vmode16_pipe;
-    draw_graphics(7);
+    draw_graphics(7, skip);
 
     if (!vicii.color_latency) {
         vmode11_pipe = ( vicii.regs[0x11] & 0x60 ) >> 2;
@@ -538,10 +543,15 @@ static DRAW_INLINE void draw_sprites8(unsigned int cycle_flags)
  *
  ******/
 
-static DRAW_INLINE void draw_border8(void)
+static DRAW_INLINE void draw_border8(int skip)
 {
     uint8_t csel = vicii.regs[0x16] & 0x8;
 
+    if (skip) {
+        border_state = vicii.main_border;
+        return;
+    }
+
 #if 1
     /* early exit for the no border case */
     if (!(border_state || vicii.main_border)) {
@@ -623,10 +633,19 @@ static DRAW_INLINE void draw_colors_8565(int offs, int i)
     pixel_buffer[i] = render_buffer[i];
 }
 
-static DRAW_INLINE void draw_colors8(void)
+static DRAW_INLINE void draw_colors8(int skip)
 {
     int offs = vicii.dbuf_offset;
 
+    if (skip) {
+        /* keep the color registers up to date for the next drawn frame */
+        if (last_color_reg != 0xff) {
+            cregs[last_color_reg] = last_color_value;
+        }
+        update_cregs();
+        return;
+    }
+
     /* guard (could possibly be removed) */
     if (offs > VICII_DRAW_BUFFER_SIZE - 8) {
         return;
@@ -676,13 +695,16 @@ void vicii_draw_cycle(void)
         vicii.dbuf_offset = 0;
     }
 
-    draw_graphics8(cycle_flags_pipe);
+    /* Skipped frames only compute the collisions.  The sprites are drawn
+       the same way in both cases; what they leave in render_buffer is not
+       read before the next drawn frame has refilled it. */
+    draw_graphics8(cycle_flags_pipe, vicii.skip_frame);
 
     draw_sprites8(cycle_flags_pipe);
 
-    draw_border8();
+    draw_border8(vicii.skip_frame);
 
-    draw_colors8();
+    draw_colors8(vicii.skip_frame);
 
     cycle_flags_pipe = vicii.cycle_flags;
 }
@@ -95,6 +95,12 @@ static int set_vsp_bug_enabled(int val, void *param)
     return 0;
 }
 
+static int set_video_skip(int val, void *param)
+{
+    vicii_resources.video_skip = val ? 1 : 0;
+    return 0;
+}
+
 struct vicii_model_info_s {
     int video;
     int luma;
@@ -165,6 +171,9 @@ static const resource_int_t resources_int[] =
     { "VICIIVSPBug", 0, RES_EVENT_SAME, NULL,
       &vicii_resources.vsp_bug_enabled,
       set_vsp_bug_enabled, NULL },
+    { "VICIIVideoSkip", 0, RES_EVENT_NO, NULL,
+      &vicii_resources.video_skip,
+      set_video_skip, NULL },
     RESOURCE_INT_LIST_END
 };
 
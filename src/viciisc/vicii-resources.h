@@ -45,6 +45,9 @@ struct vicii_resources_s {
 
     /* Flag: Do we emulate the "VSP bug" behaviour? */
     int vsp_bug_enabled;
+
+    /* Flag: Do we skip drawing frames, computing only the collisions? */
+    int video_skip;
 };
 typedef struct vicii_resources_s vicii_resources_t;
 
@@ -415,6 +415,28 @@ void vicii_update_memory_ptrs_external(void)
 {
 }
 
+/* Check if the next frame can be skipped ("VICIIVideoSkip").  */
+static int vicii_skip_next_frame(void)
+{
+    if (!vicii_resources.video_skip) {
+        return 0;
+    }
+
+    /* requested by a screenshot, e.g. from the binary monitor */
+    if (vicii.draw_next_frame) {
+        vicii.draw_next_frame = 0;
+        return 0;
+    }
+
+    /* the emulation can end at any time (-limitcycles, -debugcart, the
+       monitor), every frame must be complete for -exitscreenshot */
+    if (machine_exit_screenshot_requested()) {
+        return 0;
+    }
+
+    return 1;
+}
+
 /* Redraw the current raster line.  This happens after the last cycle
    of each line.  */
 void vicii_raster_draw_handler(void)
@@ -433,7 +455,12 @@ void vicii_raster_draw_handler(void)
                            <= ((unsigned int)vicii.last_displayed_line - vicii.screen_height);
     }
 #endif
-    raster_line_emulate(&vicii.raster);
+    if (vicii.skip_frame) {
+        /* only the collisions have been computed for this line */
+        raster_line_skip(&vicii.raster);
+    } else {
+        raster_line_emulate(&vicii.raster);
+    }
 
     vsync_do_end_of_line();
 
@@ -441,6 +468,7 @@ void vicii_raster_draw_handler(void)
         /* no vsync here for NTSC  */
         if ((unsigned int)vicii.last_displayed_line < vicii.screen_height) {
             vsync_do_vsync(vicii.raster.canvas);
+            vicii.skip_frame = vicii_skip_next_frame();
         }
 
     }
@@ -449,6 +477,7 @@ void vicii_raster_draw_handler(void)
     if ((unsigned int)vicii.last_displayed_line >= vicii.screen_height
         && vicii.raster.current_line == vicii.last_displayed_line - vicii.screen_height + 1) {
         vsync_do_vsync(vicii.raster.canvas);
+        vicii.skip_frame = vicii_skip_next_frame();
     }
 }
 
@@ -529,6 +558,11 @@ void vicii_screenshot(screenshot_t *screenshot)
         }
     }
 
+    /* nothing is drawn while skipping frames, draw the next one */
+    if (vicii.skip_frame) {
+        vicii.draw_next_frame = 1;
+    }
+
     raster_screenshot(&vicii.raster, screenshot);
 
     screenshot->chipid = "VICII";
@@ -254,6 +254,12 @@ struct vicii_s {
     struct video_chip_cap_s *video_chip_cap;
 
     unsigned int int_num;
+
+    /* Flag: Is the current frame skipped ("VICIIVideoSkip")?  */
+    int skip_frame;
+
+    /* Flag: Draw the next frame even if frames are skipped.  */
+    int draw_next_frame;
 };
 typedef struct vicii_s vicii_t;
 
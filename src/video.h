@@ -279,10 +279,19 @@ void video_canvas_unmap(struct video_canvas_s *canvas);
 void video_canvas_resize(struct video_canvas_s *canvas, char resize_canvas);
 void video_canvas_render(struct video_canvas_s *canvas, uint8_t *trg, int width, int height, int xs, int ys, int xt, int yt, int pitcht);
 void video_canvas_refresh_all(struct video_canvas_s *canvas);
+void video_canvas_refresh_all_frame(struct video_canvas_s *canvas);
 char video_canvas_can_resize(struct video_canvas_s *canvas);
 void video_viewport_get(struct video_canvas_s *canvas, struct viewport_s **viewport, struct geometry_s **geometry);
 void video_viewport_resize(struct video_canvas_s *canvas, char resize_canvas);
 
+/* video-refresh-thread.c */
+int video_canvas_refresh_thread_start(struct video_canvas_s *canvas);
+void video_canvas_refresh_thread_stop(struct video_canvas_s *canvas);
+void video_canvas_refresh_thread_wait(struct video_canvas_s *canvas);
+uint8_t *video_canvas_refresh_thread_source(struct video_canvas_s *canvas);
+void video_canvas_refresh_frame(struct video_canvas_s *canvas, unsigned int xs, unsigned int ys, unsigned int xi, unsigned int yi,
+                                unsigned int w, unsigned int h);
+
 struct raster_s;
 
 int video_resources_init(void);
@@ -95,6 +95,8 @@ void video_canvas_shutdown(video_canvas_t *canvas)
     int i;
 
     if (canvas != NULL) {
+        video_canvas_refresh_thread_stop(canvas);
+
         /* Remove canvas from tracking */
         for (i = 0; i < TRACKED_CANVAS_MAX; i++) {
             if (tracked_canvas[i] == canvas) {
@@ -116,6 +118,7 @@ void video_canvas_render(video_canvas_t *canvas, uint8_t *trg, int width,
                          int pitcht)
 {
     viewport_t *viewport = canvas->viewport;
+    uint8_t *src;
 #ifdef VIDEO_SCALE_SOURCE
     xs /= canvas->videoconfig->scalex;
     ys /= canvas->videoconfig->scaley;
@@ -130,7 +133,12 @@ void video_canvas_render(video_canvas_t *canvas, uint8_t *trg, int width,
     if (!canvas->videoconfig->color_tables.updated) { /* update colors as necessary */
         video_color_update_palette(canvas);
     }
-    video_render_main(canvas->videoconfig, canvas->draw_buffer->draw_buffer,
+    /* on the refresh thread the frame is rendered from a copy */
+    src = video_canvas_refresh_thread_source(canvas);
+    if (src == NULL) {
+        src = canvas->draw_buffer->draw_buffer;
+    }
+    video_render_main(canvas->videoconfig, src,
                       trg, width, height, xs, ys, xt, yt,
                       canvas->draw_buffer->draw_buffer_width, pitcht,
                       viewport);
@@ -152,7 +160,11 @@ void video_canvas_refresh_all_tracked(void)
     }
 }
 
-void video_canvas_refresh_all(video_canvas_t *canvas)
+static void refresh_all(video_canvas_t *canvas,
+                        void (*refresh)(video_canvas_t *canvas,
+                                        unsigned int xs, unsigned int ys,
+                                        unsigned int xi, unsigned int yi,
+                                        unsigned int w, unsigned int h))
 {
     viewport_t *viewport;
     geometry_t *geometry;
@@ -164,16 +176,29 @@ void video_canvas_refresh_all(video_canvas_t *canvas)
     viewport = canvas->viewport;
     geometry = canvas->geometry;
 
-    video_canvas_refresh(canvas,
-                         viewport->first_x
-                         + geometry->extra_offscreen_border_left,
-                         viewport->first_line,
-                         viewport->x_offset,
-                         viewport->y_offset,
-                         MIN(canvas->draw_buffer->canvas_width,
-                             geometry->screen_size.width - viewport->first_x),
-                         MIN(canvas->draw_buffer->canvas_height,
-                             viewport->last_line - viewport->first_line + 1));
+    refresh(canvas,
+            viewport->first_x
+            + geometry->extra_offscreen_border_left,
+            viewport->first_line,
+            viewport->x_offset,
+            viewport->y_offset,
+            MIN(canvas->draw_buffer->canvas_width,
+                geometry->screen_size.width - viewport->first_x),
+            MIN(canvas->draw_buffer->canvas_height,
+                viewport->last_line - viewport->first_line + 1));
+}
+
+void video_canvas_refresh_all(video_canvas_t *canvas)
+{
+    /* don't render at the same time as the refresh thread */
+    video_canvas_refresh_thread_wait(canvas);
+    refresh_all(canvas, video_canvas_refresh);
+}
+
+/* refresh all of a finished frame, see video_canvas_refresh_frame() */
+void video_canvas_refresh_all_frame(video_canvas_t *canvas)
+{
+    refresh_all(canvas, video_canvas_refresh_frame);
 }
 
 int video_canvas_palette_set(struct video_canvas_s *canvas,
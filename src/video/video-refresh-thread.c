@@ -0,0 +1,352 @@
+/** \file   video-refresh-thread.c
+ * \brief   Render the frames of a canvas on their own thread
+ *
+ * At the end of a frame the raster code refreshes the canvas, which renders
+ * the draw buffer (palette conversion, CRT emulation, scaling) into the
+ * host frame buffer. When a machine shows two canvases at the same time, as
+ * x128 does with the VIC-II and VDC windows, both are rendered one after
+ * the other on the emulation thread.
+ *
+ * A canvas can get a refresh thread instead. At the end of a frame the
+ * finished draw buffer is copied into a buffer owned by that thread, which
+ * then renders and refreshes the canvas from the copy, while the emulation
+ * draws the next frame. If the previous frame is still being rendered the
+ * emulation waits for it.
+ *
+ * The refresh code of the UI must be safe to call from another thread for
+ * this, and all other refreshes of such a canvas wait for its thread first.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include "videoarch.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef USE_VICE_THREAD
+#include <pthread.h>
+#endif
+
+#include "lib.h"
+#include "log.h"
+#include "types.h"
+#include "video.h"
+
+
+#ifdef USE_VICE_THREAD
+
+/** \brief  Number of canvases that can have a refresh thread
+ */
+#define REFRESH_THREADS_MAX 2
+
+/** \brief  Lines of padding above and below the draw buffer
+ *
+ * See raster_calculate_padding_size(), the CRT and Scale2x filters read
+ * them.
+ */
+#define REFRESH_PADDING_LINES   2
+
+typedef struct refresh_thread_s {
+    video_canvas_t *canvas;     /**< canvas, NULL if the slot is free */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool busy;                  /**< a frame is queued or being rendered */
+    bool quit;
+
+    uint8_t *frame;             /**< copy of the padded draw buffer */
+    size_t frame_size;          /**< allocated size of frame */
+    unsigned int pitch;         /**< width of the copied draw buffer */
+
+    /* the area to refresh */
+    unsigned int xs, ys, xi, yi, w, h;
+
+    /* statistics, logged when the thread is stopped */
+    unsigned long frames;
+    unsigned long stalls;
+} refresh_thread_t;
+
+static refresh_thread_t threads[REFRESH_THREADS_MAX];
+
+/* protects the canvas of the slots, the refresh threads look them up */
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static refresh_thread_t *find_thread(video_canvas_t *canvas)
+{
+    int i;
+
+    for (i = 0; i < REFRESH_THREADS_MAX; i++) {
+        if (threads[i].canvas == canvas) {
+            return &threads[i];
+        }
+    }
+    return NULL;
+}
+
+static void *refresh_thread_main(void *data)
+{
+    refresh_thread_t *t = data;
+
+    pthread_mutex_lock(&t->lock);
+
+    for (;;) {
+        while (!t->busy && !t->quit) {
+            pthread_cond_wait(&t->cond, &t->lock);
+        }
+        if (!t->busy) {
+            break;
+        }
+
+        /* the emulation doesn't touch the copy or the area while busy */
+        pthread_mutex_unlock(&t->lock);
+        video_canvas_refresh(t->canvas, t->xs, t->ys, t->xi, t->yi, t->w, t->h);
+        pthread_mutex_lock(&t->lock);
+
+        t->busy = false;
+        pthread_cond_broadcast(&t->cond);
+    }
+
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+/* wait until the thread is done with the last frame, returns true if it
+   had to wait */
+static bool wait_idle(refresh_thread_t *t)
+{
+    bool waited = false;
+
+    pthread_mutex_lock(&t->lock);
+    while (t->busy) {
+        waited = true;
+        pthread_cond_wait(&t->cond, &t->lock);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return waited;
+}
+
+/** \brief  Give a canvas its own refresh thread
+ *
+ * \param[in]   canvas  canvas
+ *
+ * \return  0 on success, -1 on failure
+ */
+int video_canvas_refresh_thread_start(video_canvas_t *canvas)
+{
+    refresh_thread_t *t;
+
+    if (find_thread(canvas) != NULL) {
+        return 0;
+    }
+    t = find_thread(NULL);
+    if (t == NULL) {
+        log_error(LOG_DEFAULT, "No free refresh thread for the canvas.");
+        return -1;
+    }
+
+    pthread_mutex_lock(&threads_lock);
+    memset(t, 0, sizeof *t);
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->cond, NULL);
+    t->canvas = canvas;
+
+    if (pthread_create(&t->thread, NULL, refresh_thread_main, t) != 0) {
+        log_error(LOG_DEFAULT, "Cannot start the refresh thread, refreshing on the emulation thread.");
+        pthread_cond_destroy(&t->cond);
+        pthread_mutex_destroy(&t->lock);
+        t->canvas = NULL;
+        pthread_mutex_unlock(&threads_lock);
+        return -1;
+    }
+    pthread_mutex_unlock(&threads_lock);
+    return 0;
+}
+
+/** \brief  Stop the refresh thread of a canvas
+ *
+ * The last frame is refreshed before the thread exits. Nothing happens if
+ * the canvas has no refresh thread.
+ *
+ * \param[in]   canvas  canvas
+ */
+void video_canvas_refresh_thread_stop(video_canvas_t *canvas)
+{
+    refresh_thread_t *t = find_thread(canvas);
+
+    if (t == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&t->lock);
+    t->quit = true;
+    pthread_cond_broadcast(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    pthread_join(t->thread, NULL);
+
+    log_message(LOG_DEFAULT, "Refresh thread: %lu frames, waited for %lu.",
+                t->frames, t->stalls);
+
+    pthread_mutex_lock(&threads_lock);
+    pthread_cond_destroy(&t->cond);
+    pthread_mutex_destroy(&t->lock);
+    lib_free(t->frame);
+    t->frame = NULL;
+    t->canvas = NULL;
+    pthread_mutex_unlock(&threads_lock);
+}
+
+/** \brief  Wait until the refresh thread of a canvas is idle
+ *
+ * Must be called before anything the thread reads for rendering (the
+ * canvas, its render config or draw buffer geometry) is changed.
+ *
+ * \param[in]   canvas  canvas, NULL for all canvases with a refresh thread
+ */
+void video_canvas_refresh_thread_wait(video_canvas_t *canvas)
+{
+    int i;
+
+    for (i = 0; i < REFRESH_THREADS_MAX; i++) {
+        if (threads[i].canvas != NULL
+            && (canvas == NULL || threads[i].canvas == canvas)) {
+            wait_idle(&threads[i]);
+        }
+    }
+}
+
+/** \brief  Get the draw buffer to render a canvas from
+ *
+ * Called by video_canvas_render(). On the refresh thread of the canvas this
+ * is the copy of the finished frame.
+ *
+ * \param[in]   canvas  canvas
+ *
+ * \return  the copied draw buffer, NULL to use the canvas' draw buffer
+ */
+uint8_t *video_canvas_refresh_thread_source(video_canvas_t *canvas)
+{
+    refresh_thread_t *t;
+    uint8_t *src = NULL;
+
+    pthread_mutex_lock(&threads_lock);
+    t = find_thread(canvas);
+    if (t != NULL && t->frame != NULL && pthread_equal(pthread_self(), t->thread)) {
+        src = t->frame + REFRESH_PADDING_LINES * t->pitch;
+    }
+    pthread_mutex_unlock(&threads_lock);
+    return src;
+}
+
+/** \brief  Refresh a finished frame of a canvas
+ *
+ * Like video_canvas_refresh(), but on the refresh thread of the canvas if it
+ * has one. Interlaced frames are always refreshed right away, the two fields
+ * are swapped right after the refresh.
+ *
+ * \param[in]   canvas  canvas
+ * \param[in]   xs      x position in the draw buffer
+ * \param[in]   ys      y position in the draw buffer
+ * \param[in]   xi      x position on the canvas
+ * \param[in]   yi      y position on the canvas
+ * \param[in]   w       width of the area
+ * \param[in]   h       height of the area
+ */
+void video_canvas_refresh_frame(video_canvas_t *canvas,
+                                unsigned int xs, unsigned int ys,
+                                unsigned int xi, unsigned int yi,
+                                unsigned int w, unsigned int h)
+{
+    refresh_thread_t *t = find_thread(canvas);
+    draw_buffer_t *db = canvas->draw_buffer;
+    size_t size;
+
+    if (t == NULL || canvas->videoconfig->interlaced) {
+        if (t != NULL) {
+            wait_idle(t);
+        }
+        video_canvas_refresh(canvas, xs, ys, xi, yi, w, h);
+        return;
+    }
+
+    if (wait_idle(t)) {
+        t->stalls++;
+    }
+
+    /* the thread is idle, hand it a copy of the frame */
+    size = (size_t)db->draw_buffer_width * (db->draw_buffer_height + 2 * REFRESH_PADDING_LINES);
+    if (t->frame_size < size) {
+        t->frame = lib_realloc(t->frame, size);
+        t->frame_size = size;
+    }
+    memcpy(t->frame, db->draw_buffer - REFRESH_PADDING_LINES * db->draw_buffer_width, size);
+    t->pitch = db->draw_buffer_width;
+
+    t->xs = xs;
+    t->ys = ys;
+    t->xi = xi;
+    t->yi = yi;
+    t->w = w;
+    t->h = h;
+    t->frames++;
+
+    pthread_mutex_lock(&t->lock);
+    t->busy = true;
+    pthread_cond_broadcast(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+}
+
+#else /* USE_VICE_THREAD */
+
+/* without threads every frame is refreshed right away */
+
+int video_canvas_refresh_thread_start(video_canvas_t *canvas)
+{
+    return -1;
+}
+
+void video_canvas_refresh_thread_stop(video_canvas_t *canvas)
+{
+}
+
+void video_canvas_refresh_thread_wait(video_canvas_t *canvas)
+{
+}
+
+uint8_t *video_canvas_refresh_thread_source(video_canvas_t *canvas)
+{
+    return NULL;
+}
+
+void video_canvas_refresh_frame(video_canvas_t *canvas,
+                                unsigned int xs, unsigned int ys,
+                                unsigned int xi, unsigned int yi,
+                                unsigned int w, unsigned int h)
+{
+    video_canvas_refresh(canvas, xs, ys, xi, yi, w, h);
+}
+
+#endif